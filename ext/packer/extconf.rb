@@ -0,0 +1,84 @@
+# Copyright (c) 2012 David Love
+#
+# Permission to use, copy, modify, and/or distribute this software for 
+# any purpose with or without fee is hereby granted, provided that the 
+# above copyright notice and this permission notice appear in all copies.
+#
+# THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES 
+# WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF 
+# MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR 
+# ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES 
+# WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN 
+# ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF 
+# OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+#
+# encoding: utf-8
+
+###
+### Ruby Extension. Builds the Packer library (and the bstring library it
+### needs) straight into the extension, so nothing else has to be built
+### position independent. The config.h written by the CMake configure
+### step (see +bootstrap+) is used if there is one; otherwise, as when
+### the gem is installed, one is written here from config.h.in.
+###
+
+require 'mkmf'
+
+root = File.expand_path('../..', File.dirname(__FILE__))
+
+## Where the sources live. Each can be overridden with --with-<name>-dir
+packer_dir = with_config('packer-dir', File.join(root, 'src', 'lib', 'packer'))
+config_dir = with_config('config-dir', File.join(root, 'src', 'lib', 'config'))
+bstring_dir = with_config('bstring-dir', File.join(root, 'src', 'lib', 'bstring'))
+
+## Each #cmakedefine of config.h.in is probed for as CMake would: headers
+## by their names (HAVE_SYS_MMAN_H is sys/mman.h), and functions likewise
+unless File.exist?(File.join(config_dir, 'config.h'))
+  template = File.join(config_dir, 'config.h.in')
+
+  unless File.exist?(template)
+    abort "Cannot find config.h or config.h.in in #{config_dir}"
+  end
+
+  config = File.read(template).gsub(/^#cmakedefine (\w+)(.*)$/) do
+    name, value = $1, $2
+
+    found = case name
+            when 'HAVE_64_BIT' then [nil].pack('p').size == 8
+            when 'HAVE_BIG_ENDIAN' then [1].pack('s') == [1].pack('n')
+            when 'BSTRLIB_VSNP_OK' then have_func('vsnprintf', 'stdio.h')
+            when /\AHAVE_(SYS|LINUX)_(\w+)_H\z/ then have_header("#{$1.downcase}/#{$2.downcase}.h")
+            when /\AHAVE_(\w+)_H\z/ then have_header("#{$1.downcase}.h")
+            when /\AHAVE_(\w+)\z/ then have_func($1.downcase)
+            end
+
+    found ? "#define #{name}#{value}" : "/* #undef #{name} */"
+  end
+
+  File.open('config.h', 'w') { |file| file.write(config) }
+  config_dir = Dir.pwd
+end
+
+bstring_source = Dir.glob(File.join(bstring_dir, '**', 'bstrlib.c')).first
+bstring_header = Dir.glob(File.join(bstring_dir, '**', 'bstring', 'bstrlib.h')).first
+
+unless bstring_source && bstring_header
+  abort "Cannot find the bstring library in #{bstring_dir}: run 'git submodule update --init'"
+end
+
+## The library sources are compiled alongside the binding
+sources = Dir.glob(File.join(packer_dir, '*.c')).sort + [bstring_source]
+
+$VPATH.concat(sources.map { |source| File.dirname(source) }.uniq)
+$srcs = ['packer.c'] + sources.map { |source| File.basename(source) }
+
+$INCFLAGS << " -I#{config_dir}"
+$INCFLAGS << " -I#{File.join(packer_dir, 'include')}"
+$INCFLAGS << " -I#{File.dirname(File.dirname(bstring_header))}"
+
+have_library('pthread')
+have_library('m')
+
+abort "This Ruby cannot release the GVL" unless have_func('rb_thread_call_without_gvl', 'ruby/thread.h')
+
+create_makefile('packer')
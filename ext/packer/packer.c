@@ -0,0 +1,387 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file packer.c
+*** \brief Ruby binding to the Packer library
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/**
+*** Ruby Extension. Makes the Packer library available in-process as
+*** Packer::Context, so the publishing scripts need not start a ppack
+*** for every page:
+***
+***   context = Packer::Context.new(:backend => "html", :max_depth => 64)
+***   context.compile(File.read("Welcome.byx"), "Welcome.pdoc")
+***   html = context.render(File.read("Welcome.byx"))
+***
+*** Each context wraps a pk_context, and so keeps its highlighter and
+*** manual page index across pages. The page is copied out of the Ruby
+*** string, and compiled or rendered with the GVL released, so several
+*** Ruby threads (one context each) compile in parallel. A context is
+*** only ever used by one thread at a time: a second caller is refused.
+*** Thread#kill, or an interrupt, gives up the page being worked on.
+**/
+
+/* Ruby comes before config.h here, as ruby.h must be included first; the
+ * HAVE_ macros the two share are defined to the same values
+ */
+#include "ruby.h"
+#include "ruby/thread.h"
+#include "ruby/encoding.h"
+
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/context.h"
+#include "packer/doc.h"
+#include "packer/render.h"
+
+static VALUE packer_error;
+
+/**
+*** Contexts
+**/
+
+struct binding {
+  struct pk_context* context;   /*< The library context */
+  int                busy;      /*< Non-zero while a page is being worked on */
+  };
+
+static void binding_free (void* data) {
+  struct binding* binding = (struct binding*) data;
+
+  pk_context_free (binding->context);
+  xfree (binding);
+  }
+
+static size_t binding_size (const void* data) {
+  (void) data;
+  return sizeof (struct binding);
+  }
+
+static const rb_data_type_t binding_type = {
+  "Packer::Context",
+  { NULL, binding_free, binding_size, },
+  NULL, NULL, RUBY_TYPED_FREE_IMMEDIATELY
+  };
+
+static VALUE context_alloc (VALUE klass) {
+  struct binding* binding;
+  VALUE self = TypedData_Make_Struct (klass, struct binding, &binding_type, binding);
+
+  binding->context = pk_context_new ();
+
+  if (binding->context == NULL) {
+    rb_raise (rb_eNoMemError, "cannot allocate a Packer context");
+    }
+
+  return self;
+  }
+
+/* The context of self, which must not be busy. Arguments are converted
+ * before this is called, as converting them may run Ruby code, and so let
+ * another thread start work on the context
+ */
+static struct pk_context* context_of (VALUE self) {
+  struct binding* binding = (struct binding*) rb_check_typeddata (self, &binding_type);
+
+  if (binding->busy) {
+    rb_raise (packer_error, "the context is in use by another thread");
+    }
+
+  return binding->context;
+  }
+
+/* A limit from the options: nil leaves the limit alone, zero removes it */
+static void get_limit (VALUE options, const char* name, size_t* limit) {
+  VALUE value = rb_hash_aref (options, ID2SYM (rb_intern (name)));
+
+  if (!NIL_P (value)) {
+    *limit = NUM2SIZET (value);
+    }
+  }
+
+/* The backend and manual page index may be given by name */
+static VALUE context_set_backend (VALUE self, VALUE name) {
+  const char* backend = StringValueCStr (name);
+
+  if (pk_context_backend (context_of (self), backend) != PK_OK) {
+    rb_raise (rb_eArgError, "unknown backend '%s'", backend);
+    }
+
+  return name;
+  }
+
+static VALUE context_set_man_index (VALUE self, VALUE path) {
+  const char* index = NIL_P (path) ? NULL : StringValueCStr (path);
+
+  if (pk_context_man_index (context_of (self), index) != PK_OK) {
+    rb_raise (packer_error, "cannot open the manual page index '%s'", index);
+    }
+
+  return path;
+  }
+
+/* Context.new(options = {}): the options are :backend, :man_index,
+ * :max_depth, :max_nodes and :max_output
+ */
+static VALUE context_initialize (int argc, VALUE* argv, VALUE self) {
+  struct pk_context* context;
+  struct pk_limits limits;
+  VALUE options;
+  VALUE value;
+
+  rb_scan_args (argc, argv, "01", &options);
+
+  if (NIL_P (options)) {
+    return self;
+    }
+
+  Check_Type (options, T_HASH);
+  limits = context_of (self)->limits;
+  get_limit (options, "max_depth", &limits.depth);
+  get_limit (options, "max_nodes", &limits.tokens);
+  get_limit (options, "max_output", &limits.output);
+
+  context = context_of (self);
+  context->limits.depth = limits.depth;
+  context->limits.tokens = limits.tokens;
+  context->limits.output = limits.output;
+
+  if (!NIL_P (value = rb_hash_aref (options, ID2SYM (rb_intern ("backend"))))) {
+    context_set_backend (self, value);
+    }
+
+  if (!NIL_P (value = rb_hash_aref (options, ID2SYM (rb_intern ("man_index"))))) {
+    context_set_man_index (self, value);
+    }
+
+  return self;
+  }
+
+/**
+*** Work. Pages are compiled and rendered without the GVL, from copies of
+*** the Ruby strings, as other threads may change or move the originals.
+*** The context is claimed just before the GVL is released, and let go
+*** (with the copies) however the work ends
+**/
+
+struct work {
+  struct binding* binding;    /*< The context to work in */
+  void* (*fn) (void*);        /*< What to do with the page */
+  char*           source;     /*< Copy of the page */
+  size_t          len;        /*< Length of the page */
+  char*           output;     /*< Copy of the path of the .pdoc to write (compile only) */
+  size_t          nodes;      /*< Nodes compiled */
+  bstring         result;     /*< Rendered page (render only) */
+  int             status;     /*< PK_OK or PK_ERR */
+  volatile int    cancel;     /*< Set to give up the page */
+  };
+
+static void* compile_page (void* data) {
+  struct work* work = (struct work*) data;
+  const struct pk_doc* doc = pk_context_compile (work->binding->context, work->source, work->len);
+
+  work->status = doc && pk_doc_write (doc, work->output) == PK_OK ? PK_OK : PK_ERR;
+  work->nodes = doc ? doc->count : 0;
+  return NULL;
+  }
+
+static void* render_page (void* data) {
+  struct work* work = (struct work*) data;
+
+  work->result = pk_context_render_string (work->binding->context, work->source, work->len);
+  work->status = work->result ? PK_OK : PK_ERR;
+  return NULL;
+  }
+
+/* Called by Ruby, from another thread, to interrupt the work */
+static void cancel_work (void* data) {
+  ( (struct work*) data)->cancel = 1;
+  }
+
+/* Copy a Ruby string (already converted with StringValue) into a new
+ * malloc'ed, NUL terminated buffer. Returns NULL if out of memory
+ */
+static char* copy_string (VALUE string, size_t* len) {
+  char* copy;
+
+  *len = (size_t) RSTRING_LEN (string);
+  copy = (char*) malloc (*len + 1);
+
+  if (copy != NULL) {
+    memcpy (copy, RSTRING_PTR (string), *len);
+    copy[*len] = '\0';
+    }
+
+  return copy;
+  }
+
+/* Do the work without the GVL. A rendered page is turned into a Ruby
+ * string here, so that it is released by finish_work whatever happens
+ */
+static VALUE start_work (VALUE data) {
+  struct work* work = (struct work*) data;
+
+  work->binding->context->limits.cancel = &work->cancel;
+  rb_thread_call_without_gvl (work->fn, work, cancel_work, work);
+
+  if (work->status == PK_OK && work->result != NULL) {
+    return rb_utf8_str_new ( (const char*) work->result->data, blength (work->result));
+    }
+
+  return Qnil;
+  }
+
+static VALUE finish_work (VALUE data) {
+  struct work* work = (struct work*) data;
+
+  work->binding->context->limits.cancel = NULL;
+  work->binding->busy = 0;
+  free (work->source);
+  free (work->output);
+  bdestroy (work->result);
+  work->source = NULL;
+  work->output = NULL;
+  work->result = NULL;
+  return Qnil;
+  }
+
+/* Run fn over the copied page, holding the context for the duration. The
+ * context is tested and claimed with no Ruby code run in between, so no
+ * other thread can claim it too. Returns the rendered page, if any
+ */
+static VALUE run_work (VALUE self, struct work* work, void* (*fn) (void*)) {
+  struct binding* binding = (struct binding*) rb_check_typeddata (self, &binding_type);
+
+  if (work->source == NULL || (fn == compile_page && work->output == NULL)) {
+    free (work->source);
+    free (work->output);
+    rb_raise (rb_eNoMemError, "cannot copy the page");
+    }
+
+  if (binding->busy) {
+    free (work->source);
+    free (work->output);
+    rb_raise (packer_error, "the context is in use by another thread");
+    }
+
+  binding->busy = 1;
+  work->binding = binding;
+  work->fn = fn;
+  return rb_ensure (start_work, (VALUE) work, finish_work, (VALUE) work);
+  }
+
+/* Raise the error for a page that failed, naming any limit reached */
+static void raise_failure (struct pk_context* context, const char* what) {
+  if (context->limited & PK_LIMIT_TOKENS) {
+    rb_raise (packer_error, "cannot %s the page: it has too many tokens", what);
+    }
+
+  if (context->limited & PK_LIMIT_OUTPUT) {
+    rb_raise (packer_error, "cannot %s the page: the output is too large", what);
+    }
+
+  if (context->limited & PK_LIMIT_CANCEL) {
+    rb_raise (packer_error, "cannot %s the page: it was interrupted", what);
+    }
+
+  rb_raise (packer_error, "cannot %s the page", what);
+  }
+
+/* compile(source, path): compile the page, writing it to the .pdoc file
+ * at path. Returns the number of nodes
+ */
+static VALUE context_compile (VALUE self, VALUE source, VALUE path) {
+  struct work work;
+  size_t len;
+
+  /* Converting the arguments may run Ruby code, so comes first */
+  StringValue (source);
+  FilePathValue (path);
+  memset (&work, 0, sizeof (work));
+  work.output = copy_string (path, &len);
+  work.source = copy_string (source, &work.len);
+  run_work (self, &work, compile_page);
+
+  if (work.status != PK_OK) {
+    raise_failure (work.binding->context, "compile");
+    }
+
+  return SIZET2NUM (work.nodes);
+  }
+
+/* render(source): render the page with the backend of the context */
+static VALUE context_render (VALUE self, VALUE source) {
+  struct work work;
+  VALUE result;
+
+  StringValue (source);
+  memset (&work, 0, sizeof (work));
+  work.source = copy_string (source, &work.len);
+  result = run_work (self, &work, render_page);
+
+  if (work.status != PK_OK) {
+    raise_failure (work.binding->context, "render");
+    }
+
+  return result;
+  }
+
+/* The number of footnotes of the page last rendered */
+static VALUE context_notes (VALUE self) {
+  return INT2NUM (context_of (self)->notes);
+  }
+
+/* Whether the last page nested tags past the depth limit */
+static VALUE context_too_deep (VALUE self) {
+  return (context_of (self)->limited & PK_LIMIT_DEPTH) ? Qtrue : Qfalse;
+  }
+
+/* The number of pages compiled or rendered so far */
+static VALUE context_pages (VALUE self) {
+  return SIZET2NUM (context_of (self)->pages);
+  }
+
+void Init_packer (void) {
+  VALUE packer = rb_define_module ("Packer");
+  VALUE context = rb_define_class_under (packer, "Context", rb_cObject);
+
+  packer_error = rb_define_class_under (packer, "Error", rb_eStandardError);
+
+  rb_define_alloc_func (context, context_alloc);
+  rb_define_method (context, "initialize", context_initialize, -1);
+  rb_define_method (context, "backend=", context_set_backend, 1);
+  rb_define_method (context, "man_index=", context_set_man_index, 1);
+  rb_define_method (context, "compile", context_compile, 2);
+  rb_define_method (context, "render", context_render, 1);
+  rb_define_method (context, "notes", context_notes, 0);
+  rb_define_method (context, "too_deep?", context_too_deep, 0);
+  rb_define_method (context, "pages", context_pages, 0);
+  }
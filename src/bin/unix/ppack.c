@@ -22,6 +22,8 @@
 
 /* Include the standard library */
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 
 /* Include the POSIX path functions */
 #include <libgen.h>
@@ -33,6 +35,1677 @@
 /* Option processing is done via argtable */
 #include "argtable2.h"
 
+/* Include the Packer library */
+#include "packer/archive.h"
+#include "packer/asset.h"
+#include "packer/context.h"
+#include "packer/cpu.h"
+#include "packer/diff.h"
+#include "packer/doc.h"
+#include "packer/highlight.h"
+#include "packer/io.h"
+#include "packer/latency.h"
+#include "packer/lexer.h"
+#include "packer/manindex.h"
+#include "packer/meta.h"
+#include "packer/nav.h"
+#include "packer/perf.h"
+#include "packer/pool.h"
+#include "packer/query.h"
+#include "packer/render.h"
+#include "packer/span.h"
+
+/**
+*** Site Navigation. Patch the saved navigation graph with the current
+*** state of one page, and rewrite the navigation (+.nav+) files of just
+*** those pages whose navigation changed as a result. Pages whose source
+*** has gone since the graph was saved are dropped from it first.
+**/
+
+/* Whether the page at path (named from the root, or as given if it lies
+ * outside the root) can still be opened
+ */
+static int page_exists (const char* root, size_t root_len, const_bstring path) {
+  bstring source = root_len ? bformat ("%s/%s", root, bdata (path)) : NULL;
+  FILE* file = fopen (source ? bdata (source) : bdata (path), "r");
+
+  if (file == NULL && source != NULL) {
+    file = fopen (bdata (path), "r");
+    }
+
+  if (file != NULL) {
+    fclose (file);
+    }
+
+  bdestroy (source);
+  return file != NULL;
+  }
+
+/* Remove the pages of the graph whose source can no longer be opened,
+ * returning the number removed (or -1 on error)
+ */
+static int remove_missing_pages (struct pk_nav* nav, const char* root, size_t root_len) {
+  struct pk_nav_page* page = pk_nav_first (nav);
+  int removed = 0;
+
+  while (page != NULL) {
+    struct pk_nav_page* next = pk_nav_next (page);
+    bstring path;
+
+    if (!page_exists (root, root_len, page->path)) {
+      /* The page, and its path with it, is freed on removal */
+      path = bstrcpy (page->path);
+
+      if (path == NULL || pk_nav_remove (nav, bdata (path)) != PK_OK) {
+        bdestroy (path);
+        return -1;
+        }
+
+      bdestroy (path);
+      removed++;
+      }
+
+    page = next;
+    }
+
+  return removed;
+  }
+static int update_navigation (const char* state_path, const char* root, const char* input_path, int verbose) {
+  struct pk_nav* nav;
+  struct pk_meta_cache* cache;
+  struct pk_meta meta;
+  struct pk_nav_outline outline;
+  struct pk_nav_page* page;
+  const struct pk_span* value;
+  const char* page_path = input_path;
+  bstring title = NULL;
+  bstring text = NULL;
+  bstring nav_path = NULL;
+  char* source;
+  size_t source_len;
+  size_t root_len = root ? strlen (root) : 0;
+  int weight = 0;
+  int written = 0;
+  int removed = 0;
+  int status = 0;
+  FILE* file;
+
+  nav = pk_nav_new ();
+  cache = pk_meta_cache_new (root);
+
+  if (nav == NULL || cache == NULL) {
+    fprintf (stderr, "Allocation of the navigation graph failed\n");
+    pk_nav_free (nav);
+    pk_meta_cache_free (cache);
+    return 10;
+    }
+
+  /* Start from the saved graph, if there is one */
+  file = fopen (state_path, "r");
+
+  if (file != NULL) {
+    if (pk_nav_load (nav, file) != PK_OK) {
+      fprintf (stderr, "Ignoring unreadable navigation state '%s'\n", state_path);
+      pk_nav_free (nav);
+      nav = pk_nav_new ();
+      }
+
+    fclose (file);
+    }
+
+  /* Pages are named relative to the site root */
+  if (root_len > 0 && strncmp (input_path, root, root_len) == 0 && input_path[root_len] == '/') {
+    page_path = input_path + root_len + 1;
+    }
+
+  /* The title and position of the page come from its front-matter */
+  pk_meta_init (&meta);
+  pk_nav_outline_init (&outline);
+
+  if (pk_meta_cache_document (cache, input_path, &meta) == PK_OK) {
+    if ( (value = pk_meta_get_own (&meta, "title")) != NULL) {
+      title = blk2bstr (value->data, (int) value->len);
+      }
+
+    if ( (value = pk_meta_get_own (&meta, "order")) != NULL && (text = blk2bstr (value->data, (int) value->len)) != NULL) {
+      weight = atoi ( (const char*) text->data);
+      bdestroy (text);
+      text = NULL;
+      }
+    }
+
+  /* Pages removed from the site leave the graph, and their neighbours are
+   * written again below
+   */
+  removed = nav ? remove_missing_pages (nav, root, root_len) : 0;
+
+  if (removed < 0) {
+    fprintf (stderr, "Cannot check the pages of the navigation state '%s'\n", state_path);
+    status = 10;
+    source = NULL;
+    goto cleanup;
+    }
+
+  source = pk_read_file (input_path, &source_len);
+
+  if (nav == NULL || source == NULL || pk_nav_scan (source, source_len, &outline) != PK_OK ||
+      pk_nav_update (nav, page_path, title ? bdata (title) : NULL, weight, &outline) != PK_OK) {
+    fprintf (stderr, "Cannot update the navigation for '%s'\n", input_path);
+    status = 10;
+    goto cleanup;
+    }
+
+  /* Write the navigation of every page affected by the change */
+  text = bfromcstr ("");
+
+  while (text != NULL && (page = pk_nav_take_dirty (nav)) != NULL) {
+    int index;
+
+    page->dirty = 0;
+    bdestroy (nav_path);
+    nav_path = root_len ? bformat ("%s/%s", root, bdata (page->path)) : bstrcpy (page->path);
+    index = nav_path ? bstrrchr (nav_path, '.') : BSTR_ERR;
+
+    if (index != BSTR_ERR && bstrrchr (nav_path, '/') < index) {
+      btrunc (nav_path, index);
+      }
+
+    btrunc (text, 0);
+
+    if (nav_path == NULL || bcatcstr (nav_path, ".nav") != BSTR_OK || pk_nav_format (page, text) != PK_OK ||
+        (file = fopen (bdata (nav_path), "w")) == NULL) {
+      fprintf (stderr, "Cannot write the navigation for '%s'\n", bdata (page->path));
+      status = 10;
+      continue;
+      }
+
+    fwrite (text->data, 1, (size_t) blength (text), file);
+    fclose (file);
+    written++;
+    }
+
+  if (verbose) {
+    printf ("Navigation updated for %d page(s), %d missing page(s) removed\n", written, removed);
+    }
+
+  /* Save the patched graph for the next run */
+  file = fopen (state_path, "w");
+
+  if (file == NULL || pk_nav_save (nav, file) != PK_OK) {
+    fprintf (stderr, "Cannot save the navigation state '%s'\n", state_path);
+    status = 10;
+    }
+
+  if (file != NULL) {
+    fclose (file);
+    }
+
+cleanup:
+  free (source);
+  bdestroy (title);
+  bdestroy (text);
+  bdestroy (nav_path);
+  pk_nav_outline_clear (&outline);
+  pk_meta_clear (&meta);
+  pk_meta_cache_free (cache);
+  pk_nav_free (nav);
+  return status;
+  }
+
+/**
+*** Image Assets. Resolve the images referred to by the page, and copy
+*** each distinct image once into the asset directory under a name
+*** derived from its content.
+**/
+static int process_assets (const char* output_dir, const char* cache_path, const char* root, const char* input_path,
+                           int jobs, int verbose) {
+  struct pk_assets* assets;
+  struct pk_asset* asset;
+  char* source;
+  size_t source_len;
+  size_t i;
+  int failed;
+  int status = 0;
+  FILE* file;
+
+  assets = pk_assets_new (output_dir, root, jobs);
+  source = pk_read_file (input_path, &source_len);
+
+  if (assets == NULL || source == NULL) {
+    fprintf (stderr, "Cannot read the images of '%s'\n", input_path);
+    pk_assets_free (assets);
+    free (source);
+    return 10;
+    }
+
+  /* Dimensions measured on earlier runs save reading unchanged images */
+  if (cache_path != NULL && (file = fopen (cache_path, "r")) != NULL) {
+    if (pk_assets_load_cache (assets, file) != PK_OK) {
+      fprintf (stderr, "Ignoring unreadable asset cache '%s'\n", cache_path);
+      }
+
+    fclose (file);
+    }
+
+  if (pk_assets_collect (assets, input_path, source, source_len) != PK_OK ||
+      (failed = pk_assets_process (assets)) == PK_ERR) {
+    fprintf (stderr, "Cannot process the images of '%s'\n", input_path);
+    status = 10;
+    goto cleanup;
+    }
+
+  for (i = 0; i < pk_assets_count (assets); i++) {
+    asset = pk_assets_get (assets, i);
+
+    if (asset->state == PK_ASSET_MISSING) {
+      fprintf (stderr, "%s: cannot find the image '%s'\n", input_path, bdata (asset->name));
+      }
+
+    else if (asset->state == PK_ASSET_FAILED) {
+      fprintf (stderr, "%s: cannot copy the image '%s'\n", input_path, bdata (asset->source));
+      }
+
+    else if (verbose) {
+      printf ("%s -> %s (%dx%d)\n", bdata (asset->source), bdata (asset->target), asset->width, asset->height);
+      }
+    }
+
+  if (failed > 0) {
+    status = 10;
+    }
+
+  if (cache_path != NULL) {
+    file = fopen (cache_path, "w");
+
+    if (file == NULL || pk_assets_save_cache (assets, file) != PK_OK) {
+      fprintf (stderr, "Cannot save the asset cache '%s'\n", cache_path);
+      status = 10;
+      }
+
+    if (file != NULL) {
+      fclose (file);
+      }
+    }
+
+cleanup:
+  free (source);
+  pk_assets_free (assets);
+  return status;
+  }
+
+/**
+*** Code Listings. Highlight the body of each +[code lang|line]+ block in
+*** the page, and write the results to a listings file as HTML. The
+*** highlighter is that of the context, so rendering the page afterwards
+*** finds the listings in its cache.
+**/
+static int write_listings (struct pk_highlighter* hl, const char* listings_path, const char* input_path, int verbose) {
+  struct pk_lexer lexer;
+  struct pk_token token;
+  struct pk_span lang;
+  const struct pk_hl_fragment* fragment;
+  bstring html;
+  char* source;
+  size_t source_len;
+  size_t hits;
+  size_t misses;
+  int first_line = 0;
+  int in_code = 0;
+  int type;
+  int status = 0;
+  FILE* file;
+
+  source = pk_read_file (input_path, &source_len);
+  html = bfromcstr ("");
+
+  if (source == NULL || html == NULL) {
+    fprintf (stderr, "Cannot read the listings of '%s'\n", input_path);
+    free (source);
+    bdestroy (html);
+    return 10;
+    }
+
+  lang.data = NULL;
+  lang.len = 0;
+  pk_lexer_init (&lexer, source, source_len);
+
+  while (status == 0 && (type = pk_lexer_next (&lexer, &token)) != PK_TOKEN_EOF) {
+    if (type == PK_ERR) {
+      status = 10;
+      }
+
+    else if (type == PK_TOKEN_OPEN && token.tag == PK_TAG_CODE) {
+      pk_highlight_args (token.args, &lang, &first_line);
+      in_code = 1;
+      }
+
+    else if (type == PK_TOKEN_TEXT && in_code) {
+      /* The body starts on the line after the tag */
+      if (token.text.len > 0 && token.text.data[0] == '\n') {
+        token.text = pk_span_mid (token.text, 1, token.text.len);
+        }
+
+      fragment = pk_highlight (hl, lang, token.text.data, token.text.len);
+
+      if (fragment == NULL || bformata (html, "<pre class=\"hl hl-%.*s\">", (int) lang.len, lang.data) != BSTR_OK ||
+          pk_highlight_html (fragment, first_line, html) != PK_OK || bcatcstr (html, "</pre>\n") != BSTR_OK) {
+        status = 10;
+        }
+      }
+
+    else if (type == PK_TOKEN_END) {
+      in_code = 0;
+      }
+    }
+
+  pk_lexer_clear (&lexer);
+
+  if (status == 0) {
+    file = fopen (listings_path, "w");
+
+    if (file == NULL || fwrite (html->data, 1, (size_t) blength (html), file) != (size_t) blength (html)) {
+      status = 10;
+      }
+
+    if (file != NULL && fclose (file) != 0) {
+      status = 10;
+      }
+    }
+
+  if (status != 0) {
+    fprintf (stderr, "Cannot write the listings of '%s' to '%s'\n", input_path, listings_path);
+    }
+
+  else if (verbose) {
+    pk_highlight_stats (hl, &hits, &misses);
+    printf ("Highlighted %lu listing(s), %lu from the cache\n", (unsigned long) (hits + misses), (unsigned long) hits);
+    }
+
+  free (source);
+  bdestroy (html);
+  return status;
+  }
+
+/**
+*** Manual Pages. Resolve each +[man:N name]+ reference in the page
+*** against the manual page index, building the index first if asked to
+*** (or if there is no index yet). Unknown pages are reported.
+**/
+static int resolve_man_pages (const char* index_path, const char* manpath, const char* list_path,
+                              const char* url_template, const char* input_path, int verbose) {
+  struct pk_man_builder* builder;
+  struct pk_man_index* index;
+  struct pk_lexer lexer;
+  struct pk_token token;
+  struct pk_span name;
+  struct pk_span section;
+  const char* url;
+  bstring text = NULL;
+  char* source;
+  size_t source_len;
+  int line = 0;
+  int unknown = 0;
+  int type;
+  int status = 0;
+  FILE* file;
+
+  index = manpath || list_path ? NULL : pk_man_index_open (index_path);
+
+  /* Build the index once: later runs just map it */
+  if (index == NULL) {
+    builder = pk_man_builder_new (url_template);
+
+    if (manpath == NULL && list_path == NULL) {
+      manpath = getenv ("MANPATH") ? getenv ("MANPATH") : "/usr/share/man:/usr/local/share/man";
+      }
+
+    if (builder == NULL || (manpath != NULL && pk_man_builder_scan (builder, manpath) != PK_OK)) {
+      status = 10;
+      }
+
+    if (status == 0 && list_path != NULL) {
+      file = fopen (list_path, "r");
+
+      if (file == NULL || pk_man_builder_read_list (builder, file) != PK_OK) {
+        fprintf (stderr, "Cannot read the manual page list '%s'\n", list_path);
+        status = 10;
+        }
+
+      if (file != NULL) {
+        fclose (file);
+        }
+      }
+
+    if (status == 0 && pk_man_builder_write (builder, index_path) != PK_OK) {
+      fprintf (stderr, "Cannot write the manual page index '%s'\n", index_path);
+      status = 10;
+      }
+
+    if (status == 0 && verbose) {
+      printf ("Indexed %lu manual page(s)\n", (unsigned long) pk_man_builder_count (builder));
+      }
+
+    pk_man_builder_free (builder);
+    index = status == 0 ? pk_man_index_open (index_path) : NULL;
+    }
+
+  if (index == NULL) {
+    fprintf (stderr, "Cannot open the manual page index '%s'\n", index_path);
+    return 10;
+    }
+
+  source = pk_read_file (input_path, &source_len);
+
+  if (source == NULL) {
+    fprintf (stderr, "Cannot read '%s'\n", input_path);
+    pk_man_index_close (index);
+    return 10;
+    }
+
+  section.data = NULL;
+  section.len = 0;
+  pk_lexer_init (&lexer, source, source_len);
+
+  while (status == 0 && (type = pk_lexer_next (&lexer, &token)) != PK_TOKEN_EOF) {
+    if (type == PK_ERR) {
+      status = 10;
+      }
+
+    else if (type == PK_TOKEN_OPEN && token.tag == PK_TAG_MAN) {
+      section = token.label;
+      line = token.line;
+      bdestroy (text);
+      text = bfromcstr ("");
+      status = text ? 0 : 10;
+      }
+
+    else if (type == PK_TOKEN_TEXT && text != NULL) {
+      status = bcatblk (text, token.text.data, (int) token.text.len) == BSTR_OK ? 0 : 10;
+      }
+
+    else if (type == PK_TOKEN_CLOSE && token.tag == PK_TAG_MAN && text != NULL) {
+      btrimws (text);
+      name.data = (const char*) text->data;
+      name.len = (size_t) blength (text);
+      url = pk_man_index_lookup (index, name, section);
+
+      if (url == NULL) {
+        fprintf (stderr, "%s:%d: unknown manual page '%s(%.*s)'\n", input_path, line, bdata (text),
+                 (int) section.len, section.data);
+        unknown++;
+        }
+
+      else if (verbose) {
+        printf ("%s(%.*s) -> %s\n", bdata (text), (int) section.len, section.data, url);
+        }
+
+      bdestroy (text);
+      text = NULL;
+      }
+    }
+
+  if (verbose && status == 0) {
+    printf ("%d unknown manual page reference(s)\n", unknown);
+    }
+
+  pk_lexer_clear (&lexer);
+  bdestroy (text);
+  free (source);
+  pk_man_index_close (index);
+  return status;
+  }
+
+/* Report the CPU features found, and the variant each kernel runs */
+static void report_cpu_features (void) {
+  bstring detected = bfromcstr ("");
+  bstring kernels = bfromcstr ("");
+
+  if (detected != NULL && kernels != NULL && pk_cpu_describe (detected, pk_cpu_detected ()) == PK_OK &&
+      pk_cpu_describe_kernels (kernels) == PK_OK) {
+    printf ("CPU features: %s (running %s)\n", bdata (detected), bdata (kernels));
+    }
+
+  bdestroy (kernels);
+  bdestroy (detected);
+  }
+
+/* Print one row of the counter report: the counts of a phase, its
+ * instructions per cycle and its misses per KB of source. Events the host
+ * does not count are shown as '-'
+ */
+static void report_phase (const struct pk_perf* perf, const char* name, const uint64_t* count) {
+  static const int rates[] = { PK_PERF_BRANCH_MISSES, PK_PERF_L1_MISSES, PK_PERF_LLC_MISSES };
+  double kb = (double) perf->input / 1024;
+  size_t i;
+
+  printf ("  %-8s", name);
+
+  if (pk_perf_has (perf, PK_PERF_CYCLES)) {
+    printf (" %14.0f", (double) count[PK_PERF_CYCLES]);
+    }
+
+  else {
+    printf (" %14s", "-");
+    }
+
+  if (pk_perf_has (perf, PK_PERF_INSTRUCTIONS)) {
+    printf (" %14.0f", (double) count[PK_PERF_INSTRUCTIONS]);
+    }
+
+  else {
+    printf (" %14s", "-");
+    }
+
+  if (pk_perf_has (perf, PK_PERF_CYCLES) && pk_perf_has (perf, PK_PERF_INSTRUCTIONS) && count[PK_PERF_CYCLES] > 0) {
+    printf (" %6.2f", (double) count[PK_PERF_INSTRUCTIONS] / (double) count[PK_PERF_CYCLES]);
+    }
+
+  else {
+    printf (" %6s", "-");
+    }
+
+  for (i = 0; i < sizeof (rates) / sizeof (rates[0]); i++) {
+    if (pk_perf_has (perf, rates[i]) && kb > 0) {
+      printf (" %12.1f", (double) count[rates[i]] / kb);
+      }
+
+    else {
+      printf (" %12s", "-");
+      }
+    }
+
+  if (pk_perf_has (perf, PK_PERF_TIME)) {
+    printf (" %10.3f\n", (double) count[PK_PERF_TIME] / 1e6);
+    }
+
+  else {
+    printf (" %10s\n", "-");
+    }
+  }
+
+/* Report the counters of each phase counted, then of them all */
+static void report_perf (const struct pk_perf* perf) {
+  uint64_t total[PK_PERF_EVENTS];
+  const char* lead = "Not counted on this host: ";
+  int phase;
+  int i;
+
+  memset (total, 0, sizeof (total));
+
+  if (perf->input > 0) {
+    printf ("Performance counters, over %lu byte(s) of source (misses per KB):\n", (unsigned long) perf->input);
+    }
+
+  else {
+    printf ("Performance counters:\n");
+    }
+
+  printf ("  %-8s %14s %14s %6s %12s %12s %12s %10s\n", "phase", "cycles", "instructions", "IPC", "branch", "L1 data",
+          "last level", "time (ms)");
+
+  for (phase = 0; phase < PK_PHASES; phase++) {
+    if (perf->runs[phase] > 0) {
+      report_phase (perf, pk_phase_names[phase], perf->count[phase]);
+
+      for (i = 0; i < PK_PERF_EVENTS; i++) {
+        total[i] += perf->count[phase][i];
+        }
+      }
+    }
+
+  report_phase (perf, "total", total);
+
+  for (i = 0; i < PK_PERF_EVENTS; i++) {
+    if (!pk_perf_has (perf, i)) {
+      printf ("%s%s", lead, pk_perf_event_names[i]);
+      lead = ", ";
+      }
+    }
+
+  if (strcmp (lead, ", ") == 0) {
+    printf ("\n");
+    }
+  }
+
+/* Report what each kind of tag cost in one pass, dearest first. A pass
+ * that handled no tokens is left out
+ */
+static void report_tag_costs (const struct pk_tag_costs* costs, const char* pass, const char* bytes) {
+  int order[PK_TAG_COUNT + 1];
+  uint64_t total = 0;
+  int count = 0;
+  int i;
+  int j;
+
+  /* Order the kinds rendered by time, by insertion: there are few */
+  for (i = 0; i <= PK_TAG_COUNT; i++) {
+    if (costs->tags[i].calls > 0) {
+      for (j = count++; j > 0 && costs->tags[order[j - 1]].ns < costs->tags[i].ns; j--) {
+        order[j] = order[j - 1];
+        }
+
+      order[j] = i;
+      total += costs->tags[i].ns;
+      }
+    }
+
+  if (count == 0) {
+    return;
+    }
+
+  printf ("%s cost of each tag:\n", pass);
+  printf ("  %-12s %8s %8s %10s %7s %12s\n", "tag", "opened", "tokens", "time (ms)", "share", bytes);
+
+  for (i = 0; i < count; i++) {
+    const struct pk_tag_cost* cost = &costs->tags[order[i]];
+
+    printf ("  %-12s %8lu %8lu %10.3f %6.1f%% %12lu\n", order[i] < PK_TAG_COUNT ? pk_tag_name (order[i]) : "(document)",
+            (unsigned long) cost->count, (unsigned long) cost->calls, (double) cost->ns / 1e6,
+            total > 0 ? 100.0 * (double) cost->ns / (double) total : 0.0, (unsigned long) cost->bytes);
+    }
+  }
+
+/* Count a pass of the lexer alone over the page. Lexing is interleaved
+ * with parsing and rendering, token by token, so it is counted on its own
+ * and then taken out of the counts of those phases
+ */
+static void count_lexing (struct pk_perf* perf, const struct pk_limits* limits, const char* input_path) {
+  struct pk_lexer lexer;
+  struct pk_token token;
+  size_t source_len;
+  char* source = pk_read_file (input_path, &source_len);
+  int type;
+
+  /* A page that cannot be read is reported when it is compiled */
+  if (source == NULL) {
+    return;
+    }
+
+  perf->input += source_len;
+  pk_lexer_init (&lexer, source, source_len);
+  pk_lexer_limit (&lexer, limits);
+  pk_perf_begin (perf, PK_PHASE_LEX);
+
+  do {
+    type = pk_lexer_next (&lexer, &token);
+    }
+
+  while (type != PK_TOKEN_EOF && type != PK_ERR);
+
+  pk_perf_end (perf);
+  pk_lexer_clear (&lexer);
+  free (source);
+  }
+
+/* End the running phase, which read the page through the lexer once
+ * more, and take that pass out of its counts
+ */
+static void end_lexed (struct pk_perf* perf, int phase) {
+  pk_perf_end (perf);
+  pk_perf_exclude (perf, phase, PK_PHASE_LEX);
+  }
+
+/* Tell the author which of the limits on the page were reached */
+static void report_limits (const char* input_path, unsigned limited) {
+  if (limited & PK_LIMIT_DEPTH) {
+    fprintf (stderr, "%s: tags are nested too deeply (see --max-depth): the deepest were kept as text\n", input_path);
+    }
+
+  if (limited & PK_LIMIT_TOKENS) {
+    fprintf (stderr, "%s: the page has too many tokens (see --max-nodes)\n", input_path);
+    }
+
+  if (limited & PK_LIMIT_OUTPUT) {
+    fprintf (stderr, "%s: the rendered page is too large (see --max-output)\n", input_path);
+    }
+
+  if (limited & PK_LIMIT_HELD) {
+    fprintf (stderr, "%s: more than %d tables, footnotes or other tags holding their body are nested\n",
+             input_path, PK_RENDER_MAX_HELD);
+    }
+  }
+
+/**
+*** Rendering. Render the page in one pass with the named backend. Code
+*** listings are highlighted, and manual page references are linked if
+*** there is an index for them.
+**/
+static int render_page (struct pk_context* context, const char* render_path, const char* backend_name,
+                        const char* input_path, struct pk_perf* perf, int verbose) {
+  char* source;
+  size_t source_len;
+  int status = 0;
+  FILE* file;
+
+  if (pk_context_backend (context, backend_name) != PK_OK) {
+    fprintf (stderr, "Unknown backend '%s'\n", backend_name);
+    return 1;
+    }
+
+  source = pk_read_file (input_path, &source_len);
+
+  if (source == NULL) {
+    fprintf (stderr, "Cannot read '%s'\n", input_path);
+    return 10;
+    }
+
+  pk_perf_begin (perf, PK_PHASE_EMIT);
+  file = fopen (render_path, "w");
+
+  if (file == NULL) {
+    fprintf (stderr, "Cannot write '%s'\n", render_path);
+    status = 10;
+    }
+
+  else if (pk_context_render (context, source, source_len, file) != PK_OK) {
+    fprintf (stderr, "Cannot render '%s'\n", input_path);
+    report_limits (input_path, context->limited);
+    status = 10;
+    }
+
+  else if (verbose) {
+    printf ("Rendered '%s' as %s, with %d footnote(s)\n", input_path, context->backend->name, context->notes);
+    }
+
+  if (file != NULL && fclose (file) != 0) {
+    status = 10;
+    }
+
+  pk_perf_end (perf);
+  free (source);
+  return status;
+  }
+
+/* Compile the input into a .pdoc file. Strings are interned as the tokens
+ * are read, so each literal is stored once however often it is used
+ */
+static int compile_document (struct pk_context* context, const char* output_path, const char* input_path,
+                             struct pk_perf* perf, int verbose) {
+  const struct pk_doc* doc;
+  char* source;
+  size_t source_len;
+  int status = 0;
+
+  source = pk_read_file (input_path, &source_len);
+
+  if (source == NULL) {
+    fprintf (stderr, "Cannot read '%s'\n", input_path);
+    return 10;
+    }
+
+  pk_perf_begin (perf, PK_PHASE_PARSE);
+  doc = pk_context_compile (context, source, source_len);
+  pk_perf_begin (perf, PK_PHASE_EMIT);
+
+  if (doc == NULL) {
+    fprintf (stderr, "Cannot compile '%s'\n", input_path);
+    status = 10;
+    }
+
+  else if (pk_doc_write (doc, output_path) != PK_OK) {
+    fprintf (stderr, "Cannot write '%s'\n", output_path);
+    status = 10;
+    }
+
+  pk_perf_end (perf);
+  report_limits (input_path, context->limited);
+
+  if (status == 0 && verbose) {
+    printf ("Compiled '%s' into '%s': %lu node(s), %lu string(s), %lu byte(s) shared\n", input_path, output_path,
+            (unsigned long) doc->count, (unsigned long) doc->strings->count, (unsigned long) doc->strings->saved);
+    }
+
+  free (source);
+  return status;
+  }
+
+/**
+*** Build Times. The time each page of an archive took, summarised as
+*** percentiles and a histogram, with the slowest pages listed in full:
+*** an average hides the one page that doubles the time of a build.
+**/
+
+/* Total time a page took to build */
+static uint64_t page_time (const struct pk_archive_page_stats* stats) {
+  return stats->read + stats->compile + stats->emit;
+  }
+
+/* Order pages slowest first */
+static int compare_page_times (const void* a, const void* b) {
+  uint64_t x = page_time ( (const struct pk_archive_page_stats*) a);
+  uint64_t y = page_time ( (const struct pk_archive_page_stats*) b);
+
+  return x > y ? -1 : x < y;
+  }
+
+/* Nanoseconds as milliseconds */
+static double ms (uint64_t ns) {
+  return (double) ns / 1e6;
+  }
+
+/* Append a JSON string literal to out */
+static void json_string (bstring out, const char* str) {
+  bconchar (out, '"');
+
+  for (; *str != '\0'; str++) {
+    unsigned char c = (unsigned char) *str;
+
+    if (c == '"' || c == '\\') {
+      bconchar (out, '\\');
+      bconchar (out, (char) c);
+      }
+
+    else if (c < 0x20) {
+      bformata (out, "\\u%04x", c);
+      }
+
+    else {
+      bconchar (out, (char) c);
+      }
+    }
+
+  bconchar (out, '"');
+  }
+
+/* Print the percentiles, the histogram and the slowest pages */
+static void print_build_times (struct pk_latency* latency, const struct pk_archive_page_stats* pages, size_t count,
+                               size_t slowest) {
+  size_t widest = 0;
+  size_t i;
+  int b;
+
+  printf ("Page times over %lu page(s): p50 %.3f ms, p90 %.3f ms, p99 %.3f ms, max %.3f ms\n", (unsigned long) count,
+          ms (pk_latency_quantile (latency, 0.5)), ms (pk_latency_quantile (latency, 0.9)),
+          ms (pk_latency_quantile (latency, 0.99)), ms (pk_latency_quantile (latency, 1)));
+
+  for (b = 0; b < PK_LATENCY_BUCKETS; b++) {
+    widest = latency->buckets[b] > widest ? latency->buckets[b] : widest;
+    }
+
+  printf ("  %13s %8s\n", "from", "pages");
+
+  for (b = 0; b < PK_LATENCY_BUCKETS; b++) {
+    if (latency->buckets[b] > 0) {
+      int bar = (int) ( (latency->buckets[b] * 40 + widest - 1) / widest);
+
+      printf ("  %10.3f ms %8lu %.*s\n", b > 0 ? ms ( (uint64_t) 1000 << (b - 1)) : 0.0,
+              (unsigned long) latency->buckets[b], bar, "########################################");
+      }
+    }
+
+  if (slowest > 0 && count > 0) {
+    printf ("Slowest %lu page(s):\n", (unsigned long) (slowest < count ? slowest : count));
+    }
+
+  for (i = 0; i < slowest && i < count; i++) {
+    printf ("  %10.3f ms  %s: %lu byte(s), %lu node(s); read %.3f, compile %.3f, emit %.3f ms\n",
+            ms (page_time (&pages[i])), pages[i].path, (unsigned long) pages[i].size, (unsigned long) pages[i].nodes,
+            ms (pages[i].read), ms (pages[i].compile), ms (pages[i].emit));
+    }
+  }
+
+/* Write the percentiles, the histogram and the slowest pages to path as
+ * JSON ('-' for the standard output)
+ */
+static int write_build_times (const char* path, struct pk_latency* latency, const struct pk_archive_page_stats* pages,
+                              size_t count, size_t slowest) {
+  bstring out = bfromcstr ("");
+  FILE* file;
+  const char* sep = "";
+  size_t i;
+  int b;
+  int status = 0;
+
+  if (out == NULL) {
+    return 10;
+    }
+
+  bformata (out, "{\n  \"pages\": %lu,\n", (unsigned long) count);
+  bformata (out, "  \"percentiles_ms\": {\"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+            ms (pk_latency_quantile (latency, 0.5)), ms (pk_latency_quantile (latency, 0.9)),
+            ms (pk_latency_quantile (latency, 0.99)), ms (pk_latency_quantile (latency, 1)));
+  bcatcstr (out, "  \"histogram\": [");
+
+  /* Each bucket runs from its start up to the start of the next */
+  for (b = 0; b < PK_LATENCY_BUCKETS; b++) {
+    if (latency->buckets[b] > 0) {
+      bformata (out, "%s\n    {\"from_ms\": %.3f, \"pages\": %lu}", sep, b > 0 ? ms ( (uint64_t) 1000 << (b - 1)) : 0.0,
+                (unsigned long) latency->buckets[b]);
+      sep = ",";
+      }
+    }
+
+  bcatcstr (out, "\n  ],\n  \"slowest\": [");
+  sep = "";
+
+  for (i = 0; i < slowest && i < count; i++) {
+    bformata (out, "%s\n    {\"path\": ", sep);
+    json_string (out, pages[i].path);
+    bformata (out, ", \"bytes\": %lu, \"nodes\": %lu, \"total_ms\": %.3f, \"read_ms\": %.3f, \"compile_ms\": %.3f, "
+              "\"emit_ms\": %.3f}", (unsigned long) pages[i].size, (unsigned long) pages[i].nodes,
+              ms (page_time (&pages[i])), ms (pages[i].read), ms (pages[i].compile), ms (pages[i].emit));
+    sep = ",";
+    }
+
+  bcatcstr (out, "\n  ]\n}\n");
+  file = strcmp (path, "-") == 0 ? stdout : fopen (path, "w");
+
+  if (file == NULL || fwrite (out->data, 1, (size_t) blength (out), file) != (size_t) blength (out)) {
+    fprintf (stderr, "Cannot write the build times to '%s'\n", path);
+    status = 10;
+    }
+
+  if (file != NULL && file != stdout && fclose (file) != 0) {
+    status = 10;
+    }
+
+  bdestroy (out);
+  return status;
+  }
+
+/* Report the time each page of the archive took: printed if verbose, and
+ * written as JSON to stats_path if not NULL
+ */
+static int report_build_times (const struct pk_archive_builder* builder, size_t slowest, const char* stats_path,
+                               int verbose) {
+  size_t count = pk_archive_builder_count (builder);
+  struct pk_archive_page_stats* pages = (struct pk_archive_page_stats*) malloc (count * sizeof (*pages) + 1);
+  struct pk_latency latency;
+  int status = pages ? 0 : 10;
+  size_t i;
+
+  pk_latency_init (&latency);
+
+  for (i = 0; status == 0 && i < count; i++) {
+    if (pk_archive_builder_stats (builder, i, &pages[i]) != PK_OK ||
+        pk_latency_add (&latency, page_time (&pages[i])) != PK_OK) {
+      status = 10;
+      }
+    }
+
+  if (status == 0) {
+    qsort (pages, count, sizeof (*pages), compare_page_times);
+
+    if (verbose) {
+      print_build_times (&latency, pages, count, slowest);
+      }
+
+    if (stats_path != NULL) {
+      status = write_build_times (stats_path, &latency, pages, count, slowest);
+      }
+    }
+
+  else {
+    fprintf (stderr, "Cannot allocate the build times\n");
+    }
+
+  pk_latency_clear (&latency);
+  free (pages);
+  return status;
+  }
+
+/* Read the next path of a file list into path. Paths end at separator:
+ * a newline for a plain list, or a NUL for the output of 'find -print0'.
+ * Empty entries are skipped, and a newline list may end its lines with
+ * CR LF. Returns 1 for a path, 0 at the end of the list and -1 if the
+ * list cannot be read
+ */
+static int read_listed_path (FILE* list, bstring path, int separator) {
+  int c;
+
+  btrunc (path, 0);
+
+  while ( (c = getc (list)) != EOF) {
+    if (c != separator) {
+      if (bconchar (path, (char) c) != BSTR_OK) {
+        return -1;
+        }
+
+      continue;
+      }
+
+    if (c == '\n' && blength (path) > 0 && bchar (path, blength (path) - 1) == '\r') {
+      btrunc (path, blength (path) - 1);
+      }
+
+    if (blength (path) > 0) {
+      return 1;
+      }
+    }
+
+  if (ferror (list)) {
+    return -1;
+    }
+
+  return blength (path) > 0;
+  }
+
+/* Compile the page or directory at input into the archive */
+static int archive_input (struct pk_archive_builder* builder, const char* input, const char* root, size_t root_len) {
+  const char* path = NULL;
+  int status;
+
+  /* Pages below the root are named from the root */
+  if (root_len > 0 && strncmp (input, root, root_len) == 0 && (input[root_len] == '/' || input[root_len] == '\0')) {
+    path = input + root_len + (input[root_len] == '/');
+    }
+
+  status = pk_archive_builder_scan (builder, input, path);
+
+  if (status == PK_ARCHIVE_DUPLICATE) {
+    fprintf (stderr, "Cannot archive '%s': a page is already at its path\n", input);
+    return 10;
+    }
+
+  if (status != PK_OK) {
+    fprintf (stderr, "Cannot compile '%s'\n", input);
+    return 10;
+    }
+
+  return 0;
+  }
+
+/* Compile every page named by inputs, then every path listed in list_path
+ * (if not NULL; '-' reads the list from the standard input, and the paths
+ * end at a NUL rather than a newline if nul_list is set), into one
+ * site archive. Directories are searched for Bayeux files; each page is
+ * kept at its path from the root of the site. Each listed page is
+ * compiled as soon as its path has been read, so the list is never held
+ * in memory, nor passed on the command line. The compiled pages are,
+ * though: they share one string table, and are written in order of path
+ * once the last has been added. What each kind of tag costs to compile
+ * is added to costs, if not NULL
+ */
+static int write_archive (const char* archive_path, const char* root, const char** inputs, int count,
+                          const char* list_path, int nul_list, const struct pk_limits* limits,
+                          struct pk_tag_costs* costs, struct pk_perf* perf, size_t slowest, const char* stats_path,
+                          int verbose) {
+  struct pk_archive_builder* builder = pk_archive_builder_new ();
+  size_t root_len = root ? strlen (root) : 0;
+  size_t page;
+  int status = 0;
+  int i;
+
+  if (builder == NULL) {
+    fprintf (stderr, "Cannot allocate the site archive\n");
+    return 10;
+    }
+
+  pk_archive_builder_limit (builder, limits);
+  pk_archive_builder_count_tags (builder, costs);
+
+  while (root_len > 1 && root[root_len - 1] == '/') {
+    root_len--;
+    }
+
+  /* Pages are lexed as they are compiled, so here lexing is counted as
+   * part of parsing
+   */
+  pk_perf_begin (perf, PK_PHASE_PARSE);
+
+  for (i = 0; status == 0 && i < count; i++) {
+    status = archive_input (builder, inputs[i], root, root_len);
+    }
+
+  if (status == 0 && list_path != NULL) {
+    FILE* list = strcmp (list_path, "-") == 0 ? stdin : fopen (list_path, "rb");
+    bstring input = bfromcstralloc (256, "");
+    int more = 0;
+
+    if (list == NULL || input == NULL) {
+      fprintf (stderr, "Cannot read the file list '%s'\n", list_path);
+      status = 10;
+      }
+
+    while (status == 0 && (more = read_listed_path (list, input, nul_list ? '\0' : '\n')) > 0) {
+      /* A path cannot hold a NUL, so the list was meant for --null */
+      if (memchr (input->data, '\0', (size_t) blength (input)) != NULL) {
+        fprintf (stderr, "The file list '%s' holds NUL characters: read it with --null\n", list_path);
+        status = 10;
+        }
+
+      else {
+        status = archive_input (builder, bdata (input), root, root_len);
+        }
+      }
+
+    if (more < 0) {
+      fprintf (stderr, "Cannot read the file list '%s'\n", list_path);
+      status = 10;
+      }
+
+    if (list != NULL && list != stdin) {
+      fclose (list);
+      }
+
+    bdestroy (input);
+    }
+
+  pk_perf_begin (perf, PK_PHASE_EMIT);
+
+  if (status == 0 && pk_archive_builder_write (builder, archive_path) != PK_OK) {
+    fprintf (stderr, "Cannot write the site archive '%s'\n", archive_path);
+    status = 10;
+    }
+
+  else if (status == 0 && verbose) {
+    const struct pk_intern* strings = pk_archive_builder_strings (builder);
+
+    printf ("Archived %lu page(s) into '%s': %lu string(s), %lu byte(s) shared\n",
+            (unsigned long) pk_archive_builder_count (builder), archive_path, (unsigned long) strings->count,
+            (unsigned long) strings->saved);
+    }
+
+  pk_perf_end (perf);
+
+  /* The rates are per KB of every page archived */
+  for (page = 0; perf != NULL && page < pk_archive_builder_count (builder); page++) {
+    struct pk_archive_page_stats stats;
+
+    if (pk_archive_builder_stats (builder, page, &stats) == PK_OK) {
+      perf->input += stats.size;
+      }
+    }
+
+  if (status == 0 && (verbose || stats_path != NULL)) {
+    status = report_build_times (builder, slowest, stats_path, verbose);
+    }
+
+  pk_archive_builder_free (builder);
+  return status;
+  }
+
+/**
+*** Archived Pages. A page of a site archive is named by the archive and
+*** its path in the site, as in "site.pak:Labs/Labs.byx".
+**/
+
+/* Whether file names a whole site archive */
+static int is_archive (const char* file) {
+  size_t len = strlen (file);
+
+  return len > 4 && strcmp (file + len - 4, ".pak") == 0;
+  }
+
+/* The path of the page named by file within its archive, or NULL if file
+ * does not name a page of an archive
+ */
+static const char* archived_path (const char* file) {
+  const char* path = strstr (file, ".pak:");
+
+  return path ? path + 5 : NULL;
+  }
+
+/* Add the nodes of the page file names to doc: a page of an archive, or
+ * else a Bayeux source to compile
+ */
+static int load_page (struct pk_doc* doc, const char* file) {
+  const char* path = archived_path (file);
+  bstring name = path ? blk2bstr (file, (int) (path - file - 1)) : NULL;
+  struct pk_archive* archive = name ? pk_archive_open (bdata (name)) : NULL;
+  size_t document;
+  char* source;
+  size_t source_len;
+  int status;
+
+  if (path != NULL) {
+    status = archive && pk_archive_find (archive, pk_span_cstr (path), &document) == PK_OK ?
+             pk_archive_load (archive, document, doc) : PK_ERR;
+    pk_archive_close (archive);
+    bdestroy (name);
+    return status;
+    }
+
+  source = pk_read_file (file, &source_len);
+  status = source ? pk_doc_compile (doc, source, source_len) : PK_ERR;
+  free (source);
+  return status;
+  }
+
+/**
+*** Document Differences. Compare two versions of a page node by node,
+*** reporting what was inserted, deleted, changed or moved. Pages may be
+*** given as compiled .pdoc files, as Bayeux sources, or as pages of a
+*** site archive.
+**/
+
+/* Read a version of a page into doc */
+static int load_version (struct pk_doc* doc, const char* path) {
+  size_t len = strlen (path);
+
+  if (pk_doc_init (doc, NULL) != PK_OK) {
+    return PK_ERR;
+    }
+
+  if (len > 5 && strcmp (path + len - 5, ".pdoc") == 0) {
+    return pk_doc_read (doc, path);
+    }
+
+  return load_page (doc, path);
+  }
+
+/* Append up to 40 bytes of text to a description, on one line */
+static void describe_text (bstring out, struct pk_span text) {
+  size_t len = text.len > 40 ? 40 : text.len;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    bconchar (out, (char) (text.data[i] == '\n' || text.data[i] == '\t' ? ' ' : text.data[i]));
+    }
+
+  if (len < text.len) {
+    bcatcstr (out, "...");
+    }
+  }
+
+/* Describe a node for a change note: the tag and the start of its first
+ * text, or the start of the text itself
+ */
+static bstring describe_node (const struct pk_doc* doc, size_t index) {
+  struct pk_token token;
+  struct pk_token first;
+  bstring out = bfromcstr ("");
+
+  pk_doc_token (doc, index, &token);
+
+  if (out == NULL) {
+    return NULL;
+    }
+
+  if (token.type == PK_TOKEN_TEXT) {
+    bcatcstr (out, "text \"");
+    describe_text (out, pk_span_trim (token.text));
+    bconchar (out, '"');
+    return out;
+    }
+
+  bconchar (out, '[');
+  bcatblk (out, token.name.data, (int) token.name.len);
+
+  if (token.label.len) {
+    bconchar (out, ':');
+    bcatblk (out, token.label.data, (int) token.label.len);
+    }
+
+  /* Blocks are known by their arguments, headings and items by the words
+   * they start with
+   */
+  if (token.args.len) {
+    bconchar (out, ' ');
+    describe_text (out, token.args);
+    }
+
+  else if (token.type == PK_TOKEN_OPEN && doc->nodes[index].close > index + 1) {
+    pk_doc_token (doc, index + 1, &first);
+
+    if (first.type == PK_TOKEN_TEXT && pk_span_trim (first.text).len > 0) {
+      bconchar (out, ' ');
+      describe_text (out, pk_span_trim (first.text));
+      }
+    }
+
+  bconchar (out, ']');
+  return out;
+  }
+
+/* Is a node text with nothing but white space? Changes to such text are
+ * counted, but not shown
+ */
+static int blank_text (const struct pk_doc* doc, size_t index) {
+  struct pk_token token;
+
+  if (index == PK_DIFF_NONE) {
+    return 1;
+    }
+
+  pk_doc_token (doc, index, &token);
+  return token.type == PK_TOKEN_TEXT && pk_span_trim (token.text).len == 0;
+  }
+
+/* Print one change */
+static void print_change (const struct pk_diff_change* change, const struct pk_doc* before,
+                          const struct pk_doc* after) {
+  static const char* const kinds[] = { "inserted", "deleted", "changed", "moved" };
+  const struct pk_doc* doc = change->after != PK_DIFF_NONE ? after : before;
+  size_t node = change->after != PK_DIFF_NONE ? change->after : change->before;
+  bstring what = describe_node (doc, node);
+  bstring parent = change->parent != PK_DIFF_NONE ? describe_node (after, change->parent) : NULL;
+
+  printf ("%-9s %s", kinds[change->kind], what ? (const char*) what->data : "?");
+
+  if (parent != NULL) {
+    printf (" in %s", (const char*) parent->data);
+    }
+
+  if (change->before != PK_DIFF_NONE && change->after != PK_DIFF_NONE) {
+    printf (", line %lu -> %lu\n", (unsigned long) before->nodes[change->before].line,
+            (unsigned long) after->nodes[change->after].line);
+    }
+
+  else {
+    printf (", line %lu\n", (unsigned long) doc->nodes[node].line);
+    }
+
+  bdestroy (what);
+  bdestroy (parent);
+  }
+
+/* Compare the two versions given on the command line. Exits, as diff(1)
+ * does, with zero if they have the same structure, one if they differ and
+ * two on a usage error; ten if a version cannot be read or compared
+ */
+static int diff_main (int argc, char** argv, const char* progname) {
+  struct arg_lit*  verb  = arg_lit0 ("v", "verbose", "count the changes of each kind");
+  struct arg_lit*  help  = arg_lit0 (NULL, "help", "print this help and exit");
+  struct arg_file* files = arg_filen (NULL, NULL, "<file>", 2, 2, "old and new versions of the page (.pdoc, .byx or site.pak:path)");
+  struct arg_end*  end   = arg_end (20);
+  void* argtable[4];
+  struct pk_doc before;
+  struct pk_doc after;
+  struct pk_diff diff;
+  int exit_code;
+  size_t counts[4] = { 0, 0, 0, 0 };
+  size_t i;
+
+  argtable[0] = verb;
+  argtable[1] = help;
+  argtable[2] = files;
+  argtable[3] = end;
+
+  /* Both versions are cleared however far the comparison gets */
+  memset (&before, 0, sizeof (before));
+  memset (&after, 0, sizeof (after));
+
+  if (arg_nullcheck (argtable) != 0) {
+    printf ("%s: insufficient memory\n", progname);
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    return 10;
+    }
+
+  if (arg_parse (argc, argv, argtable) > 0 || help->count > 0) {
+    if (help->count == 0) {
+      arg_print_errors (stdout, end, progname);
+      }
+
+    printf ("Usage: %s diff", progname);
+    arg_print_syntax (stdout, argtable, "\n");
+    arg_print_glossary (stdout, argtable, "  %-20s %s\n");
+    exit_code = help->count > 0 ? 0 : 2;
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    return exit_code;
+    }
+
+  if (load_version (&before, files->filename[0]) != PK_OK) {
+    fprintf (stderr, "Cannot read '%s'\n", files->filename[0]);
+    exit_code = 10;
+    }
+
+  else if (load_version (&after, files->filename[1]) != PK_OK) {
+    fprintf (stderr, "Cannot read '%s'\n", files->filename[1]);
+    exit_code = 10;
+    }
+
+  else if (pk_diff_docs (&diff, &before, &after) != PK_OK) {
+    fprintf (stderr, "Cannot compare '%s' with '%s'\n", files->filename[0], files->filename[1]);
+    exit_code = 10;
+    }
+
+  else {
+    for (i = 0; i < diff.count; i++) {
+      const struct pk_diff_change* change = &diff.changes[i];
+
+      if (!blank_text (&before, change->before) || !blank_text (&after, change->after)) {
+        print_change (change, &before, &after);
+        }
+
+      counts[change->kind]++;
+      }
+
+    if (verb->count > 0) {
+      printf ("%lu change(s): %lu inserted, %lu deleted, %lu changed, %lu moved\n", (unsigned long) diff.count,
+              (unsigned long) counts[PK_DIFF_INSERTED], (unsigned long) counts[PK_DIFF_DELETED],
+              (unsigned long) counts[PK_DIFF_CHANGED], (unsigned long) counts[PK_DIFF_MOVED]);
+      }
+
+    exit_code = diff.count > 0 ? 1 : 0;
+    pk_diff_clear (&diff);
+    }
+
+  pk_doc_clear (&before);
+  pk_doc_clear (&after);
+  arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+  return exit_code;
+  }
+
+/**
+*** Tag Queries. Find the tags picked out by a query in each of a set of
+*** pages, compiled (.pdoc) or not, one page per worker thread at a time.
+*** Matches are printed as grep would, in the order the pages were given.
+**/
+
+struct query_jobs {
+  const struct pk_query* query;       /*< The query */
+  const char**           files;       /*< The pages to search */
+  bstring*               results;     /*< The report on each page, or NULL on error */
+  size_t*                counts;      /*< The number of matches in each page */
+  int                    count_only;  /*< Report only the number of matches */
+  };
+
+struct query_page {
+  const char* file;       /*< Page being searched */
+  bstring     out;        /*< Report on the page */
+  size_t      count;      /*< Number of matches */
+  int         count_only; /*< Report only the number of matches */
+  };
+
+/* Report one match as "file:line: [tag:label words]" */
+static int report_match (const struct pk_doc* doc, size_t node, void* ctx) {
+  struct query_page* page = (struct query_page*) ctx;
+  bstring what;
+  int status = PK_OK;
+
+  page->count++;
+
+  if (!page->count_only) {
+    what = describe_node (doc, node);
+    status = what && bformata (page->out, "%s:%lu: %s\n", page->file, (unsigned long) doc->nodes[node].line,
+                               (const char*) what->data) == BSTR_OK ? PK_OK : PK_ERR;
+    bdestroy (what);
+    }
+
+  return status;
+  }
+
+/* Search every page of the archive at file, each reported as file:path */
+static int query_archive (const struct pk_query* query, const char* file, struct query_page* page) {
+  struct pk_archive* archive = pk_archive_open (file);
+  size_t count = archive ? pk_archive_count (archive) : 0;
+  size_t i;
+  int status = archive ? PK_OK : PK_ERR;
+
+  for (i = 0; status == PK_OK && i < count; i++) {
+    const char* path = pk_archive_path (archive, i);
+    bstring name = path ? bformat ("%s:%s", file, path) : NULL;
+    struct pk_doc doc;
+
+    status = name ? pk_doc_init (&doc, NULL) : PK_ERR;
+
+    if (status == PK_OK) {
+      status = pk_archive_load (archive, i, &doc);
+      page->file = bdata (name);
+
+      if (status == PK_OK) {
+        status = pk_query_doc (query, &doc, report_match, page);
+        }
+
+      pk_doc_clear (&doc);
+      }
+
+    bdestroy (name);
+    }
+
+  page->file = file;
+  pk_archive_close (archive);
+  return status;
+  }
+
+/* Search one page, or every page of an archive */
+static void query_job (size_t index, void* ctx) {
+  struct query_jobs* jobs = (struct query_jobs*) ctx;
+  const char* file = jobs->files[index];
+  size_t len = strlen (file);
+  struct query_page page;
+  struct pk_doc_file compiled;
+  struct pk_doc doc;
+  int status;
+
+  page.file = file;
+  page.out = bfromcstr ("");
+  page.count = 0;
+  page.count_only = jobs->count_only;
+  status = page.out ? PK_OK : PK_ERR;
+
+  /* Compiled pages are searched through their postings */
+  if (status == PK_OK && len > 5 && strcmp (file + len - 5, ".pdoc") == 0) {
+    status = pk_doc_open (&compiled, file);
+
+    if (status == PK_OK) {
+      status = pk_query_file (jobs->query, &compiled, report_match, &page);
+      pk_doc_close (&compiled);
+      }
+    }
+
+  else if (status == PK_OK && is_archive (file)) {
+    status = query_archive (jobs->query, file, &page);
+    }
+
+  else if (status == PK_OK) {
+    status = pk_doc_init (&doc, NULL);
+
+    if (status == PK_OK) {
+      status = load_page (&doc, file);
+
+      if (status == PK_OK) {
+        status = pk_query_doc (jobs->query, &doc, report_match, &page);
+        }
+
+      pk_doc_clear (&doc);
+      }
+    }
+
+  if (status != PK_OK) {
+    bdestroy (page.out);
+    page.out = NULL;
+    }
+
+  jobs->results[index] = page.out;
+  jobs->counts[index] = page.count;
+  }
+
+/* Search the pages given on the command line. Exits with zero if anything
+ * matched, one if nothing did, two if the arguments or the query are
+ * wrong, and ten if a page could not be searched
+ */
+static int query_main (int argc, char** argv, const char* progname) {
+  struct arg_lit*  verb  = arg_lit0 ("v", "verbose", "report the number of pages and matches");
+  struct arg_lit*  help  = arg_lit0 (NULL, "help", "print this help and exit");
+  struct arg_lit*  cnt   = arg_lit0 ("c", "count", "print only the number of matches in each page");
+  struct arg_int*  jobs  = arg_int0 ("j", "jobs", "<n>", "number of worker threads (default: one per processor)");
+  struct arg_str*  expr  = arg_str1 (NULL, NULL, "<query>", "tags to find, e.g. 'command[~nsd]'");
+  struct arg_file* files = arg_filen (NULL, NULL, "<file>", 1, argc + 2, "pages to search (.pdoc, .byx, .pak or site.pak:path)");
+  struct arg_end*  end   = arg_end (20);
+  void* argtable[7];
+  struct query_jobs work;
+  struct pk_query* query = NULL;
+  size_t matches = 0;
+  size_t error = 0;
+  int exit_code = 1;
+  int i;
+
+  argtable[0] = verb;
+  argtable[1] = help;
+  argtable[2] = cnt;
+  argtable[3] = jobs;
+  argtable[4] = expr;
+  argtable[5] = files;
+  argtable[6] = end;
+
+  if (arg_nullcheck (argtable) != 0) {
+    printf ("%s: insufficient memory\n", progname);
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    return 10;
+    }
+
+  if (arg_parse (argc, argv, argtable) > 0 || help->count > 0) {
+    if (help->count == 0) {
+      arg_print_errors (stdout, end, progname);
+      }
+
+    printf ("Usage: %s query", progname);
+    arg_print_syntax (stdout, argtable, "\n");
+    arg_print_glossary (stdout, argtable, "  %-20s %s\n");
+    exit_code = help->count > 0 ? 0 : 2;
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    return exit_code;
+    }
+
+  query = pk_query_new (expr->sval[0], &error);
+
+  if (query == NULL) {
+    fprintf (stderr, "Cannot parse the query '%s' at offset %lu\n", expr->sval[0], (unsigned long) error);
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    return 2;
+    }
+
+  work.query = query;
+  work.files = files->filename;
+  work.results = (bstring*) calloc ( (size_t) files->count, sizeof (*work.results));
+  work.counts = (size_t*) calloc ( (size_t) files->count, sizeof (*work.counts));
+  work.count_only = cnt->count > 0;
+
+  if (work.results == NULL || work.counts == NULL) {
+    fprintf (stderr, "Cannot allocate the query results\n");
+    exit_code = 10;
+    }
+
+  else {
+    pk_pool_run (jobs->count > 0 ? jobs->ival[0] : pk_pool_processors (), (size_t) files->count, query_job, &work);
+
+    for (i = 0; i < files->count; i++) {
+      if (work.results[i] == NULL) {
+        fprintf (stderr, "Cannot search '%s'\n", files->filename[i]);
+        exit_code = 10;
+        continue;
+        }
+
+      if (work.count_only) {
+        printf ("%s:%lu\n", files->filename[i], (unsigned long) work.counts[i]);
+        }
+
+      else {
+        fwrite (work.results[i]->data, 1, (size_t) blength (work.results[i]), stdout);
+        }
+
+      matches += work.counts[i];
+      bdestroy (work.results[i]);
+      }
+
+    if (verb->count > 0) {
+      printf ("%lu match(es) in %d page(s)\n", (unsigned long) matches, files->count);
+      }
+
+    if (exit_code != 10) {
+      exit_code = matches > 0 ? 0 : 1;
+      }
+    }
+
+  free (work.results);
+  free (work.counts);
+  pk_query_free (query);
+  arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+  return exit_code;
+  }
+
 /**
 *** Main Loop. This should do very little other than parse the command
 *** line and call the appropriate library function.
@@ -46,25 +1719,109 @@ int main (int argc, char** argv) {
 
   int exit_code = 0;                /*< The final exit code returned to the caller on termination */
 
-  bstring input_file;              /*< The name of the input file */
-  bstring input_file_path;          /*< The full name and path of the input file */
+  bstring input_file = NULL;        /*< The name of the input file */
+  bstring input_file_path = NULL;   /*< The full name and path of the input file */
 
-  bstring output_file;              /*< The name of the output file */
-  bstring output_file_path;         /*< The full name and path of the output file */
+  bstring output_file = NULL;       /*< The name of the output file */
+  bstring output_file_path = NULL;  /*< The full name and path of the output file */
 
   /* Tell the argtable library how our options are set-up */
   struct arg_lit*  verb  = arg_lit0 ("v", "verbose", "show processing diagnostics");
   struct arg_lit*  help  = arg_lit0 (NULL, "help",        "print this help and exit");
   struct arg_lit*  vers  = arg_lit0 (NULL, "version",     "print version information and exit");
-  struct arg_file* files = arg_filen (NULL, NULL, NULL, 1, argc + 2, NULL);
+  struct arg_file* root  = arg_file0 (NULL, "root", "<dir>", "root directory of the site");
+  struct arg_file* nav   = arg_file0 (NULL, "nav", "<file>", "update the site navigation, kept in <file>");
+  struct arg_file* asset = arg_file0 (NULL, "assets", "<dir>", "copy the images of the page into <dir>");
+  struct arg_file* acache = arg_file0 (NULL, "asset-cache", "<file>", "remember image sizes in <file>");
+  struct arg_file* lists = arg_file0 (NULL, "listings", "<file>", "write the highlighted code listings to <file>");
+  struct arg_file* man   = arg_file0 (NULL, "man-index", "<file>", "resolve [man] references with the index <file>");
+  struct arg_str*  mpath = arg_str0 (NULL, "man-path", "<dirs>", "build the index from the manual path <dirs>");
+  struct arg_file* mlist = arg_file0 (NULL, "man-list", "<file>", "build the index from the page list <file>");
+  struct arg_str*  murl  = arg_str0 (NULL, "man-url", "<template>", "URL of indexed pages ({name}, {section})");
+  struct arg_file* rend  = arg_file0 (NULL, "render", "<file>", "render the page into <file>");
+  struct arg_file* arch  = arg_file0 (NULL, "archive", "<file>", "compile every page and directory given into <file>");
+  struct arg_file* flist = arg_file0 (NULL, "files-from", "<file>", "also archive each page listed in <file> (- for stdin)");
+  struct arg_lit*  nul   = arg_lit0 ("0", "null", "paths in the --files-from list end with NUL, not newline");
+  struct arg_str*  back  = arg_str0 (NULL, "backend", "<name>", "output format for --render: html (default) or text");
+  struct arg_int*  jobs  = arg_int0 ("j", "jobs", "<n>", "number of worker threads (default: one per processor)");
+  struct arg_int*  mdepth = arg_int0 (NULL, "max-depth", "<n>", "keep tags nested deeper than <n> as text (0: no limit)");
+  struct arg_int*  mnodes = arg_int0 (NULL, "max-nodes", "<n>", "fail on pages of more than <n> tokens (0: no limit)");
+  struct arg_int*  mout  = arg_int0 (NULL, "max-output", "<bytes>", "fail on rendered pages larger than <bytes> (0: no limit)");
+  struct arg_str*  cpu   = arg_str0 (NULL, "cpu-features", "<list>", "use only these of sse2,sse4.2,avx2,avx512 (none: portable code)");
+  struct arg_lit*  pctr  = arg_lit0 (NULL, "perf-counters", "count cycles, instructions and misses of each phase");
+  struct arg_lit*  tcost = arg_lit0 (NULL, "tag-costs", "report what each kind of tag costs to compile and render");
+  struct arg_int*  slow  = arg_int0 (NULL, "slowest", "<n>", "list the <n> slowest pages of an archive (default 10)");
+  struct arg_file* btime = arg_file0 (NULL, "build-times", "<file>", "write the time of each archived page to <file> as JSON");
+  struct arg_file* files = arg_filen (NULL, NULL, NULL, 0, argc + 2, NULL);
   struct arg_end*  end   = arg_end (20);
 
-  void* argtable[5];
+  const char* root_dir = NULL;      /*< Root directory of the site */
+  const char* nav_state = NULL;     /*< Navigation state file */
+  const char* asset_dir = NULL;     /*< Output directory for images */
+  const char* asset_cache = NULL;   /*< Image dimension cache file */
+  const char* listings = NULL;      /*< Highlighted listings file */
+  const char* man_index = NULL;     /*< Manual page index file */
+  const char* man_path = NULL;      /*< Manual path to index */
+  const char* man_list = NULL;      /*< Manual page list to index */
+  const char* man_url = NULL;       /*< URL template for indexed pages */
+  const char* render_file = NULL;   /*< Rendered output file */
+  const char* backend = "html";     /*< Backend used for the rendered output */
+  const char* archive = NULL;       /*< Site archive file */
+  const char* file_list = NULL;     /*< List of further pages to archive */
+  int nul_list = 0;                 /*< Paths in the list end with NUL */
+  const char** inputs = NULL;       /*< Pages and directories to archive */
+  const char* times_path = NULL;    /*< JSON report of the archive build times */
+  size_t slowest = 10;              /*< Number of the slowest pages reported */
+  int ninputs = 0;                  /*< Number of inputs to archive */
+  int workers = 0;                  /*< Number of worker threads */
+  int verbose = 0;                  /*< Show processing diagnostics */
+  struct pk_limits limits = pk_limits_default; /*< Limits on each page */
+  struct pk_context* context;       /*< State shared by compiling and rendering */
+  struct pk_perf perf;              /*< Performance counters */
+  struct pk_perf* counters = NULL;  /*< The counters, if they are read */
+  int tag_costs = 0;                /*< Count what each kind of tag costs to compile and render */
+
+  void* argtable[28];
   argtable[0] = verb;
   argtable[1] = help;
   argtable[2] = vers;
-  argtable[3] = files;
-  argtable[4] = end;
+  argtable[3] = root;
+  argtable[4] = nav;
+  argtable[5] = asset;
+  argtable[6] = acache;
+  argtable[7] = lists;
+  argtable[8] = man;
+  argtable[9] = mpath;
+  argtable[10] = mlist;
+  argtable[11] = murl;
+  argtable[12] = rend;
+  argtable[13] = back;
+  argtable[14] = jobs;
+  argtable[15] = arch;
+  argtable[16] = flist;
+  argtable[17] = mdepth;
+  argtable[18] = mnodes;
+  argtable[19] = mout;
+  argtable[20] = cpu;
+  argtable[21] = pctr;
+  argtable[22] = slow;
+  argtable[23] = btime;
+  argtable[24] = nul;
+  argtable[25] = tcost;
+  argtable[26] = files;
+  argtable[27] = end;
+
+  /* 'ppack diff <old> <new>' compares two versions of a page instead */
+  if (argc > 1 && strcmp (argv[1], "diff") == 0) {
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    exit (diff_main (argc - 1, argv + 1, progname));
+    }
+
+  /* 'ppack query <query> <file>...' searches pages for tags */
+  if (argc > 1 && strcmp (argv[1], "query") == 0) {
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    exit (query_main (argc - 1, argv + 1, progname));
+    }
 
   /* verify the argtable[] entries were allocated sucessfully */
   if (arg_nullcheck (argtable) != 0) {
@@ -109,10 +1866,63 @@ int main (int argc, char** argv) {
     goto call_exit;
     }
 
+  /* Listed pages can only go into an archive, and then stand in for the
+   * file arguments: otherwise at least one file must be given
+   */
+  if (flist->count > 0 && arch->count == 0) {
+    printf ("%s: option --files-from needs --archive\n", progname);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
+  if (nul->count > 0 && flist->count == 0) {
+    printf ("%s: option --null needs --files-from\n", progname);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
+  if (btime->count > 0 && arch->count == 0) {
+    printf ("%s: option --build-times needs --archive\n", progname);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
+  /* The slowest pages are only listed in the build times of an archive */
+  if (slow->count > 0 && arch->count == 0) {
+    printf ("%s: option --slowest needs --archive\n", progname);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
+  if (slow->count > 0 && verb->count == 0 && btime->count == 0) {
+    printf ("%s: option --slowest needs -v or --build-times\n", progname);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
+  if (files->count == 0 && flist->count == 0) {
+    printf ("%s: missing option <file>\n", progname);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
   /* Count the number of file argument: we should have exactly two (one
    * for input and one for output). If we only have one file, assume
    * this file is the input, and form the output file from the input
-   * file
+   * file. With no file arguments at all, every page comes from the file
+   * list
    */
   if (files->count == 1) {
     /* We should have at least two files, so pick the first argument and
@@ -138,7 +1948,11 @@ int main (int argc, char** argv) {
      *
      */
 
-    bassigncstr (output_file_path, dirname (bdata (input_file_path)));
+    /* dirname and basename may modify their argument, so work on a copy
+     * of the input path
+     */
+    bassign (output_file_path, input_file_path);
+    bassigncstr (output_file_path, dirname (bdata (output_file_path)));
 
     /* Check for an empty directory in the path */
     if ( (blength (output_file_path) == 1) && (bchar (output_file_path, 0) == '.')) {
@@ -182,7 +1996,8 @@ int main (int argc, char** argv) {
       goto call_exit;
       }
 
-    bassigncstr (input_file, basename (bdata (input_file_path)));
+    bassign (input_file, input_file_path);
+    bassigncstr (input_file, basename (bdata (input_file)));
 
     index = bstrrchr (input_file, '.');
 
@@ -191,9 +2006,7 @@ int main (int argc, char** argv) {
        * up to the period from the +input_file+ into the
        * +output_file+
        */
-      output_file = bstrcpy (bmidstr (input_file, 0, index));
-
-      if (!output_file) {
+      if (pk_span_assign (output_file, pk_span_mid (pk_span_bstr (input_file), 0, (size_t) index)) != PK_OK) {
         fprintf (stderr, "Construction of the output filename failed");
         exit_code = 10;
         goto call_exit;
@@ -227,7 +2040,7 @@ int main (int argc, char** argv) {
 
     }
 
-  else {
+  else if (files->count > 1) {
     /* We should have at least two files, so pick the first two and
      * form the input and output file arguments from them
      */
@@ -268,10 +2081,210 @@ call_exit:
 
 call_braid:
 
+  /* Keep the options we need: the strings themselves live in argv */
+  verbose = verb->count > 0;
+
+  if (root->count > 0) {
+    root_dir = root->filename[0];
+    }
+
+  if (nav->count > 0) {
+    nav_state = nav->filename[0];
+    }
+
+  if (asset->count > 0) {
+    asset_dir = asset->filename[0];
+    }
+
+  if (acache->count > 0) {
+    asset_cache = acache->filename[0];
+    }
+
+  if (lists->count > 0) {
+    listings = lists->filename[0];
+    }
+
+  if (man->count > 0) {
+    man_index = man->filename[0];
+    }
+
+  if (mpath->count > 0) {
+    man_path = mpath->sval[0];
+    }
+
+  if (mlist->count > 0) {
+    man_list = mlist->filename[0];
+    }
+
+  if (murl->count > 0) {
+    man_url = murl->sval[0];
+    }
+
+  if (rend->count > 0) {
+    render_file = rend->filename[0];
+    }
+
+  if (back->count > 0) {
+    backend = back->sval[0];
+    }
+
+  workers = jobs->count > 0 ? jobs->ival[0] : pk_pool_processors ();
+
+  /* Negative limits are taken as no limit at all */
+  if (mdepth->count > 0) {
+    limits.depth = mdepth->ival[0] > 0 ? (size_t) mdepth->ival[0] : 0;
+    }
+
+  if (mnodes->count > 0) {
+    limits.tokens = mnodes->ival[0] > 0 ? (size_t) mnodes->ival[0] : 0;
+    }
+
+  if (mout->count > 0) {
+    limits.output = mout->ival[0] > 0 ? (size_t) mout->ival[0] : 0;
+    }
+
+  /* Narrow the scanning kernels before any page is read */
+  if (cpu->count > 0 && pk_cpu_select (cpu->sval[0]) != PK_OK) {
+    printf ("%s: unknown CPU feature in '%s'\n", progname, cpu->sval[0]);
+    printf ("Invalid arguments. Try '%s --help' for more information.\n", progname);
+
+    exit_code = 1;
+    goto call_exit;
+    }
+
+  if (verbose) {
+    report_cpu_features ();
+    }
+
+  /* Open the counters before any page is read. A host without them still
+   * builds the page
+   */
+  tag_costs = pctr->count > 0 || tcost->count > 0;
+
+  if (pctr->count > 0) {
+    if (pk_perf_open (&perf) == PK_OK) {
+      counters = &perf;
+      }
+
+    else {
+      fprintf (stderr, "%s: no performance counters on this system\n", progname);
+      }
+    }
+
+  /* Every file argument is a page of the archive */
+  if (arch->count > 0) {
+    archive = arch->filename[0];
+    inputs = (const char**) malloc ( (size_t) files->count * sizeof (*inputs) + 1); /* never malloc (0) */
+    ninputs = inputs ? files->count : 0;
+
+    for (index = 0; index < ninputs; index++) {
+      inputs[index] = files->filename[index];
+      }
+    }
+
+  if (flist->count > 0) {
+    file_list = flist->filename[0];
+    nul_list = nul->count > 0;
+    }
+
+  if (slow->count > 0) {
+    slowest = slow->ival[0] > 0 ? (size_t) slow->ival[0] : 0;
+    }
+
+  if (btime->count > 0) {
+    times_path = btime->filename[0];
+    }
+
   /* Deallocate the memory reserved by the options argtable */
   arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
 
-  /* Call the main library */
+  /* Call the main library. The page is compiled and rendered through one
+   * context, so the two share its state
+   */
+  context = pk_context_new ();
+
+  if (context == NULL) {
+    fprintf (stderr, "Cannot allocate the compile context\n");
+    exit_code = 10;
+    }
+
+  else if (tag_costs && pk_context_count_tags (context) != PK_OK) {
+    fprintf (stderr, "Cannot allocate the tag costs\n");
+    exit_code = 10;
+    }
+
+  else if (archive != NULL) {
+    context->limits = limits;
+    exit_code = inputs ? write_archive (archive, root_dir, inputs, ninputs, file_list, nul_list, &context->limits,
+                                        context->compile_costs, counters, slowest, times_path, verbose) : 10;
+    }
+
+  else {
+    context->limits = limits;
+
+    if (counters != NULL) {
+      count_lexing (counters, &context->limits, bdata (input_file_path));
+      }
+
+    exit_code = compile_document (context, bdata (output_file_path), bdata (input_file_path), counters, verbose);
+    pk_perf_exclude (counters, PK_PHASE_PARSE, PK_PHASE_LEX);
+    }
+
+  free (inputs);
+
+  /* The remaining steps work on a single page, so there is nothing more
+   * to do for an archive, even one of a single page
+   */
+  if (archive != NULL || input_file_path == NULL) {
+    nav_state = asset_dir = listings = man_index = render_file = NULL;
+    }
+
+  if (nav_state != NULL && exit_code == 0) {
+    pk_perf_begin (counters, PK_PHASE_RESOLVE);
+    exit_code = update_navigation (nav_state, root_dir, bdata (input_file_path), verbose);
+    end_lexed (counters, PK_PHASE_RESOLVE);
+    }
+
+  if (asset_dir != NULL && exit_code == 0) {
+    pk_perf_begin (counters, PK_PHASE_RESOLVE);
+    exit_code = process_assets (asset_dir, asset_cache, root_dir, bdata (input_file_path), workers, verbose);
+    end_lexed (counters, PK_PHASE_RESOLVE);
+    }
+
+  if (listings != NULL && exit_code == 0) {
+    pk_perf_begin (counters, PK_PHASE_EMIT);
+    exit_code = write_listings (context->highlighter, listings, bdata (input_file_path), verbose);
+    end_lexed (counters, PK_PHASE_EMIT);
+    }
+
+  if (man_index != NULL && exit_code == 0) {
+    pk_perf_begin (counters, PK_PHASE_RESOLVE);
+    exit_code = resolve_man_pages (man_index, man_path, man_list, man_url, bdata (input_file_path), verbose);
+    end_lexed (counters, PK_PHASE_RESOLVE);
+    }
+
+  if (render_file != NULL && exit_code == 0) {
+    /* The index may only just have been built, so it is opened here */
+    if (man_index != NULL) {
+      pk_context_man_index (context, man_index);
+      }
+
+    exit_code = render_page (context, render_file, backend, bdata (input_file_path), counters, verbose);
+    pk_perf_exclude (counters, PK_PHASE_EMIT, PK_PHASE_LEX);
+    }
+
+  if (counters != NULL) {
+    report_perf (counters);
+    pk_perf_close (counters);
+    }
+
+  /* Each pass run reports the tags it handled */
+  if (context != NULL && context->costs != NULL && context->compile_costs != NULL) {
+    report_tag_costs (context->compile_costs, "Compiling", "bytes in");
+    report_tag_costs (context->costs, "Rendering", "bytes out");
+    }
+
+  pk_context_free (context);
 
   /* Deallocate the string library */
   bdestroy (input_file);
@@ -279,6 +2292,6 @@ call_braid:
   bdestroy (input_file_path);
   bdestroy (output_file_path);
 
-  /* Tell the caller eveyrthing went OK */
-  exit (0);
+  /* Tell the caller how things went */
+  exit (exit_code);
   }
@@ -0,0 +1,596 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file ppbench.c
+*** \brief Compare two builds of ppack by running them in turn over a corpus
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* wait4 and processor affinity are GNU extensions */
+#define _GNU_SOURCE
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+/* Include the standard library */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Include the POSIX process and file functions */
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#ifdef HAVE_SCHED_SETAFFINITY
+#include <sched.h>
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+/* Option processing is done via argtable */
+#include "argtable2.h"
+
+/* Include the Packer library */
+#include "packer/latency.h"
+
+/* The most runs of each build: enough for any interval, and few enough
+ * that the binomial tail below cannot underflow
+ */
+#define MAX_RUNS 1000
+
+/**
+*** Runs. Each run forks, optionally pins the child to one processor, and
+*** executes one build of ppack over the corpus, timing it with the
+*** monotonic clock and taking its processor time and peak memory from
+*** the kernel's accounting of the child.
+**/
+
+/* What one run of a build measured */
+struct run {
+  double wall;                    /*< Elapsed time (ms) */
+  double cpu;                     /*< User and system time (ms) */
+  double rss;                     /*< Peak resident memory (KB) */
+  };
+
+/* Run binary with the arguments args (args[0] is replaced by binary),
+ * pinned to the processor cpu unless cpu is negative
+ */
+static int run_once (const char* binary, char** args, int cpu, int quiet, struct run* run) {
+  struct rusage usage;
+  uint64_t start;
+  pid_t pid;
+  int status;
+
+  fflush (stdout);
+  fflush (stderr);
+
+  start = pk_clock_ns ();
+  pid = fork ();
+
+  if (pid < 0) {
+    perror ("Cannot start a run");
+    return PK_ERR;
+    }
+
+  if (pid == 0) {
+    args[0] = (char*) binary;
+
+#ifdef HAVE_SCHED_SETAFFINITY
+
+    if (cpu >= 0) {
+      cpu_set_t set;
+
+      CPU_ZERO (&set);
+      CPU_SET (cpu, &set);
+
+      if (sched_setaffinity (0, sizeof set, &set) != 0) {
+        perror ("Cannot pin the run to the processor");
+        _exit (126);
+        }
+      }
+
+#else
+    (void) cpu;
+#endif
+
+    if (quiet) {
+      int null = open ("/dev/null", O_WRONLY);
+
+      if (null >= 0) {
+        dup2 (null, STDOUT_FILENO);
+        dup2 (null, STDERR_FILENO);
+        close (null);
+        }
+      }
+
+    execvp (binary, args);
+    _exit (127);
+    }
+
+  if (wait4 (pid, &status, 0, &usage) != pid) {
+    perror ("Cannot wait for a run");
+    return PK_ERR;
+    }
+
+  run->wall = (double) (pk_clock_ns () - start) / 1e6;
+  run->cpu = (double) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1e3
+             + (double) (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e3;
+  run->rss = (double) usage.ru_maxrss;
+
+  /* A run that failed measured nothing worth comparing */
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0) {
+    if (WIFEXITED (status) && WEXITSTATUS (status) == 127) {
+      fprintf (stderr, "Cannot run '%s'\n", binary);
+      }
+
+    else if (WIFEXITED (status)) {
+      fprintf (stderr, "'%s' failed with exit code %d\n", binary, WEXITSTATUS (status));
+      }
+
+    else {
+      fprintf (stderr, "'%s' was stopped by signal %d\n", binary, WTERMSIG (status));
+      }
+
+    return PK_ERR;
+    }
+
+  return PK_OK;
+  }
+
+/* One page of the input, identified by its file */
+struct page {
+  dev_t dev;                      /*< Device of the file */
+  ino_t ino;                      /*< Inode of the file */
+  double size;                    /*< Size of the file */
+  };
+
+/* The pages read by each run, which may be named more than once */
+struct input {
+  struct page* pages;             /*< The pages found */
+  size_t count;                   /*< Number of pages found */
+  size_t capacity;                /*< Number of pages allocated */
+  };
+
+/* Add the page path, or every page below the directory path, to input */
+static void measure_input (const char* path, struct input* input) {
+  struct stat info;
+  size_t len = strlen (path);
+
+  if (stat (path, &info) != 0) {
+    return;
+    }
+
+  if (S_ISDIR (info.st_mode)) {
+    DIR* dir = opendir (path);
+    struct dirent* entry;
+
+    if (dir == NULL) {
+      return;
+      }
+
+    while ( (entry = readdir (dir)) != NULL) {
+      bstring child;
+
+      if (entry->d_name[0] == '.') {
+        continue;
+        }
+
+      child = bformat ("%s/%s", path, entry->d_name);
+
+      if (child != NULL) {
+        measure_input (bdata (child), input);
+        bdestroy (child);
+        }
+      }
+
+    closedir (dir);
+    }
+
+  /* Only pages count as input: the other file arguments are mostly the
+   * outputs of earlier runs
+   */
+  else if (S_ISREG (info.st_mode) && len > 4 && strcmp (path + len - 4, ".byx") == 0) {
+    if (input->count == input->capacity) {
+      size_t capacity = input->capacity ? input->capacity * 2 : 64;
+      struct page* grown = (struct page*) realloc (input->pages, capacity * sizeof (*grown));
+
+      if (grown == NULL) {
+        return;
+        }
+
+      input->pages = grown;
+      input->capacity = capacity;
+      }
+
+    input->pages[input->count].dev = info.st_dev;
+    input->pages[input->count].ino = info.st_ino;
+    input->pages[input->count].size = (double) info.st_size;
+    input->count++;
+    }
+  }
+
+static int compare_pages (const void* a, const void* b) {
+  const struct page* x = (const struct page*) a;
+  const struct page* y = (const struct page*) b;
+
+  if (x->dev != y->dev) {
+    return x->dev < y->dev ? -1 : 1;
+    }
+
+  return x->ino < y->ino ? -1 : x->ino > y->ino ? 1 : 0;
+  }
+
+/* Count the distinct pages of input into *pages and their size into *bytes */
+static void count_input (struct input* input, unsigned long* pages, double* bytes) {
+  size_t i;
+
+  qsort (input->pages, input->count, sizeof (*input->pages), compare_pages);
+
+  for (i = 0; i < input->count; i++) {
+    if (i == 0 || compare_pages (&input->pages[i - 1], &input->pages[i]) != 0) {
+      *pages += 1;
+      *bytes += input->pages[i].size;
+      }
+    }
+  }
+
+/**
+*** Statistics. Run-to-run noise on a shared machine is neither normal
+*** nor symmetric, so the comparison rests on medians and their
+*** distribution-free (sign test) confidence intervals, which need no
+*** assumption about the shape of the noise. The builds are compared on
+*** the change within each pair of runs, taken back to back, so drift in
+*** the load of the machine cancels rather than showing up as a
+*** difference between the builds.
+**/
+
+static int compare_doubles (const void* a, const void* b) {
+  double x = * (const double*) a;
+  double y = * (const double*) b;
+
+  return x < y ? -1 : x > y ? 1 : 0;
+  }
+
+/* The rank k (from 1) such that the k-th smallest and k-th largest of n
+ * samples bound their median with at least the given confidence, or zero
+ * if there are too few samples for any such interval
+ */
+static size_t interval_rank (size_t n, double confidence) {
+  double tail = 0.0;
+  double term = 1.0;
+  size_t rank = 0;
+  size_t j;
+
+  for (j = 0; j < n; j++) {
+    term *= 0.5;
+    }
+
+  /* term is now P(X = 0) for X ~ Binomial (n, 1/2) */
+  for (j = 0; j < n; j++) {
+    if (tail + term > (1.0 - confidence) / 2.0) {
+      break;
+      }
+
+    tail += term;
+    rank = j + 1;
+    term = term * (double) (n - j) / (double) (j + 1);
+    }
+
+  return rank;
+  }
+
+/* The median of a metric and the interval around it */
+struct estimate {
+  double median;                  /*< Median of the samples */
+  double low;                     /*< Lower bound of the interval */
+  double high;                    /*< Upper bound of the interval */
+  int bounded;                    /*< Whether the interval could be found */
+  };
+
+/* Estimate the median of the n samples (sorting them) */
+static void estimate (double* samples, size_t n, size_t rank, struct estimate* est) {
+  qsort (samples, n, sizeof (*samples), compare_doubles);
+
+  est->median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+  est->bounded = rank > 0;
+  est->low = rank > 0 ? samples[rank - 1] : est->median;
+  est->high = rank > 0 ? samples[n - rank] : est->median;
+  }
+
+/* The metrics compared, each taken from the runs of both builds */
+enum metric {
+  THROUGHPUT,
+  WALL,
+  CPU,
+  RSS,
+  METRICS
+  };
+
+/* Fill out with the metric m of each run */
+static void metric_values (const struct run* runs, size_t n, enum metric m, double bytes, double* out) {
+  size_t i;
+
+  for (i = 0; i < n; i++) {
+    switch (m) {
+      case THROUGHPUT:
+        /* MB/s of pages, or runs per second if there are no pages */
+        out[i] = runs[i].wall > 0.0 ? (bytes > 0.0 ? bytes / 1e6 : 1.0) / (runs[i].wall / 1e3) : 0.0;
+        break;
+
+      case WALL:
+        out[i] = runs[i].wall;
+        break;
+
+      case CPU:
+        out[i] = runs[i].cpu;
+        break;
+
+      default:
+        out[i] = runs[i].rss;
+      }
+    }
+  }
+
+/* Compare the builds on the metric m, with a line of the report */
+static void report_metric (const struct run* base, const struct run* cand, size_t n, enum metric m, double bytes,
+                           size_t rank, double* a, double* b) {
+  static const char* const names[METRICS] = {
+    "throughput (MB/s)", "wall time (ms)", "CPU time (ms)", "max RSS (KB)"
+    };
+  struct estimate base_est;
+  struct estimate cand_est;
+  struct estimate change;
+  const char* name = m == THROUGHPUT && bytes <= 0.0 ? "throughput (runs/s)" : names[m];
+  const char* verdict = "no clear change";
+  size_t i;
+
+  metric_values (base, n, m, bytes, a);
+  metric_values (cand, n, m, bytes, b);
+
+  /* The change of each pair, as a percentage of the baseline */
+  for (i = 0; i < n; i++) {
+    b[i] = a[i] != 0.0 ? 100.0 * (b[i] - a[i]) / a[i] : 0.0;
+    }
+
+  estimate (b, n, rank, &change);
+
+  metric_values (base, n, m, bytes, a);
+  metric_values (cand, n, m, bytes, b);
+  estimate (a, n, 0, &base_est);
+  estimate (b, n, 0, &cand_est);
+
+  /* Only throughput is better for being higher */
+  if (change.bounded && (change.low > 0.0 || change.high < 0.0)) {
+    verdict = (change.low > 0.0) == (m == THROUGHPUT) ? "better" : "worse";
+    }
+
+  printf ("  %-20s %12.3f %12.3f %+9.2f%%", name, base_est.median, cand_est.median, change.median);
+
+  if (change.bounded) {
+    printf ("   [%+.2f%%, %+.2f%%]  %s\n", change.low, change.high, verdict);
+    }
+
+  else {
+    printf ("   -\n");
+    }
+  }
+
+/**
+*** Main Loop. Warm both builds up, then run them in pairs, swapping
+*** which goes first in each pair so neither always runs on a cache the
+*** other has just warmed, and compare the pairs.
+**/
+int main (int argc, char** argv) {
+  const char* progname = "ppbench";
+
+  struct arg_lit*  verb  = arg_lit0 ("v", "verbose", "show the measurements of every run");
+  struct arg_lit*  help  = arg_lit0 (NULL, "help", "print this help and exit");
+  struct arg_int*  runs  = arg_int0 ("n", "runs", "<n>", "measured runs of each build (default 20)");
+  struct arg_int*  warm  = arg_int0 ("w", "warmup", "<n>", "unmeasured runs of each build first (default 2)");
+  struct arg_int*  cpu   = arg_int0 (NULL, "cpu", "<n>", "pin every run to processor <n>");
+  struct arg_dbl*  conf  = arg_dbl0 (NULL, "confidence", "<percent>", "confidence of the intervals (default 95)");
+  struct arg_lit*  show  = arg_lit0 (NULL, "show-output", "let the runs write to the terminal");
+  struct arg_file* corp  = arg_filen (NULL, "input", "<path>", 0, argc + 2, "pages read by each run (default: those in the arguments)");
+  struct arg_str*  bins  = arg_strn (NULL, NULL, "<ppack>", 2, 2, "the baseline build, then the candidate");
+  struct arg_str*  args  = arg_strn (NULL, NULL, "-- <arg>", 0, argc + 2, "arguments of each run, e.g. --archive out.pak site/");
+  struct arg_end*  end   = arg_end (20);
+  void* argtable[11];
+
+  struct run* base = NULL;          /*< Measured runs of the baseline */
+  struct run* cand = NULL;          /*< Measured runs of the candidate */
+  double* a = NULL;                 /*< Scratch samples of the baseline */
+  double* b = NULL;                 /*< Scratch samples of the candidate */
+  char** child = NULL;              /*< Argument vector of each run */
+  size_t nruns = 20;                /*< Measured runs of each build */
+  size_t nwarm = 2;                 /*< Warm-up runs of each build */
+  double confidence = 0.95;         /*< Confidence of the intervals */
+  struct input input = {NULL, 0, 0}; /*< Pages read by each run */
+  double bytes = 0.0;               /*< Size of the pages read by each run */
+  unsigned long pages = 0;          /*< Number of pages read by each run */
+  size_t rank;                      /*< Rank of the interval bounds */
+  int pin = -1;                     /*< Processor of every run */
+  int quiet;                        /*< Hide the output of the runs */
+  int exit_code = 0;
+  int metric;
+  size_t i;
+  int j;
+
+  argtable[0] = verb;
+  argtable[1] = help;
+  argtable[2] = runs;
+  argtable[3] = warm;
+  argtable[4] = cpu;
+  argtable[5] = conf;
+  argtable[6] = show;
+  argtable[7] = corp;
+  argtable[8] = bins;
+  argtable[9] = args;
+  argtable[10] = end;
+
+  if (arg_nullcheck (argtable) != 0) {
+    printf ("%s: insufficient memory\n", progname);
+    arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+    return 1;
+    }
+
+  /* Both positional lists fill in order: the first two are the builds */
+  if (arg_parse (argc, argv, argtable) > 0 || help->count > 0) {
+    if (help->count == 0) {
+      arg_print_errors (stdout, end, progname);
+      }
+
+    printf ("Usage: %s", progname);
+    arg_print_syntax (stdout, argtable, "\n");
+    printf ("Run two builds of ppack in turn with the same arguments, and compare them.\n\n");
+    arg_print_glossary (stdout, argtable, "  %-20s %s\n");
+    exit_code = help->count > 0 ? 0 : 1;
+    goto call_exit;
+    }
+
+  if (runs->count > 0) {
+    if (runs->ival[0] < 1 || runs->ival[0] > MAX_RUNS) {
+      printf ("%s: --runs must be from 1 to %d\n", progname, MAX_RUNS);
+      exit_code = 1;
+      goto call_exit;
+      }
+
+    nruns = (size_t) runs->ival[0];
+    }
+
+  if (warm->count > 0) {
+    nwarm = warm->ival[0] > 0 ? (size_t) warm->ival[0] : 0;
+    }
+
+  if (conf->count > 0) {
+    if (conf->dval[0] <= 0.0 || conf->dval[0] >= 100.0) {
+      printf ("%s: --confidence must be between 0 and 100\n", progname);
+      exit_code = 1;
+      goto call_exit;
+      }
+
+    confidence = conf->dval[0] / 100.0;
+    }
+
+  if (cpu->count > 0) {
+#ifdef HAVE_SCHED_SETAFFINITY
+    pin = cpu->ival[0];
+#else
+    printf ("%s: --cpu is not supported on this platform\n", progname);
+    exit_code = 1;
+    goto call_exit;
+#endif
+    }
+
+  quiet = show->count == 0;
+
+  base = (struct run*) calloc (nruns, sizeof (*base));
+  cand = (struct run*) calloc (nruns, sizeof (*cand));
+  a = (double*) calloc (nruns, sizeof (*a));
+  b = (double*) calloc (nruns, sizeof (*b));
+  child = (char**) calloc ( (size_t) args->count + 2, sizeof (*child));
+
+  if (base == NULL || cand == NULL || a == NULL || b == NULL || child == NULL) {
+    fprintf (stderr, "Cannot allocate the runs\n");
+    exit_code = 10;
+    goto call_exit;
+    }
+
+  for (j = 0; j < args->count; j++) {
+    child[j + 1] = (char*) args->sval[j];
+    }
+
+  /* Without --input, guess the pages from the arguments of the runs */
+  for (j = 0; j < corp->count; j++) {
+    measure_input (corp->filename[j], &input);
+    }
+
+  for (j = 0; corp->count == 0 && j < args->count; j++) {
+    measure_input (args->sval[j], &input);
+    }
+
+  count_input (&input, &pages, &bytes);
+
+  printf ("Comparing %lu run(s) of each build, in alternating pairs, after %lu warm-up run(s)",
+          (unsigned long) nruns, (unsigned long) nwarm);
+
+  if (pin >= 0) {
+    printf (", on processor %d", pin);
+    }
+
+  printf ("\n  baseline:  %s\n  candidate: %s\n  input:     %lu page(s), %.0f byte(s)\n\n",
+          bins->sval[0], bins->sval[1], pages, bytes);
+
+  for (i = 0; i < nwarm; i++) {
+    struct run ignored;
+
+    if (run_once (bins->sval[0], child, pin, quiet, &ignored) != PK_OK
+        || run_once (bins->sval[1], child, pin, quiet, &ignored) != PK_OK) {
+      exit_code = 10;
+      goto call_exit;
+      }
+    }
+
+  for (i = 0; i < nruns; i++) {
+    int first = i % 2 == 0;
+
+    if (run_once (bins->sval[first ? 0 : 1], child, pin, quiet, first ? &base[i] : &cand[i]) != PK_OK
+        || run_once (bins->sval[first ? 1 : 0], child, pin, quiet, first ? &cand[i] : &base[i]) != PK_OK) {
+      exit_code = 10;
+      goto call_exit;
+      }
+
+    if (verb->count > 0) {
+      printf ("  pair %3lu: baseline %10.3f ms %8.0f KB, candidate %10.3f ms %8.0f KB\n",
+              (unsigned long) i + 1, base[i].wall, base[i].rss, cand[i].wall, cand[i].rss);
+      }
+    }
+
+  rank = interval_rank (nruns, confidence);
+
+  if (verb->count > 0) {
+    printf ("\n");
+    }
+
+  printf ("  %-20s %12s %12s %10s   %g%% interval of the change\n", "median", "baseline", "candidate", "change",
+          confidence * 100.0);
+
+  for (metric = 0; metric < METRICS; metric++) {
+    report_metric (base, cand, nruns, (enum metric) metric, bytes, rank, a, b);
+    }
+
+  if (rank == 0) {
+    printf ("\nToo few runs for a %g%% interval: use more with --runs\n", confidence * 100.0);
+    }
+
+call_exit:
+  free (base);
+  free (cand);
+  free (a);
+  free (b);
+  free (child);
+  free (input.pages);
+  arg_freetable (argtable, sizeof argtable / sizeof argtable[0]);
+  return exit_code;
+  }
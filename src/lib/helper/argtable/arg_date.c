@@ -180,6 +180,7 @@ struct arg_date* arg_daten (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = NULL;
 
     /* store the tmval[maxcount] array immediately after the arg_date struct */
     result->tmval  = (struct tm*) (result + 1);
@@ -158,6 +158,7 @@ struct arg_dbl* arg_dbln (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = NULL;
 
     /* Store the dval[maxcount] array on the first double boundary that immediately follows the arg_dbl struct. */
     /* We do the memory alignment purely for SPARC and Motorola systems. They require floats and doubles to be  */
@@ -96,6 +96,7 @@ struct arg_end* arg_end (int maxcount) {
     result->hdr.scanfn    = NULL;
     result->hdr.checkfn   = NULL;
     result->hdr.errorfn   = errorfn;
+    result->hdr.freefn    = NULL;
 
     /* store error[maxcount] array immediately after struct arg_end */
     result->error = (int*) (result + 1);
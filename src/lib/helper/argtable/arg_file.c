@@ -101,7 +101,7 @@ static const char* arg_extension (const char* basename) {
     }
 
   /* special case: empty extensions (eg "foo.","foo..") are not considered as true extensions */
-  if (basename && result && result[1] == '\0') {
+  if (basename && result && result[0] == '.' && result[1] == '\0') {
     result = basename + strlen (basename);
     }
 
@@ -221,6 +221,7 @@ struct arg_file* arg_filen (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = NULL;
 
     /* store the filename,basename,extension arrays immediately after the arg_file struct */
     result->filename  = (const char**) (result + 1);
@@ -336,6 +336,7 @@ struct arg_int* arg_intn (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = NULL;
 
     /* store the ival[maxcount] array immediately after the arg_int struct */
     result->ival  = (int*) (result + 1);
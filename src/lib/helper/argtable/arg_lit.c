@@ -117,6 +117,7 @@ struct arg_lit* arg_litn (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = NULL;
 
     /* init local variables */
     result->count = 0;
@@ -48,6 +48,7 @@ struct arg_rem* arg_rem (const char* datatype,
     result->hdr.scanfn    = NULL;
     result->hdr.checkfn   = NULL;
     result->hdr.errorfn   = NULL;
+    result->hdr.freefn    = NULL;
     }
 
   /*printf("arg_rem() returns %p\n",result);*/
@@ -39,19 +39,18 @@ enum {EMINCOUNT = 200, EMAXCOUNT = 201};
 struct privhdr {
   const char* pattern;
   int flags;
+  int compiled;   /* non-zero once regex holds a valid compiled pattern */
   regex_t regex;
   };
 
 
 static void resetfn (struct arg_rex* parent) {
-  struct privhdr* priv = (struct privhdr*) (parent->hdr.priv);
-
   /*printf("%s:resetfn(%p)\n",__FILE__,parent);*/
   parent->count = 0;
 
-  /* construct the regex representation of the given pattern string. */
-  /* Dont bother checking for errors as we already did that earlier (in the constructor) */
-  regcomp (& (priv->regex), priv->pattern, priv->flags);
+  /* the regex was compiled once by the constructor and is kept until */
+  /* the table is freed, so repeated (or concurrent) parses against   */
+  /* it need neither recompile nor leak a regex_t per parse           */
   }
 
 static int scanfn (struct arg_rex* parent, const char* argval) {
@@ -74,7 +73,14 @@ static int scanfn (struct arg_rex* parent, const char* argval) {
 
     /* test the current argument value for a match with the regular expression */
     /* if a match is detected, record the argument value in the arg_rex struct */
-    errorcode = regexec (& (priv->regex), argval, 0, NULL, 0);
+    if (priv->compiled) {
+      errorcode = regexec (& (priv->regex), argval, 0, NULL, 0);
+      }
+
+    else {
+      /* the pattern failed to compile (already reported by the constructor) */
+      errorcode = REG_BADPAT;
+      }
 
     if (errorcode == 0) {
       parent->sval[parent->count++] = argval;
@@ -87,15 +93,21 @@ static int scanfn (struct arg_rex* parent, const char* argval) {
 
 static int checkfn (struct arg_rex* parent) {
   int errorcode = (parent->count < parent->hdr.mincount) ? EMINCOUNT : 0;
-  struct privhdr* priv = (struct privhdr*) parent->hdr.priv;
-
-  /* free the regex "program" we constructed in resetfn */
-  regfree (& (priv->regex));
 
   /*printf("%s:checkfn(%p) returns %d\n",__FILE__,parent,errorcode);*/
   return errorcode;
   }
 
+static void freefn (struct arg_rex* parent) {
+  struct privhdr* priv = (struct privhdr*) parent->hdr.priv;
+
+  /* free the regex "program" we constructed in the constructor */
+  if (priv->compiled) {
+    regfree (& (priv->regex));
+    priv->compiled = 0;
+    }
+  }
+
 static void errorfn (struct arg_rex* parent, FILE* fp, int errorcode, const char* argval, const char* progname) {
   const char* shortopts = parent->hdr.shortopts;
   const char* longopts  = parent->hdr.longopts;
@@ -194,6 +206,7 @@ struct arg_rex* arg_rexn (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = (arg_freefn*) freefn;
 
     /* store the arg_rex_priv struct immediately after the arg_rex struct */
     result->hdr.priv  = (const char**) (result + 1);
@@ -210,11 +223,12 @@ struct arg_rex* arg_rexn (const char* shortopts,
       result->sval[i] = "";
       }
 
-    /* here we construct and destroy a regex representation of the regular expression
-       for no other reason than to force any regex errors to be trapped now rather
-       than later. If we dont, then errors may go undetected until an argument is
-       actually parsed. */
+    /* here we construct the regex representation of the regular expression once,
+       both to force any regex errors to be trapped now rather than later and so
+       that every subsequent parse can share it. It is released by freefn when
+       the argtable is freed. */
     errorcode = regcomp (& (priv->regex), priv->pattern, priv->flags);
+    priv->compiled = (errorcode == 0);
 
     if (errorcode) {
       char errbuff[256];
@@ -222,10 +236,6 @@ struct arg_rex* arg_rexn (const char* shortopts,
       printf ("argtable: %s \"%s\"\n", errbuff, priv->pattern);
       printf ("argtable: Bad argument table.\n");
       }
-
-    else {
-      regfree (& (priv->regex));
-      }
     }
 
   /*printf("arg_rexn() returns %p\n",result);*/
@@ -139,6 +139,7 @@ struct arg_str* arg_strn (const char* shortopts,
     result->hdr.scanfn    = (arg_scanfn*) scanfn;
     result->hdr.checkfn   = (arg_checkfn*) checkfn;
     result->hdr.errorfn   = (arg_errorfn*) errorfn;
+    result->hdr.freefn    = NULL;
 
     /* store the sval[maxcount] array immediately after the arg_str struct */
     result->sval  = (const char**) (result + 1);
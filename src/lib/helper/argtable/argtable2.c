@@ -284,7 +284,7 @@ int arg_endindex (struct arg_hdr** table) {
 
 
 static
-void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg_end* endtable) {
+void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg_end* endtable, struct _getopt_data* state) {
   struct longoptions* longoptions;
   char* shortoptions;
   int copt;
@@ -308,11 +308,12 @@ void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg
   /*dump_longoptions(longoptions);*/
 
   /* reset getopts internal option-index to zero, and disable error reporting */
-  optind = 0;
-  opterr = 0;
+  state->optind = 0;
+  state->opterr = 0;
 
-  /* fetch and process args using getopt_long */
-  while ( (copt = getopt_long (argc, argv, shortoptions, longoptions->options, NULL)) != -1) {
+  /* fetch and process args using the reentrant getopt_long: all of the  */
+  /* scanner state lives in *state, so concurrent parses do not collide */
+  while ( (copt = _getopt_long_r (argc, argv, shortoptions, longoptions->options, NULL, state)) != -1) {
     /*
     printf("optarg='%s'\n",optarg);
     printf("optind=%d\n",optind);
@@ -325,17 +326,17 @@ void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg
         void* parent  = table[tabindex]->parent;
 
         /*printf("long option detected from argtable[%d]\n", tabindex);*/
-        if (optarg && optarg[0] == 0 && (table[tabindex]->flag & ARG_HASVALUE)) {
+        if (state->optarg && state->optarg[0] == 0 && (table[tabindex]->flag & ARG_HASVALUE)) {
           /* printf(": long option %s requires an argument\n",argv[optind-1]); */
-          arg_register_error (endtable, endtable, ARG_EMISSARG, argv[optind - 1]);
+          arg_register_error (endtable, endtable, ARG_EMISSARG, argv[state->optind - 1]);
           /* continue to scan the (empty) argument value to enforce argument count checking */
           }
 
         if (table[tabindex]->scanfn) {
-          int errorcode = table[tabindex]->scanfn (parent, optarg);
+          int errorcode = table[tabindex]->scanfn (parent, state->optarg);
 
           if (errorcode != 0) {
-            arg_register_error (endtable, parent, errorcode, optarg);
+            arg_register_error (endtable, parent, errorcode, state->optarg);
             }
           }
         }
@@ -348,15 +349,15 @@ void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg
         * if it was a short option its value is in optopt
         * if it was a long option then optopt=0
         */
-        switch (optopt) {
+        switch (state->optopt) {
           case 0:
             /*printf("?0 unrecognised long option %s\n",argv[optind-1]);*/
-            arg_register_error (endtable, endtable, ARG_ELONGOPT, argv[optind - 1]);
+            arg_register_error (endtable, endtable, ARG_ELONGOPT, argv[state->optind - 1]);
             break;
 
           default:
             /*printf("?* unrecognised short option '%c'\n",optopt);*/
-            arg_register_error (endtable, endtable, optopt, NULL);
+            arg_register_error (endtable, endtable, state->optopt, NULL);
             break;
           }
 
@@ -367,7 +368,7 @@ void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg
         * getopt_long() found an option with its argument missing.
         */
         /*printf(": option %s requires an argument\n",argv[optind-1]); */
-        arg_register_error (endtable, endtable, ARG_EMISSARG, argv[optind - 1]);
+        arg_register_error (endtable, endtable, ARG_EMISSARG, argv[state->optind - 1]);
         break;
 
       default: {
@@ -384,10 +385,10 @@ void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg
         else {
           if (table[tabindex]->scanfn) {
             void* parent  = table[tabindex]->parent;
-            int errorcode = table[tabindex]->scanfn (parent, optarg);
+            int errorcode = table[tabindex]->scanfn (parent, state->optarg);
 
             if (errorcode != 0) {
-              arg_register_error (endtable, parent, errorcode, optarg);
+              arg_register_error (endtable, parent, errorcode, state->optarg);
               }
             }
           }
@@ -403,7 +404,7 @@ void arg_parse_tagged (int argc, char** argv, struct arg_hdr** table, struct arg
 
 
 static
-void arg_parse_untagged (int argc, char** argv, struct arg_hdr** table, struct arg_end* endtable) {
+void arg_parse_untagged (int argc, char** argv, struct arg_hdr** table, struct arg_end* endtable, struct _getopt_data* state) {
   int tabindex = 0;
   int errorlast = 0;
   const char* optarglast = NULL;
@@ -415,7 +416,7 @@ void arg_parse_untagged (int argc, char** argv, struct arg_hdr** table, struct a
     int errorcode;
 
     /* if we have exhausted our argv[optind] entries then we have finished */
-    if (optind >= argc) {
+    if (state->optind >= argc) {
       /*printf("arg_parse_untagged(): argv[] exhausted\n");*/
       return;
       }
@@ -438,12 +439,12 @@ void arg_parse_untagged (int argc, char** argv, struct arg_hdr** table, struct a
     /* table[tabindex] entry. If it succeeds then keep it, otherwise */
     /* try again with the next table[] entry.                        */
     parent = table[tabindex]->parent;
-    errorcode = table[tabindex]->scanfn (parent, argv[optind]);
+    errorcode = table[tabindex]->scanfn (parent, argv[state->optind]);
 
     if (errorcode == 0) {
       /* success, move onto next argv[optind] but stay with same table[tabindex] */
       /*printf("arg_parse_untagged(): argtable[%d] successfully matched\n",tabindex);*/
-      optind++;
+      state->optind++;
 
       /* clear the last tentative error */
       errorlast = 0;
@@ -456,7 +457,7 @@ void arg_parse_untagged (int argc, char** argv, struct arg_hdr** table, struct a
 
       /* remember this as a tentative error we may wish to reinstate later */
       errorlast = errorcode;
-      optarglast = argv[optind];
+      optarglast = argv[state->optind];
       parentlast = parent;
       }
 
@@ -465,14 +466,14 @@ void arg_parse_untagged (int argc, char** argv, struct arg_hdr** table, struct a
   /* if a tenative error still remains at this point then register it as a proper error */
   if (errorlast) {
     arg_register_error (endtable, parentlast, errorlast, optarglast);
-    optind++;
+    state->optind++;
     }
 
   /* only get here when not all argv[] entries were consumed */
   /* register an error for each unused argv[] entry */
-  while (optind < argc) {
+  while (state->optind < argc) {
     /*printf("arg_parse_untagged(): argv[%d]=\"%s\" not consumed\n",optind,argv[optind]);*/
-    arg_register_error (endtable, endtable, ARG_ENOMATCH, argv[optind++]);
+    arg_register_error (endtable, endtable, ARG_ENOMATCH, argv[state->optind++]);
     }
 
   return;
@@ -518,6 +519,7 @@ int arg_parse (int argc, char** argv, void** argtable) {
   struct arg_end* endtable;
   int endindex;
   char** argvcopy = NULL;
+  struct _getopt_data state;
 
   /*printf("arg_parse(%d,%p,%p)\n",argc,argv,argtable);*/
 
@@ -553,11 +555,15 @@ int arg_parse (int argc, char** argv, void** argtable) {
       argvcopy[i] = argv[i];
       }
 
+    /* the getopt state is local to this call, which keeps arg_parse */
+    /* reentrant for callers parsing separate argtables in parallel  */
+    memset (&state, 0, sizeof (state));
+
     /* parse the command line (local copy) for tagged options */
-    arg_parse_tagged (argc, argvcopy, table, endtable);
+    arg_parse_tagged (argc, argvcopy, table, endtable, &state);
 
     /* parse the command line (local copy) for untagged options */
-    arg_parse_untagged (argc, argvcopy, table, endtable);
+    arg_parse_untagged (argc, argvcopy, table, endtable, &state);
 
     /* if no errors so far then perform post-parse checks otherwise dont bother */
     if (endtable->count == 0) {
@@ -1147,6 +1153,11 @@ void arg_free (void** argtable) {
       }
 
     flag = table[tabindex]->flag;
+
+    if (table[tabindex]->freefn) {
+      table[tabindex]->freefn (table[tabindex]->parent);
+      }
+
     free (table[tabindex]);
     table[tabindex++] = NULL;
 
@@ -1165,6 +1176,10 @@ void arg_freetable (void** argtable, size_t n) {
       continue;
       }
 
+    if (table[tabindex]->freefn) {
+      table[tabindex]->freefn (table[tabindex]->parent);
+      }
+
     free (table[tabindex]);
     table[tabindex] = NULL;
     };
@@ -54,7 +54,13 @@
    and linking in this code is a waste when using the GNU C library
    (especially if it is a shared library).  Rather than having every GNU
    program understand `configure --with-gnu-libc' and omit the object files,
-   it is simpler to just do this in the source for each such file.  */
+   it is simpler to just do this in the source for each such file.
+
+   Only the classic interface (the globals and `getopt' itself) is elided
+   in that case: the reentrant scanner `_getopt_internal_r' has no
+   counterpart in the C library's public interface, and is always
+   compiled so that callers such as `arg_parse' can keep their own
+   state.  */
 
 #define GETOPT_INTERFACE_VERSION 2
 #if !defined (_LIBC) && defined (__GLIBC__) && __GLIBC__ >= 2
@@ -64,8 +70,6 @@
 #endif
 #endif
 
-#ifndef ELIDE_CODE
-
 /* This needs to come after some library #include
    to get __GNU_LIBRARY__ defined.  */
 #ifdef  __GNU_LIBRARY__
@@ -118,6 +122,8 @@
 
 #include "getopt.h"
 
+#ifndef ELIDE_CODE
+
 /* For communication from `getopt' to the caller.
    When `getopt' finds an option that takes an argument,
    the argument value is returned here.
@@ -141,21 +147,6 @@ char* optarg = NULL;
 /* 1003.2 says this must be 1 before any call.  */
 int optind = 1;
 
-/* Formerly, initialization of getopt depended on optind==0, which
-   causes problems with re-calling getopt as programs generally don't
-   know that. */
-
-int __getopt_initialized = 0;
-
-/* The next char to be scanned in the option-element
-   in which the last option character we returned was found.
-   This allows us to pick up the scan where we left off.
-
-   If this is zero, or a null string, it means resume the scan
-   by advancing to the next ARGV-element.  */
-
-static char* nextchar;
-
 /* Callers store zero here to inhibit the error message
    for unrecognized options.  */
 
@@ -167,7 +158,33 @@ int opterr = 1;
 
 int optopt = '?';
 
-/* Describe how to deal with options that follow non-option ARGV-elements.
+/* Keep a global copy of all internal members of getopt_data.  The
+   classic interface copies the globals above into it before each scan,
+   and back out again afterwards.  */
+
+static struct _getopt_data getopt_data;
+
+#endif /* Not ELIDE_CODE.  */
+
+/* The rest of the scanner's state lives in `struct _getopt_data'
+   (see getopt.h), so that each caller of `_getopt_internal_r' can
+   keep its own:
+
+   `__initialized' replaces the old test of optind==0, which caused
+   problems with re-calling getopt as programs generally don't know
+   that.
+
+   `__nextchar' is the next char to be scanned in the option-element
+   in which the last option character we returned was found.  This
+   allows us to pick up the scan where we left off.  If this is zero,
+   or a null string, it means resume the scan by advancing to the next
+   ARGV-element.
+
+   `__posixly_correct' holds the value of the POSIXLY_CORRECT
+   environment variable.
+
+   `__ordering' describes how to deal with options that follow
+   non-option ARGV-elements.
 
    If the caller did not specify anything,
    the default is REQUIRE_ORDER if the environment variable
@@ -196,14 +213,6 @@ int optopt = '?';
    of the value of `ordering'.  In the case of RETURN_IN_ORDER, only
    `--' can cause `getopt' to return -1 with `optind' != ARGC.  */
 
-static enum {
-  REQUIRE_ORDER, PERMUTE, RETURN_IN_ORDER
-}
-ordering;
-
-/* Value of POSIXLY_CORRECT environment variable.  */
-static char* posixly_correct;
-
 #ifdef  __GNU_LIBRARY__
 /* We want to avoid inclusion of string.h with non-GNU libraries
    because there are many ways it can cause trouble.
@@ -253,10 +262,8 @@ extern int strlen (const char*);
 
 /* Describe the part of ARGV that contains non-options that have
    been skipped.  `first_nonopt' is the index in ARGV of the first of them;
-   `last_nonopt' is the index after the last of them.  */
-
-static int first_nonopt;
-static int last_nonopt;
+   `last_nonopt' is the index after the last of them.  Both live in
+   `struct _getopt_data' as `__first_nonopt' and `__last_nonopt'.  */
 
 #ifdef _LIBC
 /* Bash 2.0 gives us an environment variable containing flags
@@ -292,17 +299,18 @@ text_set_element (__libc_subinit, store_args);
    the new indices of the non-options in ARGV after they are moved.  */
 
 #if defined (__STDC__) && __STDC__
-static void exchange (char**);
+static void exchange (char**, struct _getopt_data*);
 
 #endif
 
 static void
-exchange (argv)
+exchange (argv, d)
 char** argv;
+struct _getopt_data* d;
   {
-  int bottom = first_nonopt;
-  int middle = last_nonopt;
-  int top = optind;
+  int bottom = d->__first_nonopt;
+  int middle = d->__last_nonopt;
+  int top = d->optind;
   char* tem;
 
   /* Exchange the shorter segment with the far end of the longer segment.
@@ -346,55 +354,63 @@ char** argv;
 
   /* Update records for the slots the non-options now occupy.  */
 
-  first_nonopt += (optind - last_nonopt);
-  last_nonopt = optind;
+  d->__first_nonopt += (d->optind - d->__last_nonopt);
+  d->__last_nonopt = d->optind;
   }
 
 /* Initialize the internal data when the first call is made.  */
 
 #if defined (__STDC__) && __STDC__
-static const char* _getopt_initialize (int, char* const*, const char*);
+static const char* _getopt_initialize (int, char* const*, const char*,
+                                       struct _getopt_data*);
 
 #endif
 static const char*
-_getopt_initialize (argc, argv, optstring)
+_getopt_initialize (argc, argv, optstring, d)
 int argc;
 char* const* argv;
 const char* optstring;
+struct _getopt_data* d;
   {
+#ifndef _LIBC
+  /* Only the C library checks argc and argv against the originals */
+  (void) argc;
+  (void) argv;
+#endif
+
   /* Start processing options with ARGV-element 1 (since ARGV-element 0
      is the program name); the sequence of previously skipped
      non-option ARGV-elements is empty.  */
 
-  first_nonopt = last_nonopt = optind = 1;
+  d->__first_nonopt = d->__last_nonopt = d->optind = 1;
 
-  nextchar = NULL;
+  d->__nextchar = NULL;
 
-  posixly_correct = getenv ("POSIXLY_CORRECT");
+  d->__posixly_correct = getenv ("POSIXLY_CORRECT");
 
   /* Determine how to handle the ordering of options and nonoptions.  */
 
   if (optstring[0] == '-') {
-    ordering = RETURN_IN_ORDER;
+    d->__ordering = RETURN_IN_ORDER;
     ++optstring;
     }
 
   else if (optstring[0] == '+') {
-    ordering = REQUIRE_ORDER;
+    d->__ordering = REQUIRE_ORDER;
     ++optstring;
     }
 
-  else if (posixly_correct != NULL) {
-    ordering = REQUIRE_ORDER;
+  else if (d->__posixly_correct != NULL) {
+    d->__ordering = REQUIRE_ORDER;
     }
 
   else {
-    ordering = PERMUTE;
+    d->__ordering = PERMUTE;
     }
 
 #ifdef _LIBC
 
-  if (posixly_correct == NULL
+  if (d->__posixly_correct == NULL
       && argc == original_argc && argv == original_argv) {
     /* Bash 2.0 puts a special variable in the environment for each
        command it runs, specifying which ARGV elements are the results of
@@ -480,20 +496,21 @@ const char* optstring;
    long-named options.  */
 
 int
-_getopt_internal (argc, argv, optstring, longopts, longind, long_only)
+_getopt_internal_r (argc, argv, optstring, longopts, longind, long_only, d)
 int argc;
 char* const* argv;
 const char* optstring;
 const struct option* longopts;
 int* longind;
 int long_only;
+struct _getopt_data* d;
   {
-  optarg = NULL;
+  d->optarg = NULL;
 
-  if (!__getopt_initialized || optind == 0) {
-    optstring = _getopt_initialize (argc, argv, optstring);
-    optind = 1; /* Don't scan ARGV[0], the program name.  */
-    __getopt_initialized = 1;
+  if (!d->__initialized || d->optind == 0) {
+    optstring = _getopt_initialize (argc, argv, optstring, d);
+    d->optind = 1; /* Don't scan ARGV[0], the program name.  */
+    d->__initialized = 1;
     }
 
   /* Test whether ARGV[optind] points to a non-option argument.
@@ -501,46 +518,46 @@ int long_only;
      from the shell indicating it is not an option.  The later information
      is only used when the used in the GNU libc.  */
 #ifdef _LIBC
-#define NONOPTION_P (argv[optind][0] != '-' || argv[optind][1] == '\0'        \
-                     || (optind < nonoption_flags_len           \
-                         && nonoption_flags[optind] == '1'))
+#define NONOPTION_P (argv[d->optind][0] != '-' || argv[d->optind][1] == '\0' \
+                     || (d->optind < nonoption_flags_len           \
+                         && nonoption_flags[d->optind] == '1'))
 #else
-#define NONOPTION_P (argv[optind][0] != '-' || argv[optind][1] == '\0')
+#define NONOPTION_P (argv[d->optind][0] != '-' || argv[d->optind][1] == '\0')
 #endif
 
-  if (nextchar == NULL || *nextchar == '\0') {
+  if (d->__nextchar == NULL || *d->__nextchar == '\0') {
     /* Advance to the next ARGV-element.  */
 
     /* Give FIRST_NONOPT & LAST_NONOPT rational values if OPTIND has been
        moved back by the user (who may also have changed the arguments).  */
-    if (last_nonopt > optind) {
-      last_nonopt = optind;
+    if (d->__last_nonopt > d->optind) {
+      d->__last_nonopt = d->optind;
       }
 
-    if (first_nonopt > optind) {
-      first_nonopt = optind;
+    if (d->__first_nonopt > d->optind) {
+      d->__first_nonopt = d->optind;
       }
 
-    if (ordering == PERMUTE) {
+    if (d->__ordering == PERMUTE) {
       /* If we have just processed some options following some non-options,
          exchange them so that the options come first.  */
 
-      if (first_nonopt != last_nonopt && last_nonopt != optind) {
-        exchange ( (char**) argv);
+      if (d->__first_nonopt != d->__last_nonopt && d->__last_nonopt != d->optind) {
+        exchange ( (char**) argv, d);
         }
 
-      else if (last_nonopt != optind) {
-        first_nonopt = optind;
+      else if (d->__last_nonopt != d->optind) {
+        d->__first_nonopt = d->optind;
         }
 
       /* Skip any additional non-options
          and extend the range of non-options previously skipped.  */
 
-      while (optind < argc && NONOPTION_P) {
-        optind++;
+      while (d->optind < argc && NONOPTION_P) {
+        d->optind++;
         }
 
-      last_nonopt = optind;
+      d->__last_nonopt = d->optind;
       }
 
     /* The special ARGV-element `--' means premature end of options.
@@ -548,30 +565,30 @@ int long_only;
        then exchange with previous non-options as if it were an option,
        then skip everything else like a non-option.  */
 
-    if (optind != argc && !strcmp (argv[optind], "--")) {
-      optind++;
+    if (d->optind != argc && !strcmp (argv[d->optind], "--")) {
+      d->optind++;
 
-      if (first_nonopt != last_nonopt && last_nonopt != optind) {
-        exchange ( (char**) argv);
+      if (d->__first_nonopt != d->__last_nonopt && d->__last_nonopt != d->optind) {
+        exchange ( (char**) argv, d);
         }
 
-      else if (first_nonopt == last_nonopt) {
-        first_nonopt = optind;
+      else if (d->__first_nonopt == d->__last_nonopt) {
+        d->__first_nonopt = d->optind;
         }
 
-      last_nonopt = argc;
+      d->__last_nonopt = argc;
 
-      optind = argc;
+      d->optind = argc;
       }
 
     /* If we have done all the ARGV-elements, stop the scan
        and back over any non-options that we skipped and permuted.  */
 
-    if (optind == argc) {
+    if (d->optind == argc) {
       /* Set the next-arg-index to point at the non-options
          that we previously skipped, so the caller will digest them.  */
-      if (first_nonopt != last_nonopt) {
-        optind = first_nonopt;
+      if (d->__first_nonopt != d->__last_nonopt) {
+        d->optind = d->__first_nonopt;
         }
 
       return -1;
@@ -581,19 +598,19 @@ int long_only;
        either stop the scan or describe it to the caller and pass it by.  */
 
     if (NONOPTION_P) {
-      if (ordering == REQUIRE_ORDER) {
+      if (d->__ordering == REQUIRE_ORDER) {
         return -1;
         }
 
-      optarg = argv[optind++];
+      d->optarg = argv[d->optind++];
       return 1;
       }
 
     /* We have found another option-ARGV-element.
        Skip the initial punctuation.  */
 
-    nextchar = (argv[optind] + 1
-                + (longopts != NULL && argv[optind][1] == '-'));
+    d->__nextchar = (argv[d->optind] + 1
+                + (longopts != NULL && argv[d->optind][1] == '-'));
     }
 
   /* Decode the current option-ARGV-element.  */
@@ -612,8 +629,8 @@ int long_only;
      This distinction seems to be the most useful approach.  */
 
   if (longopts != NULL
-      && (argv[optind][1] == '-'
-          || (long_only && (argv[optind][2] || !my_index (optstring, argv[optind][1]))))) {
+      && (argv[d->optind][1] == '-'
+          || (long_only && (argv[d->optind][2] || !my_index (optstring, argv[d->optind][1]))))) {
     char* nameend;
     const struct option* p;
     const struct option* pfound = NULL;
@@ -622,14 +639,14 @@ int long_only;
     int indfound = -1;
     int option_index;
 
-    for (nameend = nextchar; *nameend && *nameend != '='; nameend++)
+    for (nameend = d->__nextchar; *nameend && *nameend != '='; nameend++)
       /* Do nothing.  */ ;
 
     /* Test all long options for either exact match
        or abbreviated matches.  */
     for (p = longopts, option_index = 0; p->name; p++, option_index++)
-      if (!strncmp (p->name, nextchar, nameend - nextchar)) {
-        if ( (unsigned int) (nameend - nextchar)
+      if (!strncmp (p->name, d->__nextchar, nameend - d->__nextchar)) {
+        if ( (unsigned int) (nameend - d->__nextchar)
              == (unsigned int) strlen (p->name)) {
           /* Exact match found.  */
           pfound = p;
@@ -652,30 +669,30 @@ int long_only;
         }
 
     if (ambig && !exact) {
-      if (opterr)
+      if (d->opterr)
         fprintf (stderr, _ ("%s: option `%s' is ambiguous\n"),
-                 argv[0], argv[optind]);
+                 argv[0], argv[d->optind]);
 
-      nextchar += strlen (nextchar);
-      optind++;
-      optopt = 0;
+      d->__nextchar += strlen (d->__nextchar);
+      d->optind++;
+      d->optopt = 0;
       return '?';
       }
 
     if (pfound != NULL) {
       option_index = indfound;
-      optind++;
+      d->optind++;
 
       if (*nameend) {
         /* Don't test has_arg with >, because some C compilers don't
            allow it to be used on enums.  */
         if (pfound->has_arg) {
-          optarg = nameend + 1;
+          d->optarg = nameend + 1;
           }
 
         else {
-          if (opterr) {
-            if (argv[optind - 1][1] == '-')
+          if (d->opterr) {
+            if (argv[d->optind - 1][1] == '-')
               /* --option */
               fprintf (stderr,
                        _ ("%s: option `--%s' doesn't allow an argument\n"),
@@ -685,34 +702,34 @@ int long_only;
               /* +option or -option */
               fprintf (stderr,
                        _ ("%s: option `%c%s' doesn't allow an argument\n"),
-                       argv[0], argv[optind - 1][0], pfound->name);
+                       argv[0], argv[d->optind - 1][0], pfound->name);
             }
 
-          nextchar += strlen (nextchar);
+          d->__nextchar += strlen (d->__nextchar);
 
-          optopt = pfound->val;
+          d->optopt = pfound->val;
           return '?';
           }
         }
 
       else if (pfound->has_arg == 1) {
-        if (optind < argc) {
-          optarg = argv[optind++];
+        if (d->optind < argc) {
+          d->optarg = argv[d->optind++];
           }
 
         else {
-          if (opterr)
+          if (d->opterr)
             fprintf (stderr,
                      _ ("%s: option `%s' requires an argument\n"),
-                     argv[0], argv[optind - 1]);
+                     argv[0], argv[d->optind - 1]);
 
-          nextchar += strlen (nextchar);
-          optopt = pfound->val;
+          d->__nextchar += strlen (d->__nextchar);
+          d->optopt = pfound->val;
           return optstring[0] == ':' ? ':' : '?';
           }
         }
 
-      nextchar += strlen (nextchar);
+      d->__nextchar += strlen (d->__nextchar);
 
       if (longind != NULL) {
         *longind = option_index;
@@ -730,23 +747,23 @@ int long_only;
        or the option starts with '--' or is not a valid short
        option, then it's an error.
        Otherwise interpret it as a short option.  */
-    if (!long_only || argv[optind][1] == '-'
-        || my_index (optstring, *nextchar) == NULL) {
-      if (opterr) {
-        if (argv[optind][1] == '-')
+    if (!long_only || argv[d->optind][1] == '-'
+        || my_index (optstring, *d->__nextchar) == NULL) {
+      if (d->opterr) {
+        if (argv[d->optind][1] == '-')
           /* --option */
           fprintf (stderr, _ ("%s: unrecognized option `--%s'\n"),
-                   argv[0], nextchar);
+                   argv[0], d->__nextchar);
 
         else
           /* +option or -option */
           fprintf (stderr, _ ("%s: unrecognized option `%c%s'\n"),
-                   argv[0], argv[optind][0], nextchar);
+                   argv[0], argv[d->optind][0], d->__nextchar);
         }
 
-      nextchar = (char*) "";
-      optind++;
-      optopt = 0;
+      d->__nextchar = (char*) "";
+      d->optind++;
+      d->optopt = 0;
       return '?';
       }
     }
@@ -754,17 +771,17 @@ int long_only;
   /* Look at and handle the next short option-character.  */
 
     {
-    char c = *nextchar++;
+    char c = *d->__nextchar++;
     char* temp = my_index (optstring, c);
 
     /* Increment `optind' when we start to process its last character.  */
-    if (*nextchar == '\0') {
-      ++optind;
+    if (*d->__nextchar == '\0') {
+      ++d->optind;
       }
 
     if (temp == NULL || c == ':') {
-      if (opterr) {
-        if (posixly_correct)
+      if (d->opterr) {
+        if (d->__posixly_correct)
           /* 1003.2 specifies the format of this message.  */
           fprintf (stderr, _ ("%s: illegal option -- %c\n"),
                    argv[0], c);
@@ -774,7 +791,7 @@ int long_only;
                    argv[0], c);
         }
 
-      optopt = c;
+      d->optopt = c;
       return '?';
       }
 
@@ -789,21 +806,21 @@ int long_only;
       int option_index;
 
       /* This is an option that requires an argument.  */
-      if (*nextchar != '\0') {
-        optarg = nextchar;
+      if (*d->__nextchar != '\0') {
+        d->optarg = d->__nextchar;
         /* If we end this ARGV-element by taking the rest as an arg,
            we must advance to the next element now.  */
-        optind++;
+        d->optind++;
         }
 
-      else if (optind == argc) {
-        if (opterr) {
+      else if (d->optind == argc) {
+        if (d->opterr) {
           /* 1003.2 specifies the format of this message.  */
           fprintf (stderr, _ ("%s: option requires an argument -- %c\n"),
                    argv[0], c);
           }
 
-        optopt = c;
+        d->optopt = c;
 
         if (optstring[0] == ':') {
           c = ':';
@@ -820,20 +837,20 @@ int long_only;
         /* We already incremented `optind' once;
            increment it again when taking next ARGV-elt as argument.  */
         {
-        optarg = argv[optind++];
+        d->optarg = argv[d->optind++];
         }
 
       /* optarg is now the argument, see if it's in the
          table of longopts.  */
 
-      for (nextchar = nameend = optarg; *nameend && *nameend != '='; nameend++)
+      for (d->__nextchar = nameend = d->optarg; *nameend && *nameend != '='; nameend++)
         /* Do nothing.  */ ;
 
       /* Test all long options for either exact match
          or abbreviated matches.  */
       for (p = longopts, option_index = 0; p->name; p++, option_index++)
-        if (!strncmp (p->name, nextchar, nameend - nextchar)) {
-          if ( (unsigned int) (nameend - nextchar) == strlen (p->name)) {
+        if (!strncmp (p->name, d->__nextchar, nameend - d->__nextchar)) {
+          if ( (unsigned int) (nameend - d->__nextchar) == strlen (p->name)) {
             /* Exact match found.  */
             pfound = p;
             indfound = option_index;
@@ -855,12 +872,12 @@ int long_only;
           }
 
       if (ambig && !exact) {
-        if (opterr)
+        if (d->opterr)
           fprintf (stderr, _ ("%s: option `-W %s' is ambiguous\n"),
-                   argv[0], argv[optind]);
+                   argv[0], argv[d->optind]);
 
-        nextchar += strlen (nextchar);
-        optind++;
+        d->__nextchar += strlen (d->__nextchar);
+        d->optind++;
         return '?';
         }
 
@@ -871,37 +888,37 @@ int long_only;
           /* Don't test has_arg with >, because some C compilers don't
              allow it to be used on enums.  */
           if (pfound->has_arg) {
-            optarg = nameend + 1;
+            d->optarg = nameend + 1;
             }
 
           else {
-            if (opterr)
+            if (d->opterr)
               fprintf (stderr, _ ("\
 %s: option `-W %s' doesn't allow an argument\n"),
                        argv[0], pfound->name);
 
-            nextchar += strlen (nextchar);
+            d->__nextchar += strlen (d->__nextchar);
             return '?';
             }
           }
 
         else if (pfound->has_arg == 1) {
-          if (optind < argc) {
-            optarg = argv[optind++];
+          if (d->optind < argc) {
+            d->optarg = argv[d->optind++];
             }
 
           else {
-            if (opterr)
+            if (d->opterr)
               fprintf (stderr,
                        _ ("%s: option `%s' requires an argument\n"),
-                       argv[0], argv[optind - 1]);
+                       argv[0], argv[d->optind - 1]);
 
-            nextchar += strlen (nextchar);
+            d->__nextchar += strlen (d->__nextchar);
             return optstring[0] == ':' ? ':' : '?';
             }
           }
 
-        nextchar += strlen (nextchar);
+        d->__nextchar += strlen (d->__nextchar);
 
         if (longind != NULL) {
           *longind = option_index;
@@ -915,43 +932,43 @@ int long_only;
         return pfound->val;
         }
 
-      nextchar = NULL;
+      d->__nextchar = NULL;
       return 'W'; /* Let the application handle it.   */
       }
 
     if (temp[1] == ':') {
       if (temp[2] == ':') {
         /* This is an option that accepts an argument optionally.  */
-        if (*nextchar != '\0') {
-          optarg = nextchar;
-          optind++;
+        if (*d->__nextchar != '\0') {
+          d->optarg = d->__nextchar;
+          d->optind++;
           }
 
         else {
-          optarg = NULL;
+          d->optarg = NULL;
           }
 
-        nextchar = NULL;
+        d->__nextchar = NULL;
         }
 
       else {
         /* This is an option that requires an argument.  */
-        if (*nextchar != '\0') {
-          optarg = nextchar;
+        if (*d->__nextchar != '\0') {
+          d->optarg = d->__nextchar;
           /* If we end this ARGV-element by taking the rest as an arg,
              we must advance to the next element now.  */
-          optind++;
+          d->optind++;
           }
 
-        else if (optind == argc) {
-          if (opterr) {
+        else if (d->optind == argc) {
+          if (d->opterr) {
             /* 1003.2 specifies the format of this message.  */
             fprintf (stderr,
                      _ ("%s: option requires an argument -- %c\n"),
                      argv[0], c);
             }
 
-          optopt = c;
+          d->optopt = c;
 
           if (optstring[0] == ':') {
             c = ':';
@@ -966,10 +983,10 @@ int long_only;
           /* We already incremented `optind' once;
              increment it again when taking next ARGV-elt as argument.  */
           {
-          optarg = argv[optind++];
+          d->optarg = argv[d->optind++];
           }
 
-        nextchar = NULL;
+        d->__nextchar = NULL;
         }
       }
 
@@ -977,6 +994,32 @@ int long_only;
     }
   }
 
+#ifndef ELIDE_CODE
+
+int
+_getopt_internal (argc, argv, optstring, longopts, longind, long_only)
+int argc;
+char* const* argv;
+const char* optstring;
+const struct option* longopts;
+int* longind;
+int long_only;
+  {
+  int result;
+
+  getopt_data.optind = optind;
+  getopt_data.opterr = opterr;
+
+  result = _getopt_internal_r (argc, argv, optstring, longopts,
+                               longind, long_only, &getopt_data);
+
+  optind = getopt_data.optind;
+  optarg = getopt_data.optarg;
+  optopt = getopt_data.optopt;
+
+  return result;
+  }
+
 int
 getopt (argc, argv, optstring)
 int argc;
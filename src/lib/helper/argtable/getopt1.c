@@ -91,6 +91,23 @@ int* opt_index;
   }
 
 #endif /* Not ELIDE_CODE.  */
+
+/* Like getopt_long, but all of the scanner's state, including the
+   values normally returned in `optarg', `optind' and `optopt', is kept
+   in D rather than in globals.  */
+
+int
+_getopt_long_r (argc, argv, options, long_options, opt_index, d)
+int argc;
+char* const* argv;
+const char* options;
+const struct option* long_options;
+int* opt_index;
+struct _getopt_data* d;
+  {
+  return _getopt_internal_r (argc, argv, options, long_options, opt_index,
+                             0, d);
+  }
 
 #ifdef TEST
 
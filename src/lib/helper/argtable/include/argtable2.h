@@ -45,6 +45,7 @@ extern "C" {
   typedef int (arg_scanfn) (void* parent, const char* argval);
   typedef int (arg_checkfn) (void* parent);
   typedef void (arg_errorfn) (void* parent, FILE* fp, int error, const char* argval, const char* progname);
+  typedef void (arg_freefn) (void* parent);
 
 
   /*
@@ -63,6 +64,10 @@ extern "C" {
    * constructor function. The user could alter them after construction
    * if desired, but the original intention is for them to be set by the
    * constructor and left unaltered.
+   * The freefn pointer is optional: arg_xxx structs which hold resources
+   * beyond their own allocation (such as a compiled regex) set it, and
+   * arg_free() and arg_freetable() call it just before the struct itself
+   * is released. Constructors must set it to NULL otherwise.
    */
   struct arg_hdr {
     char         flag;        /* Modifier flags: ARG_TERMINATOR, ARG_HASVALUE. */
@@ -78,6 +83,7 @@ extern "C" {
     arg_checkfn* checkfn;     /* Pointer to parent arg_xxx check function */
     arg_errorfn* errorfn;     /* Pointer to parent arg_xxx error function */
     void*        priv;        /* Pointer to private header data for use by arg_xxx functions */
+    arg_freefn*  freefn;      /* Pointer to parent arg_xxx release function, or NULL if none */
     };
 
   struct arg_rem {
@@ -131,3 +131,63 @@ extern "C"
 #endif
 
 #endif        /* _GETOPT_H */
+
+/* The reentrant interface is kept outside the _GETOPT_H guard: callers
+   that pick up the C library's <getopt.h> first still need it, since
+   the scanner itself is always compiled from getopt.c.  */
+
+#ifndef _GETOPT_DATA_H
+#define _GETOPT_DATA_H 1
+
+#ifdef  __cplusplus
+extern "C"
+  {
+#endif
+
+  /* State for a reentrant scan.  Everything `getopt' normally keeps in
+     the globals `optarg', `optind', `opterr' and `optopt', and in its
+     own file-scope variables, lives here instead, so that separate
+     threads can each scan their own ARGV.  Zero the structure and set
+     `opterr' before the first call.  */
+
+  struct _getopt_data {
+    /* These have exactly the same meaning as the corresponding global
+       variables, except that they are used for the reentrant
+       versions of getopt.  */
+    int optind;
+    int opterr;
+    int optopt;
+    char* optarg;
+
+    /* Internal members; see getopt.c.  */
+    int __initialized;
+    char* __nextchar;
+    enum {
+      REQUIRE_ORDER, PERMUTE, RETURN_IN_ORDER
+      }
+    __ordering;
+    char* __posixly_correct;
+    int __first_nonopt;
+    int __last_nonopt;
+    };
+
+#if defined (__STDC__) && __STDC__
+  extern int _getopt_internal_r (int argc, char* const* argv,
+                                 const char* shortopts,
+                                 const struct option* longopts,
+                                 int* longind, int long_only,
+                                 struct _getopt_data* d);
+  extern int _getopt_long_r (int argc, char* const* argv,
+                             const char* shortopts,
+                             const struct option* longopts, int* longind,
+                             struct _getopt_data* d);
+#else       /* not __STDC__ */
+  extern int _getopt_internal_r();
+  extern int _getopt_long_r();
+#endif        /* __STDC__ */
+
+#ifdef  __cplusplus
+  }
+#endif
+
+#endif        /* _GETOPT_DATA_H */
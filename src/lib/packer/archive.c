@@ -0,0 +1,797 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file archive.c
+*** \brief Site archives holding every compiled page of a site in one file
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#else
+#error "can't find the C standard I/O library"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#else
+#error "can't find the C99 standard types"
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/archive.h"
+#include "packer/hash.h"
+#include "packer/intern.h"
+#include "packer/io.h"
+#include "packer/latency.h"
+#include "packer/span.h"
+
+/* Identifies an archive */
+#define ARCHIVE_MAGIC "PKARCH01"
+
+/* Size of the header, and of each slot, document and node, in bytes */
+#define ARCHIVE_HEADER_SIZE 48
+#define ARCHIVE_SLOT_SIZE 12
+#define ARCHIVE_DOC_SIZE 12
+#define ARCHIVE_NODE_SIZE 24
+
+/* Read and write little endian integers */
+static uint32_t get16 (const unsigned char* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8;
+  }
+
+static uint32_t get32 (const unsigned char* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+  }
+
+static void put16 (unsigned char* p, uint32_t value) {
+  p[0] = (unsigned char) (value & 0xFF);
+  p[1] = (unsigned char) ( (value >> 8) & 0xFF);
+  }
+
+static void put32 (unsigned char* p, uint32_t value) {
+  p[0] = (unsigned char) (value & 0xFF);
+  p[1] = (unsigned char) ( (value >> 8) & 0xFF);
+  p[2] = (unsigned char) ( (value >> 16) & 0xFF);
+  p[3] = (unsigned char) ( (value >> 24) & 0xFF);
+  }
+
+/* The hash stored in each slot */
+static uint32_t path_hash (const char* path, size_t len) {
+  return (uint32_t) (pk_hash_bytes (path, len) & 0xFFFFFFFFUL);
+  }
+
+/**
+*** Building
+**/
+
+struct archive_page {
+  uint32_t      path;     /*< Path of the page, in the shared table */
+  struct pk_doc doc;      /*< The compiled page */
+  size_t        size;     /*< Bytes of source */
+  uint64_t      read;     /*< Nanoseconds reading the source */
+  uint64_t      compile;  /*< Nanoseconds compiling the page */
+  uint64_t      emit;     /*< Nanoseconds laying the page out in the archive */
+  };
+
+struct pk_archive_builder {
+  struct pk_intern        strings;    /*< Strings of every page */
+  struct archive_page*    pages;      /*< Pages added, in order */
+  size_t                  count;      /*< Number of pages */
+  size_t                  capacity;   /*< Number of pages allocated */
+  unsigned char*          used;       /*< For each string of the table, whether a page is at it */
+  size_t                  nused;      /*< Number of strings used has room for */
+  const struct pk_limits* limits;     /*< Limits on compiling each page (NULL for the defaults) */
+  struct pk_tag_costs*    costs;      /*< Where the cost of compiling each tag is counted (may be NULL) */
+  };
+
+struct pk_archive_builder* pk_archive_builder_new (void) {
+  struct pk_archive_builder* builder = (struct pk_archive_builder*) calloc (1, sizeof (*builder));
+
+  if (builder != NULL && pk_intern_init (&builder->strings) != PK_OK) {
+    free (builder);
+    return NULL;
+    }
+
+  return builder;
+  }
+
+void pk_archive_builder_free (struct pk_archive_builder* builder) {
+  size_t i;
+
+  if (builder != NULL) {
+    for (i = 0; i < builder->count; i++) {
+      pk_doc_clear (&builder->pages[i].doc);
+      }
+
+    pk_intern_clear (&builder->strings);
+    free (builder->pages);
+    free (builder->used);
+    free (builder);
+    }
+  }
+
+size_t pk_archive_builder_count (const struct pk_archive_builder* builder) {
+  return builder->count;
+  }
+
+int pk_archive_builder_stats (const struct pk_archive_builder* builder, size_t page,
+                              struct pk_archive_page_stats* stats) {
+  const struct archive_page* added;
+
+  if (page >= builder->count) {
+    return PK_ERR;
+    }
+
+  added = &builder->pages[page];
+  stats->path = pk_intern_str (&builder->strings, added->path);
+  stats->size = added->size;
+  stats->nodes = added->doc.count;
+  stats->read = added->read;
+  stats->compile = added->compile;
+  stats->emit = added->emit;
+  return PK_OK;
+  }
+
+const struct pk_intern* pk_archive_builder_strings (const struct pk_archive_builder* builder) {
+  return &builder->strings;
+  }
+
+void pk_archive_builder_limit (struct pk_archive_builder* builder, const struct pk_limits* limits) {
+  builder->limits = limits;
+  }
+
+void pk_archive_builder_count_tags (struct pk_archive_builder* builder, struct pk_tag_costs* costs) {
+  builder->costs = costs;
+  }
+
+int pk_archive_builder_add (struct pk_archive_builder* builder, const char* path, const char* buf, size_t len) {
+  uint64_t start = pk_clock_ns ();
+  struct archive_page* page;
+
+  if (builder->count == builder->capacity) {
+    size_t capacity = builder->capacity ? builder->capacity * 2 : 64;
+    struct archive_page* pages = (struct archive_page*) realloc (builder->pages, capacity * sizeof (*pages));
+
+    if (pages == NULL) {
+      return PK_ERR;
+      }
+
+    builder->pages = pages;
+    builder->capacity = capacity;
+    }
+
+  page = &builder->pages[builder->count];
+  page->path = pk_intern_cstr (&builder->strings, path);
+
+  if (page->path == PK_INTERN_NONE) {
+    return PK_ERR;
+    }
+
+  /* Paths are interned, so a page already at the path has the same string */
+  if (page->path >= builder->nused) {
+    size_t nused = builder->strings.count > 64 ? builder->strings.count * 2 : 128;
+    unsigned char* used = (unsigned char*) realloc (builder->used, nused);
+
+    if (used == NULL) {
+      return PK_ERR;
+      }
+
+    memset (used + builder->nused, 0, nused - builder->nused);
+    builder->used = used;
+    builder->nused = nused;
+    }
+
+  if (builder->used[page->path]) {
+    return PK_ARCHIVE_DUPLICATE;
+    }
+
+  if (pk_doc_init (&page->doc, &builder->strings) != PK_OK) {
+    return PK_ERR;
+    }
+
+  page->doc.limits = builder->limits;
+  page->doc.costs = builder->costs;
+
+  if (pk_doc_compile (&page->doc, buf, len) != PK_OK) {
+    pk_doc_clear (&page->doc);
+    return PK_ERR;
+    }
+
+  page->size = len;
+  page->read = 0;
+  page->compile = pk_clock_ns () - start;
+  page->emit = 0;
+  builder->used[page->path] = 1;
+  builder->count++;
+  return PK_OK;
+  }
+
+int pk_archive_builder_add_file (struct pk_archive_builder* builder, const char* path, const char* file) {
+  uint64_t start = pk_clock_ns ();
+  size_t len;
+  char* source = pk_read_file (file, &len);
+  uint64_t read = pk_clock_ns () - start;
+  int status;
+
+  if (source == NULL) {
+    return PK_ERR;
+    }
+
+  status = pk_archive_builder_add (builder, path, source, len);
+
+  if (status == PK_OK) {
+    builder->pages[builder->count - 1].read = read;
+    }
+
+  free (source);
+  return status;
+  }
+
+#ifdef HAVE_DIRENT_H
+
+/* Add the Bayeux files below dir, whose path in the site is prefix */
+static int scan_dir (struct pk_archive_builder* builder, const_bstring dir, const_bstring prefix) {
+  DIR* entries = opendir ( (const char*) dir->data);
+  struct dirent* entry;
+  int status = entries ? PK_OK : PK_ERR;
+
+  while (status == PK_OK && (entry = readdir (entries)) != NULL) {
+    size_t len = strlen (entry->d_name);
+    bstring file;
+    bstring path;
+    DIR* sub;
+
+    /* Hidden files, and the directory links, are skipped */
+    if (entry->d_name[0] == '.') {
+      continue;
+      }
+
+    file = bformat ("%s/%s", (const char*) dir->data, entry->d_name);
+    path = blength (prefix) ? bformat ("%s/%s", (const char*) prefix->data, entry->d_name) : bfromcstr (entry->d_name);
+    sub = file ? opendir ( (const char*) file->data) : NULL;
+
+    if (file == NULL || path == NULL) {
+      status = PK_ERR;
+      }
+
+    else if (sub != NULL) {
+      closedir (sub);
+      status = scan_dir (builder, file, path);
+      }
+
+    else if (len > 4 && strcmp (entry->d_name + len - 4, ".byx") == 0) {
+      status = pk_archive_builder_add_file (builder, (const char*) path->data, (const char*) file->data);
+      }
+
+    bdestroy (path);
+    bdestroy (file);
+    }
+
+  if (entries != NULL) {
+    closedir (entries);
+    }
+
+  return status;
+  }
+
+#endif
+
+int pk_archive_builder_scan (struct pk_archive_builder* builder, const char* file, const char* path) {
+#ifdef HAVE_DIRENT_H
+  DIR* sub = opendir (file);
+  bstring dir;
+  bstring prefix;
+  int status;
+
+  if (sub == NULL) {
+    return pk_archive_builder_add_file (builder, path ? path : file, file);
+    }
+
+  closedir (sub);
+  dir = bfromcstr (file);
+  prefix = bfromcstr (path ? path : "");
+  status = dir && prefix ? PK_OK : PK_ERR;
+
+  /* Paths in the site never start or end with a separator */
+  while (status == PK_OK && blength (dir) > 1 && bchar (dir, blength (dir) - 1) == '/') {
+    btrunc (dir, blength (dir) - 1);
+    }
+
+  while (status == PK_OK && blength (prefix) > 0 && bchar (prefix, blength (prefix) - 1) == '/') {
+    btrunc (prefix, blength (prefix) - 1);
+    }
+
+  if (status == PK_OK) {
+    status = scan_dir (builder, dir, prefix);
+    }
+
+  bdestroy (prefix);
+  bdestroy (dir);
+  return status;
+#else
+  return pk_archive_builder_add_file (builder, path ? path : file, file);
+#endif
+  }
+
+/* A page, with the path it is sorted by */
+struct archive_order {
+  const char* path;
+  size_t      page;
+  };
+
+static int compare_paths (const void* a, const void* b) {
+  return strcmp ( ( (const struct archive_order*) a)->path, ( (const struct archive_order*) b)->path);
+  }
+
+/* Give a string an identifier in the file, in order of first use */
+static uint32_t local_id (uint32_t* local, uint32_t* order, uint32_t* count, uint32_t id) {
+  if (local[id] == PK_INTERN_NONE) {
+    local[id] = *count;
+    order[ (*count)++] = id;
+    }
+
+  return local[id];
+  }
+
+/* Place one document in the slot table, unless its path is already present */
+static void place (const struct pk_intern* strings, const uint32_t* order, unsigned char* slots, uint32_t nslots,
+                   uint32_t path, uint32_t document) {
+  struct pk_span key = pk_intern_get (strings, order[path]);
+  uint32_t hash = path_hash (key.data, key.len);
+  uint32_t i = hash & (nslots - 1);
+
+  for (;;) {
+    unsigned char* slot = slots + (size_t) i * ARCHIVE_SLOT_SIZE;
+
+    if (get32 (slot + 8) == 0) {
+      put32 (slot, hash);
+      put32 (slot + 4, path);
+      put32 (slot + 8, document + 1);
+      return;
+      }
+
+    if (get32 (slot + 4) == path) {
+      return;
+      }
+
+    i = (i + 1) & (nslots - 1);
+    }
+  }
+
+/* Lay out the slots, documents and nodes of the archive, numbering the
+ * strings in the order the sorted pages use them. The time each page
+ * takes is kept with it
+ */
+static int lay_out (struct pk_archive_builder* builder, const struct archive_order* sorted, uint32_t* local,
+                    uint32_t* order, uint32_t* count, unsigned char* slots, uint32_t nslots, unsigned char* documents,
+                    unsigned char* nodes) {
+  size_t first = 0;
+  size_t i;
+  size_t j;
+
+  for (i = 0; i < builder->count; i++) {
+    struct archive_page* page = &builder->pages[sorted[i].page];
+    uint64_t start = pk_clock_ns ();
+    uint32_t path = local_id (local, order, count, page->path);
+
+    put32 (documents + i * ARCHIVE_DOC_SIZE, path);
+    put32 (documents + i * ARCHIVE_DOC_SIZE + 4, (uint32_t) first);
+    put32 (documents + i * ARCHIVE_DOC_SIZE + 8, (uint32_t) page->doc.count);
+    place (&builder->strings, order, slots, nslots, path, (uint32_t) i);
+
+    for (j = 0; j < page->doc.count; j++) {
+      const struct pk_doc_node* node = &page->doc.nodes[j];
+      unsigned char* p = nodes + (first + j) * ARCHIVE_NODE_SIZE;
+
+      p[0] = node->type;
+      p[1] = node->tag;
+      put16 (p + 2, node->flags);
+      put32 (p + 4, node->line);
+      put32 (p + 8, local_id (local, order, count, node->text));
+      put32 (p + 12, local_id (local, order, count, node->label));
+      put32 (p + 16, local_id (local, order, count, node->args));
+      put32 (p + 20, node->close);
+      }
+
+    first += page->doc.count;
+    page->emit = pk_clock_ns () - start;
+    }
+
+  return first <= 0xFFFFFFFFUL ? PK_OK : PK_ERR;
+  }
+
+/* Write the parts of an archive to a temporary name, then move it into
+ * place, so readers never map a partial archive
+ */
+static int write_file (const char* path, const unsigned char* header, const unsigned char* slots, size_t slots_size,
+                       const unsigned char* documents, size_t documents_size, const unsigned char* nodes,
+                       size_t nodes_size, const unsigned char* offsets, size_t offsets_size, const_bstring pool) {
+  bstring temp = bformat ("%s.tmp", path);
+  FILE* file = temp ? fopen ( (const char*) temp->data, "wb") : NULL;
+  int status = PK_OK;
+
+  if (file == NULL || fwrite (header, 1, ARCHIVE_HEADER_SIZE, file) != ARCHIVE_HEADER_SIZE ||
+      fwrite (slots, 1, slots_size, file) != slots_size || fwrite (documents, 1, documents_size, file) != documents_size ||
+      fwrite (nodes, 1, nodes_size, file) != nodes_size || fwrite (offsets, 1, offsets_size, file) != offsets_size ||
+      fwrite (pool->data, 1, (size_t) blength (pool), file) != (size_t) blength (pool)) {
+    status = PK_ERR;
+    }
+
+  if (file != NULL && fclose (file) != 0) {
+    status = PK_ERR;
+    }
+
+  if (status == PK_OK && rename ( (const char*) temp->data, path) != 0) {
+    status = PK_ERR;
+    }
+
+  if (status != PK_OK && file != NULL) {
+    remove ( (const char*) temp->data);
+    }
+
+  bdestroy (temp);
+  return status;
+  }
+
+int pk_archive_builder_write (struct pk_archive_builder* builder, const char* path) {
+  unsigned char header[ARCHIVE_HEADER_SIZE];
+  size_t strings = builder->strings.count;
+  size_t total = 0;
+  uint32_t nslots = 16;
+  uint32_t count = 0;
+  size_t slots_size;
+  size_t documents_size = builder->count * ARCHIVE_DOC_SIZE;
+  size_t nodes_size;
+  size_t offset;
+  struct archive_order* sorted = (struct archive_order*) malloc (builder->count * sizeof (*sorted) + 1);
+  uint32_t* local = (uint32_t*) malloc (strings * sizeof (*local));
+  uint32_t* order = (uint32_t*) malloc (strings * sizeof (*order));
+  unsigned char* slots;
+  unsigned char* documents = (unsigned char*) malloc (documents_size + 1);
+  unsigned char* nodes = NULL;
+  unsigned char* offsets = NULL;
+  bstring pool = bfromcstr ("");
+  size_t i;
+  int status;
+
+  /* Keep the table at most half full, so probes stay short */
+  while (nslots < builder->count * 2) {
+    nslots *= 2;
+    }
+
+  slots_size = (size_t) nslots * ARCHIVE_SLOT_SIZE;
+  slots = (unsigned char*) calloc (1, slots_size);
+
+  for (i = 0; i < builder->count; i++) {
+    total += builder->pages[i].doc.count;
+    }
+
+  nodes_size = total * ARCHIVE_NODE_SIZE;
+  nodes = (unsigned char*) malloc (nodes_size + 1);
+  status = sorted && local && order && slots && documents && nodes && pool ? PK_OK : PK_ERR;
+
+  if (status == PK_OK) {
+    for (i = 0; i < builder->count; i++) {
+      sorted[i].path = pk_intern_str (&builder->strings, builder->pages[i].path);
+      sorted[i].page = i;
+      }
+
+    qsort (sorted, builder->count, sizeof (*sorted), compare_paths);
+    memset (local, 0xFF, strings * sizeof (*local));
+    status = lay_out (builder, sorted, local, order, &count, slots, nslots, documents, nodes);
+    }
+
+  if (status == PK_OK) {
+    offsets = (unsigned char*) malloc ( (size_t) count * 4 + 1);
+    status = offsets ? PK_OK : PK_ERR;
+    }
+
+  for (i = 0; status == PK_OK && i < count; i++) {
+    struct pk_span span = pk_intern_get (&builder->strings, order[i]);
+
+    put32 (offsets + i * 4, (uint32_t) blength (pool));
+
+    if (bcatblk (pool, span.data, (int) span.len) != BSTR_OK || bconchar (pool, '\0') != BSTR_OK) {
+      status = PK_ERR;
+      }
+    }
+
+  /* Every offset in the file must fit in 32 bits */
+  offset = ARCHIVE_HEADER_SIZE + slots_size + documents_size + nodes_size + (size_t) count * 4;
+
+  if (status == PK_OK && (offset < nodes_size || offset + (size_t) blength (pool) > 0xFFFFFFFFUL)) {
+    status = PK_ERR;
+    }
+
+  if (status == PK_OK) {
+    memset (header, 0, sizeof (header));
+    memcpy (header, ARCHIVE_MAGIC, 8);
+    put32 (header + 8, (uint32_t) builder->count);
+    put32 (header + 12, nslots);
+    put32 (header + 16, count);
+    put32 (header + 20, (uint32_t) total);
+    put32 (header + 24, ARCHIVE_HEADER_SIZE);
+    put32 (header + 28, (uint32_t) (ARCHIVE_HEADER_SIZE + slots_size));
+    put32 (header + 32, (uint32_t) (ARCHIVE_HEADER_SIZE + slots_size + documents_size));
+    put32 (header + 36, (uint32_t) (offset - (size_t) count * 4));
+    put32 (header + 40, (uint32_t) offset);
+    put32 (header + 44, (uint32_t) blength (pool));
+    status = write_file (path, header, slots, slots_size, documents, documents_size, nodes, nodes_size, offsets,
+                         (size_t) count * 4, pool);
+    }
+
+  bdestroy (pool);
+  free (offsets);
+  free (nodes);
+  free (documents);
+  free (slots);
+  free (order);
+  free (local);
+  free (sorted);
+  return status;
+  }
+
+/**
+*** Reading
+**/
+
+struct pk_archive {
+  struct pk_mapping    map;        /*< The archive file */
+  const unsigned char* slots;      /*< The slot table */
+  uint32_t             nslots;     /*< Number of slots (a power of two) */
+  const unsigned char* documents;  /*< The document table */
+  uint32_t             count;      /*< Number of documents */
+  const unsigned char* nodes;      /*< The nodes of every document */
+  uint32_t             nnodes;     /*< Number of nodes */
+  const unsigned char* offsets;    /*< Start of each string in the pool */
+  uint32_t             strings;    /*< Number of strings */
+  const char*          pool;       /*< The string pool */
+  uint32_t             pool_size;  /*< Size of the pool */
+  };
+
+/* Check a table of count entries of size bytes at offset lies within the file */
+static int within (const struct pk_archive* archive, uint32_t offset, uint32_t count, size_t size) {
+  return offset <= archive->map.len && (archive->map.len - offset) / size >= count;
+  }
+
+struct pk_archive* pk_archive_open (const char* path) {
+  struct pk_archive* archive = (struct pk_archive*) calloc (1, sizeof (*archive));
+  const unsigned char* data;
+  uint32_t slot_offset;
+  uint32_t document_offset;
+  uint32_t node_offset;
+  uint32_t string_offset;
+  uint32_t pool_offset;
+
+  if (archive == NULL) {
+    return NULL;
+    }
+
+  if (pk_map_file (path, &archive->map) != PK_OK || archive->map.len < ARCHIVE_HEADER_SIZE ||
+      memcmp (archive->map.data, ARCHIVE_MAGIC, 8) != 0) {
+    pk_archive_close (archive);
+    return NULL;
+    }
+
+  data = (const unsigned char*) archive->map.data;
+  archive->count = get32 (data + 8);
+  archive->nslots = get32 (data + 12);
+  archive->strings = get32 (data + 16);
+  archive->nnodes = get32 (data + 20);
+  slot_offset = get32 (data + 24);
+  document_offset = get32 (data + 28);
+  node_offset = get32 (data + 32);
+  string_offset = get32 (data + 36);
+  pool_offset = get32 (data + 40);
+  archive->pool_size = get32 (data + 44);
+
+  /* Check the tables lie within the file, one after another as they were
+   * written, before trusting them. Entries are checked as they are used,
+   * so opening costs the same for any size of site
+   */
+  if (archive->nslots == 0 || (archive->nslots & (archive->nslots - 1)) != 0 ||
+      !within (archive, slot_offset, archive->nslots, ARCHIVE_SLOT_SIZE) ||
+      !within (archive, document_offset, archive->count, ARCHIVE_DOC_SIZE) ||
+      !within (archive, node_offset, archive->nnodes, ARCHIVE_NODE_SIZE) ||
+      !within (archive, string_offset, archive->strings, 4) || !within (archive, pool_offset, archive->pool_size, 1) ||
+      slot_offset != ARCHIVE_HEADER_SIZE ||
+      document_offset - slot_offset != (size_t) archive->nslots * ARCHIVE_SLOT_SIZE ||
+      node_offset - document_offset != (size_t) archive->count * ARCHIVE_DOC_SIZE ||
+      string_offset - node_offset != (size_t) archive->nnodes * ARCHIVE_NODE_SIZE ||
+      pool_offset - string_offset != (size_t) archive->strings * 4 ||
+      archive->map.len - pool_offset != archive->pool_size) {
+    pk_archive_close (archive);
+    return NULL;
+    }
+
+  archive->slots = data + slot_offset;
+  archive->documents = data + document_offset;
+  archive->nodes = data + node_offset;
+  archive->offsets = data + string_offset;
+  archive->pool = archive->map.data + pool_offset;
+  return archive;
+  }
+
+void pk_archive_close (struct pk_archive* archive) {
+  if (archive != NULL) {
+    pk_unmap_file (&archive->map);
+    free (archive);
+    }
+  }
+
+size_t pk_archive_count (const struct pk_archive* archive) {
+  return archive->count;
+  }
+
+/* Fetch a string of the pool, checking it lies within the pool */
+static int get_string (const struct pk_archive* archive, uint32_t id, struct pk_span* span) {
+  size_t start;
+  size_t end;
+
+  if (id >= archive->strings) {
+    return PK_ERR;
+    }
+
+  start = get32 (archive->offsets + (size_t) id * 4);
+  end = id + 1 < archive->strings ? get32 (archive->offsets + (size_t) (id + 1) * 4) : archive->pool_size;
+
+  if (start >= end || end > archive->pool_size || archive->pool[end - 1] != '\0') {
+    return PK_ERR;
+    }
+
+  *span = pk_span_make (archive->pool + start, end - start - 1);
+  return PK_OK;
+  }
+
+/* Find the nodes of a document, checking they lie within the node table */
+static const unsigned char* get_document (const struct pk_archive* archive, size_t document, uint32_t* count) {
+  const unsigned char* entry = archive->documents + document * ARCHIVE_DOC_SIZE;
+  uint32_t first;
+
+  if (document >= archive->count) {
+    return NULL;
+    }
+
+  first = get32 (entry + 4);
+  *count = get32 (entry + 8);
+
+  if (first > archive->nnodes || archive->nnodes - first < *count) {
+    return NULL;
+    }
+
+  return archive->nodes + (size_t) first * ARCHIVE_NODE_SIZE;
+  }
+
+int pk_archive_find (const struct pk_archive* archive, struct pk_span path, size_t* document) {
+  uint32_t hash = path_hash (path.data, path.len);
+  uint32_t i;
+  uint32_t probes;
+
+  for (i = hash & (archive->nslots - 1), probes = 0; probes < archive->nslots;
+       i = (i + 1) & (archive->nslots - 1), probes++) {
+    const unsigned char* slot = archive->slots + (size_t) i * ARCHIVE_SLOT_SIZE;
+    uint32_t entry = get32 (slot + 8);
+    struct pk_span key;
+
+    if (entry == 0) {
+      break;
+      }
+
+    if (get32 (slot) == hash && entry <= archive->count && get_string (archive, get32 (slot + 4), &key) == PK_OK &&
+        pk_span_eq (key, path)) {
+      *document = entry - 1;
+      return PK_OK;
+      }
+    }
+
+  return PK_ERR;
+  }
+
+const char* pk_archive_path (const struct pk_archive* archive, size_t document) {
+  struct pk_span path;
+
+  if (document >= archive->count ||
+      get_string (archive, get32 (archive->documents + document * ARCHIVE_DOC_SIZE), &path) != PK_OK) {
+    return NULL;
+    }
+
+  return path.data;
+  }
+
+size_t pk_archive_nodes (const struct pk_archive* archive, size_t document) {
+  uint32_t count = 0;
+
+  return get_document (archive, document, &count) ? count : 0;
+  }
+
+int pk_archive_token (const struct pk_archive* archive, size_t document, size_t node, struct pk_token* token) {
+  uint32_t count;
+  const unsigned char* p = get_document (archive, document, &count);
+
+  if (p == NULL || node >= count) {
+    return PK_ERR;
+    }
+
+  p += node * ARCHIVE_NODE_SIZE;
+
+  if (p[0] < PK_TOKEN_TEXT || p[0] > PK_TOKEN_END || p[1] >= PK_TAG_COUNT) {
+    return PK_ERR;
+    }
+
+  memset (token, 0, sizeof (*token));
+  token->type = (enum pk_token_type) p[0];
+  token->tag = p[1];
+  token->flags = get16 (p + 2);
+  token->line = (int) get32 (p + 4);
+
+  if (get_string (archive, get32 (p + 8), &token->text) != PK_OK) {
+    return PK_ERR;
+    }
+
+  /* As in a compiled document, the name of a tag stands in for its source */
+  if (p[0] == PK_TOKEN_OPEN) {
+    token->name = token->text;
+
+    if (get_string (archive, get32 (p + 12), &token->label) != PK_OK ||
+        get_string (archive, get32 (p + 16), &token->args) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+int pk_archive_load (const struct pk_archive* archive, size_t document, struct pk_doc* doc) {
+  size_t count = pk_archive_nodes (archive, document);
+  struct pk_token token;
+  size_t i;
+  int status = document < archive->count ? PK_OK : PK_ERR;
+
+  /* The closing nodes are matched again as the tokens are added */
+  for (i = 0; status == PK_OK && i < count; i++) {
+    status = pk_archive_token (archive, document, i, &token);
+
+    if (status == PK_OK) {
+      status = pk_doc_add (doc, &token);
+      }
+    }
+
+  return status;
+  }
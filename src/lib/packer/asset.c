@@ -0,0 +1,1099 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file asset.c
+*** \brief Resolution, de-duplication and copying of image assets
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* copy_file_range is a GNU extension */
+#define _GNU_SOURCE
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_CTYPE_H
+#include <ctype.h>
+#else
+#error "can't find the C character class library"
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LINUX_FS_H
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
+
+#include "packer/asset.h"
+#include "packer/hash.h"
+#include "packer/lexer.h"
+#include "packer/pool.h"
+
+/* Size of the buffer used to hash and copy files */
+#define ASSET_CHUNK (64 * 1024)
+
+/* Initial number of buckets in each of the lookup maps */
+#define ASSET_BUCKETS 64
+
+/* First line of a saved dimension cache */
+#define ASSET_CACHE_MAGIC "PACKER-ASSETS 1"
+
+/* Directories searched, relative to the page and each of its parents */
+static const char* const asset_subdirs[] = { "", "images", "figures", NULL };
+
+/* Extensions tried when a reference has none */
+static const char* const asset_extensions[] = { "", ".png", ".jpg", ".jpeg", ".gif", ".svg", ".pdf", NULL };
+
+/**
+*** String Maps. The table needs three lookups (reference to asset, file
+*** to asset, and file to cached dimensions), all keyed by strings.
+**/
+
+struct map_entry {
+  uint64_t          hash;   /*< Hash of the key */
+  bstring           key;    /*< The key */
+  void*             value;  /*< The value */
+  struct map_entry* next;   /*< Next entry in the same bucket */
+  };
+
+struct map {
+  struct map_entry** buckets;   /*< Hash buckets */
+  size_t             nbuckets;  /*< Number of buckets */
+  size_t             count;     /*< Number of entries */
+  };
+
+static int map_init (struct map* map) {
+  map->nbuckets = ASSET_BUCKETS;
+  map->count = 0;
+  map->buckets = (struct map_entry**) calloc (map->nbuckets, sizeof (*map->buckets));
+  return map->buckets ? PK_OK : PK_ERR;
+  }
+
+/* Release the map, and each value if free_value is given */
+static void map_clear (struct map* map, void (*free_value) (void*)) {
+  size_t i;
+
+  for (i = 0; map->buckets != NULL && i < map->nbuckets; i++) {
+    struct map_entry* entry = map->buckets[i];
+
+    while (entry != NULL) {
+      struct map_entry* next = entry->next;
+
+      if (free_value != NULL) {
+        free_value (entry->value);
+        }
+
+      bdestroy (entry->key);
+      free (entry);
+      entry = next;
+      }
+    }
+
+  free (map->buckets);
+  map->buckets = NULL;
+  }
+
+static struct map_entry* map_find (const struct map* map, const_bstring key) {
+  uint64_t hash = pk_hash_bytes (key->data, (size_t) key->slen);
+  struct map_entry* entry;
+
+  for (entry = map->buckets[hash & (map->nbuckets - 1)]; entry != NULL; entry = entry->next) {
+    if (entry->hash == hash && biseq (entry->key, key)) {
+      return entry;
+      }
+    }
+
+  return NULL;
+  }
+
+/* Add a new entry (the key must not be present) */
+static struct map_entry* map_insert (struct map* map, const_bstring key, void* value) {
+  struct map_entry* entry = (struct map_entry*) malloc (sizeof (*entry));
+  size_t slot;
+
+  if (entry == NULL || (entry->key = bstrcpy (key)) == NULL) {
+    free (entry);
+    return NULL;
+    }
+
+  if (map->count >= map->nbuckets) {
+    size_t nbuckets = map->nbuckets * 2;
+    struct map_entry** buckets = (struct map_entry**) calloc (nbuckets, sizeof (*buckets));
+
+    if (buckets != NULL) {
+      size_t i;
+
+      for (i = 0; i < map->nbuckets; i++) {
+        while (map->buckets[i] != NULL) {
+          struct map_entry* moved = map->buckets[i];
+          map->buckets[i] = moved->next;
+          moved->next = buckets[moved->hash & (nbuckets - 1)];
+          buckets[moved->hash & (nbuckets - 1)] = moved;
+          }
+        }
+
+      free (map->buckets);
+      map->buckets = buckets;
+      map->nbuckets = nbuckets;
+      }
+    }
+
+  entry->hash = pk_hash_bytes (key->data, (size_t) key->slen);
+  entry->value = value;
+  slot = (size_t) (entry->hash & (map->nbuckets - 1));
+  entry->next = map->buckets[slot];
+  map->buckets[slot] = entry;
+  map->count++;
+  return entry;
+  }
+
+/**
+*** Asset Table
+**/
+
+/* The dimensions remembered for a file */
+struct cache_entry {
+  long     size;    /*< Size of the file when measured */
+  long     mtime;   /*< Modification time of the file when measured */
+  uint64_t hash;    /*< Hash of the content */
+  int      width;   /*< Width in pixels */
+  int      height;  /*< Height in pixels */
+  };
+
+struct pk_assets {
+  bstring           output;     /*< Output directory */
+  bstring           root;       /*< Highest directory searched (may be NULL) */
+  bstring*          search;     /*< Extra search directories */
+  size_t            nsearch;    /*< Number of extra search directories */
+  struct pk_asset** items;      /*< Assets, in the order they were added */
+  size_t            count;      /*< Number of assets */
+  size_t            capacity;   /*< Number of assets allocated */
+  struct map        refs;       /*< "page dir" NUL "name" to asset */
+  struct map        files;      /*< Source path to asset */
+  struct map        cache;      /*< Source path to cached dimensions */
+  int               workers;    /*< Number of worker threads */
+  };
+
+static void free_asset (void* value) {
+  struct pk_asset* asset = (struct pk_asset*) value;
+
+  if (asset != NULL) {
+    bdestroy (asset->name);
+    bdestroy (asset->source);
+    bdestroy (asset->target);
+    free (asset);
+    }
+  }
+
+struct pk_assets* pk_assets_new (const char* output_dir, const char* root, int workers) {
+  struct pk_assets* assets = (struct pk_assets*) calloc (1, sizeof (*assets));
+
+  if (assets == NULL) {
+    return NULL;
+    }
+
+  assets->workers = workers;
+  assets->output = bfromcstr (output_dir);
+
+  if (root != NULL) {
+    assets->root = bfromcstr (root);
+    }
+
+  if (assets->output == NULL || (root != NULL && assets->root == NULL) || map_init (&assets->refs) != PK_OK ||
+      map_init (&assets->files) != PK_OK || map_init (&assets->cache) != PK_OK) {
+    pk_assets_free (assets);
+    return NULL;
+    }
+
+  return assets;
+  }
+
+void pk_assets_free (struct pk_assets* assets) {
+  size_t i;
+
+  if (assets == NULL) {
+    return;
+    }
+
+  for (i = 0; i < assets->count; i++) {
+    free_asset (assets->items[i]);
+    }
+
+  for (i = 0; i < assets->nsearch; i++) {
+    bdestroy (assets->search[i]);
+    }
+
+  map_clear (&assets->refs, NULL);
+  map_clear (&assets->files, NULL);
+  map_clear (&assets->cache, free);
+  free (assets->items);
+  free (assets->search);
+  bdestroy (assets->output);
+  bdestroy (assets->root);
+  free (assets);
+  }
+
+int pk_assets_add_search_dir (struct pk_assets* assets, const char* dir) {
+  bstring* search = (bstring*) realloc (assets->search, (assets->nsearch + 1) * sizeof (*search));
+
+  if (search == NULL) {
+    return PK_ERR;
+    }
+
+  assets->search = search;
+  search[assets->nsearch] = bfromcstr (dir);
+  return search[assets->nsearch] ? (assets->nsearch++, PK_OK) : PK_ERR;
+  }
+
+size_t pk_assets_count (const struct pk_assets* assets) {
+  return assets->count;
+  }
+
+struct pk_asset* pk_assets_get (struct pk_assets* assets, size_t index) {
+  return index < assets->count ? assets->items[index] : NULL;
+  }
+
+/* Add a new asset to the table */
+static struct pk_asset* new_asset (struct pk_assets* assets, const char* name, const_bstring source) {
+  struct pk_asset* asset;
+
+  if (assets->count == assets->capacity) {
+    size_t capacity = assets->capacity ? assets->capacity * 2 : 32;
+    struct pk_asset** items = (struct pk_asset**) realloc (assets->items, capacity * sizeof (*items));
+
+    if (items == NULL) {
+      return NULL;
+      }
+
+    assets->items = items;
+    assets->capacity = capacity;
+    }
+
+  asset = (struct pk_asset*) calloc (1, sizeof (*asset));
+
+  if (asset == NULL || (asset->name = bfromcstr (name)) == NULL ||
+      (source != NULL && (asset->source = bstrcpy (source)) == NULL)) {
+    free_asset (asset);
+    return NULL;
+    }
+
+  asset->state = source ? PK_ASSET_RESOLVED : PK_ASSET_MISSING;
+  asset->canonical = asset;
+  assets->items[assets->count++] = asset;
+  return asset;
+  }
+
+/* Look for name in dir, trying each of the image extensions. On success
+ * the path is left in path
+ */
+static int find_in_dir (bstring path, const char* dir, size_t dlen, const char* sub, const char* name) {
+  struct stat info;
+  int i;
+
+  for (i = 0; asset_extensions[i] != NULL; i++) {
+    bassignblk (path, dir, (int) dlen);
+
+    if (dlen > 0) {
+      bconchar (path, '/');
+      }
+
+    if (*sub != '\0') {
+      bcatcstr (path, sub);
+      bconchar (path, '/');
+      }
+
+    bcatcstr (path, name);
+
+    if (bcatcstr (path, asset_extensions[i]) == BSTR_OK && stat ((char*) path->data, &info) == 0 &&
+        S_ISREG (info.st_mode)) {
+      return 1;
+      }
+    }
+
+  return 0;
+  }
+
+/* Find the file for name, starting in dir and working up to the root,
+ * then along the search path
+ */
+static int resolve (struct pk_assets* assets, bstring path, const char* dir, size_t dlen, const char* name) {
+  size_t i;
+  int s;
+
+  for (;;) {
+    for (s = 0; asset_subdirs[s] != NULL; s++) {
+      if (find_in_dir (path, dir, dlen, asset_subdirs[s], name)) {
+        return 1;
+        }
+      }
+
+    /* Stop at the root, or at the page directory if there is no root */
+    if (assets->root == NULL || dlen <= (size_t) blength (assets->root) || dlen == 0) {
+      break;
+      }
+
+    while (dlen > 0 && dir[dlen - 1] != '/') {
+      dlen--;
+      }
+
+    if (dlen > 0) {
+      dlen--;
+      }
+    }
+
+  for (i = 0; i < assets->nsearch; i++) {
+    if (find_in_dir (path, bdata (assets->search[i]), (size_t) blength (assets->search[i]), "", name)) {
+      return 1;
+      }
+    }
+
+  return 0;
+  }
+
+struct pk_asset* pk_assets_add (struct pk_assets* assets, const char* page_path, const char* name) {
+  const char* slash = strrchr (page_path, '/');
+  size_t dlen = slash ? (size_t) (slash - page_path) : 0;
+  struct map_entry* entry;
+  struct pk_asset* asset = NULL;
+  bstring key;
+  bstring path;
+
+  /* References are resolved relative to the page directory */
+  key = blk2bstr (page_path, (int) dlen);
+
+  if (key == NULL || bconchar (key, '\0') != BSTR_OK || bcatcstr (key, name) != BSTR_OK) {
+    bdestroy (key);
+    return NULL;
+    }
+
+  if ( (entry = map_find (&assets->refs, key)) != NULL) {
+    bdestroy (key);
+    return (struct pk_asset*) entry->value;
+    }
+
+  path = bfromcstr ("");
+
+  if (path != NULL) {
+    if (resolve (assets, path, page_path, dlen, name)) {
+      /* Several references may name the same file */
+      entry = map_find (&assets->files, path);
+      asset = entry ? (struct pk_asset*) entry->value : new_asset (assets, name, path);
+
+      if (entry == NULL && asset != NULL && map_insert (&assets->files, path, asset) == NULL) {
+        asset = NULL;
+        }
+      }
+
+    else {
+      asset = new_asset (assets, name, NULL);
+      }
+    }
+
+  if (asset != NULL && map_insert (&assets->refs, key, asset) == NULL) {
+    asset = NULL;
+    }
+
+  bdestroy (path);
+  bdestroy (key);
+  return asset;
+  }
+
+int pk_assets_collect (struct pk_assets* assets, const char* page_path, const char* buf, size_t len) {
+  struct pk_lexer lexer;
+  struct pk_token token;
+  bstring name = NULL;
+  int depth = 0;
+  int type;
+  int status = PK_OK;
+
+  pk_lexer_init (&lexer, buf, len);
+
+  while (status == PK_OK && (type = pk_lexer_next (&lexer, &token)) != PK_TOKEN_EOF) {
+    if (type == PK_ERR) {
+      status = PK_ERR;
+      }
+
+    else if (name == NULL) {
+      if (type == PK_TOKEN_OPEN && token.tag == PK_TAG_IMAGE) {
+        depth = 1;
+        name = bfromcstr ("");
+        status = name ? PK_OK : PK_ERR;
+        }
+      }
+
+    else if (type == PK_TOKEN_TEXT) {
+      status = bcatblk (name, token.text.data, (int) token.text.len) == BSTR_OK ? PK_OK : PK_ERR;
+      }
+
+    else if (type == PK_TOKEN_OPEN) {
+      depth++;
+      }
+
+    else if (--depth == 0) {
+      /* Trim the name, and resolve it */
+      while (blength (name) > 0 && isspace (name->data[name->slen - 1])) {
+        btrunc (name, name->slen - 1);
+        }
+
+      if (blength (name) > 0 && pk_assets_add (assets, page_path, bdata (name)) == NULL) {
+        status = PK_ERR;
+        }
+
+      bdestroy (name);
+      name = NULL;
+      }
+    }
+
+  bdestroy (name);
+  pk_lexer_clear (&lexer);
+  return status;
+  }
+
+/**
+*** Image Headers
+**/
+
+/* Read big and little endian integers from a header */
+#define BE16(p) ((unsigned) (p)[0] << 8 | (unsigned) (p)[1])
+#define BE32(p) ((unsigned long) (p)[0] << 24 | (unsigned long) (p)[1] << 16 | (unsigned long) (p)[2] << 8 | (p)[3])
+#define LE16(p) ((unsigned) (p)[1] << 8 | (unsigned) (p)[0])
+#define LE32(p) ((unsigned long) (p)[3] << 24 | (unsigned long) (p)[2] << 16 | (unsigned long) (p)[1] << 8 | (p)[0])
+
+/* Walk the JPEG segments to the start of frame, which holds the size */
+static int jpeg_size (FILE* file, int* width, int* height) {
+  unsigned char seg[8];
+
+  if (fseek (file, 2, SEEK_SET) != 0) {
+    return PK_ERR;
+    }
+
+  while (fread (seg, 1, 4, file) == 4) {
+    unsigned marker = seg[1];
+    unsigned length = BE16 (seg + 2);
+
+    if (seg[0] != 0xFF || length < 2) {
+      return PK_ERR;
+      }
+
+    /* SOF0 to SOF15, except DHT (C4), JPG (C8) and DAC (CC) */
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC) {
+      if (fread (seg, 1, 5, file) != 5) {
+        return PK_ERR;
+        }
+
+      *height = (int) BE16 (seg + 1);
+      *width = (int) BE16 (seg + 3);
+      return PK_OK;
+      }
+
+    if (fseek (file, (long) length - 2, SEEK_CUR) != 0) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_ERR;
+  }
+
+int pk_image_size (FILE* file, int* width, int* height) {
+  unsigned char head[26];
+  size_t len;
+
+  *width = *height = 0;
+
+  if (fseek (file, 0, SEEK_SET) != 0) {
+    return PK_ERR;
+    }
+
+  len = fread (head, 1, sizeof (head), file);
+
+  if (len >= 24 && memcmp (head, "\211PNG\r\n\032\n", 8) == 0 && memcmp (head + 12, "IHDR", 4) == 0) {
+    *width = (int) BE32 (head + 16);
+    *height = (int) BE32 (head + 20);
+    return PK_OK;
+    }
+
+  if (len >= 10 && (memcmp (head, "GIF87a", 6) == 0 || memcmp (head, "GIF89a", 6) == 0)) {
+    *width = (int) LE16 (head + 6);
+    *height = (int) LE16 (head + 8);
+    return PK_OK;
+    }
+
+  if (len >= 26 && head[0] == 'B' && head[1] == 'M') {
+    long h = (long) LE32 (head + 22);
+
+    /* Top-down bitmaps have a negative height */
+    if (h & 0x80000000L) {
+      h = (long) (0x100000000UL - (unsigned long) h);
+      }
+
+    *width = (int) LE32 (head + 18);
+    *height = (int) h;
+    return PK_OK;
+    }
+
+  if (len >= 2 && head[0] == 0xFF && head[1] == 0xD8) {
+    return jpeg_size (file, width, height);
+    }
+
+  return PK_ERR;
+  }
+
+/**
+*** Processing
+**/
+
+/* Format a hash as sixteen hex digits (C90 has no format for 64-bit) */
+static void format_hash (uint64_t hash, char* out) {
+  static const char digits[] = "0123456789abcdef";
+  int i;
+
+  for (i = 15; i >= 0; i--) {
+    out[i] = digits[hash & 0xF];
+    hash >>= 4;
+    }
+
+  out[16] = '\0';
+  }
+
+/* Phase one: hash and measure one asset */
+static void hash_job (size_t index, void* ctx) {
+  struct pk_assets* assets = (struct pk_assets*) ctx;
+  struct pk_asset* asset = assets->items[index];
+  struct map_entry* entry;
+  struct stat info;
+  FILE* file;
+  char* chunk;
+  size_t len;
+
+  if (asset->state != PK_ASSET_RESOLVED) {
+    return;
+    }
+
+  if (stat ((char*) asset->source->data, &info) != 0) {
+    asset->state = PK_ASSET_FAILED;
+    return;
+    }
+
+  asset->size = (long) info.st_size;
+  asset->mtime = (long) info.st_mtime;
+
+  /* The cache is only read during this phase, so needs no lock */
+  entry = map_find (&assets->cache, asset->source);
+
+  if (entry != NULL && ( (struct cache_entry*) entry->value)->size == asset->size &&
+      ( (struct cache_entry*) entry->value)->mtime == asset->mtime) {
+    asset->hash = ( (struct cache_entry*) entry->value)->hash;
+    asset->width = ( (struct cache_entry*) entry->value)->width;
+    asset->height = ( (struct cache_entry*) entry->value)->height;
+    asset->state = PK_ASSET_HASHED;
+    return;
+    }
+
+  file = fopen (bdata (asset->source), "rb");
+  chunk = (char*) malloc (ASSET_CHUNK);
+
+  if (file == NULL || chunk == NULL) {
+    asset->state = PK_ASSET_FAILED;
+    }
+
+  else {
+    /* An unknown format is not an error: the size is just unknown */
+    pk_image_size (file, &asset->width, &asset->height);
+    asset->hash = pk_hash_seed ();
+
+    if (fseek (file, 0, SEEK_SET) == 0) {
+      while ( (len = fread (chunk, 1, ASSET_CHUNK, file)) > 0) {
+        asset->hash = pk_hash_continue (asset->hash, chunk, len);
+        }
+      }
+
+    asset->state = ferror (file) ? PK_ASSET_FAILED : PK_ASSET_HASHED;
+    }
+
+  if (file != NULL) {
+    fclose (file);
+    }
+
+  free (chunk);
+  }
+
+/* Whether the files a and b hold the same bytes: the hash only finds
+ * candidates, as different content can share it. Returns PK_ERR if
+ * either file cannot be read
+ */
+static int same_content (const char* a, const char* b) {
+  FILE* fa = fopen (a, "rb");
+  FILE* fb = fopen (b, "rb");
+  char* chunk = (char*) malloc (2 * ASSET_CHUNK);
+  int same = PK_ERR;
+  size_t na;
+  size_t nb;
+
+  if (fa != NULL && fb != NULL && chunk != NULL) {
+    do {
+      na = fread (chunk, 1, ASSET_CHUNK, fa);
+      nb = fread (chunk + ASSET_CHUNK, 1, ASSET_CHUNK, fb);
+      same = na == nb && memcmp (chunk, chunk + ASSET_CHUNK, na) == 0;
+      }
+    while (same && na > 0);
+
+    if (ferror (fa) || ferror (fb)) {
+      same = PK_ERR;
+      }
+    }
+
+  if (fa != NULL) {
+    fclose (fa);
+    }
+
+  if (fb != NULL) {
+    fclose (fb);
+    }
+
+  free (chunk);
+  return same;
+  }
+
+/* Copy src to dst, preferring a reflink, then an in-kernel copy */
+static int copy_file (const char* src, const char* dst, long size) {
+  char* chunk;
+  int in;
+  int out;
+  int status = PK_ERR;
+  ssize_t n;
+
+  in = open (src, O_RDONLY);
+
+  if (in < 0) {
+    return PK_ERR;
+    }
+
+  out = open (dst, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if (out < 0) {
+    close (in);
+    return PK_ERR;
+    }
+
+#ifdef FICLONE
+
+  /* Share the blocks outright on copy-on-write file systems */
+  if (ioctl (out, FICLONE, in) == 0) {
+    close (in);
+    return close (out) == 0 ? PK_OK : PK_ERR;
+    }
+
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+
+  /* Copy within the kernel. Falls back to read/write on the first
+   * failure (e.g. across file systems on older kernels)
+   */
+  while (size > 0 && (n = copy_file_range (in, NULL, out, NULL, (size_t) size, 0)) > 0) {
+    size -= (long) n;
+    }
+
+  if (size == 0) {
+    close (in);
+    return close (out) == 0 ? PK_OK : PK_ERR;
+    }
+
+  /* Restart from the beginning with plain reads and writes */
+  if (lseek (in, 0, SEEK_SET) != 0 || lseek (out, 0, SEEK_SET) != 0 || ftruncate (out, 0) != 0) {
+    close (in);
+    close (out);
+    return PK_ERR;
+    }
+
+#else
+  (void) size;
+#endif
+
+  chunk = (char*) malloc (ASSET_CHUNK);
+
+  if (chunk != NULL) {
+    status = PK_OK;
+
+    while ( (n = read (in, chunk, ASSET_CHUNK)) > 0) {
+      char* p = chunk;
+
+      while (n > 0) {
+        ssize_t written = write (out, p, (size_t) n);
+
+        if (written < 0 && errno == EINTR) {
+          continue;
+          }
+
+        if (written <= 0) {
+          status = PK_ERR;
+          break;
+          }
+
+        p += written;
+        n -= written;
+        }
+
+      if (status != PK_OK) {
+        break;
+        }
+      }
+
+    if (n < 0) {
+      status = PK_ERR;
+      }
+
+    free (chunk);
+    }
+
+  close (in);
+
+  if (close (out) != 0) {
+    status = PK_ERR;
+    }
+
+  return status;
+  }
+
+/* Phase three: copy one canonical asset into place */
+static void copy_job (size_t index, void* ctx) {
+  struct pk_assets* assets = (struct pk_assets*) ctx;
+  struct pk_asset* asset = assets->items[index];
+  struct stat info;
+  bstring temp;
+
+  if (asset->canonical != asset || asset->state != PK_ASSET_HASHED) {
+    return;
+    }
+
+  /* Content addressed outputs never change, so an existing one is done:
+   * unless it is damaged, or holds other content under the same hash
+   */
+  if (stat ((char*) asset->target->data, &info) == 0 && (long) info.st_size == asset->size &&
+      same_content (bdata (asset->source), bdata (asset->target)) == 1) {
+    asset->state = PK_ASSET_COPIED;
+    return;
+    }
+
+  /* Copy to a temporary name, so readers never see a partial file */
+  temp = bformat ("%s.%ld.tmp", bdata (asset->target), (long) getpid ());
+
+  if (temp != NULL && copy_file (bdata (asset->source), bdata (temp), asset->size) == PK_OK &&
+      rename (bdata (temp), bdata (asset->target)) == 0) {
+    asset->state = PK_ASSET_COPIED;
+    }
+
+  else {
+    if (temp != NULL) {
+      unlink ((char*) temp->data);
+      }
+
+    asset->state = PK_ASSET_FAILED;
+    }
+
+  bdestroy (temp);
+  }
+
+/* Phase two: fold identical content onto one asset, name the outputs,
+ * and remember the measurements
+ */
+static int fold_duplicates (struct pk_assets* assets) {
+  struct map content;
+  size_t i;
+  int status = PK_OK;
+
+  if (map_init (&content) != PK_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < assets->count && status == PK_OK; i++) {
+    struct pk_asset* asset = assets->items[i];
+    struct map_entry* entry;
+    struct cache_entry* cached;
+    char digest[17];
+    char suffix[24];
+    bstring key;
+    const char* ext;
+    int clash = 0;
+
+    if (asset->state != PK_ASSET_HASHED || asset->target != NULL) {
+      continue;
+      }
+
+    /* Content is found by its hash and size, and then compared: files
+     * that differ despite matching are numbered in turn ("-1", "-2", ...)
+     */
+    format_hash (asset->hash, digest);
+
+    for (;;) {
+      key = bformat ("%s-%ld-%d", digest, asset->size, clash);
+
+      if (key == NULL) {
+        status = PK_ERR;
+        break;
+        }
+
+      entry = map_find (&content, key);
+
+      if (entry == NULL) {
+        if (map_insert (&content, key, asset) == NULL) {
+          status = PK_ERR;
+          }
+
+        bdestroy (key);
+        break;
+        }
+
+      bdestroy (key);
+
+      if (same_content (bdata (( (struct pk_asset*) entry->value)->source), bdata (asset->source)) == 1) {
+        asset->canonical = (struct pk_asset*) entry->value;
+        break;
+        }
+
+      clash++;
+      }
+
+    if (status != PK_OK) {
+      break;
+      }
+
+    /* Keep the extension of the canonical source, for the benefit of
+     * servers that guess the type from the name
+     */
+    ext = strrchr ((char*) asset->canonical->source->data, '.');
+
+    if (ext != NULL && strchr (ext, '/') != NULL) {
+      ext = NULL;
+      }
+
+    suffix[0] = '\0';
+
+    if (clash > 0) {
+      sprintf (suffix, "-%d", clash);
+      }
+
+    asset->target = bformat ("%s/%s%s%s", bdata (assets->output), digest, suffix, ext ? ext : "");
+
+    if (asset->target == NULL) {
+      status = PK_ERR;
+      }
+
+    /* Record the measurements for the next run */
+    entry = map_find (&assets->cache, asset->source);
+    cached = entry ? (struct cache_entry*) entry->value : (struct cache_entry*) malloc (sizeof (*cached));
+
+    if (cached == NULL || (entry == NULL && map_insert (&assets->cache, asset->source, cached) == NULL)) {
+      if (entry == NULL) {
+        free (cached);
+        }
+
+      status = PK_ERR;
+      continue;
+      }
+
+    cached->size = asset->size;
+    cached->mtime = asset->mtime;
+    cached->hash = asset->hash;
+    cached->width = asset->width;
+    cached->height = asset->height;
+    }
+
+  map_clear (&content, NULL);
+  return status;
+  }
+
+int pk_assets_process (struct pk_assets* assets) {
+  size_t i;
+  int failed = 0;
+
+  /* Create the output directory, if needed */
+  if (mkdir ((char*) assets->output->data, 0755) != 0 && errno != EEXIST) {
+    return PK_ERR;
+    }
+
+  pk_pool_run (assets->workers, assets->count, hash_job, assets);
+
+  if (fold_duplicates (assets) != PK_OK) {
+    return PK_ERR;
+    }
+
+  pk_pool_run (assets->workers, assets->count, copy_job, assets);
+
+  /* Duplicates share the fate of their canonical copy */
+  for (i = 0; i < assets->count; i++) {
+    struct pk_asset* asset = assets->items[i];
+
+    if (asset->canonical != asset && asset->state == PK_ASSET_HASHED) {
+      asset->state = asset->canonical->state;
+      }
+
+    if (asset->state == PK_ASSET_FAILED) {
+      failed++;
+      }
+    }
+
+  return failed;
+  }
+
+/**
+*** Dimension Cache
+**/
+
+int pk_assets_save_cache (struct pk_assets* assets, FILE* file) {
+  size_t i;
+
+  fprintf (file, "%s\n", ASSET_CACHE_MAGIC);
+
+  for (i = 0; i < assets->cache.nbuckets; i++) {
+    struct map_entry* entry;
+
+    for (entry = assets->cache.buckets[i]; entry != NULL; entry = entry->next) {
+      struct cache_entry* cached = (struct cache_entry*) entry->value;
+      char digest[17];
+
+      /* The path ends the line, so one without a path or holding a line
+       * end cannot be written. It is measured again on the next run
+       */
+      if (entry->key == NULL || entry->key->data == NULL || strpbrk ( (char*) entry->key->data, "\r\n") != NULL) {
+        continue;
+        }
+
+      format_hash (cached->hash, digest);
+      fprintf (file, "%ld\t%ld\t%s\t%d\t%d\t%s\n", cached->size, cached->mtime, digest, cached->width,
+               cached->height, (char*) entry->key->data);
+      }
+    }
+
+  return ferror (file) ? PK_ERR : PK_OK;
+  }
+
+/* Read the next line of a cache file into line, without its line end.
+ * Returns one for a line, zero at the end of the file and -1 on error
+ */
+static int read_line (FILE* file, bstring line) {
+  int c;
+
+  btrunc (line, 0);
+
+  while ( (c = getc (file)) != EOF && c != '\n') {
+    if (bconchar (line, (char) c) != BSTR_OK) {
+      return -1;
+      }
+    }
+
+  if (ferror (file)) {
+    return -1;
+    }
+
+  if (blength (line) > 0 && bchar (line, blength (line) - 1) == '\r') {
+    btrunc (line, blength (line) - 1);
+    }
+
+  return c != EOF || blength (line) > 0;
+  }
+
+int pk_assets_load_cache (struct pk_assets* assets, FILE* file) {
+  bstring line = bfromcstr ("");
+  char digest[17];
+  struct cache_entry entry;
+  int status = PK_OK;
+  int more;
+
+  if (line == NULL || read_line (file, line) <= 0 || biseqcstr (line, ASSET_CACHE_MAGIC) != 1) {
+    bdestroy (line);
+    return PK_ERR;
+    }
+
+  while (status == PK_OK && (more = read_line (file, line)) != 0) {
+    struct cache_entry* cached;
+    struct map_entry* found;
+    const char* path;
+    bstring key;
+    int i;
+
+    if (more < 0) {
+      status = PK_ERR;
+      break;
+      }
+
+    /* The path is everything after the fifth tab, and may hold tabs */
+    for (path = (const char*) line->data, i = 0; i < 5 && path != NULL; i++) {
+      path = strchr (path, '\t');
+      path = path ? path + 1 : NULL;
+      }
+
+    if (path == NULL || *path == '\0' || sscanf ( (const char*) line->data, "%ld\t%ld\t%16s\t%d\t%d\t",
+        &entry.size, &entry.mtime, digest, &entry.width, &entry.height) != 5) {
+      continue;
+      }
+
+    entry.hash = 0;
+
+    for (i = 0; i < 16 && isxdigit ( (unsigned char) digest[i]); i++) {
+      entry.hash = (entry.hash << 4) | (uint64_t) (isdigit ( (unsigned char) digest[i]) ? digest[i] - '0' :
+                   tolower ( (unsigned char) digest[i]) - 'a' + 10);
+      }
+
+    key = bfromcstr (path);
+
+    if (key == NULL) {
+      status = PK_ERR;
+      break;
+      }
+
+    found = map_find (&assets->cache, key);
+    cached = found ? (struct cache_entry*) found->value : (struct cache_entry*) malloc (sizeof (*cached));
+
+    if (cached == NULL || (found == NULL && map_insert (&assets->cache, key, cached) == NULL)) {
+      if (found == NULL) {
+        free (cached);
+        }
+
+      status = PK_ERR;
+      }
+
+    else {
+      *cached = entry;
+      }
+
+    bdestroy (key);
+    }
+
+  bdestroy (line);
+  return status;
+  }
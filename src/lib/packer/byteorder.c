@@ -0,0 +1,164 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file byteorder.c
+*** \brief Columns of little endian integers read from the file formats
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#else
+#error "can't find the C99 standard types"
+#endif
+
+#include "packer/byteorder.h"
+
+#ifdef HAVE_BIG_ENDIAN
+
+/* Reverse the bytes of an integer */
+#define SWAP16(x) ( (uint16_t) ( ( (x) >> 8) | ( (x) << 8)))
+#define SWAP32(x) ( ( (x) >> 24) | ( ( (x) >> 8) & 0xFF00) | ( ( (x) & 0xFF00) << 8) | ( (x) << 24))
+
+/* Masks of alternate bytes and alternate pairs of bytes of a word */
+#define WORD_BYTES ( ( (uint64_t) 0x00FF00FFUL << 32) | 0x00FF00FFUL)
+#define WORD_PAIRS ( ( (uint64_t) 0x0000FFFFUL << 32) | 0x0000FFFFUL)
+
+/* Reverse the bytes of each 16-bit integer in a word */
+static uint64_t swap_word16 (uint64_t w) {
+  return ( (w & WORD_BYTES) << 8) | ( (w >> 8) & WORD_BYTES);
+  }
+
+/* Reverse the bytes of each 32-bit integer in a word */
+static uint64_t swap_word32 (uint64_t w) {
+  w = swap_word16 (w);
+  return ( (w & WORD_PAIRS) << 16) | ( (w >> 16) & WORD_PAIRS);
+  }
+
+/* Swap the n integers of size bytes at out in place, a 64-bit word (two
+ * or four integers) at a time, then the few left over one by one. The
+ * words are copied in and out, so out need only be aligned for its own
+ * integers
+ */
+static void swap_words (void* out, size_t n, size_t size) {
+  unsigned char* p = (unsigned char*) out;
+  unsigned char* end = p + n * size;
+  uint64_t w;
+
+  for (; end - p >= (ptrdiff_t) sizeof (w); p += sizeof (w)) {
+    memcpy (&w, p, sizeof (w));
+    w = size == sizeof (uint32_t) ? swap_word32 (w) : swap_word16 (w);
+    memcpy (p, &w, sizeof (w));
+    }
+
+  for (; p < end; p += size) {
+    if (size == sizeof (uint32_t)) {
+      uint32_t x;
+
+      memcpy (&x, p, sizeof (x));
+      x = SWAP32 (x);
+      memcpy (p, &x, sizeof (x));
+      }
+
+    else {
+      uint16_t x;
+
+      memcpy (&x, p, sizeof (x));
+      x = SWAP16 (x);
+      memcpy (p, &x, sizeof (x));
+      }
+    }
+  }
+
+#endif
+
+/* Non-zero if p is aligned for an integer of size bytes */
+#define ALIGNED(p, size) ( ( (size_t) (p) & ( (size) - 1)) == 0)
+
+const uint32_t* pk_le32_view (const unsigned char* p, size_t n, uint32_t** scratch) {
+  uint32_t* out;
+
+  *scratch = NULL;
+
+#ifndef HAVE_BIG_ENDIAN
+
+  if (ALIGNED (p, sizeof (uint32_t))) {
+    return (const uint32_t*) (const void*) p;
+    }
+
+#endif
+
+  out = (uint32_t*) malloc (n * sizeof (*out) + 1);
+
+  if (out == NULL) {
+    return NULL;
+    }
+
+  memcpy (out, p, n * sizeof (*out));
+
+#ifdef HAVE_BIG_ENDIAN
+  swap_words (out, n, sizeof (*out));
+#endif
+
+  *scratch = out;
+  return out;
+  }
+
+const uint16_t* pk_le16_view (const unsigned char* p, size_t n, uint16_t** scratch) {
+  uint16_t* out;
+
+  *scratch = NULL;
+
+#ifndef HAVE_BIG_ENDIAN
+
+  if (ALIGNED (p, sizeof (uint16_t))) {
+    return (const uint16_t*) (const void*) p;
+    }
+
+#endif
+
+  out = (uint16_t*) malloc (n * sizeof (*out) + 1);
+
+  if (out == NULL) {
+    return NULL;
+    }
+
+  memcpy (out, p, n * sizeof (*out));
+
+#ifdef HAVE_BIG_ENDIAN
+  swap_words (out, n, sizeof (*out));
+#endif
+
+  *scratch = out;
+  return out;
+  }
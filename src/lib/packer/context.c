@@ -0,0 +1,164 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file context.c
+*** \brief Long-lived compile context for embedding the compiler
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#include "packer/context.h"
+
+struct pk_context* pk_context_new (void) {
+  struct pk_context* context = (struct pk_context*) calloc (1, sizeof (*context));
+
+  if (context == NULL) {
+    return NULL;
+    }
+
+  if (pk_doc_init (&context->doc, NULL) != PK_OK) {
+    free (context);
+    return NULL;
+    }
+
+  context->highlighter = pk_highlighter_new ();
+
+  if (context->highlighter == NULL) {
+    pk_doc_clear (&context->doc);
+    free (context);
+    return NULL;
+    }
+
+  context->backend = &pk_backend_html;
+  context->limits = pk_limits_default;
+  context->cache_limit = PK_CONTEXT_CACHE_SIZE;
+  context->doc.limits = &context->limits;
+  return context;
+  }
+
+void pk_context_free (struct pk_context* context) {
+  if (context != NULL) {
+    pk_doc_clear (&context->doc);
+    pk_highlighter_free (context->highlighter);
+    pk_man_index_close (context->man_index);
+    free (context->costs);
+    free (context->compile_costs);
+    free (context);
+    }
+  }
+
+int pk_context_man_index (struct pk_context* context, const char* path) {
+  pk_man_index_close (context->man_index);
+  context->man_index = NULL;
+
+  if (path == NULL) {
+    return PK_OK;
+    }
+
+  context->man_index = pk_man_index_open (path);
+  return context->man_index ? PK_OK : PK_ERR;
+  }
+
+int pk_context_count_tags (struct pk_context* context) {
+  if (context->costs == NULL) {
+    context->costs = (struct pk_tag_costs*) calloc (1, sizeof (*context->costs));
+    }
+
+  if (context->compile_costs == NULL) {
+    context->compile_costs = (struct pk_tag_costs*) calloc (1, sizeof (*context->compile_costs));
+    }
+
+  context->doc.costs = context->compile_costs;
+  return context->costs && context->compile_costs ? PK_OK : PK_ERR;
+  }
+
+int pk_context_backend (struct pk_context* context, const char* name) {
+  const struct pk_backend* backend = pk_backend_find (name);
+
+  if (backend == NULL) {
+    return PK_ERR;
+    }
+
+  context->backend = backend;
+  return PK_OK;
+  }
+
+const struct pk_doc* pk_context_compile (struct pk_context* context, const char* buf, size_t len) {
+  int status;
+
+  pk_doc_reset (&context->doc);
+  status = pk_doc_compile (&context->doc, buf, len);
+  context->limited = context->doc.limited;
+  context->pages++;
+  return status == PK_OK ? &context->doc : NULL;
+  }
+
+/* Render a page to file or, with no file, into *out */
+static int render_page (struct pk_context* context, const char* buf, size_t len, FILE* file, bstring* out) {
+  struct pk_render* render = pk_render_new (context->backend, file);
+  int status;
+
+  context->limited = 0;
+  context->notes = 0;
+  context->pages++;
+
+  if (render == NULL) {
+    return PK_ERR;
+    }
+
+  render->highlighter = context->highlighter;
+  render->man_index = context->man_index;
+  render->limits = &context->limits;
+  render->costs = context->costs;
+  status = pk_render_run (render, buf, len);
+
+  if (status == PK_OK && out != NULL) {
+    *out = pk_render_take (render);
+    status = *out ? PK_OK : PK_ERR;
+    }
+
+  context->limited = render->limited;
+  context->notes = render->notes.next - 1;
+  pk_render_free (render);
+
+  /* The listings of one page rarely turn up on the next, so the cache is
+   * only kept while it is small
+   */
+  if (pk_highlight_cached (context->highlighter) > context->cache_limit) {
+    pk_highlight_flush (context->highlighter);
+    }
+
+  return status;
+  }
+
+int pk_context_render (struct pk_context* context, const char* buf, size_t len, FILE* file) {
+  return render_page (context, buf, len, file, NULL);
+  }
+
+bstring pk_context_render_string (struct pk_context* context, const char* buf, size_t len) {
+  bstring out = NULL;
+
+  return render_page (context, buf, len, NULL, &out) == PK_OK ? out : NULL;
+  }
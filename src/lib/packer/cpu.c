@@ -0,0 +1,382 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file cpu.c
+*** \brief Binding of the scanning kernels to the features of the processor
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+/* The vector variants need the processor probe, the intrinsics, and a
+ * compiler that builds single functions for a wider instruction set
+ */
+#if defined(HAVE_CPUID_H) && defined(HAVE_IMMINTRIN_H) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define CPU_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/cpu.h"
+
+/* Words with every byte set to 0x01, and to 0x80 */
+#define WORD_ONES   ( (unsigned long) -1 / 0xFF)
+#define WORD_HIGHS  (WORD_ONES * 0x80)
+
+/* Non-zero if any byte of the word is zero */
+#define HAS_ZERO(w) ( ( (w) - WORD_ONES) & ~ (w) & WORD_HIGHS)
+
+typedef const char* (scan_set_fn) (const char* p, const char* end, const char* set);
+
+/* The feature names, widest last */
+static const struct {
+  const char* name;
+  unsigned    feature;
+  } cpu_names[] = {
+  { "sse2", PK_CPU_SSE2 },
+  { "sse4.2", PK_CPU_SSE42 },
+  { "avx2", PK_CPU_AVX2 },
+  { "avx512", PK_CPU_AVX512 }
+  };
+
+static const char* scan_set_first (const char* p, const char* end, const char* set);
+
+static unsigned     detected;                     /*< Features of the processor */
+static unsigned     bound;                        /*< Features the kernels are bound to */
+static scan_set_fn* scan_set = scan_set_first;    /*< The bound pk_scan_set */
+static const char*  scan_set_variant = "portable"; /*< Name of the variant it is bound to */
+
+/**
+*** Portable Variants
+**/
+
+/* Skip a word at a time while no byte of the word is in the set */
+static const char* scan_set_word (const char* p, const char* end, const char* set) {
+  unsigned long c0 = WORD_ONES * (unsigned char) set[0];
+  unsigned long c1 = WORD_ONES * (unsigned char) set[1];
+  unsigned long c2 = WORD_ONES * (unsigned char) set[2];
+  unsigned long c3 = WORD_ONES * (unsigned char) set[3];
+
+  while ( (size_t) (end - p) >= sizeof (unsigned long)) {
+    unsigned long word;
+
+    memcpy (&word, p, sizeof (word));
+
+    if (HAS_ZERO (word ^ c0) | HAS_ZERO (word ^ c1) | HAS_ZERO (word ^ c2) | HAS_ZERO (word ^ c3)) {
+      break;
+      }
+
+    p += sizeof (word);
+    }
+
+  while (p < end && *p != set[0] && *p != set[1] && *p != set[2] && *p != set[3]) {
+    p++;
+    }
+
+  return p;
+  }
+
+#ifdef CPU_X86
+
+/**
+*** x86 Variants. Each compares a vector of the text against the four
+*** bytes at once, and leaves the tail shorter than a vector to the
+*** portable code. There is no SSE 4.2 variant: for a set of four bytes
+*** pcmpestri is slower than the four SSE2 comparisons it replaces
+**/
+
+__attribute__ ( (target ("sse2")))
+static const char* scan_set_sse2 (const char* p, const char* end, const char* set) {
+  __m128i c0 = _mm_set1_epi8 (set[0]);
+  __m128i c1 = _mm_set1_epi8 (set[1]);
+  __m128i c2 = _mm_set1_epi8 (set[2]);
+  __m128i c3 = _mm_set1_epi8 (set[3]);
+
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128 ( (const __m128i*) p);
+    __m128i hit = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (v, c0), _mm_cmpeq_epi8 (v, c1)),
+                                _mm_or_si128 (_mm_cmpeq_epi8 (v, c2), _mm_cmpeq_epi8 (v, c3)));
+    int mask = _mm_movemask_epi8 (hit);
+
+    if (mask != 0) {
+      return p + __builtin_ctz ( (unsigned) mask);
+      }
+
+    p += 16;
+    }
+
+  return scan_set_word (p, end, set);
+  }
+
+__attribute__ ( (target ("avx2")))
+static const char* scan_set_avx2 (const char* p, const char* end, const char* set) {
+  __m256i c0 = _mm256_set1_epi8 (set[0]);
+  __m256i c1 = _mm256_set1_epi8 (set[1]);
+  __m256i c2 = _mm256_set1_epi8 (set[2]);
+  __m256i c3 = _mm256_set1_epi8 (set[3]);
+
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256 ( (const __m256i*) p);
+    __m256i hit = _mm256_or_si256 (_mm256_or_si256 (_mm256_cmpeq_epi8 (v, c0), _mm256_cmpeq_epi8 (v, c1)),
+                                   _mm256_or_si256 (_mm256_cmpeq_epi8 (v, c2), _mm256_cmpeq_epi8 (v, c3)));
+    unsigned mask = (unsigned) _mm256_movemask_epi8 (hit);
+
+    if (mask != 0) {
+      return p + __builtin_ctz (mask);
+      }
+
+    p += 32;
+    }
+
+  return scan_set_sse2 (p, end, set);
+  }
+
+/* The tail is read with a masked load, so no byte past end is touched */
+__attribute__ ( (target ("avx512f,avx512bw")))
+static const char* scan_set_avx512 (const char* p, const char* end, const char* set) {
+  __m512i c0 = _mm512_set1_epi8 (set[0]);
+  __m512i c1 = _mm512_set1_epi8 (set[1]);
+  __m512i c2 = _mm512_set1_epi8 (set[2]);
+  __m512i c3 = _mm512_set1_epi8 (set[3]);
+
+  __m512i v;
+  __mmask64 live;
+  __mmask64 hit;
+
+  while (end - p >= 64) {
+    v = _mm512_loadu_si512 ( (const void*) p);
+    hit = _mm512_cmpeq_epi8_mask (v, c0) | _mm512_cmpeq_epi8_mask (v, c1) | _mm512_cmpeq_epi8_mask (v, c2) |
+          _mm512_cmpeq_epi8_mask (v, c3);
+
+    if (hit != 0) {
+      return p + __builtin_ctzll (hit);
+      }
+
+    p += 64;
+    }
+
+  if (p >= end) {
+    return end;
+    }
+
+  live = ( (__mmask64) 1 << (end - p)) - 1;
+  v = _mm512_maskz_loadu_epi8 (live, p);
+  hit = (_mm512_cmpeq_epi8_mask (v, c0) | _mm512_cmpeq_epi8_mask (v, c1) | _mm512_cmpeq_epi8_mask (v, c2) |
+         _mm512_cmpeq_epi8_mask (v, c3)) & live;
+
+  return hit != 0 ? p + __builtin_ctzll (hit) : end;
+  }
+
+/* XCR0 bits for the SSE and AVX registers, and for the AVX-512 ones */
+#define XCR0_AVX    0x06
+#define XCR0_AVX512 0xE6
+
+/* The register state the operating system saves (XCR0) */
+static unsigned xgetbv0 (void) {
+  unsigned lo;
+  unsigned hi;
+
+  __asm__ ("xgetbv" : "=a" (lo), "=d" (hi) : "c" (0));
+  (void) hi;
+  return lo;
+  }
+
+#endif
+
+/**
+*** Probing and Binding
+**/
+
+/* The features of the processor whose registers the OS also saves */
+static unsigned probe (void) {
+  unsigned features = 0;
+#ifdef CPU_X86
+  unsigned eax, ebx, ecx, edx;
+  unsigned xcr0 = 0;
+
+  if (!__get_cpuid (1, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+    }
+
+  features |= (edx & bit_SSE2) ? PK_CPU_SSE2 : 0;
+  features |= (ecx & bit_SSE4_2) ? PK_CPU_SSE42 : 0;
+
+  if ( (ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+    xcr0 = xgetbv0 ();
+    }
+
+  if (__get_cpuid_max (0, NULL) >= 7) {
+    __cpuid_count (7, 0, eax, ebx, ecx, edx);
+
+    features |= ( (xcr0 & XCR0_AVX) == XCR0_AVX && (ebx & bit_AVX2)) ? PK_CPU_AVX2 : 0;
+    features |= ( (xcr0 & XCR0_AVX512) == XCR0_AVX512 && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW)) ?
+                PK_CPU_AVX512 : 0;
+    }
+#endif
+
+  return features;
+  }
+
+/* Bind each kernel to the widest variant the features allow */
+static void bind_kernels (unsigned features) {
+  scan_set = scan_set_word;
+  scan_set_variant = "portable";
+#ifdef CPU_X86
+
+  if (features & PK_CPU_AVX512) {
+    scan_set = scan_set_avx512;
+    scan_set_variant = "avx512";
+    }
+
+  else if (features & PK_CPU_AVX2) {
+    scan_set = scan_set_avx2;
+    scan_set_variant = "avx2";
+    }
+
+  else if (features & PK_CPU_SSE2) {
+    scan_set = scan_set_sse2;
+    scan_set_variant = "sse2";
+    }
+
+#endif
+  bound = features;
+  }
+
+static void bind_detected (void) {
+  detected = probe ();
+  bind_kernels (detected);
+  }
+
+#ifdef HAVE_PTHREAD_H
+static pthread_once_t bind_once = PTHREAD_ONCE_INIT;
+#else
+static int bind_once = 0;
+#endif
+
+/* Probe the processor and bind the kernels, once */
+static void bind_first (void) {
+#ifdef HAVE_PTHREAD_H
+  pthread_once (&bind_once, bind_detected);
+#else
+
+  if (!bind_once) {
+    bind_once = 1;
+    bind_detected ();
+    }
+
+#endif
+  }
+
+/* The kernels start out bound to these, which bind them properly */
+static const char* scan_set_first (const char* p, const char* end, const char* set) {
+  bind_first ();
+  return scan_set (p, end, set);
+  }
+
+unsigned pk_cpu_detected (void) {
+  bind_first ();
+  return detected;
+  }
+
+unsigned pk_cpu_features (void) {
+  bind_first ();
+  return bound;
+  }
+
+int pk_cpu_select (const char* names) {
+  unsigned features = 0;
+  const char* p = names;
+
+  bind_first ();
+
+  if (names == NULL) {
+    bind_kernels (detected);
+    return PK_OK;
+    }
+
+  while (*p != '\0') {
+    size_t len = strcspn (p, ",");
+    size_t i;
+
+    for (i = 0; i < sizeof (cpu_names) / sizeof (cpu_names[0]); i++) {
+      if (strlen (cpu_names[i].name) == len && strncmp (p, cpu_names[i].name, len) == 0) {
+        features |= cpu_names[i].feature;
+        break;
+        }
+      }
+
+    if (i == sizeof (cpu_names) / sizeof (cpu_names[0]) && ! (len == 4 && strncmp (p, "none", len) == 0)) {
+      return PK_ERR;
+      }
+
+    p += len;
+    p += *p == ',';
+    }
+
+  bind_kernels (features & detected);
+  return PK_OK;
+  }
+
+int pk_cpu_describe (bstring out, unsigned features) {
+  size_t i;
+  int first = 1;
+
+  for (i = 0; i < sizeof (cpu_names) / sizeof (cpu_names[0]); i++) {
+    if ( (features & cpu_names[i].feature) == 0) {
+      continue;
+      }
+
+    if ( (!first && bconchar (out, ',') != BSTR_OK) || bcatcstr (out, cpu_names[i].name) != BSTR_OK) {
+      return PK_ERR;
+      }
+
+    first = 0;
+    }
+
+  return !first || bcatcstr (out, "none") == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+int pk_cpu_describe_kernels (bstring out) {
+  bind_first ();
+  return bcatcstr (out, "pk_scan_set=") == BSTR_OK && bcatcstr (out, scan_set_variant) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+const char* pk_scan_set (const char* p, const char* end, const char* set) {
+  return scan_set (p, end, set);
+  }
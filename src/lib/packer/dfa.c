@@ -0,0 +1,731 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file dfa.c
+*** \brief Table-driven DFAs compiled from simple regular expressions
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/dfa.h"
+#include "packer/hash.h"
+
+/**
+*** NFA Construction. Each pattern is parsed by recursive descent into a
+*** Thompson automaton. States refer to each other by index, as the
+*** state array moves as it grows.
+**/
+
+enum nfa_kind {
+  NFA_EPSILON,    /*< Up to two empty transitions */
+  NFA_SET,        /*< One transition on any byte in a set */
+  NFA_ACCEPT      /*< Accepts a rule */
+  };
+
+struct nfa_state {
+  int kind;   /*< One of enum nfa_kind */
+  int out1;   /*< First successor (-1: none) */
+  int out2;   /*< Second successor, for NFA_EPSILON (-1: none) */
+  int set;    /*< Byte set, for NFA_SET. Rule, for NFA_ACCEPT */
+  };
+
+struct nfa {
+  struct nfa_state* states;     /*< The states */
+  size_t            count;      /*< Number of states */
+  size_t            capacity;   /*< Number of states allocated */
+  unsigned char*    sets;       /*< Byte sets, 32 bytes (a bit per byte) each */
+  size_t            nsets;      /*< Number of sets */
+  size_t            setcap;     /*< Number of sets allocated */
+  const char*       p;          /*< Parse position */
+  int               error;      /*< Non-zero once the parse has failed */
+  };
+
+/* A partly built automaton: end is an epsilon state with no successor */
+struct frag {
+  int start;
+  int end;
+  };
+
+#define SET_BYTES 32
+#define SET_HAS(set, b) ((set)[(b) >> 3] & (1 << ((b) & 7)))
+#define SET_ADD(set, b) ((set)[(b) >> 3] |= (unsigned char) (1 << ((b) & 7)))
+
+static int new_state (struct nfa* nfa, int kind) {
+  if (nfa->count == nfa->capacity) {
+    size_t capacity = nfa->capacity ? nfa->capacity * 2 : 64;
+    struct nfa_state* states = (struct nfa_state*) realloc (nfa->states, capacity * sizeof (*states));
+
+    if (states == NULL) {
+      nfa->error = 1;
+      return -1;
+      }
+
+    nfa->states = states;
+    nfa->capacity = capacity;
+    }
+
+  nfa->states[nfa->count].kind = kind;
+  nfa->states[nfa->count].out1 = -1;
+  nfa->states[nfa->count].out2 = -1;
+  nfa->states[nfa->count].set = -1;
+  return (int) nfa->count++;
+  }
+
+static unsigned char* new_set (struct nfa* nfa) {
+  if (nfa->nsets == nfa->setcap) {
+    size_t setcap = nfa->setcap ? nfa->setcap * 2 : 32;
+    unsigned char* sets = (unsigned char*) realloc (nfa->sets, setcap * SET_BYTES);
+
+    if (sets == NULL) {
+      nfa->error = 1;
+      return NULL;
+      }
+
+    nfa->sets = sets;
+    nfa->setcap = setcap;
+    }
+
+  memset (nfa->sets + nfa->nsets * SET_BYTES, 0, SET_BYTES);
+  return nfa->sets + nfa->nsets++ * SET_BYTES;
+  }
+
+/* A fragment matching one byte from the most recent set */
+static struct frag set_frag (struct nfa* nfa) {
+  struct frag f;
+
+  f.start = new_state (nfa, NFA_SET);
+  f.end = new_state (nfa, NFA_EPSILON);
+
+  if (!nfa->error) {
+    nfa->states[f.start].set = (int) nfa->nsets - 1;
+    nfa->states[f.start].out1 = f.end;
+    }
+
+  return f;
+  }
+
+/* Read one (possibly escaped) character of a pattern */
+static int pattern_char (struct nfa* nfa) {
+  int c = (unsigned char) *nfa->p++;
+
+  if (c == '\\') {
+    c = (unsigned char) *nfa->p;
+
+    if (c == '\0') {
+      nfa->error = 1;
+      return 0;
+      }
+
+    nfa->p++;
+
+    switch (c) {
+      case 'n':
+        return '\n';
+
+      case 'r':
+        return '\r';
+
+      case 't':
+        return '\t';
+
+      default:
+        return c;
+      }
+    }
+
+  return c;
+  }
+
+/* Parse a class, after the opening '[' */
+static void parse_class (struct nfa* nfa, unsigned char* set) {
+  int negate = 0;
+  int first = 1;
+  int b;
+
+  if (*nfa->p == '^') {
+    negate = 1;
+    nfa->p++;
+    }
+
+  /* A ']' straight after the '[' (or '[^') is a literal */
+  while (*nfa->p != '\0' && (*nfa->p != ']' || first)) {
+    int lo = pattern_char (nfa);
+    int hi = lo;
+
+    if (nfa->p[0] == '-' && nfa->p[1] != ']' && nfa->p[1] != '\0') {
+      nfa->p++;
+      hi = pattern_char (nfa);
+      }
+
+    for (b = lo; b <= hi; b++) {
+      SET_ADD (set, b);
+      }
+
+    first = 0;
+    }
+
+  if (*nfa->p != ']') {
+    nfa->error = 1;
+    return;
+    }
+
+  nfa->p++;
+
+  if (negate) {
+    for (b = 0; b < SET_BYTES; b++) {
+      set[b] = (unsigned char) ~set[b];
+      }
+    }
+  }
+
+static struct frag parse_alternation (struct nfa* nfa);
+
+static struct frag parse_atom (struct nfa* nfa) {
+  struct frag f;
+  unsigned char* set;
+  int b;
+
+  if (*nfa->p == '(') {
+    nfa->p++;
+    f = parse_alternation (nfa);
+
+    if (*nfa->p != ')') {
+      nfa->error = 1;
+      }
+
+    else {
+      nfa->p++;
+      }
+
+    return f;
+    }
+
+  set = new_set (nfa);
+
+  if (set == NULL) {
+    f.start = f.end = -1;
+    return f;
+    }
+
+  if (*nfa->p == '[') {
+    nfa->p++;
+    parse_class (nfa, set);
+    }
+
+  else if (*nfa->p == '.') {
+    nfa->p++;
+
+    for (b = 0; b < 256; b++) {
+      if (b != '\n') {
+        SET_ADD (set, b);
+        }
+      }
+    }
+
+  else {
+    b = pattern_char (nfa);
+    SET_ADD (set, b);
+    }
+
+  return set_frag (nfa);
+  }
+
+static struct frag parse_repeat (struct nfa* nfa) {
+  struct frag f = parse_atom (nfa);
+
+  while (!nfa->error && (*nfa->p == '*' || *nfa->p == '+' || *nfa->p == '?')) {
+    char op = *nfa->p++;
+    int start = new_state (nfa, NFA_EPSILON);
+    int end = new_state (nfa, NFA_EPSILON);
+
+    if (nfa->error) {
+      break;
+      }
+
+    /* start -> f (-> start again) -> end */
+    nfa->states[start].out1 = f.start;
+    nfa->states[start].out2 = op == '+' ? -1 : end;
+    nfa->states[f.end].out1 = op == '?' ? end : start;
+    nfa->states[f.end].out2 = op == '?' ? -1 : end;
+
+    if (op == '+') {
+      nfa->states[f.end].out1 = f.start;
+      }
+
+    f.start = start;
+    f.end = end;
+    }
+
+  return f;
+  }
+
+static struct frag parse_sequence (struct nfa* nfa) {
+  struct frag f;
+
+  f.start = f.end = new_state (nfa, NFA_EPSILON);
+
+  while (!nfa->error && *nfa->p != '\0' && *nfa->p != '|' && *nfa->p != ')') {
+    struct frag next = parse_repeat (nfa);
+
+    if (!nfa->error) {
+      nfa->states[f.end].out1 = next.start;
+      f.end = next.end;
+      }
+    }
+
+  return f;
+  }
+
+static struct frag parse_alternation (struct nfa* nfa) {
+  struct frag f = parse_sequence (nfa);
+
+  while (!nfa->error && *nfa->p == '|') {
+    struct frag other;
+    int start;
+    int end;
+
+    nfa->p++;
+    other = parse_sequence (nfa);
+    start = new_state (nfa, NFA_EPSILON);
+    end = new_state (nfa, NFA_EPSILON);
+
+    if (nfa->error) {
+      break;
+      }
+
+    nfa->states[start].out1 = f.start;
+    nfa->states[start].out2 = other.start;
+    nfa->states[f.end].out1 = end;
+    nfa->states[other.end].out1 = end;
+    f.start = start;
+    f.end = end;
+    }
+
+  return f;
+  }
+
+/**
+*** Subset Construction. Each DFA state is the set of NFA states the NFA
+*** could be in: only the set and accepting states matter, as the epsilon
+*** states are always followed through.
+**/
+
+struct subset {
+  int*     members;   /*< Sorted NFA set and accept states */
+  size_t   count;     /*< Number of members */
+  uint64_t hash;      /*< Hash of the members */
+  };
+
+struct builder {
+  struct nfa*    nfa;         /*< The automaton being converted */
+  struct subset* subsets;     /*< DFA states, as NFA state sets */
+  size_t         count;       /*< Number of DFA states */
+  size_t         capacity;    /*< Number of DFA states allocated */
+  int*           stack;       /*< Work stack for the closure */
+  int*           scratch;     /*< Members of the closure being built */
+  unsigned*      seen;        /*< Generation each NFA state was last visited */
+  unsigned       generation;  /*< Current visit generation */
+  };
+
+static int compare_ints (const void* a, const void* b) {
+  int x = *(const int*) a;
+  int y = *(const int*) b;
+  return x < y ? -1 : x > y;
+  }
+
+/* Follow the epsilon transitions from the count states in from, and
+ * return the DFA state for the result: -1 if it is empty, -2 on error
+ */
+static int closure (struct builder* b, const int* from, size_t count) {
+  struct nfa* nfa = b->nfa;
+  size_t depth = 0;
+  size_t n = 0;
+  size_t i;
+  uint64_t hash;
+
+  b->generation++;
+
+  for (i = 0; i < count; i++) {
+    if (b->seen[from[i]] != b->generation) {
+      b->seen[from[i]] = b->generation;
+      b->stack[depth++] = from[i];
+      }
+    }
+
+  while (depth > 0) {
+    int s = b->stack[--depth];
+    const struct nfa_state* state = &nfa->states[s];
+
+    if (state->kind != NFA_EPSILON) {
+      b->scratch[n++] = s;
+      continue;
+      }
+
+    if (state->out1 >= 0 && b->seen[state->out1] != b->generation) {
+      b->seen[state->out1] = b->generation;
+      b->stack[depth++] = state->out1;
+      }
+
+    if (state->out2 >= 0 && b->seen[state->out2] != b->generation) {
+      b->seen[state->out2] = b->generation;
+      b->stack[depth++] = state->out2;
+      }
+    }
+
+  if (n == 0) {
+    return -1;
+    }
+
+  qsort (b->scratch, n, sizeof (int), compare_ints);
+  hash = pk_hash_bytes (b->scratch, n * sizeof (int));
+
+  for (i = 0; i < b->count; i++) {
+    if (b->subsets[i].hash == hash && b->subsets[i].count == n &&
+        memcmp (b->subsets[i].members, b->scratch, n * sizeof (int)) == 0) {
+      return (int) i;
+      }
+    }
+
+  /* A new state */
+  if (b->count == PK_DFA_MAX_STATES) {
+    return -2;
+    }
+
+  if (b->count == b->capacity) {
+    size_t capacity = b->capacity ? b->capacity * 2 : 64;
+    struct subset* subsets = (struct subset*) realloc (b->subsets, capacity * sizeof (*subsets));
+
+    if (subsets == NULL) {
+      return -2;
+      }
+
+    b->subsets = subsets;
+    b->capacity = capacity;
+    }
+
+  b->subsets[b->count].members = (int*) malloc (n * sizeof (int));
+
+  if (b->subsets[b->count].members == NULL) {
+    return -2;
+    }
+
+  memcpy (b->subsets[b->count].members, b->scratch, n * sizeof (int));
+  b->subsets[b->count].count = n;
+  b->subsets[b->count].hash = hash;
+  return (int) b->count++;
+  }
+
+/* Split the bytes into classes, such that no set tells apart two bytes
+ * in the same class. Returns the number of classes
+ */
+static int byte_classes (const struct nfa* nfa, unsigned char* classes, int* representative) {
+  int map[512];
+  int nclasses = 1;
+  size_t s;
+  int b;
+
+  memset (classes, 0, 256);
+
+  for (s = 0; s < nfa->nsets; s++) {
+    const unsigned char* set = nfa->sets + s * SET_BYTES;
+    int n = 0;
+
+    for (b = 0; b < nclasses * 2; b++) {
+      map[b] = -1;
+      }
+
+    for (b = 0; b < 256; b++) {
+      int key = classes[b] * 2 + (SET_HAS (set, b) ? 1 : 0);
+
+      if (map[key] < 0) {
+        map[key] = n++;
+        }
+
+      classes[b] = (unsigned char) map[key];
+      }
+
+    nclasses = n;
+    }
+
+  for (b = 255; b >= 0; b--) {
+    representative[classes[b]] = b;
+    }
+
+  return nclasses;
+  }
+
+/* Make room in the transition table for every state found so far */
+static int grow_table (struct pk_dfa* dfa, const struct builder* b, size_t* cap) {
+  int* next;
+
+  if (b->count <= *cap) {
+    return PK_OK;
+    }
+
+  next = (int*) realloc (dfa->next, b->capacity * (size_t) dfa->nclasses * sizeof (int));
+
+  if (next == NULL) {
+    return PK_ERR;
+    }
+
+  dfa->next = next;
+  *cap = b->capacity;
+  return PK_OK;
+  }
+
+/* Find the earliest rule reachable from each state, and cut the
+ * transitions into states that can accept no rule at all: scans then stop
+ * as soon as no longer match is possible, instead of running on through
+ * a sink to the end of the text
+ */
+static int prune_dead (struct pk_dfa* dfa) {
+  size_t n = (size_t) dfa->nstates * (size_t) dfa->nclasses;
+  size_t i;
+  int changed = 1;
+
+  dfa->pending = (int*) malloc ( (size_t) dfa->nstates * sizeof (int));
+
+  if (dfa->pending == NULL) {
+    return PK_ERR;
+    }
+
+  memcpy (dfa->pending, dfa->accept, (size_t) dfa->nstates * sizeof (int));
+
+  /* Relax until stable: each pass takes the rules one step further back */
+  while (changed) {
+    changed = 0;
+
+    for (i = 0; i < n; i++) {
+      int from = (int) (i / (size_t) dfa->nclasses);
+      int to = dfa->next[i];
+
+      if (to >= 0 && dfa->pending[to] >= 0 && (dfa->pending[from] < 0 || dfa->pending[to] < dfa->pending[from])) {
+        dfa->pending[from] = dfa->pending[to];
+        changed = 1;
+        }
+      }
+    }
+
+  for (i = 0; i < n; i++) {
+    if (dfa->next[i] >= 0 && dfa->pending[dfa->next[i]] < 0) {
+      dfa->next[i] = -1;
+      }
+    }
+
+  return PK_OK;
+  }
+
+static struct pk_dfa* build_dfa (struct nfa* nfa, int start) {
+  struct builder b;
+  struct pk_dfa* dfa = (struct pk_dfa*) calloc (1, sizeof (*dfa));
+  int representative[256];
+  size_t cap = 0;
+  size_t i;
+  int failed = 0;
+
+  memset (&b, 0, sizeof (b));
+  b.nfa = nfa;
+  b.stack = (int*) malloc (nfa->count * sizeof (int));
+  b.scratch = (int*) malloc (nfa->count * sizeof (int));
+  b.seen = (unsigned*) calloc (nfa->count, sizeof (unsigned));
+
+  if (dfa == NULL || b.stack == NULL || b.scratch == NULL || b.seen == NULL || closure (&b, &start, 1) != 0) {
+    failed = 1;
+    }
+
+  else {
+    dfa->nclasses = byte_classes (nfa, dfa->classes, representative);
+    }
+
+  /* Work through the states in the order they were found */
+  for (i = 0; !failed && i < b.count; i++) {
+    int c;
+
+    if (grow_table (dfa, &b, &cap) != PK_OK) {
+      failed = 1;
+      break;
+      }
+
+    for (c = 0; c < dfa->nclasses; c++) {
+      int byte = representative[c];
+      size_t m;
+      size_t n = 0;
+      int target;
+
+      /* The members may move as the subsets grow, so index afresh */
+      for (m = 0; m < b.subsets[i].count; m++) {
+        const struct nfa_state* state = &nfa->states[b.subsets[i].members[m]];
+
+        if (state->kind == NFA_SET && SET_HAS (nfa->sets + state->set * SET_BYTES, byte)) {
+          b.stack[n++] = state->out1;
+          }
+        }
+
+      /* closure uses the stack from the start, so move the targets out */
+      memcpy (b.scratch, b.stack, n * sizeof (int));
+      target = n ? closure (&b, b.scratch, n) : -1;
+
+      if (target == -2) {
+        failed = 1;
+        break;
+        }
+
+      if (grow_table (dfa, &b, &cap) != PK_OK) {
+        failed = 1;
+        break;
+        }
+
+      dfa->next[i * (size_t) dfa->nclasses + (size_t) c] = target;
+      }
+    }
+
+  /* Each state accepts the earliest rule among its accepting members */
+  if (!failed) {
+    dfa->nstates = (int) b.count;
+    dfa->accept = (int*) malloc (b.count * sizeof (int));
+    failed = dfa->accept == NULL;
+    }
+
+  for (i = 0; !failed && i < b.count; i++) {
+    size_t m;
+
+    dfa->accept[i] = -1;
+
+    for (m = 0; m < b.subsets[i].count; m++) {
+      const struct nfa_state* state = &nfa->states[b.subsets[i].members[m]];
+
+      if (state->kind == NFA_ACCEPT && (dfa->accept[i] < 0 || state->set < dfa->accept[i])) {
+        dfa->accept[i] = state->set;
+        }
+      }
+    }
+
+  if (!failed) {
+    failed = prune_dead (dfa) != PK_OK;
+    }
+
+  for (i = 0; i < b.count; i++) {
+    free (b.subsets[i].members);
+    }
+
+  free (b.subsets);
+  free (b.stack);
+  free (b.scratch);
+  free (b.seen);
+
+  if (failed) {
+    pk_dfa_free (dfa);
+    return NULL;
+    }
+
+  return dfa;
+  }
+
+struct pk_dfa* pk_dfa_compile (const char* const* patterns, size_t count) {
+  struct nfa nfa;
+  struct pk_dfa* dfa = NULL;
+  int start;
+  int link;
+  size_t i;
+
+  memset (&nfa, 0, sizeof (nfa));
+  start = link = new_state (&nfa, NFA_EPSILON);
+
+  /* The start state branches to each rule in turn */
+  for (i = 0; i < count && !nfa.error; i++) {
+    struct frag f;
+    int accept;
+    int branch;
+
+    nfa.p = patterns[i];
+    f = parse_alternation (&nfa);
+    accept = new_state (&nfa, NFA_ACCEPT);
+    branch = new_state (&nfa, NFA_EPSILON);
+
+    if (nfa.error || *nfa.p != '\0') {
+      nfa.error = 1;
+      break;
+      }
+
+    nfa.states[accept].set = (int) i;
+    nfa.states[f.end].out1 = accept;
+    nfa.states[link].out1 = f.start;
+    nfa.states[link].out2 = branch;
+    link = branch;
+    }
+
+  if (!nfa.error) {
+    dfa = build_dfa (&nfa, start);
+    }
+
+  free (nfa.states);
+  free (nfa.sets);
+  return dfa;
+  }
+
+void pk_dfa_free (struct pk_dfa* dfa) {
+  if (dfa != NULL) {
+    free (dfa->next);
+    free (dfa->accept);
+    free (dfa->pending);
+    free (dfa);
+    }
+  }
+
+int pk_dfa_match (const struct pk_dfa* dfa, const char* text, size_t len, size_t* match_len, int* open) {
+  const unsigned char* p = (const unsigned char*) text;
+  int state = 0;
+  int rule = -1;
+  size_t i;
+
+  *open = -1;
+
+  for (i = 0; i < len; i++) {
+    state = dfa->next[state * dfa->nclasses + dfa->classes[p[i]]];
+
+    if (state < 0) {
+      return rule;
+      }
+
+    if (dfa->accept[state] >= 0) {
+      rule = dfa->accept[state];
+      *match_len = i + 1;
+      }
+    }
+
+  /* The text ran out part way through a match that could still grow */
+  if (len > 0 && (rule < 0 || *match_len < len)) {
+    *open = dfa->pending[state];
+    }
+
+  return rule;
+  }
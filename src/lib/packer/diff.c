@@ -0,0 +1,887 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file diff.c
+*** \brief Structural differences between two compiled documents
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_CTYPE_H
+#include <ctype.h>
+#else
+#error "can't find the C character class library"
+#endif
+
+#include "packer/diff.h"
+#include "packer/hash.h"
+#include "packer/lexer.h"
+
+/* A pair of runs of sibling nodes still to compare */
+struct diff_task {
+  size_t before_first;    /*< First node of the old run */
+  size_t before_end;      /*< Node after the old run */
+  size_t after_first;     /*< First node of the new run */
+  size_t after_end;       /*< Node after the new run */
+  size_t parent;          /*< OPEN node enclosing the new run */
+  };
+
+/* State of a comparison. Pending runs are kept on a stack, not by
+ * recursion, as tags may nest without limit
+ */
+struct diff_state {
+  const struct pk_doc* before;
+  const struct pk_doc* after;
+  const uint64_t*      before_hashes;
+  const uint64_t*      after_hashes;
+  struct pk_diff*      diff;
+  struct diff_task*    tasks;
+  size_t               ntasks;
+  size_t               task_capacity;
+  };
+
+/* Most pairs of leftover siblings of one kind, within one gap, that are
+ * weighed against each other; larger groups are paired in order
+ */
+#define DIFF_SIMILAR_PAIRS  4096
+
+/* Bytes of plain text kept from each end of a leftover sibling */
+#define DIFF_PROFILE_TEXT   64
+
+/* What a leftover sibling is compared on: the plain text at either end
+ * of it, and the sorted subtree hashes of its children
+ */
+struct diff_profile {
+  char      head[DIFF_PROFILE_TEXT];  /*< First bytes of its text */
+  size_t    head_len;                 /*< Bytes in head */
+  char      tail[DIFF_PROFILE_TEXT];  /*< Last bytes of its text */
+  size_t    tail_len;                 /*< Bytes in tail */
+  uint64_t* children;                 /*< Hashes of its children, sorted */
+  size_t    nchildren;                /*< Number of children */
+  };
+
+/* A possible pairing of two leftover siblings */
+struct diff_pair {
+  size_t score;   /*< How much the two have in common */
+  size_t skew;    /*< How far apart their places in the group are */
+  size_t before;  /*< Old sibling, as an index into the group */
+  size_t after;   /*< New sibling, as an index into the group */
+  };
+
+/* One sibling of either run, as sorted to group the runs by key */
+struct diff_entry {
+  uint64_t key;           /*< Subtree hash, or kind of node */
+  size_t   gap;           /*< Number of kept anchors before the sibling */
+  size_t   pos;           /*< Position in its run */
+  int      side;          /*< 0 for the old run, 1 for the new */
+  };
+
+/* Fold a 64-bit value into a hash */
+static uint64_t mix (uint64_t hash, uint64_t value) {
+  unsigned char bytes[8];
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    bytes[i] = (unsigned char) ( (value >> (8 * i)) & 0xFF);
+    }
+
+  return pk_hash_continue (hash, bytes, sizeof (bytes));
+  }
+
+/* Fold one of the strings of a node into a hash */
+static uint64_t mix_string (uint64_t hash, const struct pk_doc* doc, uint32_t id) {
+  struct pk_span span = pk_intern_get (doc->strings, id);
+
+  return mix (pk_hash_continue (hash, span.data, span.len), span.len);
+  }
+
+/* Hash the content of one node, leaving out its line */
+static uint64_t own_hash (const struct pk_doc* doc, const struct pk_doc_node* node) {
+  uint64_t hash = mix (pk_hash_seed (), (uint64_t) node->type | (uint64_t) node->tag << 8 | (uint64_t) node->flags << 16);
+
+  hash = mix_string (hash, doc, node->text);
+  hash = mix_string (hash, doc, node->label);
+  return mix_string (hash, doc, node->args);
+  }
+
+int pk_diff_hash (const struct pk_doc* doc, uint64_t* hashes) {
+  size_t* open = NULL;
+  size_t depth = 0;
+  size_t capacity = 0;
+  size_t i;
+
+  for (i = 0; i < doc->count; i++) {
+    const struct pk_doc_node* node = &doc->nodes[i];
+    uint64_t hash = own_hash (doc, node);
+
+    hashes[i] = hash;
+
+    /* An open tag gathers the hashes of its children until it closes */
+    if (node->type == PK_TOKEN_OPEN && node->close > i) {
+      if (depth == capacity) {
+        size_t size = capacity ? capacity * 2 : 64;
+        size_t* stack = (size_t*) realloc (open, size * sizeof (*stack));
+
+        if (stack == NULL) {
+          free (open);
+          return PK_ERR;
+          }
+
+        open = stack;
+        capacity = size;
+        }
+
+      open[depth++] = i;
+      continue;
+      }
+
+    if (depth > 0 && doc->nodes[open[depth - 1]].close == i) {
+      size_t top = open[--depth];
+
+      hashes[top] = mix (hashes[top], hash);
+      hash = hashes[top];
+      }
+
+    if (depth > 0) {
+      hashes[open[depth - 1]] = mix (hashes[open[depth - 1]], hash);
+      }
+    }
+
+  free (open);
+  return PK_OK;
+  }
+
+void pk_diff_clear (struct pk_diff* diff) {
+  free (diff->changes);
+  memset (diff, 0, sizeof (*diff));
+  }
+
+/* Record a change */
+static int add_change (struct pk_diff* diff, enum pk_diff_kind kind, size_t before, size_t after, size_t parent,
+                       size_t where) {
+  struct pk_diff_change* change;
+
+  if (diff->count == diff->capacity) {
+    size_t capacity = diff->capacity ? diff->capacity * 2 : 32;
+    struct pk_diff_change* changes = (struct pk_diff_change*) realloc (diff->changes, capacity * sizeof (*changes));
+
+    if (changes == NULL) {
+      return PK_ERR;
+      }
+
+    diff->changes = changes;
+    diff->capacity = capacity;
+    }
+
+  change = &diff->changes[diff->count];
+  change->kind = kind;
+  change->before = before;
+  change->after = after;
+  change->parent = parent;
+  change->where = where;
+  change->sequence = diff->count++;
+  return PK_OK;
+  }
+
+/* Queue the children of two tags for comparison */
+static int add_task (struct diff_state* state, size_t before, size_t after) {
+  struct diff_task* task;
+
+  if (state->ntasks == state->task_capacity) {
+    size_t capacity = state->task_capacity ? state->task_capacity * 2 : 16;
+    struct diff_task* tasks = (struct diff_task*) realloc (state->tasks, capacity * sizeof (*tasks));
+
+    if (tasks == NULL) {
+      return PK_ERR;
+      }
+
+    state->tasks = tasks;
+    state->task_capacity = capacity;
+    }
+
+  task = &state->tasks[state->ntasks++];
+  task->before_first = before + 1;
+  task->before_end = state->before->nodes[before].close;
+  task->after_first = after + 1;
+  task->after_end = state->after->nodes[after].close;
+  task->parent = after;
+  return PK_OK;
+  }
+
+/* Does node i open a tag whose children lie before end? */
+static int has_children (const struct pk_doc* doc, size_t i, size_t end) {
+  return doc->nodes[i].type == PK_TOKEN_OPEN && doc->nodes[i].close > i && doc->nodes[i].close < end;
+  }
+
+/* List the siblings from first to end, stepping over their children */
+static size_t* siblings (const struct pk_doc* doc, size_t first, size_t end, size_t* count) {
+  size_t* items = (size_t*) malloc ( (end - first) * sizeof (*items) + 1);
+  size_t i = first;
+
+  *count = 0;
+
+  while (items != NULL && i < end) {
+    items[ (*count)++] = i;
+    i = has_children (doc, i, end) ? doc->nodes[i].close + 1 : i + 1;
+    }
+
+  return items;
+  }
+
+/* Order entries by key, then gap, then side, then position */
+static int compare_entries (const void* x, const void* y) {
+  const struct diff_entry* a = (const struct diff_entry*) x;
+  const struct diff_entry* b = (const struct diff_entry*) y;
+
+  if (a->key != b->key) {
+    return a->key < b->key ? -1 : 1;
+    }
+
+  if (a->gap != b->gap) {
+    return a->gap < b->gap ? -1 : 1;
+    }
+
+  if (a->side != b->side) {
+    return a->side - b->side;
+    }
+
+  return a->pos < b->pos ? -1 : a->pos > b->pos;
+  }
+
+/* Is node i text of nothing but white space? Such nodes (the line breaks
+ * between tags) are all alike, so say nothing about where a tag went
+ */
+static int blank_node (const struct pk_doc* doc, size_t i) {
+  struct pk_span text;
+  size_t c;
+
+  if (doc->nodes[i].type != PK_TOKEN_TEXT) {
+    return 0;
+    }
+
+  text = pk_intern_get (doc->strings, doc->nodes[i].text);
+
+  for (c = 0; c < text.len; c++) {
+    if (!isspace ( (unsigned char) text.data[c])) {
+      return 0;
+      }
+    }
+
+  return 1;
+  }
+
+/* Pair the old and new entries of each group of equal keys, taking them
+ * in order. With by_gap set, entries pair only within the same gap between
+ * kept anchors. Pairs are recorded in match and taken, and flagged in same
+ * (if not NULL); entries already paired are passed over
+ */
+static void pair_groups (const struct diff_entry* entries, size_t count, int by_gap, size_t* match, size_t* taken,
+                         int* same, size_t* olds) {
+  size_t first = 0;
+
+  while (first < count) {
+    size_t end = first;
+    size_t nold = 0;
+    size_t used = 0;
+    size_t e;
+
+    while (end < count && entries[end].key == entries[first].key &&
+           (!by_gap || entries[end].gap == entries[first].gap)) {
+      end++;
+      }
+
+    /* The old entries sort first, so collect them, then deal them out */
+    for (e = first; e < end; e++) {
+      const struct diff_entry* entry = &entries[e];
+
+      if (entry->side == 0 && taken[entry->pos] == PK_DIFF_NONE) {
+        olds[nold++] = entry->pos;
+        }
+
+      else if (entry->side == 1 && match[entry->pos] == PK_DIFF_NONE && used < nold) {
+        match[entry->pos] = olds[used];
+        taken[olds[used++]] = entry->pos;
+
+        if (same != NULL) {
+          same[entry->pos] = 1;
+          }
+        }
+      }
+
+    first = end;
+    }
+  }
+
+/* Mark the longest run of matches whose old positions rise in step with
+ * their new ones. The rest have moved
+ */
+static int mark_in_order (const size_t* match, const int* same, size_t count, int* kept) {
+  size_t* tails = (size_t*) malloc (count * sizeof (*tails) + 1);
+  size_t* previous = (size_t*) malloc (count * sizeof (*previous) + 1);
+  size_t length = 0;
+  size_t j;
+
+  if (tails == NULL || previous == NULL) {
+    free (tails);
+    free (previous);
+    return PK_ERR;
+    }
+
+  for (j = 0; j < count; j++) {
+    size_t low = 0;
+    size_t high = length;
+
+    kept[j] = 0;
+
+    if (!same[j]) {
+      continue;
+      }
+
+    while (low < high) {
+      size_t middle = low + (high - low) / 2;
+
+      if (match[tails[middle]] < match[j]) {
+        low = middle + 1;
+        }
+
+      else {
+        high = middle;
+        }
+      }
+
+    previous[j] = low > 0 ? tails[low - 1] : PK_DIFF_NONE;
+    tails[low] = j;
+    length += low == length;
+    }
+
+  for (j = length ? tails[length - 1] : PK_DIFF_NONE; j != PK_DIFF_NONE; j = previous[j]) {
+    kept[j] = 1;
+    }
+
+  free (tails);
+  free (previous);
+  return PK_OK;
+  }
+
+/* The kind of a node: changed nodes are paired only with their own kind */
+static uint64_t node_kind (const struct pk_doc* doc, size_t i) {
+  return mix (pk_hash_seed (), (uint64_t) doc->nodes[i].type | (uint64_t) doc->nodes[i].tag << 8);
+  }
+
+/* Order hashes */
+static int compare_hashes (const void* x, const void* y) {
+  uint64_t a = * (const uint64_t*) x;
+  uint64_t b = * (const uint64_t*) y;
+
+  return a < b ? -1 : a > b;
+  }
+
+/* Add text to the ends kept by a profile */
+static void profile_text (struct diff_profile* profile, struct pk_span text) {
+  size_t keep = text.len < DIFF_PROFILE_TEXT ? text.len : DIFF_PROFILE_TEXT;
+  size_t room = DIFF_PROFILE_TEXT - profile->head_len;
+
+  memcpy (profile->head + profile->head_len, text.data, text.len < room ? text.len : room);
+  profile->head_len += text.len < room ? text.len : room;
+
+  /* The tail slides along, keeping the last bytes seen */
+  if (profile->tail_len + keep > DIFF_PROFILE_TEXT) {
+    size_t drop = profile->tail_len + keep - DIFF_PROFILE_TEXT;
+
+    memmove (profile->tail, profile->tail + drop, profile->tail_len - drop);
+    profile->tail_len -= drop;
+    }
+
+  memcpy (profile->tail + profile->tail_len, text.data + text.len - keep, keep);
+  profile->tail_len += keep;
+  }
+
+/* Profile node i, whose subtree ends before end. A tag without children
+ * is known by its arguments
+ */
+static int make_profile (const struct pk_doc* doc, const uint64_t* hashes, size_t i, size_t end,
+                         struct diff_profile* profile) {
+  const struct pk_doc_node* node = &doc->nodes[i];
+  size_t* items;
+  size_t close;
+  size_t j;
+
+  memset (profile, 0, sizeof (*profile));
+
+  if (!has_children (doc, i, end)) {
+    profile_text (profile, pk_intern_get (doc->strings, node->type == PK_TOKEN_TEXT ? node->text : node->args));
+    return PK_OK;
+    }
+
+  close = node->close;
+
+  for (j = i + 1; j < close; j++) {
+    if (doc->nodes[j].type == PK_TOKEN_TEXT) {
+      profile_text (profile, pk_intern_get (doc->strings, doc->nodes[j].text));
+      }
+    }
+
+  items = siblings (doc, i + 1, close, &profile->nchildren);
+  profile->children = (uint64_t*) malloc (profile->nchildren * sizeof (*profile->children) + 1);
+
+  if (items == NULL || profile->children == NULL) {
+    free (items);
+    return PK_ERR;
+    }
+
+  for (j = 0; j < profile->nchildren; j++) {
+    profile->children[j] = hashes[items[j]];
+    }
+
+  qsort (profile->children, profile->nchildren, sizeof (*profile->children), compare_hashes);
+  free (items);
+  return PK_OK;
+  }
+
+/* How much two profiles have in common: the bytes their text shares at
+ * either end, and (counting for more) the children they share
+ */
+static size_t similarity (const struct diff_profile* a, const struct diff_profile* b) {
+  size_t score = 0;
+  size_t x = 0;
+  size_t y = 0;
+
+  while (score < a->head_len && score < b->head_len && a->head[score] == b->head[score]) {
+    score++;
+    }
+
+  while (x < a->tail_len && x < b->tail_len && a->tail[a->tail_len - 1 - x] == b->tail[b->tail_len - 1 - x]) {
+    x++;
+    }
+
+  score += x;
+
+  for (x = 0; x < a->nchildren && y < b->nchildren;) {
+    if (a->children[x] == b->children[y]) {
+      score += DIFF_PROFILE_TEXT;
+      x++;
+      y++;
+      }
+
+    else if (a->children[x] < b->children[y]) {
+      x++;
+      }
+
+    else {
+      y++;
+      }
+    }
+
+  return score;
+  }
+
+/* Order pairs best first: the most in common, then the least out of
+ * place, then through the new run
+ */
+static int compare_pairs (const void* x, const void* y) {
+  const struct diff_pair* a = (const struct diff_pair*) x;
+  const struct diff_pair* b = (const struct diff_pair*) y;
+
+  if (a->score != b->score) {
+    return a->score > b->score ? -1 : 1;
+    }
+
+  if (a->skew != b->skew) {
+    return a->skew < b->skew ? -1 : 1;
+    }
+
+  return a->after < b->after ? -1 : a->after > b->after;
+  }
+
+/* Pair the old and new siblings of one group of leftovers (the same kind,
+ * within the same gap) that have most in common, best pairs first
+ */
+static int pair_similar_group (struct diff_state* state, const size_t* a, const size_t* b, const size_t* olds,
+                               size_t nold, const size_t* news, size_t nnew, size_t before_end, size_t after_end,
+                               size_t* match, size_t* taken) {
+  struct diff_profile* profiles = (struct diff_profile*) calloc (nold + nnew, sizeof (*profiles));
+  struct diff_pair* pairs = (struct diff_pair*) malloc (nold * nnew * sizeof (*pairs) + 1);
+  size_t npairs = 0;
+  size_t i;
+  size_t j;
+  int status = profiles && pairs ? PK_OK : PK_ERR;
+
+  for (i = 0; status == PK_OK && i < nold; i++) {
+    status = make_profile (state->before, state->before_hashes, a[olds[i]], before_end, &profiles[i]);
+    }
+
+  for (j = 0; status == PK_OK && j < nnew; j++) {
+    status = make_profile (state->after, state->after_hashes, b[news[j]], after_end, &profiles[nold + j]);
+    }
+
+  for (i = 0; status == PK_OK && i < nold; i++) {
+    for (j = 0; j < nnew; j++) {
+      struct diff_pair* pair = &pairs[npairs];
+
+      pair->score = similarity (&profiles[i], &profiles[nold + j]);
+      pair->skew = i * nnew > j * nold ? i * nnew - j * nold : j * nold - i * nnew;
+      pair->before = i;
+      pair->after = j;
+      npairs += pair->score > 0;
+      }
+    }
+
+  if (status == PK_OK) {
+    qsort (pairs, npairs, sizeof (*pairs), compare_pairs);
+
+    for (i = 0; i < npairs; i++) {
+      size_t before = olds[pairs[i].before];
+      size_t after = news[pairs[i].after];
+
+      if (taken[before] == PK_DIFF_NONE && match[after] == PK_DIFF_NONE) {
+        match[after] = before;
+        taken[before] = after;
+        }
+      }
+    }
+
+  for (i = 0; profiles != NULL && i < nold + nnew; i++) {
+    free (profiles[i].children);
+    }
+
+  free (profiles);
+  free (pairs);
+  return status;
+  }
+
+/* Pair the leftovers of each group of entries (sorted by kind and gap) by
+ * what they have in common. Those sharing nothing, and groups too large
+ * to weigh every pair, are left to be paired in order
+ */
+static int pair_similar (struct diff_state* state, const struct diff_task* task, const struct diff_entry* entries,
+                         size_t count, const size_t* a, size_t m, const size_t* b, size_t n, size_t* match,
+                         size_t* taken) {
+  size_t* olds = (size_t*) malloc (m * sizeof (*olds) + 1);
+  size_t* news = (size_t*) malloc (n * sizeof (*news) + 1);
+  size_t first = 0;
+  int status = olds && news ? PK_OK : PK_ERR;
+
+  while (status == PK_OK && first < count) {
+    size_t end = first;
+    size_t nold = 0;
+    size_t nnew = 0;
+    size_t e;
+
+    while (end < count && entries[end].key == entries[first].key && entries[end].gap == entries[first].gap) {
+      end++;
+      }
+
+    for (e = first; e < end; e++) {
+      if (entries[e].side == 0 && taken[entries[e].pos] == PK_DIFF_NONE) {
+        olds[nold++] = entries[e].pos;
+        }
+
+      else if (entries[e].side == 1 && match[entries[e].pos] == PK_DIFF_NONE) {
+        news[nnew++] = entries[e].pos;
+        }
+      }
+
+    if (nold > 0 && nnew > 0 && nold * nnew <= DIFF_SIMILAR_PAIRS) {
+      status = pair_similar_group (state, a, b, olds, nold, news, nnew, task->before_end, task->after_end, match,
+                                   taken);
+      }
+
+    first = end;
+    }
+
+  free (olds);
+  free (news);
+  return status;
+  }
+
+/* Sort the entries of both runs, the m old then the new, by the given
+ * keys and gaps. These are indexed as the entries: old first, then new
+ */
+static void sort_entries (struct diff_entry* entries, const uint64_t* keys, const size_t* gaps, size_t m,
+                          size_t count) {
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    size_t index = entries[i].side ? m + entries[i].pos : entries[i].pos;
+
+    entries[i].key = keys[index];
+    entries[i].gap = gaps[index];
+    }
+
+  qsort (entries, count, sizeof (*entries), compare_entries);
+  }
+
+/* Compare the unmatched middles of two runs of siblings, a (of m nodes)
+ * and b (of n).
+ *
+ * Siblings whose subtree is found exactly once on each side anchor the
+ * comparison: the longest run of anchors kept in order stays put, and the
+ * other anchors have moved. Repeated subtrees (most often the blank text
+ * between tags) would pair up arbitrarily, so they take no part in the
+ * run: they are paired within the same gap between kept anchors, and only
+ * reported as moved if they had to cross one. Blank text never is. What
+ * is left is paired by kind, again only within the same gap, so edits are
+ * matched with the node they replaced
+ */
+static int compare_middle (struct diff_state* state, const struct diff_task* task, const size_t* a, size_t m,
+                           const size_t* b, size_t n) {
+  struct diff_entry* entries = (struct diff_entry*) malloc ( (m + n) * sizeof (*entries) + 1);
+  uint64_t* keys = (uint64_t*) malloc ( (m + n) * sizeof (*keys) + 1);
+  size_t* gaps = (size_t*) calloc (m + n + 1, sizeof (*gaps));
+  size_t* match = (size_t*) malloc (n * sizeof (*match) + 1);
+  size_t* taken = (size_t*) malloc (m * sizeof (*taken) + 1);
+  size_t* olds = (size_t*) malloc (m * sizeof (*olds) + 1);
+  int* same = (int*) calloc (n + 1, sizeof (*same));
+  int* kept = (int*) malloc (n * sizeof (*kept) + 1);
+  size_t where = task->after_end;
+  size_t first;
+  size_t gap;
+  size_t j;
+  size_t k;
+  int status = entries && keys && gaps && match && taken && olds && same && kept ? PK_OK : PK_ERR;
+
+  /* Entries 0..m-1 are the old run, m..m+n-1 the new */
+  for (k = 0; status == PK_OK && k < m + n; k++) {
+    entries[k].side = k >= m;
+    entries[k].pos = k < m ? k : k - m;
+    keys[k] = k < m ? state->before_hashes[a[k]] : state->after_hashes[b[k - m]];
+    }
+
+  for (k = 0; status == PK_OK && k < m; k++) {
+    taken[k] = PK_DIFF_NONE;
+    }
+
+  for (j = 0; status == PK_OK && j < n; j++) {
+    match[j] = PK_DIFF_NONE;
+    }
+
+  /* Anchors: subtrees found once in each run */
+  if (status == PK_OK) {
+    sort_entries (entries, keys, gaps, m, m + n);
+
+    for (first = 0; first < m + n; first = k) {
+      for (k = first + 1; k < m + n && entries[k].key == entries[first].key; k++) {
+        }
+
+      if (k - first == 2 && entries[first].side == 0 && entries[first + 1].side == 1) {
+        match[entries[first + 1].pos] = entries[first].pos;
+        taken[entries[first].pos] = entries[first + 1].pos;
+        same[entries[first + 1].pos] = 2;
+        }
+      }
+
+    status = mark_in_order (match, same, n, kept);
+    }
+
+  if (status == PK_OK) {
+    /* Number the gaps between the kept anchors on both sides */
+    for (gap = 0, j = 0; j < n; j++) {
+      gap += kept[j];
+      gaps[m + j] = gap;
+      }
+
+    for (gap = 0, k = 0; k < m; k++) {
+      gap += taken[k] != PK_DIFF_NONE && kept[taken[k]];
+      gaps[k] = gap;
+      }
+
+    /* Repeated subtrees paired within their gap stay put (the anchors
+     * are marked 2, so they can be told apart)
+     */
+    sort_entries (entries, keys, gaps, m, m + n);
+    pair_groups (entries, m + n, 1, match, taken, same, olds);
+
+    for (j = 0; j < n; j++) {
+      kept[j] = kept[j] || same[j] == 1;
+      }
+
+    /* The rest have crossed an anchor, so have moved */
+    pair_groups (entries, m + n, 0, match, taken, same, olds);
+
+    /* Pair what is left by kind within each gap: those most alike first,
+     * then the rest in order
+     */
+    for (k = 0; k < m + n; k++) {
+      keys[k] = k < m ? node_kind (state->before, a[k]) : node_kind (state->after, b[k - m]);
+      }
+
+    sort_entries (entries, keys, gaps, m, m + n);
+    status = pair_similar (state, task, entries, m + n, a, m, b, n, match, taken);
+    }
+
+  if (status == PK_OK) {
+    pair_groups (entries, m + n, 1, match, taken, NULL, olds);
+    }
+
+  for (j = 0; status == PK_OK && j < n; j++) {
+    size_t before = match[j];
+
+    if (before == PK_DIFF_NONE) {
+      status = add_change (state->diff, PK_DIFF_INSERTED, PK_DIFF_NONE, b[j], task->parent, b[j]);
+      }
+
+    else if (same[j]) {
+      if (!kept[j] && !blank_node (state->after, b[j])) {
+        status = add_change (state->diff, PK_DIFF_MOVED, a[before], b[j], task->parent, b[j]);
+        }
+      }
+
+    else {
+      int children = has_children (state->before, a[before], task->before_end) &&
+                     has_children (state->after, b[j], task->after_end);
+
+      if (!children || own_hash (state->before, &state->before->nodes[a[before]]) !=
+          own_hash (state->after, &state->after->nodes[b[j]])) {
+        status = add_change (state->diff, PK_DIFF_CHANGED, a[before], b[j], task->parent, b[j]);
+        }
+
+      if (status == PK_OK && children) {
+        status = add_task (state, a[before], b[j]);
+        }
+      }
+    }
+
+  /* A deletion is placed before whatever followed it in the old run,
+   * found from the end, but the deletions are recorded in order
+   */
+  for (k = m; status == PK_OK && k-- > 0;) {
+    where = taken[k] == PK_DIFF_NONE ? where : b[taken[k]];
+    olds[k] = where;
+    }
+
+  for (k = 0; status == PK_OK && k < m; k++) {
+    if (taken[k] == PK_DIFF_NONE) {
+      status = add_change (state->diff, PK_DIFF_DELETED, a[k], PK_DIFF_NONE, task->parent, olds[k]);
+      }
+    }
+
+  free (entries);
+  free (keys);
+  free (gaps);
+  free (match);
+  free (taken);
+  free (olds);
+  free (same);
+  free (kept);
+  return status;
+  }
+
+/* Compare two runs of siblings */
+static int run_task (struct diff_state* state, const struct diff_task* task) {
+  size_t m;
+  size_t n;
+  size_t* a = siblings (state->before, task->before_first, task->before_end, &m);
+  size_t* b = siblings (state->after, task->after_first, task->after_end, &n);
+  size_t start = 0;
+  size_t tail = 0;
+  int status = a && b ? PK_OK : PK_ERR;
+
+  /* Identical siblings at either end cost one comparison each */
+  while (start < m && start < n && state->before_hashes[a[start]] == state->after_hashes[b[start]]) {
+    start++;
+    }
+
+  while (tail < m - start && tail < n - start &&
+         state->before_hashes[a[m - 1 - tail]] == state->after_hashes[b[n - 1 - tail]]) {
+    tail++;
+    }
+
+  if (status == PK_OK && (start < m - tail || start < n - tail)) {
+    status = compare_middle (state, task, a + start, m - start - tail, b + start, n - start - tail);
+    }
+
+  free (a);
+  free (b);
+  return status;
+  }
+
+/* Order changes through the new version, then as they were found */
+static int compare_changes (const void* x, const void* y) {
+  const struct pk_diff_change* a = (const struct pk_diff_change*) x;
+  const struct pk_diff_change* b = (const struct pk_diff_change*) y;
+
+  if (a->where != b->where) {
+    return a->where < b->where ? -1 : 1;
+    }
+
+  return a->sequence < b->sequence ? -1 : a->sequence > b->sequence;
+  }
+
+int pk_diff_docs (struct pk_diff* diff, const struct pk_doc* before, const struct pk_doc* after) {
+  struct diff_state state;
+  uint64_t* before_hashes = (uint64_t*) malloc (before->count * sizeof (*before_hashes) + 1);
+  uint64_t* after_hashes = (uint64_t*) malloc (after->count * sizeof (*after_hashes) + 1);
+  int status = before_hashes && after_hashes ? PK_OK : PK_ERR;
+
+  memset (diff, 0, sizeof (*diff));
+  memset (&state, 0, sizeof (state));
+  state.before = before;
+  state.after = after;
+  state.before_hashes = before_hashes;
+  state.after_hashes = after_hashes;
+  state.diff = diff;
+
+  if (status == PK_OK && (pk_diff_hash (before, before_hashes) != PK_OK || pk_diff_hash (after, after_hashes) != PK_OK)) {
+    status = PK_ERR;
+    }
+
+  /* The whole document is one run of siblings */
+  if (status == PK_OK) {
+    struct diff_task root;
+
+    root.before_first = 0;
+    root.before_end = before->count;
+    root.after_first = 0;
+    root.after_end = after->count;
+    root.parent = PK_DIFF_NONE;
+    status = run_task (&state, &root);
+    }
+
+  while (status == PK_OK && state.ntasks > 0) {
+    struct diff_task task = state.tasks[--state.ntasks];
+
+    status = run_task (&state, &task);
+    }
+
+  if (status == PK_OK && diff->count > 1) {
+    qsort (diff->changes, diff->count, sizeof (*diff->changes), compare_changes);
+    }
+
+  if (status != PK_OK) {
+    pk_diff_clear (diff);
+    }
+
+  free (state.tasks);
+  free (before_hashes);
+  free (after_hashes);
+  return status;
+  }
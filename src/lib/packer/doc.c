@@ -0,0 +1,838 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file doc.c
+*** \brief Compiled Bayeux documents, and the .pdoc files that hold them
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#else
+#error "can't find the C standard I/O library"
+#endif
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/byteorder.h"
+#include "packer/doc.h"
+#include "packer/io.h"
+#include "packer/latency.h"
+#include "packer/lz.h"
+#include "packer/tags.h"
+
+/* Identifies a compiled document */
+#define DOC_MAGIC "PKPDOC02"
+
+/* Size of the header, of each entry in the section index, and of each
+ * node, in bytes
+ */
+#define DOC_HEADER_SIZE 32
+#define DOC_ENTRY_SIZE 32
+#define DOC_NODE_SIZE 24
+
+/* How a section block is stored */
+#define DOC_STORED 0
+#define DOC_LZ 1
+
+/* Long runs without a heading are cut at the next top level node after
+ * this many, so no section grows too large to read on its own
+ */
+#define DOC_SECTION_NODES 8192
+
+/* Read and write little endian integers */
+static uint32_t get32 (const unsigned char* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+  }
+
+static void put16 (unsigned char* p, uint32_t value) {
+  p[0] = (unsigned char) (value & 0xFF);
+  p[1] = (unsigned char) ( (value >> 8) & 0xFF);
+  }
+
+static void put32 (unsigned char* p, uint32_t value) {
+  p[0] = (unsigned char) (value & 0xFF);
+  p[1] = (unsigned char) ( (value >> 8) & 0xFF);
+  p[2] = (unsigned char) ( (value >> 16) & 0xFF);
+  p[3] = (unsigned char) ( (value >> 24) & 0xFF);
+  }
+
+int pk_doc_init (struct pk_doc* doc, struct pk_intern* strings) {
+  memset (doc, 0, sizeof (*doc));
+
+  if (strings == NULL) {
+    strings = (struct pk_intern*) malloc (sizeof (*strings));
+
+    if (strings == NULL || pk_intern_init (strings) != PK_OK) {
+      free (strings);
+      return PK_ERR;
+      }
+
+    doc->owned = 1;
+    }
+
+  doc->strings = strings;
+  return PK_OK;
+  }
+
+void pk_doc_clear (struct pk_doc* doc) {
+  if (doc->owned) {
+    pk_intern_clear (doc->strings);
+    free (doc->strings);
+    }
+
+  free (doc->nodes);
+  free (doc->open);
+  memset (doc, 0, sizeof (*doc));
+  }
+
+void pk_doc_reset (struct pk_doc* doc) {
+  if (doc->owned) {
+    pk_intern_reset (doc->strings);
+    }
+
+  doc->count = 0;
+  doc->depth = 0;
+  doc->limited = 0;
+  }
+
+/* Make room for count more nodes */
+static int reserve_nodes (struct pk_doc* doc, size_t count) {
+  size_t capacity = doc->capacity ? doc->capacity : 256;
+  struct pk_doc_node* nodes;
+
+  if (doc->count + count <= doc->capacity) {
+    return PK_OK;
+    }
+
+  while (capacity < doc->count + count) {
+    capacity *= 2;
+    }
+
+  nodes = (struct pk_doc_node*) realloc (doc->nodes, capacity * sizeof (*nodes));
+
+  if (nodes == NULL) {
+    return PK_ERR;
+    }
+
+  doc->nodes = nodes;
+  doc->capacity = capacity;
+  return PK_OK;
+  }
+
+int pk_doc_add (struct pk_doc* doc, const struct pk_token* token) {
+  struct pk_doc_node* node;
+
+  if (doc->count >= PK_INTERN_NONE || reserve_nodes (doc, 1) != PK_OK) {
+    return PK_ERR;
+    }
+
+  node = &doc->nodes[doc->count];
+  memset (node, 0, sizeof (*node));
+  node->type = (uint8_t) token->type;
+  node->tag = (uint8_t) token->tag;
+  node->flags = (uint16_t) token->flags;
+  node->line = (uint32_t) token->line;
+
+  switch (token->type) {
+    case PK_TOKEN_TEXT:
+      node->text = pk_intern_span (doc->strings, token->text.data, token->text.len);
+      break;
+
+    case PK_TOKEN_OPEN:
+      node->text = pk_intern_span (doc->strings, token->name.data, token->name.len);
+      node->label = pk_intern_span (doc->strings, token->label.data, token->label.len);
+      node->args = pk_intern_span (doc->strings, token->args.data, token->args.len);
+
+      if (doc->depth == doc->open_capacity) {
+        size_t capacity = doc->open_capacity ? doc->open_capacity * 2 : 16;
+        uint32_t* open = (uint32_t*) realloc (doc->open, capacity * sizeof (*open));
+
+        if (open == NULL) {
+          return PK_ERR;
+          }
+
+        doc->open = open;
+        doc->open_capacity = capacity;
+        }
+
+      doc->open[doc->depth++] = (uint32_t) doc->count;
+      break;
+
+    case PK_TOKEN_CLOSE:
+    case PK_TOKEN_END:
+      if (doc->depth > 0) {
+        doc->nodes[doc->open[--doc->depth]].close = (uint32_t) doc->count;
+        }
+
+      break;
+
+    default:
+      return PK_ERR;
+    }
+
+  if (node->text == PK_INTERN_NONE || node->label == PK_INTERN_NONE || node->args == PK_INTERN_NONE) {
+    return PK_ERR;
+    }
+
+  doc->count++;
+  return PK_OK;
+  }
+
+/* The cost a token is charged to: the tag it opens, or else the innermost
+ * open tag (which a closing token ends), or else the document itself
+ */
+static struct pk_tag_cost* token_cost (const struct pk_doc* doc, const struct pk_token* token) {
+  int tag = token->type == PK_TOKEN_OPEN ? token->tag :
+            doc->depth > 0 ? doc->nodes[doc->open[doc->depth - 1]].tag : PK_TAG_COUNT;
+
+  return &doc->costs->tags[tag >= 0 && tag < PK_TAG_COUNT ? tag : PK_TAG_COUNT];
+  }
+
+int pk_doc_compile (struct pk_doc* doc, const char* buf, size_t len) {
+  struct pk_lexer lexer;
+  struct pk_token token;
+  int type;
+  int status = PK_OK;
+
+  pk_lexer_init (&lexer, buf, len);
+  pk_lexer_limit (&lexer, doc->limits);
+
+  /* A token is charged for lexing it as well as adding it */
+  while (status == PK_OK) {
+    uint64_t start = doc->costs ? pk_clock_ns () : 0;
+    struct pk_tag_cost* cost;
+
+    type = pk_lexer_next (&lexer, &token);
+
+    if (type == PK_TOKEN_EOF || type == PK_ERR) {
+      status = type == PK_ERR ? PK_ERR : PK_OK;
+      break;
+      }
+
+    cost = doc->costs ? token_cost (doc, &token) : NULL;
+    status = pk_doc_add (doc, &token);
+
+    if (cost != NULL) {
+      cost->count += token.type == PK_TOKEN_OPEN;
+      cost->calls++;
+      cost->ns += pk_clock_ns () - start;
+      cost->bytes += token.text.len;
+      }
+    }
+
+  doc->limited |= lexer.limited;
+
+  if (lexer.limited & (PK_LIMIT_TOKENS | PK_LIMIT_CANCEL)) {
+    status = PK_ERR;
+    }
+
+  pk_lexer_clear (&lexer);
+  return status;
+  }
+
+void pk_doc_token (const struct pk_doc* doc, size_t index, struct pk_token* token) {
+  const struct pk_doc_node* node = &doc->nodes[index];
+
+  memset (token, 0, sizeof (*token));
+  token->type = (enum pk_token_type) node->type;
+  token->tag = node->tag;
+  token->flags = node->flags;
+  token->line = (int) node->line;
+  token->text = pk_intern_get (doc->strings, node->text);
+
+  /* The raw source of a tag is not kept: its name stands in for it */
+  if (node->type == PK_TOKEN_OPEN) {
+    token->name = token->text;
+    token->label = pk_intern_get (doc->strings, node->label);
+    token->args = pk_intern_get (doc->strings, node->args);
+    }
+  }
+
+/**
+*** Writing
+**/
+
+/* Find the end of the section starting at node first: the next heading at
+ * the top level of the document. Whole tags are stepped over, so every
+ * section holds complete subtrees
+ */
+static size_t section_end (const struct pk_doc* doc, size_t first) {
+  size_t i = first;
+
+  while (i < doc->count) {
+    const struct pk_doc_node* node = &doc->nodes[i];
+
+    if (i > first && ( (node->type == PK_TOKEN_OPEN && (pk_tag_flags (node->tag) & PK_TAG_HEADING)) ||
+                       i - first >= DOC_SECTION_NODES)) {
+      break;
+      }
+
+    i = node->type == PK_TOKEN_OPEN && node->close > i ? node->close + 1 : i + 1;
+    }
+
+  return i;
+  }
+
+/* Give a string of the section an identifier in its block, in order of first use */
+static uint32_t local_id (uint32_t* local, uint32_t* order, uint32_t* count, uint32_t id) {
+  if (local[id] == PK_INTERN_NONE) {
+    local[id] = *count;
+    order[ (*count)++] = id;
+    }
+
+  return local[id];
+  }
+
+/* Lay out the block of the nodes from first to end in raw: the nodes, then
+ * the offsets of the strings they use, then the strings. Only the strings
+ * of the section are written, numbered afresh
+ */
+static int pack_section (const struct pk_doc* doc, size_t first, size_t end, uint32_t* local, uint32_t* order,
+                         uint32_t* count, bstring raw) {
+  size_t nodes = end - first;
+  unsigned char* columns = (unsigned char*) malloc (nodes * DOC_NODE_SIZE + 1);
+  unsigned char offset[4];
+  uint32_t line = 0;
+  size_t pool = 0;
+  size_t i;
+  int status = columns ? PK_OK : PK_ERR;
+
+  btrunc (raw, 0);
+  *count = 0;
+
+  for (i = 0; status == PK_OK && i < nodes; i++) {
+    const struct pk_doc_node* node = &doc->nodes[first + i];
+
+    columns[i] = node->type;
+    columns[nodes + i] = node->tag;
+    put16 (columns + 2 * nodes + 2 * i, node->flags);
+    put32 (columns + 4 * nodes + 4 * i, node->line - line);
+    put32 (columns + 8 * nodes + 4 * i, local_id (local, order, count, node->text));
+    put32 (columns + 12 * nodes + 4 * i, local_id (local, order, count, node->label));
+    put32 (columns + 16 * nodes + 4 * i, local_id (local, order, count, node->args));
+    put32 (columns + 20 * nodes + 4 * i, node->type == PK_TOKEN_OPEN ? node->close - (uint32_t) (first + i) : 0);
+    line = node->line;
+    }
+
+  if (status == PK_OK && bcatblk (raw, columns, (int) (nodes * DOC_NODE_SIZE)) != BSTR_OK) {
+    status = PK_ERR;
+    }
+
+  for (i = 0; status == PK_OK && i < *count; i++) {
+    put32 (offset, (uint32_t) pool);
+    pool += pk_intern_get (doc->strings, order[i]).len + 1;
+    status = bcatblk (raw, offset, 4) == BSTR_OK ? PK_OK : PK_ERR;
+    }
+
+  for (i = 0; status == PK_OK && i < *count; i++) {
+    struct pk_span span = pk_intern_get (doc->strings, order[i]);
+
+    if (bcatblk (raw, span.data, (int) span.len) != BSTR_OK || bconchar (raw, '\0') != BSTR_OK) {
+      status = PK_ERR;
+      }
+    }
+
+  /* Leave the map clear for the next section */
+  for (i = 0; i < *count; i++) {
+    local[order[i]] = PK_INTERN_NONE;
+    }
+
+  free (columns);
+  return status;
+  }
+
+/* Compress a section block onto the end of body, and describe it in the
+ * index. Blocks that do not shrink are stored as they are, aligned so that
+ * a little endian reader can use their columns straight from the mapping
+ */
+static int add_block (bstring index, bstring body, const_bstring raw, size_t first, size_t nodes, uint32_t strings,
+                      size_t* offset) {
+  unsigned char entry[DOC_ENTRY_SIZE];
+  size_t size = (size_t) blength (raw);
+  size_t capacity = pk_lz_bound (size);
+  unsigned char* packed = (unsigned char*) malloc (capacity);
+  size_t stored = packed ? pk_lz_compress (raw->data, size, packed, capacity) : 0;
+  int lz = stored != 0 && stored < size;
+  int status = packed ? PK_OK : PK_ERR;
+
+  while (status == PK_OK && !lz && blength (body) % 4 != 0) {
+    status = bconchar (body, '\0') == BSTR_OK ? PK_OK : PK_ERR;
+    }
+
+  put32 (entry, (uint32_t) first);
+  put32 (entry + 4, (uint32_t) nodes);
+  put32 (entry + 8, strings);
+  put32 (entry + 12, lz ? DOC_LZ : DOC_STORED);
+  put32 (entry + 16, (uint32_t) *offset);
+  put32 (entry + 20, (uint32_t) size);
+  put32 (entry + 24, (uint32_t) blength (body));
+  put32 (entry + 28, (uint32_t) (lz ? stored : size));
+
+  if (status == PK_OK && (bcatblk (index, entry, DOC_ENTRY_SIZE) != BSTR_OK ||
+                          bcatblk (body, lz ? packed : raw->data, (int) (lz ? stored : size)) != BSTR_OK)) {
+    status = PK_ERR;
+    }
+
+  *offset += size;
+  free (packed);
+  return status;
+  }
+
+/* Append the postings of every tag to body: a table giving the place and
+ * number of the OPEN nodes of each tag, then the list of those nodes
+ */
+static int add_postings (const struct pk_doc* doc, bstring body) {
+  unsigned char* table = (unsigned char*) calloc (PK_TAG_COUNT, 8);
+  unsigned char* list = (unsigned char*) malloc (doc->count * 4 + 1);
+  uint32_t counts[PK_TAG_COUNT];
+  uint32_t places[PK_TAG_COUNT];
+  uint32_t total = 0;
+  size_t i;
+  int tag;
+  int status = table && list ? PK_OK : PK_ERR;
+
+  memset (counts, 0, sizeof (counts));
+
+  for (i = 0; i < doc->count; i++) {
+    if (doc->nodes[i].type == PK_TOKEN_OPEN && doc->nodes[i].tag < PK_TAG_COUNT) {
+      counts[doc->nodes[i].tag]++;
+      }
+    }
+
+  for (tag = 0; tag < PK_TAG_COUNT; tag++) {
+    places[tag] = total;
+    total += counts[tag];
+
+    if (table != NULL) {
+      put32 (table + tag * 8, places[tag]);
+      put32 (table + tag * 8 + 4, counts[tag]);
+      }
+    }
+
+  for (i = 0; status == PK_OK && i < doc->count; i++) {
+    if (doc->nodes[i].type == PK_TOKEN_OPEN && doc->nodes[i].tag < PK_TAG_COUNT) {
+      put32 (list + (size_t) places[doc->nodes[i].tag]++ * 4, (uint32_t) i);
+      }
+    }
+
+  if (status == PK_OK && (bcatblk (body, table, PK_TAG_COUNT * 8) != BSTR_OK ||
+                          bcatblk (body, list, (int) total * 4) != BSTR_OK)) {
+    status = PK_ERR;
+    }
+
+  free (table);
+  free (list);
+  return status;
+  }
+
+/* Write the parts of a .pdoc file to a temporary name, then move it into
+ * place, so readers never see a partial document
+ */
+static int write_file (const char* path, const unsigned char* header, const_bstring index, const_bstring body) {
+  bstring temp = bformat ("%s.tmp", path);
+  FILE* file = temp ? fopen ( (const char*) temp->data, "wb") : NULL;
+  int status = PK_OK;
+
+  if (file == NULL || fwrite (header, 1, DOC_HEADER_SIZE, file) != DOC_HEADER_SIZE ||
+      fwrite (index->data, 1, (size_t) blength (index), file) != (size_t) blength (index) ||
+      fwrite (body->data, 1, (size_t) blength (body), file) != (size_t) blength (body)) {
+    status = PK_ERR;
+    }
+
+  if (file != NULL && fclose (file) != 0) {
+    status = PK_ERR;
+    }
+
+  if (status == PK_OK && rename ( (const char*) temp->data, path) != 0) {
+    status = PK_ERR;
+    }
+
+  if (status != PK_OK && file != NULL) {
+    remove ( (const char*) temp->data);
+    }
+
+  bdestroy (temp);
+  return status;
+  }
+
+int pk_doc_write (const struct pk_doc* doc, const char* path) {
+  unsigned char header[DOC_HEADER_SIZE];
+  size_t strings = doc->strings->count;
+  uint32_t* local = (uint32_t*) malloc (strings * sizeof (*local));
+  uint32_t* order = (uint32_t*) malloc (strings * sizeof (*order));
+  bstring raw = bfromcstr ("");
+  bstring index = bfromcstr ("");
+  bstring body = bfromcstr ("");
+  uint32_t sections = 0;
+  size_t offset = 0;
+  size_t first = 0;
+  int status = local && order && raw && index && body ? PK_OK : PK_ERR;
+
+  if (status == PK_OK) {
+    memset (local, 0xFF, strings * sizeof (*local));
+    }
+
+  while (status == PK_OK && first < doc->count) {
+    size_t end = section_end (doc, first);
+    uint32_t count;
+
+    status = pack_section (doc, first, end, local, order, &count, raw);
+
+    if (status == PK_OK) {
+      status = add_block (index, body, raw, first, end - first, count, &offset);
+      }
+
+    first = end;
+    sections++;
+    }
+
+  if (status == PK_OK) {
+    memset (header, 0, sizeof (header));
+    memcpy (header, DOC_MAGIC, 8);
+    put32 (header + 8, (uint32_t) doc->count);
+    put32 (header + 12, sections);
+    put32 (header + 16, DOC_HEADER_SIZE);
+    put32 (header + 20, (uint32_t) (DOC_HEADER_SIZE + blength (index)));
+    put32 (header + 24, (uint32_t) (DOC_HEADER_SIZE + blength (index) + blength (body)));
+    put32 (header + 28, PK_TAG_COUNT);
+    status = add_postings (doc, body);
+    }
+
+  if (status == PK_OK) {
+    status = write_file (path, header, index, body);
+    }
+
+  bdestroy (body);
+  bdestroy (index);
+  bdestroy (raw);
+  free (order);
+  free (local);
+  return status;
+  }
+
+/**
+*** Reading
+**/
+
+/* Intern the strings of a block, mapping them to identifiers in the table
+ * of the document. Returns the map, or NULL if the table is damaged
+ */
+static uint32_t* read_strings (struct pk_doc* doc, const unsigned char* offsets, uint32_t strings, const char* pool,
+                               size_t pool_size) {
+  uint32_t* ids = (uint32_t*) malloc ( (size_t) strings * sizeof (*ids) + 1);
+  uint32_t* scratch;
+  const uint32_t* starts = pk_le32_view (offsets, strings, &scratch);
+  uint32_t i;
+
+  if (starts == NULL) {
+    free (ids);
+    return NULL;
+    }
+
+  for (i = 0; ids != NULL && i < strings; i++) {
+    size_t start = starts[i];
+    size_t end = i + 1 < strings ? starts[i + 1] : pool_size;
+
+    if (start >= end || end > pool_size || pool[end - 1] != '\0' ||
+        (ids[i] = pk_intern_span (doc->strings, pool + start, end - start - 1)) == PK_INTERN_NONE) {
+      free (ids);
+      ids = NULL;
+      }
+    }
+
+  free (scratch);
+  return ids;
+  }
+
+/* Decode the nodes of a block onto the end of the document. The integer
+ * columns are taken whole through views, so a little endian host reads an
+ * aligned block in place
+ */
+static int read_nodes (struct pk_doc* doc, const unsigned char* data, uint32_t nodes, const uint32_t* ids,
+                       uint32_t strings) {
+  uint16_t* narrow;
+  uint32_t* wide;
+  const uint16_t* flags = pk_le16_view (data + 2 * (size_t) nodes, nodes, &narrow);
+  const uint32_t* columns = pk_le32_view (data + 4 * (size_t) nodes, 5 * (size_t) nodes, &wide);
+  uint32_t line = 0;
+  uint32_t i;
+  int status = PK_ERR;
+
+  if (flags == NULL || columns == NULL || reserve_nodes (doc, nodes) != PK_OK) {
+    goto done;
+    }
+
+  for (i = 0; i < nodes; i++) {
+    struct pk_doc_node* node = &doc->nodes[doc->count + i];
+    unsigned type = data[i];
+    unsigned tag = data[nodes + i];
+    uint32_t text = columns[nodes + i];
+    uint32_t label = columns[2 * (size_t) nodes + i];
+    uint32_t args = columns[3 * (size_t) nodes + i];
+    uint32_t close = columns[4 * (size_t) nodes + i];
+
+    if (type < PK_TOKEN_TEXT || type > PK_TOKEN_END || tag >= PK_TAG_COUNT || text >= strings || label >= strings ||
+        args >= strings || (type == PK_TOKEN_OPEN ? close == 0 || close >= nodes - i : close != 0)) {
+      goto done;
+      }
+
+    line += columns[i];
+    node->type = (uint8_t) type;
+    node->tag = (uint8_t) tag;
+    node->flags = flags[i];
+    node->line = line;
+    node->text = ids[text];
+    node->label = ids[label];
+    node->args = ids[args];
+    node->close = type == PK_TOKEN_OPEN ? (uint32_t) doc->count + i + close : 0;
+    }
+
+  doc->count += nodes;
+  status = PK_OK;
+
+done:
+  free (narrow);
+  free (wide);
+  return status;
+  }
+
+/* Check every entry of the section index against the file, so sections
+ * can later be loaded without further checks on where they lie
+ */
+static int check_index (const struct pk_doc_file* file) {
+  size_t blocks = (size_t) (file->map.len - (size_t) (file->blocks - (const unsigned char*) file->map.data));
+  uint32_t first = 0;
+  uint32_t i;
+
+  for (i = 0; i < file->sections; i++) {
+    const unsigned char* entry = file->index + (size_t) i * DOC_ENTRY_SIZE;
+    uint32_t nodes = get32 (entry + 4);
+    uint32_t codec = get32 (entry + 12);
+    uint32_t size = get32 (entry + 20);
+    uint32_t offset = get32 (entry + 24);
+    uint32_t stored = get32 (entry + 28);
+
+    if (get32 (entry) != first || nodes > file->nodes - first || codec > DOC_LZ ||
+        (codec == DOC_STORED && stored != size) || offset > blocks || blocks - offset < stored ||
+        (uint64_t) nodes * DOC_NODE_SIZE + (uint64_t) get32 (entry + 8) * 4 > size) {
+      return PK_ERR;
+      }
+
+    first += nodes;
+    }
+
+  return first == file->nodes ? PK_OK : PK_ERR;
+  }
+
+/* Find the tag postings, checking every list lies within the file. Nodes
+ * named in the lists are checked as they are read
+ */
+static int check_postings (struct pk_doc_file* file) {
+  const unsigned char* data = (const unsigned char*) file->map.data;
+  uint32_t offset = get32 (data + 24);
+  uint32_t tags = get32 (data + 28);
+  size_t size;
+  uint32_t i;
+
+  if (offset == 0) {
+    return PK_OK;
+    }
+
+  if (offset > file->map.len || (file->map.len - offset) / 8 < tags) {
+    return PK_ERR;
+    }
+
+  size = (file->map.len - offset - (size_t) tags * 8) / 4;
+
+  for (i = 0; i < tags; i++) {
+    uint32_t place = get32 (data + offset + (size_t) i * 8);
+    uint32_t count = get32 (data + offset + (size_t) i * 8 + 4);
+
+    if (place > size || size - place < count) {
+      return PK_ERR;
+      }
+    }
+
+  file->postings = data + offset;
+  file->tags = tags;
+  return PK_OK;
+  }
+
+int pk_doc_open (struct pk_doc_file* file, const char* path) {
+  const unsigned char* data;
+  uint32_t index_offset;
+  uint32_t block_offset;
+
+  memset (file, 0, sizeof (*file));
+
+  if (pk_map_file (path, &file->map) != PK_OK) {
+    return PK_ERR;
+    }
+
+  data = (const unsigned char*) file->map.data;
+
+  if (file->map.len >= DOC_HEADER_SIZE && memcmp (data, DOC_MAGIC, 8) == 0) {
+    file->nodes = get32 (data + 8);
+    file->sections = get32 (data + 12);
+    index_offset = get32 (data + 16);
+    block_offset = get32 (data + 20);
+
+    /* Check the index lies within the file before trusting it */
+    if (index_offset <= file->map.len && (file->map.len - index_offset) / DOC_ENTRY_SIZE >= file->sections &&
+        block_offset <= file->map.len) {
+      file->index = data + index_offset;
+      file->blocks = data + block_offset;
+      }
+    }
+
+  if (file->index == NULL || check_index (file) != PK_OK || check_postings (file) != PK_OK) {
+    pk_doc_close (file);
+    return PK_ERR;
+    }
+
+  return PK_OK;
+  }
+
+void pk_doc_close (struct pk_doc_file* file) {
+  pk_unmap_file (&file->map);
+  memset (file, 0, sizeof (*file));
+  }
+
+int pk_doc_section (const struct pk_doc_file* file, size_t section, struct pk_doc_section* info) {
+  const unsigned char* entry = file->index + section * DOC_ENTRY_SIZE;
+
+  if (section >= file->sections) {
+    return PK_ERR;
+    }
+
+  info->first = get32 (entry);
+  info->nodes = get32 (entry + 4);
+  info->size = get32 (entry + 20);
+  info->stored = get32 (entry + 28);
+  return PK_OK;
+  }
+
+size_t pk_doc_section_of (const struct pk_doc_file* file, uint32_t node) {
+  size_t low = 0;
+  size_t high = file->sections;
+
+  /* Find the last section starting at or before the node */
+  while (high - low > 1) {
+    size_t middle = low + (high - low) / 2;
+
+    if (get32 (file->index + middle * DOC_ENTRY_SIZE) <= node) {
+      low = middle;
+      }
+
+    else {
+      high = middle;
+      }
+    }
+
+  return low;
+  }
+
+int pk_doc_tag_count (const struct pk_doc_file* file, int tag, uint32_t* count) {
+  if (file->postings == NULL) {
+    return PK_ERR;
+    }
+
+  *count = tag >= 0 && (uint32_t) tag < file->tags ? get32 (file->postings + (size_t) tag * 8 + 4) : 0;
+  return PK_OK;
+  }
+
+uint32_t pk_doc_tag_node (const struct pk_doc_file* file, int tag, uint32_t n) {
+  const unsigned char* list = file->postings + (size_t) file->tags * 8;
+
+  return get32 (list + ( (size_t) get32 (file->postings + (size_t) tag * 8) + n) * 4);
+  }
+
+int pk_doc_load (struct pk_doc* doc, const struct pk_doc_file* file, size_t section) {
+  const unsigned char* entry = file->index + section * DOC_ENTRY_SIZE;
+  const unsigned char* block;
+  unsigned char* raw = NULL;
+  uint32_t* ids;
+  uint32_t nodes;
+  uint32_t strings;
+  size_t size;
+  size_t strings_offset;
+  int status;
+
+  if (section >= file->sections) {
+    return PK_ERR;
+    }
+
+  nodes = get32 (entry + 4);
+  strings = get32 (entry + 8);
+  size = get32 (entry + 20);
+  block = file->blocks + get32 (entry + 24);
+
+  /* Only this section is expanded; stored blocks are read in place */
+  if (get32 (entry + 12) == DOC_LZ) {
+    raw = (unsigned char*) malloc (size + 1);
+
+    if (raw == NULL || pk_lz_decompress (block, get32 (entry + 28), raw, size) != PK_OK) {
+      free (raw);
+      return PK_ERR;
+      }
+
+    block = raw;
+    }
+
+  strings_offset = (size_t) nodes * DOC_NODE_SIZE;
+  ids = read_strings (doc, block + strings_offset, strings, (const char*) block + strings_offset + (size_t) strings * 4,
+                      size - strings_offset - (size_t) strings * 4);
+  status = ids ? read_nodes (doc, block, nodes, ids, strings) : PK_ERR;
+  free (ids);
+  free (raw);
+  return status;
+  }
+
+int pk_doc_read (struct pk_doc* doc, const char* path) {
+  struct pk_doc_file file;
+  size_t i;
+  int status;
+
+  if (pk_doc_open (&file, path) != PK_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0, status = PK_OK; status == PK_OK && i < file.sections; i++) {
+    status = pk_doc_load (doc, &file, i);
+    }
+
+  pk_doc_close (&file);
+  return status;
+  }
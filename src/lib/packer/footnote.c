@@ -0,0 +1,141 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file footnote.c
+*** \brief Streaming footnote numbering and deferral
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/footnote.h"
+
+void pk_footnotes_init (struct pk_footnotes* notes, int placement, pk_fn_format_fn* format, pk_fn_flush_fn* flush,
+                        void* ctx) {
+  notes->placement = placement;
+  notes->next = 1;
+  notes->first = 1;
+  notes->bodies = NULL;
+  notes->capacity = 0;
+  notes->format = format;
+  notes->flush = flush;
+  notes->ctx = ctx;
+  }
+
+void pk_footnotes_clear (struct pk_footnotes* notes) {
+  size_t i;
+
+  for (i = 0; i < notes->capacity; i++) {
+    bdestroy (notes->bodies[i]);
+    }
+
+  free (notes->bodies);
+  notes->bodies = NULL;
+  notes->capacity = 0;
+  }
+
+int pk_footnote_number (struct pk_footnotes* notes) {
+  return notes->next++;
+  }
+
+int pk_footnote_add (struct pk_footnotes* notes, int number, const_bstring body) {
+  size_t slot;
+
+  if (number < notes->first || number >= notes->next) {
+    return PK_ERR;
+    }
+
+  slot = (size_t) (number - notes->first);
+
+  if (slot >= notes->capacity) {
+    size_t capacity = notes->capacity ? notes->capacity * 2 : 16;
+    bstring* bodies;
+
+    while (capacity <= slot) {
+      capacity *= 2;
+      }
+
+    bodies = (bstring*) realloc (notes->bodies, capacity * sizeof (*bodies));
+
+    if (bodies == NULL) {
+      return PK_ERR;
+      }
+
+    memset (bodies + notes->capacity, 0, (capacity - notes->capacity) * sizeof (*bodies));
+    notes->bodies = bodies;
+    notes->capacity = capacity;
+    }
+
+  if (notes->bodies[slot] == NULL && (notes->bodies[slot] = bfromcstr ("")) == NULL) {
+    return PK_ERR;
+    }
+
+  return notes->format (number, body, notes->bodies[slot], notes->ctx);
+  }
+
+/* Write out the waiting notes, in number order */
+static int flush_notes (struct pk_footnotes* notes, bstring out) {
+  bstring all;
+  int last = notes->next - 1;
+  size_t i;
+  int status = PK_OK;
+
+  if (last < notes->first) {
+    return PK_OK;
+    }
+
+  all = bfromcstr ("");
+
+  for (i = 0; all != NULL && i < notes->capacity; i++) {
+    if (notes->bodies[i] != NULL && bconcat (all, notes->bodies[i]) != BSTR_OK) {
+      status = PK_ERR;
+      }
+
+    bdestroy (notes->bodies[i]);
+    notes->bodies[i] = NULL;
+    }
+
+  if (all == NULL || status != PK_OK || notes->flush (all, notes->first, last, out, notes->ctx) != PK_OK) {
+    status = PK_ERR;
+    }
+
+  notes->first = notes->next;
+  bdestroy (all);
+  return status;
+  }
+
+int pk_footnotes_section_end (struct pk_footnotes* notes, bstring out) {
+  return notes->placement == PK_FN_SECTION ? flush_notes (notes, out) : PK_OK;
+  }
+
+int pk_footnotes_document_end (struct pk_footnotes* notes, bstring out) {
+  return flush_notes (notes, out);
+  }
@@ -0,0 +1,62 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file hash.c
+*** \brief Non-cryptographic hashes used for tables and caches
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/hash.h"
+
+/* The FNV-1a parameters. C90 has no 64-bit literals, so build the
+ * constants from their two halves
+ */
+#define FNV64_OFFSET  (((uint64_t) 0xcbf29ce4UL << 32) | 0x84222325UL)
+#define FNV64_PRIME   (((uint64_t) 0x00000100UL << 32) | 0x000001b3UL)
+
+uint64_t pk_hash_bytes (const void* data, size_t len) {
+  return pk_hash_continue (FNV64_OFFSET, data, len);
+  }
+
+uint64_t pk_hash_seed (void) {
+  return FNV64_OFFSET;
+  }
+
+uint64_t pk_hash_continue (uint64_t hash, const void* data, size_t len) {
+  const unsigned char* p = (const unsigned char*) data;
+  uint64_t h = hash;
+
+  while (len-- > 0) {
+    h ^= *p++;
+    h *= FNV64_PRIME;
+    }
+
+  return h;
+  }
+
+uint64_t pk_hash_cstr (const char* str) {
+  return pk_hash_bytes (str, strlen (str));
+  }
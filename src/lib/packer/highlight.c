@@ -0,0 +1,494 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file highlight.c
+*** \brief Syntax highlighting of code listings
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/dfa.h"
+#include "packer/hash.h"
+#include "packer/highlight.h"
+#include "packer/render.h"
+#include "packer/span.h"
+
+/* Initial number of buckets in the fragment cache (a power of two) */
+#define HL_BUCKETS 256
+
+/* Most rules in one language */
+#define HL_MAX_RULES 64
+
+/**
+*** Languages. Each rule maps a pattern to a highlight class. Rules are
+*** tried together, longest match first, then in order: so keywords come
+*** before the general name rules that also match them.
+***
+*** Rules for constructs that may span lines (block comments, strings)
+*** are marked open: left unclosed, they run to the end of the listing, as
+*** they would for the compiler. Without this, the scan from each later
+*** offset would run to the end of the text again, and an unclosed
+*** comment would make highlighting quadratic.
+**/
+
+struct hl_rule {
+  const char* pattern;  /*< Regular expression (see dfa.h) */
+  int         cls;      /*< Highlight class of the matched text */
+  int         open;     /*< Runs to the end of the listing when left unclosed */
+  };
+
+struct hl_language {
+  const char*           names;  /*< Space separated names of the language */
+  const struct hl_rule* rules;  /*< The rules, ending with a NULL pattern */
+  };
+
+/* BIND zone files */
+static const struct hl_rule bind_rules[] = {
+  { ";[^\n]*", PK_HL_COMMENT, 0 },
+  { "\\$[A-Za-z]+", PK_HL_PREPROC, 0 },
+  { "\"([^\"\\\\\n]|\\\\.)*\"", PK_HL_STRING, 0 },
+  { "[0-9]+(\\.[0-9]+)+", PK_HL_NUMBER, 0 },
+  { "[0-9]+[smhdwSMHDW]?", PK_HL_NUMBER, 0 },
+  {
+    "IN|CH|HS|SOA|NS|A|AAAA|MX|CNAME|DNAME|PTR|TXT|SRV|HINFO|RP|NAPTR|CAA|DS|DNSKEY|RRSIG|NSEC|NSEC3",
+    PK_HL_KEYWORD, 0
+  },
+  { "[-A-Za-z0-9_.@*]+", PK_HL_PLAIN, 0 },
+  { "[()]", PK_HL_OPERATOR, 0 },
+  { "[ \t\r\n]+", PK_HL_PLAIN, 0 },
+  { NULL, 0, 0 }
+  };
+
+/* Shell scripts and sessions */
+static const struct hl_rule shell_rules[] = {
+  { "#[^\n]*", PK_HL_COMMENT, 0 },
+  {
+    "if|then|else|elif|fi|for|while|until|do|done|case|esac|in|function|return|export|local|select",
+    PK_HL_KEYWORD, 0
+  },
+  { "\\$[A-Za-z_][A-Za-z0-9_]*|\\$\\{[^}\n]*\\}|\\$[0-9#?@*$!-]", PK_HL_VARIABLE, 0 },
+  { "\"([^\"\\\\]|\\\\.)*\"|'[^']*'", PK_HL_STRING, 1 },
+  { "[-A-Za-z0-9_./:=+,%@~#]+", PK_HL_PLAIN, 0 },
+  { "[|&;<>()]+", PK_HL_OPERATOR, 0 },
+  { "[ \t\r\n]+", PK_HL_PLAIN, 0 },
+  { NULL, 0, 0 }
+  };
+
+/* C source and headers */
+static const struct hl_rule c_rules[] = {
+  { "/\\*([^*]|\\*+[^*/])*\\*+/", PK_HL_COMMENT, 1 },
+  { "//[^\n]*", PK_HL_COMMENT, 0 },
+  { "#[ \t]*[A-Za-z]+", PK_HL_PREPROC, 0 },
+  {
+    "auto|break|case|const|continue|default|do|else|enum|extern|for|goto|if|inline|register|restrict|"
+    "return|sizeof|static|struct|switch|typedef|union|volatile|while",
+    PK_HL_KEYWORD, 0
+  },
+  {
+    "void|char|short|int|long|float|double|signed|unsigned|size_t|ssize_t|_Bool|FILE|u?int(8|16|32|64)_t",
+    PK_HL_TYPE, 0
+  },
+  { "\"([^\"\\\\\n]|\\\\.)*\"|'([^'\\\\\n]|\\\\.)*'", PK_HL_STRING, 0 },
+  { "0[xX][0-9a-fA-F]+[uUlL]*|[0-9]+(\\.[0-9]*)?([eE][-+]?[0-9]+)?[uUlLfF]*", PK_HL_NUMBER, 0 },
+  { "[A-Za-z_][A-Za-z0-9_]*", PK_HL_PLAIN, 0 },
+  { "[-+*/%=<>!&|^~?:;,.(){}]|\\[|\\]", PK_HL_OPERATOR, 0 },
+  { "[ \t\r\n]+", PK_HL_PLAIN, 0 },
+  { NULL, 0, 0 }
+  };
+
+/* Configuration files in the common key/value and INI styles */
+static const struct hl_rule conf_rules[] = {
+  { "[#;][^\n]*", PK_HL_COMMENT, 0 },
+  { "\\[[^]\n]*\\]", PK_HL_KEYWORD, 0 },
+  { "\"([^\"\\\\\n]|\\\\.)*\"|'[^'\n]*'", PK_HL_STRING, 0 },
+  { "[0-9]+(\\.[0-9]+)*", PK_HL_NUMBER, 0 },
+  { "true|false|yes|no|on|off", PK_HL_KEYWORD, 0 },
+  { "[A-Za-z_][-A-Za-z0-9_.]*", PK_HL_PLAIN, 0 },
+  { "[=:{}();,]", PK_HL_OPERATOR, 0 },
+  { "[ \t\r\n]+", PK_HL_PLAIN, 0 },
+  { NULL, 0, 0 }
+  };
+
+static const struct hl_language languages[] = {
+  { "bind zone dns", bind_rules },
+  { "sh shell bash console", shell_rules },
+  { "c h", c_rules },
+  { "conf config cfg ini", conf_rules },
+  };
+
+#define HL_LANGUAGES ((int) (sizeof (languages) / sizeof (languages[0])))
+
+static const char* const class_names[PK_HL_COUNT] = {
+  "plain", "comment", "keyword", "type", "string", "number", "variable", "preproc", "operator"
+  };
+
+struct pk_highlighter {
+  struct pk_dfa*          dfas[HL_LANGUAGES];       /*< Compiled languages (NULL until first used) */
+  int                     failed[HL_LANGUAGES];     /*< Non-zero if the language would not compile */
+  struct pk_hl_fragment** buckets;                  /*< The fragment cache */
+  size_t                  nbuckets;                 /*< Number of buckets (a power of two) */
+  size_t                  count;                    /*< Number of fragments in the cache */
+  size_t                  hits;                     /*< Fragments found in the cache */
+  size_t                  misses;                   /*< Fragments added to the cache */
+  size_t                  cached;                   /*< Bytes held by the fragments in the cache */
+  };
+
+struct pk_highlighter* pk_highlighter_new (void) {
+  struct pk_highlighter* hl = (struct pk_highlighter*) calloc (1, sizeof (struct pk_highlighter));
+
+  if (hl == NULL) {
+    return NULL;
+    }
+
+  hl->nbuckets = HL_BUCKETS;
+  hl->buckets = (struct pk_hl_fragment**) calloc (hl->nbuckets, sizeof (*hl->buckets));
+
+  if (hl->buckets == NULL) {
+    free (hl);
+    return NULL;
+    }
+
+  return hl;
+  }
+
+void pk_highlighter_free (struct pk_highlighter* hl) {
+  int i;
+
+  if (hl == NULL) {
+    return;
+    }
+
+  for (i = 0; i < HL_LANGUAGES; i++) {
+    pk_dfa_free (hl->dfas[i]);
+    }
+
+  pk_highlight_flush (hl);
+  free (hl->buckets);
+  free (hl);
+  }
+
+void pk_highlight_flush (struct pk_highlighter* hl) {
+  size_t i;
+
+  for (i = 0; i < hl->nbuckets; i++) {
+    while (hl->buckets[i] != NULL) {
+      struct pk_hl_fragment* next = hl->buckets[i]->next;
+
+      free (hl->buckets[i]->text);
+      free (hl->buckets[i]->runs);
+      free (hl->buckets[i]);
+      hl->buckets[i] = next;
+      }
+    }
+
+  hl->cached = 0;
+  hl->count = 0;
+  }
+
+size_t pk_highlight_cached (const struct pk_highlighter* hl) {
+  return hl->cached;
+  }
+
+const char* pk_hl_class_name (int cls) {
+  return cls >= 0 && cls < PK_HL_COUNT ? class_names[cls] : class_names[PK_HL_PLAIN];
+  }
+
+void pk_highlight_stats (const struct pk_highlighter* hl, size_t* hits, size_t* misses) {
+  *hits = hl->hits;
+  *misses = hl->misses;
+  }
+
+void pk_highlight_args (struct pk_span args, struct pk_span* lang, int* first_line) {
+  struct pk_span line;
+  size_t i;
+
+  pk_span_split (&args, '|', lang);
+  *lang = pk_span_trim (*lang);
+  *first_line = 0;
+
+  if (!pk_span_split (&args, '|', &line)) {
+    return;
+    }
+
+  line = pk_span_trim (line);
+
+  for (i = 0; i < line.len && line.data[i] >= '0' && line.data[i] <= '9'; i++) {
+    *first_line = *first_line * 10 + (line.data[i] - '0');
+    }
+  }
+
+/* Find the language with the given name, or -1 */
+static int find_language (struct pk_span name) {
+  int i;
+
+  for (i = 0; i < HL_LANGUAGES && name.len > 0; i++) {
+    const char* p = languages[i].names;
+
+    while (*p != '\0') {
+      size_t len = strcspn (p, " ");
+
+      if (len == name.len && strncmp (p, name.data, len) == 0) {
+        return i;
+        }
+
+      p += len;
+      p += *p == ' ';
+      }
+    }
+
+  return -1;
+  }
+
+/* The compiled automaton for a language, compiling it on first use.
+ * Returns NULL if the language has more than HL_MAX_RULES rules, or its
+ * rules will not compile
+ */
+static struct pk_dfa* language_dfa (struct pk_highlighter* hl, int lang) {
+  const char* patterns[HL_MAX_RULES];
+  size_t count;
+
+  if (hl->failed[lang] || hl->dfas[lang] != NULL) {
+    return hl->dfas[lang];
+    }
+
+  for (count = 0; languages[lang].rules[count].pattern != NULL; count++) {
+    if (count == HL_MAX_RULES) {
+      hl->failed[lang] = 1;
+      return NULL;
+      }
+
+    patterns[count] = languages[lang].rules[count].pattern;
+    }
+
+  hl->dfas[lang] = pk_dfa_compile (patterns, count);
+  hl->failed[lang] = hl->dfas[lang] == NULL;
+  return hl->dfas[lang];
+  }
+
+/* Double the buckets of the fragment cache, once it is full */
+static int grow_cache (struct pk_highlighter* hl) {
+  struct pk_hl_fragment** buckets;
+  size_t nbuckets = hl->nbuckets * 2;
+  size_t i;
+
+  if (hl->count < hl->nbuckets) {
+    return PK_OK;
+    }
+
+  buckets = (struct pk_hl_fragment**) calloc (nbuckets, sizeof (*buckets));
+
+  if (buckets == NULL) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < hl->nbuckets; i++) {
+    while (hl->buckets[i] != NULL) {
+      struct pk_hl_fragment* moved = hl->buckets[i];
+
+      hl->buckets[i] = moved->next;
+      moved->next = buckets[moved->hash & (nbuckets - 1)];
+      buckets[moved->hash & (nbuckets - 1)] = moved;
+      }
+    }
+
+  free (hl->buckets);
+  hl->buckets = buckets;
+  hl->nbuckets = nbuckets;
+  return PK_OK;
+  }
+
+/* Append a run, merging it with the last run if they share a class */
+static int add_run (struct pk_hl_fragment* fragment, size_t* capacity, size_t offset, size_t len, int cls) {
+  struct pk_hl_run* last = fragment->count ? &fragment->runs[fragment->count - 1] : NULL;
+
+  if (last != NULL && last->cls == cls && last->offset + last->len == offset) {
+    last->len += len;
+    return PK_OK;
+    }
+
+  if (fragment->count == *capacity) {
+    size_t grown = *capacity ? *capacity * 2 : 16;
+    struct pk_hl_run* runs = (struct pk_hl_run*) realloc (fragment->runs, grown * sizeof (*runs));
+
+    if (runs == NULL) {
+      return PK_ERR;
+      }
+
+    fragment->runs = runs;
+    *capacity = grown;
+    }
+
+  fragment->runs[fragment->count].offset = offset;
+  fragment->runs[fragment->count].len = len;
+  fragment->runs[fragment->count].cls = cls;
+  fragment->count++;
+  return PK_OK;
+  }
+
+/* Scan the fragment text into runs */
+static int scan (const struct pk_dfa* dfa, const struct hl_rule* rules, struct pk_hl_fragment* fragment) {
+  size_t capacity = 0;
+  size_t pos = 0;
+
+  while (pos < fragment->len) {
+    size_t len = 1;
+    int cls = PK_HL_PLAIN;
+    int open = -1;
+    int rule = dfa ? pk_dfa_match (dfa, fragment->text + pos, fragment->len - pos, &len, &open) : -1;
+
+    /* An unclosed comment or string takes the rest of the listing */
+    if (open >= 0 && rules[open].open) {
+      rule = open;
+      len = fragment->len - pos;
+      }
+
+    if (rule >= 0) {
+      cls = rules[rule].cls;
+      }
+
+    else if (dfa == NULL) {
+      len = fragment->len - pos;
+      }
+
+    if (add_run (fragment, &capacity, pos, len, cls) != PK_OK) {
+      return PK_ERR;
+      }
+
+    pos += len;
+    }
+
+  return PK_OK;
+  }
+
+const struct pk_hl_fragment* pk_highlight (struct pk_highlighter* hl, struct pk_span lang, const char* text,
+    size_t len) {
+  struct pk_hl_fragment* fragment;
+  struct pk_dfa* dfa;
+  int index = find_language (lang);
+  uint64_t hash;
+  size_t bucket;
+
+  /* Listings are identified by their language and their content */
+  hash = pk_hash_continue (pk_hash_bytes (&index, sizeof (index)), text, len);
+  bucket = (size_t) (hash & (hl->nbuckets - 1));
+
+  for (fragment = hl->buckets[bucket]; fragment != NULL; fragment = fragment->next) {
+    if (fragment->hash == hash && fragment->lang == index && fragment->len == len &&
+        memcmp (fragment->text, text, len) == 0) {
+      hl->hits++;
+      return fragment;
+      }
+    }
+
+  /* A known language that will not compile is an error, not plain text */
+  dfa = index >= 0 ? language_dfa (hl, index) : NULL;
+
+  if ( (index >= 0 && dfa == NULL) || grow_cache (hl) != PK_OK) {
+    return NULL;
+    }
+
+  bucket = (size_t) (hash & (hl->nbuckets - 1));
+  fragment = (struct pk_hl_fragment*) calloc (1, sizeof (*fragment));
+
+  if (fragment == NULL || (fragment->text = (char*) malloc (len + 1)) == NULL) {
+    free (fragment);
+    return NULL;
+    }
+
+  memcpy (fragment->text, text, len);
+  fragment->text[len] = '\0';
+  fragment->len = len;
+  fragment->lang = index;
+  fragment->hash = hash;
+
+  if (scan (dfa, index >= 0 ? languages[index].rules : NULL, fragment) != PK_OK) {
+    free (fragment->text);
+    free (fragment->runs);
+    free (fragment);
+    return NULL;
+    }
+
+  fragment->next = hl->buckets[bucket];
+  hl->buckets[bucket] = fragment;
+  hl->count++;
+  hl->misses++;
+  hl->cached += sizeof (*fragment) + len + 1 + fragment->count * sizeof (*fragment->runs);
+  return fragment;
+  }
+
+int pk_highlight_html (const struct pk_hl_fragment* fragment, int first_line, bstring out) {
+  int line = first_line;
+  int status = PK_OK;
+  size_t i;
+
+  if (line > 0 && fragment->len > 0) {
+    status = bformata (out, "<span class=\"hl-line\">%d</span>", line++) == BSTR_OK ? PK_OK : PK_ERR;
+    }
+
+  for (i = 0; i < fragment->count && status == PK_OK; i++) {
+    const struct pk_hl_run* run = &fragment->runs[i];
+    const char* p = fragment->text + run->offset;
+    const char* end = p + run->len;
+
+    /* Runs are split at line ends, so that each line can be numbered */
+    while (p < end && status == PK_OK) {
+      const char* eol = (const char*) memchr (p, '\n', (size_t) (end - p));
+      const char* stop = eol ? eol : end;
+
+      if (stop > p && run->cls != PK_HL_PLAIN) {
+        status = bformata (out, "<span class=\"hl-%s\">", class_names[run->cls]) == BSTR_OK ? PK_OK : PK_ERR;
+        }
+
+      if (status == PK_OK) {
+        status = pk_html_escape (out, p, (size_t) (stop - p));
+        }
+
+      if (status == PK_OK && stop > p && run->cls != PK_HL_PLAIN) {
+        status = bcatcstr (out, "</span>") == BSTR_OK ? PK_OK : PK_ERR;
+        }
+
+      p = stop;
+
+      if (eol != NULL && status == PK_OK) {
+        status = bconchar (out, '\n') == BSTR_OK ? PK_OK : PK_ERR;
+        p++;
+
+        /* Number the next line, unless the text ends here */
+        if (status == PK_OK && first_line > 0 && fragment->text + fragment->len > p) {
+          status = bformata (out, "<span class=\"hl-line\">%d</span>", line++) == BSTR_OK ? PK_OK : PK_ERR;
+          }
+        }
+      }
+    }
+
+  return status;
+  }
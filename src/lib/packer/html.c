@@ -0,0 +1,481 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file html.c
+*** \brief HTML backend for the renderer
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/cpu.h"
+#include "packer/render.h"
+#include "packer/span.h"
+
+/* The characters standing for an entity, for pk_scan_set */
+#define HTML_SPECIAL "&<>\""
+
+/* The entity standing for a character, or NULL if it stands for itself */
+static const char* html_entity (char c) {
+  switch (c) {
+    case '&':
+      return "&amp;";
+
+    case '<':
+      return "&lt;";
+
+    case '>':
+      return "&gt;";
+
+    case '"':
+      return "&quot;";
+
+    default:
+      return NULL;
+    }
+  }
+
+int pk_html_escape (bstring out, const char* text, size_t len) {
+  const char* run = text;
+  const char* end = text + len;
+  const char* p;
+  int status = BSTR_OK;
+
+  for (p = text; status == BSTR_OK && (p = pk_scan_set (p, end, HTML_SPECIAL)) < end; p++) {
+    status = bcatblk (out, run, (int) (p - run));
+
+    if (status == BSTR_OK) {
+      status = bcatcstr (out, html_entity (*p));
+      }
+
+    run = p + 1;
+    }
+
+  if (status == BSTR_OK) {
+    status = bcatblk (out, run, (int) (end - run));
+    }
+
+  return status == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+/* The runs between the entities are passed on as they are, so long runs
+ * of plain text are referenced rather than copied
+ */
+static int html_text (struct pk_render* render, const char* text, size_t len) {
+  const char* run = text;
+  const char* end = text + len;
+  const char* p;
+  int status = PK_OK;
+
+  for (p = text; status == PK_OK && (p = pk_scan_set (p, end, HTML_SPECIAL)) < end; p++) {
+    status = pk_render_ref (render, run, (size_t) (p - run));
+
+    if (status == PK_OK) {
+      status = pk_render_puts (render, html_entity (*p));
+      }
+
+    run = p + 1;
+    }
+
+  return status == PK_OK ? pk_render_ref (render, run, (size_t) (end - run)) : status;
+  }
+
+static int html_paragraph (struct pk_render* render, int open) {
+  return pk_render_puts (render, open ? "<p>" : "</p>\n");
+  }
+
+static int html_note (int number, const_bstring body, bstring notes, void* ctx) {
+  (void) ctx;
+
+  return bformata (notes, "<li id=\"fn-%d\">", number) == BSTR_OK && bconcat (notes, body) == BSTR_OK &&
+         bformata (notes, " <a href=\"#fnref-%d\">&#8617;</a></li>\n", number) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int html_notes (const_bstring notes, int first, int last, bstring out, void* ctx) {
+  (void) last;
+  (void) ctx;
+
+  return bformata (out, "<ol class=\"footnotes\" start=\"%d\">\n", first) == BSTR_OK && bconcat (out, notes) == BSTR_OK &&
+         bcatcstr (out, "</ol>\n") == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+/**
+*** Tag Handlers
+**/
+
+/* Look up the element written for a simple tag */
+static const char* element (int tag, int closing) {
+  switch (tag) {
+    case PK_TAG_A:
+      return closing ? "</span>" : "<span class=\"a\">";
+
+    case PK_TAG_AC:
+      return closing ? "</abbr>" : "<abbr>";
+
+    case PK_TAG_ACL:
+      return closing ? "</abbr>" : "<abbr class=\"long\">";
+
+    case PK_TAG_CITE:
+      return closing ? "</cite>" : "<cite>";
+
+    case PK_TAG_COM:
+      return closing ? "</span>" : "<span class=\"com\">";
+
+    case PK_TAG_DL:
+      return closing ? "</ul>\n" : "<ul class=\"dl\">\n";
+
+    case PK_TAG_E:
+      return closing ? "</em>" : "<em>";
+
+    case PK_TAG_ITEM:
+      return closing ? "</li>\n" : "<li>";
+
+    case PK_TAG_MEDSKIP:
+      return closing ? "" : "<div class=\"medskip\"></div>\n";
+
+    case PK_TAG_NOTE:
+      return closing ? "</div>\n" : "<div class=\"note\">\n";
+
+    case PK_TAG_OL:
+      return closing ? "</ol>\n" : "<ol>\n";
+
+    case PK_TAG_QUESTION:
+      return closing ? "</div>\n" : "<div class=\"question\">\n";
+
+    case PK_TAG_QUESTIONS:
+      return closing ? "</div>\n" : "<div class=\"questions\">\n";
+
+    case PK_TAG_QUOTE:
+      return closing ? "</blockquote>\n" : "<blockquote>\n";
+
+    case PK_TAG_S:
+      return closing ? "</strong>" : "<strong>";
+
+    case PK_TAG_SC:
+      return closing ? "</span>" : "<span class=\"sc\">";
+
+    case PK_TAG_TT:
+      return closing ? "</code>" : "<code>";
+
+    case PK_TAG_UL:
+      return closing ? "</ul>\n" : "<ul>\n";
+
+    default:
+      return closing ? "</span>" : "<span>";
+    }
+  }
+
+static int simple_open (struct pk_render* render, struct pk_render_frame* frame) {
+  return pk_render_puts (render, element (frame->open.tag, 0));
+  }
+
+static int simple_close (struct pk_render* render, struct pk_render_frame* frame) {
+  return pk_render_puts (render, element (frame->open.tag, 1));
+  }
+
+/* Write the label of a tag ("[figure:Label]") as its id */
+static int write_id (struct pk_render* render, const struct pk_render_frame* frame) {
+  if (frame->open.label.len == 0) {
+    return PK_OK;
+    }
+
+  return pk_render_puts (render, " id=\"") == PK_OK &&
+         pk_html_escape (pk_render_out (render), frame->open.label.data, frame->open.label.len) == PK_OK &&
+         pk_render_puts (render, "\"") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+static int figure_open (struct pk_render* render, struct pk_render_frame* frame) {
+  return pk_render_puts (render, "<figure") == PK_OK && write_id (render, frame) == PK_OK &&
+         pk_render_puts (render, ">\n") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+static int figure_close (struct pk_render* render, struct pk_render_frame* frame) {
+  (void) frame;
+  return pk_render_puts (render, "</figure>\n");
+  }
+
+/* The caption of a table is kept by the table, and written after the rows */
+static int caption_close (struct pk_render* render, struct pk_render_frame* frame) {
+  struct pk_render_frame* parent = render->depth > 0 ? &render->frames[render->depth - 1] : NULL;
+
+  if (parent != NULL && parent->table != NULL) {
+    bdestroy (parent->table->caption);
+    parent->table->caption = frame->body;
+    frame->body = NULL;
+    return PK_OK;
+    }
+
+  return pk_render_puts (render, "<figcaption>") == PK_OK && bconcat (pk_render_out (render), frame->body) == BSTR_OK &&
+         pk_render_puts (render, "</figcaption>\n") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+/* Rows are written as soon as they are read. Until the table ends only the
+ * alignment given by the rule is known, so numbers are marked cell by cell
+ */
+static int table_row (bstring out, const struct pk_table* table, const struct pk_table_row* row, void* ctx) {
+  const char* name = row->header ? "th" : "td";
+  size_t i;
+
+  (void) ctx;
+
+  if (bcatcstr (out, "<tr>") != BSTR_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < row->count; i++) {
+    struct pk_span cell = pk_table_cell (row, i);
+    int align = i < table->ncolumns ? table->columns[i].align : PK_ALIGN_DEFAULT;
+    const char* style = "";
+
+    if (align == PK_ALIGN_LEFT) {
+      style = " class=\"left\"";
+      }
+
+    else if (align == PK_ALIGN_CENTRE) {
+      style = " class=\"centre\"";
+      }
+
+    else if (align == PK_ALIGN_RIGHT || (!row->header && pk_table_numeric (cell.data, cell.len))) {
+      style = " class=\"right\"";
+      }
+
+    if (bformata (out, "<%s%s>", name, style) != BSTR_OK || bcatblk (out, cell.data, (int) cell.len) != BSTR_OK ||
+        bformata (out, "</%s>", name) != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return bcatcstr (out, "</tr>\n") == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int table_open (struct pk_render* render, struct pk_render_frame* frame) {
+  frame->table = pk_table_new (table_row, 0, NULL);
+
+  return frame->table != NULL && pk_render_puts (render, "<figure class=\"table\"") == PK_OK &&
+         write_id (render, frame) == PK_OK && pk_render_puts (render, ">\n<table>\n") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+static int table_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  const struct pk_table* table = frame->table;
+
+  if (pk_table_finish (frame->table, frame->body, out) != PK_OK || pk_render_puts (render, "</table>\n") != PK_OK) {
+    return PK_ERR;
+    }
+
+  if (table->caption != NULL && (pk_render_puts (render, "<figcaption>") != PK_OK ||
+                                 bconcat (out, table->caption) != BSTR_OK ||
+                                 pk_render_puts (render, "</figcaption>\n") != PK_OK)) {
+    return PK_ERR;
+    }
+
+  return pk_render_puts (render, "</figure>\n");
+  }
+
+/* Headings are diverted until their text, and so their anchor, is known */
+static int heading_close (struct pk_render* render, struct pk_render_frame* frame) {
+  const struct pk_nav_heading* heading;
+  int level = frame->open.tag - PK_TAG_H1 + 1;
+
+  if (pk_nav_outline_add (&render->outline, level, (const char*) frame->text->data, (size_t) blength (frame->text)) !=
+      PK_OK) {
+    return PK_ERR;
+    }
+
+  heading = &render->outline.headings[render->outline.count - 1];
+  return bformata (pk_render_out (render), "<h%d id=\"%s\">", level, bdata (heading->anchor)) == BSTR_OK &&
+         bconcat (pk_render_out (render), frame->body) == BSTR_OK &&
+         bformata (pk_render_out (render), "</h%d>\n", level) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int footnote_open (struct pk_render* render, struct pk_render_frame* frame) {
+  return bformata (pk_render_out (render), "<sup class=\"fn\"><a href=\"#fn-%d\" id=\"fnref-%d\">%d</a></sup>",
+                   frame->number, frame->number, frame->number) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int image_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+
+  btrimws (frame->text);
+  return pk_render_puts (render, "<img src=\"") == PK_OK &&
+         pk_html_escape (out, (const char*) frame->text->data, (size_t) blength (frame->text)) == PK_OK &&
+         pk_render_puts (render, "\" alt=\"") == PK_OK &&
+         pk_html_escape (out, (const char*) frame->text->data, (size_t) blength (frame->text)) == PK_OK &&
+         pk_render_puts (render, "\">") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+/* [link text|url], or just [link url] */
+static int link_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  struct pk_span text = pk_span_bstr (frame->body);
+  struct pk_span url = text;
+  size_t bar = pk_span_rchr (text, '|');
+
+  if (bar != PK_SPAN_NPOS) {
+    url = pk_span_mid (text, bar + 1, text.len);
+    text = pk_span_mid (text, 0, bar);
+    }
+
+  return pk_render_puts (render, "<a href=\"") == PK_OK && pk_span_cat (out, url) == PK_OK &&
+         pk_render_puts (render, "\">") == PK_OK && pk_span_cat (out, text) == PK_OK &&
+         pk_render_puts (render, "</a>") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+static int ref_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  const char* label = (const char*) frame->text->data;
+  size_t len = (size_t) blength (frame->text);
+
+  return pk_render_puts (render, "<a class=\"ref\" href=\"#") == PK_OK && pk_html_escape (out, label, len) == PK_OK &&
+         pk_render_puts (render, "\">") == PK_OK && pk_html_escape (out, label, len) == PK_OK &&
+         pk_render_puts (render, "</a>") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+static int man_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  struct pk_span name;
+  const char* url = NULL;
+
+  btrimws (frame->text);
+  name.data = (const char*) frame->text->data;
+  name.len = (size_t) blength (frame->text);
+
+  if (render->man_index != NULL) {
+    url = pk_man_index_lookup (render->man_index, name, frame->open.label);
+    }
+
+  if (url != NULL && (pk_render_puts (render, "<a class=\"man\" href=\"") != PK_OK ||
+                      pk_html_escape (out, url, strlen (url)) != PK_OK || pk_render_puts (render, "\">") != PK_OK)) {
+    return PK_ERR;
+    }
+
+  return pk_render_puts (render, url ? "" : "<span class=\"man\">") == PK_OK &&
+         pk_html_escape (out, name.data, name.len) == PK_OK &&
+         bformata (out, "(%.*s)", (int) frame->open.label.len, frame->open.label.data) == BSTR_OK &&
+         pk_render_puts (render, url ? "</a>" : "</span>") == PK_OK ? PK_OK : PK_ERR;
+  }
+
+static int verbatim_open (struct pk_render* render, struct pk_render_frame* frame) {
+  const char* kind = frame->open.tag == PK_TAG_CODE ? "code" : frame->open.tag == PK_TAG_COMMAND ? "command" : "output";
+
+  return bformata (pk_render_out (render), "<pre class=\"%s\">", kind) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int verbatim_close (struct pk_render* render, struct pk_render_frame* frame) {
+  (void) frame;
+  return pk_render_puts (render, "</pre>\n");
+  }
+
+/* Listings are highlighted, if the renderer has a highlighter */
+static int code_text (struct pk_render* render, struct pk_render_frame* frame, const char* text, size_t len) {
+  const struct pk_hl_fragment* fragment;
+  struct pk_span lang;
+  int first_line;
+
+  /* The body starts on the line after the tag */
+  if (len > 0 && *text == '\n') {
+    text++;
+    len--;
+    }
+
+  if (render->highlighter == NULL) {
+    return pk_render_text (render, text, len);
+    }
+
+  pk_highlight_args (frame->open.args, &lang, &first_line);
+  fragment = pk_highlight (render->highlighter, lang, text, len);
+  return fragment ? pk_highlight_html (fragment, first_line, pk_render_out (render)) : PK_ERR;
+  }
+
+static int plain_verbatim_text (struct pk_render* render, struct pk_render_frame* frame, const char* text, size_t len) {
+  (void) frame;
+
+  if (len > 0 && *text == '\n') {
+    text++;
+    len--;
+    }
+
+  return pk_render_text (render, text, len);
+  }
+
+#define SIMPLE { simple_open, simple_close, NULL, 0 }
+#define SIMPLE_BLOCK { simple_open, simple_close, NULL, PK_RENDER_BLOCK }
+#define HEADING { NULL, heading_close, NULL, PK_RENDER_BLOCK | PK_RENDER_DIVERT | PK_RENDER_COLLECT }
+
+/* Indexed by enum pk_tag */
+static const struct pk_tag_handler html_tags[PK_TAG_COUNT] = {
+  SIMPLE,                                                       /* unknown */
+  SIMPLE,                                                       /* a */
+  SIMPLE,                                                       /* ac */
+  SIMPLE,                                                       /* acl */
+  { NULL, NULL, NULL, PK_RENDER_BLOCK },                        /* bib */
+  { NULL, caption_close, NULL, PK_RENDER_BLOCK | PK_RENDER_DIVERT }, /* caption */
+  SIMPLE,                                                       /* cite */
+  { verbatim_open, verbatim_close, code_text, 0 },              /* code */
+  SIMPLE,                                                       /* com */
+  { verbatim_open, verbatim_close, plain_verbatim_text, 0 },    /* command */
+  SIMPLE,                                                       /* dl */
+  SIMPLE,                                                       /* e */
+  { NULL, NULL, NULL, 0 },                                      /* end */
+  { figure_open, figure_close, NULL, 0 },                       /* figure */
+  { footnote_open, NULL, NULL, 0 },                             /* fn */
+  HEADING,                                                      /* h1 */
+  HEADING,                                                      /* h2 */
+  HEADING,                                                      /* h3 */
+  { NULL, image_close, NULL, PK_RENDER_COLLECT | PK_RENDER_HIDE }, /* image */
+  SIMPLE_BLOCK,                                                 /* item */
+  { NULL, link_close, NULL, PK_RENDER_DIVERT },                 /* link */
+  { NULL, man_close, NULL, PK_RENDER_COLLECT | PK_RENDER_HIDE }, /* man */
+  SIMPLE_BLOCK,                                                 /* medskip */
+  SIMPLE,                                                       /* note */
+  SIMPLE,                                                       /* ol */
+  { verbatim_open, verbatim_close, plain_verbatim_text, 0 },    /* output */
+  SIMPLE,                                                       /* question */
+  SIMPLE,                                                       /* questions */
+  SIMPLE,                                                       /* quote */
+  { NULL, ref_close, NULL, PK_RENDER_COLLECT | PK_RENDER_HIDE }, /* ref */
+  SIMPLE,                                                       /* s */
+  SIMPLE,                                                       /* sc */
+  { table_open, table_close, pk_render_table_text, PK_RENDER_DIVERT }, /* table */
+  SIMPLE,                                                       /* tt */
+  SIMPLE                                                        /* ul */
+  };
+
+/* Notes go at the end of the page, as is usual on the web */
+const struct pk_backend pk_backend_html = {
+  "html",
+  PK_FN_DOCUMENT,
+  html_tags,
+  html_text,
+  html_paragraph,
+  html_note,
+  html_notes
+  };
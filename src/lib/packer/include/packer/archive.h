@@ -0,0 +1,160 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file archive.h
+*** \brief Site archives holding every compiled page of a site in one file
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_ARCHIVE_H
+#define PACKER_ARCHIVE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+#include "packer/doc.h"
+#include "packer/lexer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Site Archives. An archive holds the compiled documents of a whole
+*** site in one file, found by their path within the site. Every page
+*** shares one string table, so tag names, arguments and repeated text
+*** fragments are stored once for the whole site. Readers map the file
+*** and find a page through a hash table of paths, then read its nodes
+*** in place: nothing is parsed or copied on opening.
+***
+*** The file is a fixed header followed by five tables. All integers are
+*** 32-bit little endian, except the node fields noted below:
+***
+***   header:    "PKARCH01", then the number of documents, slots, strings
+***              and nodes, the offset of each table, and the pool size
+***   slots:     hash of the path, path string, document + 1 (0: empty)
+***   documents: path string, first node, number of nodes
+***   nodes:     24 bytes each, laid out as struct pk_doc_node. The close
+***              of an OPEN node counts from the first node of its page
+***   offsets:   start of each string in the pool
+***   pool:      the strings, each NUL terminated
+***
+*** Documents are ordered by path, and strings by first use, so the same
+*** site always makes the same archive.
+**/
+
+struct pk_archive_builder;
+struct pk_archive;
+
+/* Returned when a page is added at the path of one added before */
+#define PK_ARCHIVE_DUPLICATE (-2)
+
+/* What one page of an archive cost to build */
+struct pk_archive_page_stats {
+  const char* path;     /*< Path of the page in the site (owned by the builder) */
+  size_t      size;     /*< Bytes of source */
+  size_t      nodes;    /*< Nodes compiled */
+  uint64_t    read;     /*< Nanoseconds reading the source */
+  uint64_t    compile;  /*< Nanoseconds lexing and parsing the page */
+  uint64_t    emit;     /*< Nanoseconds laying the page out (set once written) */
+  };
+
+/* Start a new, empty archive */
+struct pk_archive_builder* pk_archive_builder_new (void);
+
+/* Release the builder */
+void pk_archive_builder_free (struct pk_archive_builder* builder);
+
+/* Compile every page added from now on within limits (NULL for the
+ * defaults). The limits must outlive the builder
+ */
+void pk_archive_builder_limit (struct pk_archive_builder* builder, const struct pk_limits* limits);
+
+/* Add what each kind of tag costs to compile, for every page added from
+ * now on, to costs (NULL to stop counting). The costs must outlive the
+ * builder
+ */
+void pk_archive_builder_count_tags (struct pk_archive_builder* builder, struct pk_tag_costs* costs);
+
+/* Compile the len bytes of buf as the page at path. Returns
+ * PK_ARCHIVE_DUPLICATE, adding nothing, if a page is already at path
+ */
+int pk_archive_builder_add (struct pk_archive_builder* builder, const char* path, const char* buf, size_t len);
+
+/* Compile the Bayeux file at file as the page at path */
+int pk_archive_builder_add_file (struct pk_archive_builder* builder, const char* path, const char* file);
+
+/* Compile the Bayeux file at file as the page at path. If file is a
+ * directory, every Bayeux (.byx) file below it is compiled instead, at
+ * its path from file placed under path. A NULL path names a file by
+ * itself, and puts the pages of a directory at the top of the site.
+ * Stops with PK_ARCHIVE_DUPLICATE at a page already in the archive
+ */
+int pk_archive_builder_scan (struct pk_archive_builder* builder, const char* file, const char* path);
+
+/* The number of pages added so far */
+size_t pk_archive_builder_count (const struct pk_archive_builder* builder);
+
+/* Fill stats with what page (counted from 0, in the order added) cost to
+ * build. Returns PK_ERR if there is no such page
+ */
+int pk_archive_builder_stats (const struct pk_archive_builder* builder, size_t page,
+                              struct pk_archive_page_stats* stats);
+
+/* The string table shared by the pages */
+const struct pk_intern* pk_archive_builder_strings (const struct pk_archive_builder* builder);
+
+/* Write the archive to path (replacing any existing file) */
+int pk_archive_builder_write (struct pk_archive_builder* builder, const char* path);
+
+/* Map an archive written by pk_archive_builder_write. Returns NULL if the
+ * file is missing or malformed
+ */
+struct pk_archive* pk_archive_open (const char* path);
+
+/* Release the archive */
+void pk_archive_close (struct pk_archive* archive);
+
+/* The number of documents in the archive */
+size_t pk_archive_count (const struct pk_archive* archive);
+
+/* Find the document at path, setting *document to its number */
+int pk_archive_find (const struct pk_archive* archive, struct pk_span path, size_t* document);
+
+/* The path of a document (owned by the archive), or NULL */
+const char* pk_archive_path (const struct pk_archive* archive, size_t document);
+
+/* The number of nodes in a document */
+size_t pk_archive_nodes (const struct pk_archive* archive, size_t document);
+
+/* Fill token with a node of a document. The spans of the token point
+ * into the archive
+ */
+int pk_archive_token (const struct pk_archive* archive, size_t document, size_t node, struct pk_token* token);
+
+/* Append the nodes of a document to doc, interning its strings into the
+ * table of doc
+ */
+int pk_archive_load (const struct pk_archive* archive, size_t document, struct pk_doc* doc);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
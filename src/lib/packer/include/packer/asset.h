@@ -0,0 +1,127 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file asset.h
+*** \brief Resolution, de-duplication and copying of image assets
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_ASSET_H
+#define PACKER_ASSET_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Assets. Pages refer to figures by name (+[image pfSense_menu]+). The
+*** asset table resolves each name to a file, near the page first and
+*** then along the search path, and processes each distinct file once:
+***
+***  1. In parallel, every file is hashed and its dimensions read from the
+***     image header. Files whose size and modification time match the
+***     dimension cache are not read at all.
+***  2. Files with identical content are folded onto one canonical asset,
+***     whose output name is derived from the content hash. Files are
+***     only folded once their bytes compare equal: different content
+***     under the same hash gets a numbered name instead.
+***  3. In parallel, each canonical asset is copied to the output
+***     directory, by reflink or copy_file_range where the platform and
+***     file system allow it. Outputs already present are left alone,
+***     once their bytes are checked against the source.
+**/
+
+/* States of an asset */
+enum {
+  PK_ASSET_RESOLVED = 0,  /*< Found, but not yet processed */
+  PK_ASSET_MISSING,       /*< No file matches the reference */
+  PK_ASSET_HASHED,        /*< Hashed and measured */
+  PK_ASSET_COPIED,        /*< Present in the output directory */
+  PK_ASSET_FAILED         /*< The file could not be read or copied */
+  };
+
+struct pk_asset {
+  bstring          name;      /*< Name as referenced by the page */
+  bstring          source;    /*< Path of the resolved file */
+  bstring          target;    /*< Path of the content addressed output */
+  uint64_t         hash;      /*< Hash of the file content */
+  long             size;      /*< Size of the file in bytes */
+  long             mtime;     /*< Modification time of the file */
+  int              width;     /*< Width in pixels (zero if unknown) */
+  int              height;    /*< Height in pixels (zero if unknown) */
+  int              state;     /*< One of the PK_ASSET_* states */
+  struct pk_asset* canonical; /*< The asset holding the same content (may be this one) */
+  };
+
+struct pk_assets;
+
+/* Create an asset table writing to output_dir with up to workers
+ * threads (zero for one per processor). root bounds the search for
+ * assets up the directory tree (NULL to search only the page directory)
+ */
+struct pk_assets* pk_assets_new (const char* output_dir, const char* root, int workers);
+
+/* Release the table and all its assets */
+void pk_assets_free (struct pk_assets* assets);
+
+/* Add a directory to search after the directories around the page */
+int pk_assets_add_search_dir (struct pk_assets* assets, const char* dir);
+
+/* Resolve the image name referenced from the page at page_path. Each file
+ * is only held once, however many times it is referenced. Returns NULL if
+ * memory could not be allocated: an unresolved reference returns an asset
+ * in the PK_ASSET_MISSING state
+ */
+struct pk_asset* pk_assets_add (struct pk_assets* assets, const char* page_path, const char* name);
+
+/* Add every [image] referenced in the len bytes of Bayeux source */
+int pk_assets_collect (struct pk_assets* assets, const char* page_path, const char* buf, size_t len);
+
+/* Hash, de-duplicate and copy every asset added so far. Returns the
+ * number of assets that failed, or PK_ERR on a resource failure
+ */
+int pk_assets_process (struct pk_assets* assets);
+
+/* Visit each asset in the order they were added */
+size_t pk_assets_count (const struct pk_assets* assets);
+struct pk_asset* pk_assets_get (struct pk_assets* assets, size_t index);
+
+/* Read the size of the image in the open file from its header, without
+ * reading the image data. Understands PNG, GIF, JPEG and BMP. Returns
+ * PK_ERR if the format is not recognised
+ */
+int pk_image_size (FILE* file, int* width, int* height);
+
+/* Save and load the dimension cache, so unchanged files are not re-read
+ * in later runs
+ */
+int pk_assets_save_cache (struct pk_assets* assets, FILE* file);
+int pk_assets_load_cache (struct pk_assets* assets, FILE* file);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
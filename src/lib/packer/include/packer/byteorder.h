@@ -0,0 +1,62 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file byteorder.h
+*** \brief Columns of little endian integers read from the file formats
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_BYTEORDER_H
+#define PACKER_BYTEORDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Byte Order. Every integer in a .pdoc file or a site archive is little
+*** endian, whatever the host that wrote it, so one file serves every
+*** machine. Readers take whole columns of integers at a time through a
+*** view: on a little endian host an aligned column is read in place,
+*** straight from the mapped file, and anything else is decoded into
+*** scratch memory. On a big endian host that is a byte swap, made a
+*** 64-bit word (two or four integers) at a time.
+**/
+
+/* View the n little endian 32-bit integers at p as host integers. The
+ * column is read in place where it can be, and *scratch set to NULL;
+ * otherwise it is decoded into memory allocated for *scratch, which the
+ * caller frees. Returns NULL if that memory cannot be allocated
+ */
+const uint32_t* pk_le32_view (const unsigned char* p, size_t n, uint32_t** scratch);
+
+/* View the n little endian 16-bit integers at p as host integers, as
+ * pk_le32_view does
+ */
+const uint16_t* pk_le16_view (const unsigned char* p, size_t n, uint16_t** scratch);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
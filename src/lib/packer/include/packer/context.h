@@ -0,0 +1,113 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file context.h
+*** \brief Long-lived compile context for embedding the compiler
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_CONTEXT_H
+#define PACKER_CONTEXT_H
+
+#include <stdio.h>
+
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+#include "packer/doc.h"
+#include "packer/highlight.h"
+#include "packer/lexer.h"
+#include "packer/manindex.h"
+#include "packer/render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Compile Contexts. A context holds everything that outlives a single
+*** page, so a program that compiles many pages (a web application, say)
+*** pays for it once: the compiled highlighting languages and the cache
+*** of highlighted listings, the manual page index, the chosen backend,
+*** the limits, and the memory of the last page compiled, which is
+*** emptied and reused by the next.
+***
+*** Pages are compiled and rendered from memory. A context is not safe to
+*** share between threads; use one per thread. The cache of listings is
+*** emptied whenever it grows past cache_limit bytes, so a context can
+*** serve any number of pages in bounded memory.
+**/
+
+/* Bytes of highlighted listings kept by default */
+#define PK_CONTEXT_CACHE_SIZE (16UL * 1024 * 1024)
+
+struct pk_context {
+  struct pk_doc            doc;           /*< The page last compiled (with a string table of its own) */
+  struct pk_highlighter*   highlighter;   /*< Compiled languages and listings, kept across pages */
+  struct pk_man_index*     man_index;     /*< Index for [man] (may be NULL) */
+  const struct pk_backend* backend;       /*< Output format for rendering (HTML by default) */
+  struct pk_limits         limits;        /*< Limits on each page (the defaults to start with) */
+  size_t                   cache_limit;   /*< Bytes of listings kept before the cache is emptied */
+  unsigned                 limited;       /*< PK_LIMIT_* flags of the limits reached by the last page */
+  int                      notes;         /*< Number of footnotes of the page last rendered */
+  size_t                   pages;         /*< Pages compiled or rendered so far */
+  struct pk_tag_costs*     costs;         /*< Cost of each kind of tag rendered, if counted */
+  struct pk_tag_costs*     compile_costs; /*< Cost of each kind of tag compiled, if counted */
+  };
+
+/* Create a context, rendering HTML with the default limits */
+struct pk_context* pk_context_new (void);
+
+/* Release the context, and everything it holds */
+void pk_context_free (struct pk_context* context);
+
+/* Link [man] references through the index at path, or through no index
+ * if path is NULL. Returns PK_ERR (leaving no index) if the index cannot
+ * be opened
+ */
+int pk_context_man_index (struct pk_context* context, const char* path);
+
+/* Count what each kind of tag costs to compile, in compile_costs, and to
+ * render, in costs, from the next page on. The costs add up over every
+ * page the context compiles or renders
+ */
+int pk_context_count_tags (struct pk_context* context);
+
+/* Render with the named backend. Returns PK_ERR (keeping the backend
+ * already chosen) if there is no such backend
+ */
+int pk_context_backend (struct pk_context* context, const char* name);
+
+/* Compile the len bytes of buf. The document belongs to the context, and
+ * lasts until the next page is compiled. Returns NULL if the page cannot
+ * be compiled: limited tells whether a limit was reached
+ */
+const struct pk_doc* pk_context_compile (struct pk_context* context, const char* buf, size_t len);
+
+/* Render the len bytes of buf to file */
+int pk_context_render (struct pk_context* context, const char* buf, size_t len, FILE* file);
+
+/* Render the len bytes of buf, returning the output (which the caller
+ * owns), or NULL if the page cannot be rendered
+ */
+bstring pk_context_render_string (struct pk_context* context, const char* buf, size_t len);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,95 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file cpu.h
+*** \brief Binding of the scanning kernels to the features of the processor
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_CPU_H
+#define PACKER_CPU_H
+
+#include <stddef.h>
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** CPU Feature Dispatch. The kernels scanning text byte by byte have a
+*** variant for each x86 vector extension that helps them, besides the
+*** portable code every build has. The processor is probed once, on the
+*** first use of a kernel, and each kernel bound to the widest variant
+*** the processor runs. One binary therefore serves every generation of
+*** machine. pk_cpu_select narrows the choice, to test the narrower
+*** variants, or to keep a mixed fleet on the same code paths.
+***
+*** Kernels:
+***
+***   pk_scan_set:  find the first of up to four bytes (escaping, tables)
+**/
+
+enum {
+  PK_CPU_SSE2   = 0x1,  /*< 128-bit integer vectors */
+  PK_CPU_SSE42  = 0x2,  /*< SSE 4.2 string comparisons */
+  PK_CPU_AVX2   = 0x4,  /*< 256-bit integer vectors */
+  PK_CPU_AVX512 = 0x8   /*< 512-bit byte vectors (AVX-512 F and BW) */
+  };
+
+/* The features of the processor (0 where the build cannot probe it) */
+unsigned pk_cpu_detected (void);
+
+/* The features the kernels may use. A kernel without a variant for a
+ * feature uses a narrower one: see pk_cpu_describe_kernels
+ */
+unsigned pk_cpu_features (void);
+
+/* Bind the kernels to the features in names, a comma separated list of
+ * "sse2", "sse4.2", "avx2" and "avx512", or "none" for the portable code
+ * alone. NULL binds them to every feature detected. Features the
+ * processor lacks are left out. Returns PK_ERR, binding nothing, if a
+ * name is not known. The kernels are rebound without locking, so call
+ * this before other threads use the library
+ */
+int pk_cpu_select (const char* names);
+
+/* Append the names of the features to out, comma separated ("none" if
+ * there are none)
+ */
+int pk_cpu_describe (bstring out, unsigned features);
+
+/* Append the variant each kernel is bound to, as "kernel=variant" pairs,
+ * comma separated. The variant is named by its feature, or "portable"
+ */
+int pk_cpu_describe_kernels (bstring out);
+
+/* The first byte of [p, end) that is one of the four bytes of set, or
+ * end if there is none. Repeat a byte to look for fewer
+ */
+const char* pk_scan_set (const char* p, const char* end, const char* set);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file dfa.h
+*** \brief Table-driven DFAs compiled from simple regular expressions
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_DFA_H
+#define PACKER_DFA_H
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** DFA Scanner. A set of rules, each a regular expression, is compiled
+*** once into a single deterministic automaton. Matching then costs one
+*** table lookup per input byte, whatever the number of rules.
+***
+*** The expressions support literals, +.+ (any byte but newline), classes
+*** (+[a-z_]+, +[^\n]+), grouping, alternation (+|+) and the +*+, +++ and
+*** +?+ operators. A backslash quotes the next character; +\n+, +\r+ and
+*** +\t+ have their usual meaning. Matches are longest first: where two
+*** rules match the same length, the earlier rule wins.
+***
+*** Bytes which no rule can tell apart share a column of the transition
+*** table, so the tables stay small even with many rules. States from
+*** which no rule can be accepted are removed, so a scan stops on the
+*** first byte that rules out every longer match.
+**/
+
+/* Upper bound on the number of states in a compiled automaton */
+#define PK_DFA_MAX_STATES 4096
+
+struct pk_dfa {
+  int           nstates;        /*< Number of states (the start state is 0) */
+  int           nclasses;       /*< Number of byte classes (table columns) */
+  unsigned char classes[256];   /*< Byte class of each byte */
+  int*          next;           /*< nstates x nclasses transitions (-1: no transition) */
+  int*          accept;         /*< Rule accepted in each state (-1: none) */
+  int*          pending;        /*< Earliest rule still reachable from each state */
+  };
+
+/* Compile the count rules in patterns into one automaton. Returns NULL if
+ * a pattern is malformed, the automaton is too large, or memory could not
+ * be allocated
+ */
+struct pk_dfa* pk_dfa_compile (const char* const* patterns, size_t count);
+
+/* Release a compiled automaton */
+void pk_dfa_free (struct pk_dfa* dfa);
+
+/* Find the longest match at the start of the len bytes of text. Returns
+ * the index of the matching rule, with the length of the match in
+ * match_len, or -1 if no rule matches a non-empty prefix.
+ *
+ * If the text runs out while a longer match is still possible, open is
+ * set to the earliest rule that could still match (-1 otherwise). This
+ * is how an unclosed construct, such as a comment missing its end, is
+ * found without scanning the rest of the text again from each offset
+ */
+int pk_dfa_match (const struct pk_dfa* dfa, const char* text, size_t len, size_t* match_len, int* open);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
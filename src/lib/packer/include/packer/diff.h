@@ -0,0 +1,100 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file diff.h
+*** \brief Structural differences between two compiled documents
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_DIFF_H
+#define PACKER_DIFF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+#include "packer/doc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Structural Differences. Two versions of a document are compared as
+*** trees of tags, not as lines of text. Every subtree is hashed first,
+*** from the content of its nodes but not their line numbers, so runs of
+*** identical tags are passed over by comparing one hash each, and a tag
+*** that has only moved is recognised wherever it lands.
+***
+*** Within each pair of matching tags, the children are compared in
+*** three steps. Identical children at the start and end are skipped.
+*** The rest are matched by hash. Children found exactly once on each
+*** side anchor the comparison: the longest run of anchors kept in order
+*** is left alone, and the other anchors are reported as moved. Repeated
+*** children, such as the blank text between tags, are paired within the
+*** same gap between kept anchors, so they never outweigh the tags around
+*** them; blank text is never reported as moved. Children still without a
+*** match are paired, within the same gap, with a child of the same kind
+*** (the same tag, or both text) and reported as changed: first those most
+*** alike, sharing the most children or text at either end, then the rest
+*** in order. The children of changed tags are compared in turn. Anything
+*** left over was inserted or deleted.
+**/
+
+/* Marks a change with no node on one side */
+#define PK_DIFF_NONE ( (size_t) -1)
+
+enum pk_diff_kind {
+  PK_DIFF_INSERTED,   /*< Only in the new version */
+  PK_DIFF_DELETED,    /*< Only in the old version */
+  PK_DIFF_CHANGED,    /*< Text or tag header edited in place */
+  PK_DIFF_MOVED       /*< Unchanged, but moved among its siblings */
+  };
+
+struct pk_diff_change {
+  enum pk_diff_kind kind;       /*< What happened */
+  size_t            before;     /*< Node in the old version, or PK_DIFF_NONE */
+  size_t            after;      /*< Node in the new version, or PK_DIFF_NONE */
+  size_t            parent;     /*< Enclosing OPEN node in the new version, or PK_DIFF_NONE */
+  size_t            where;      /*< Position in the new version, for ordering */
+  size_t            sequence;   /*< Order the change was found in */
+  };
+
+struct pk_diff {
+  struct pk_diff_change* changes;   /*< The changes, in order through the new version */
+  size_t                 count;     /*< Number of changes */
+  size_t                 capacity;  /*< Number of changes allocated */
+  };
+
+/* Hash every node of a document. Each OPEN node gets the hash of its
+ * whole subtree; other nodes the hash of their own content. hashes must
+ * hold doc->count values
+ */
+int pk_diff_hash (const struct pk_doc* doc, uint64_t* hashes);
+
+/* Compare two versions of a document, filling diff with the changes */
+int pk_diff_docs (struct pk_diff* diff, const struct pk_doc* before, const struct pk_doc* after);
+
+/* Release the changes of a diff */
+void pk_diff_clear (struct pk_diff* diff);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
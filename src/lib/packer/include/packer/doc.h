@@ -0,0 +1,184 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file doc.h
+*** \brief Compiled Bayeux documents, and the .pdoc files that hold them
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_DOC_H
+#define PACKER_DOC_H
+
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+#include "packer/intern.h"
+#include "packer/io.h"
+#include "packer/lexer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Compiled Documents. A compiled document is the token stream of a page,
+*** kept as an array of fixed-size nodes in document order. Nodes name
+*** their strings by interned identifier, so a document costs a few words
+*** per token, and every repeat of a literal shares one copy. Each OPEN
+*** node records where its tag ends, so whole subtrees can be skipped.
+***
+*** A .pdoc file holds one compiled document, cut into sections at each
+*** top level heading. Every section is stored as a block of its own,
+*** compressed with pk_lz_compress, so a reader can expand just the
+*** section it serves. All integers are little endian, whatever the host
+*** that wrote them, and stored blocks start on a four byte boundary.
+***
+***   header   "PKPDOC02", then the number of nodes and of sections, and
+***            the offsets of the section index and of the blocks
+***   index    32 bytes per section: its first node, its number of nodes
+***            and of strings, the codec (0 stored, 1 LZ), and the offset
+***            and size of its block both before and after compression
+***   blocks   one per section, each holding its nodes, the start of each
+***            string in its pool, and the pool of NUL terminated strings
+***   postings for each tag, the place and number of its OPEN nodes in the
+***            list that follows; then that list of node numbers, in
+***            document order, tag by tag
+***
+*** The offset of the postings and the number of tags they cover end the
+*** header. Both are zero in files written without postings.
+***
+*** The nodes of a block are stored a field at a time, in the order of
+*** struct pk_doc_node (24 bytes per node in all), as like values pack
+*** far better side by side. Each line is stored as the step from the
+*** line before, and the close of each OPEN node as the distance on to
+*** it. Identifiers in a block index the strings of that block, and are
+*** mapped back into the table of the reader as the block is read.
+**/
+
+struct pk_doc_node {
+  uint8_t  type;    /*< Token type (enum pk_token_type) */
+  uint8_t  tag;     /*< Tag identifier (enum pk_tag) */
+  uint16_t flags;   /*< PK_TAG_* and PK_TOKEN_* flags */
+  uint32_t line;    /*< Line the token starts on */
+  uint32_t text;    /*< TEXT: the text. OPEN: the name of the tag */
+  uint32_t label;   /*< OPEN: the label after the colon */
+  uint32_t args;    /*< OPEN: the header arguments */
+  uint32_t close;   /*< OPEN: index of the matching CLOSE or END node */
+  };
+
+struct pk_doc {
+  struct pk_intern*       strings;       /*< Table holding the strings of the nodes */
+  int                     owned;         /*< Non-zero if the table belongs to the document */
+  struct pk_doc_node*     nodes;         /*< The nodes, in document order */
+  size_t                  count;         /*< Number of nodes */
+  size_t                  capacity;      /*< Number of nodes allocated */
+  uint32_t*               open;          /*< Nodes of the tags still open while compiling */
+  size_t                  depth;         /*< Number of tags still open */
+  size_t                  open_capacity;
+  const struct pk_limits* limits;        /*< Limits on compiling a page (NULL for the defaults) */
+  unsigned                limited;       /*< PK_LIMIT_* flags of the limits reached while compiling */
+  struct pk_tag_costs*    costs;         /*< Where the cost of compiling each tag is counted (may be NULL) */
+  };
+
+/* Set up an empty document. Strings are interned into the given table,
+ * which may be shared by every document of a site; if it is NULL the
+ * document keeps a table of its own
+ */
+int pk_doc_init (struct pk_doc* doc, struct pk_intern* strings);
+
+/* Release the document (and its string table, if it owns one) */
+void pk_doc_clear (struct pk_doc* doc);
+
+/* Empty the document, keeping its memory for the next page. A table of
+ * its own is emptied too; a shared table is left alone
+ */
+void pk_doc_reset (struct pk_doc* doc);
+
+/* Append a token to the document */
+int pk_doc_add (struct pk_doc* doc, const struct pk_token* token);
+
+/* Lex the len bytes of buf, appending every token to the document. Tags
+ * nested past the depth limit are kept as text; a page with more tokens
+ * than the token limit fails to compile. The cost of each tag is added
+ * to costs, if the document has them
+ */
+int pk_doc_compile (struct pk_doc* doc, const char* buf, size_t len);
+
+/* Fill token with node index of the document. The spans of the token
+ * point into the string table
+ */
+void pk_doc_token (const struct pk_doc* doc, size_t index, struct pk_token* token);
+
+/* Write the document to a .pdoc file */
+int pk_doc_write (const struct pk_doc* doc, const char* path);
+
+/* Read a .pdoc file, appending its nodes to an empty document */
+int pk_doc_read (struct pk_doc* doc, const char* path);
+
+/**
+*** Sections. To read part of a document, open the file, then load the
+*** sections wanted. Only the blocks of those sections are expanded.
+**/
+
+struct pk_doc_file {
+  struct pk_mapping    map;       /*< The file, mapped into memory */
+  const unsigned char* index;     /*< The section index, within the mapping */
+  const unsigned char* blocks;    /*< Start of the section blocks */
+  uint32_t             nodes;     /*< Number of nodes in the document */
+  uint32_t             sections;  /*< Number of sections */
+  const unsigned char* postings;  /*< The tag postings, or NULL */
+  uint32_t             tags;      /*< Number of tags with postings */
+  };
+
+struct pk_doc_section {
+  uint32_t first;       /*< Index of the first node of the section */
+  uint32_t nodes;       /*< Number of nodes in the section */
+  uint32_t size;        /*< Size of its block before compression */
+  uint32_t stored;      /*< Size of its block in the file */
+  };
+
+/* Map a .pdoc file and check its section index */
+int pk_doc_open (struct pk_doc_file* file, const char* path);
+
+/* Release a file opened by pk_doc_open */
+void pk_doc_close (struct pk_doc_file* file);
+
+/* Describe a section of an open file */
+int pk_doc_section (const struct pk_doc_file* file, size_t section, struct pk_doc_section* info);
+
+/* Read a section of an open file, appending its nodes to the document */
+int pk_doc_load (struct pk_doc* doc, const struct pk_doc_file* file, size_t section);
+
+/* The section of an open file holding a node */
+size_t pk_doc_section_of (const struct pk_doc_file* file, uint32_t node);
+
+/* Set count to the number of OPEN nodes of a tag in an open file. Returns
+ * PK_ERR if the file has no postings
+ */
+int pk_doc_tag_count (const struct pk_doc_file* file, int tag, uint32_t* count);
+
+/* The nth OPEN node of a tag in an open file, in document order. n must
+ * be less than the count given by pk_doc_tag_count
+ */
+uint32_t pk_doc_tag_node (const struct pk_doc_file* file, int tag, uint32_t n);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file footnote.h
+*** \brief Streaming footnote numbering and deferral
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_FOOTNOTE_H
+#define PACKER_FOOTNOTE_H
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Footnotes. Notes are numbered as the token stream passes them, and
+*** their rendered bodies are set aside in a side buffer until the end
+*** of the section or of the document (as the backend prefers), when they
+*** are written out in number order. Only the notes of the current
+*** section are ever held, and the document is never walked twice.
+***
+*** The engine knows nothing of the output format: the backend supplies
+*** one callback to format each note, and one to wrap the notes of a
+*** section or document when they are flushed.
+**/
+
+/* Where the notes are written */
+enum pk_fn_placement {
+  PK_FN_DOCUMENT = 0,   /*< All notes at the end of the document */
+  PK_FN_SECTION         /*< The notes of each section at the end of that section */
+  };
+
+/* Format one note (number, with the rendered body) onto the end of notes */
+typedef int (pk_fn_format_fn) (int number, const_bstring body, bstring notes, void* ctx);
+
+/* Write the formatted notes numbered first to last onto the end of out */
+typedef int (pk_fn_flush_fn) (const_bstring notes, int first, int last, bstring out, void* ctx);
+
+struct pk_footnotes {
+  int              placement;   /*< One of enum pk_fn_placement */
+  int              next;        /*< Number of the next note */
+  int              first;       /*< Number of the first note not yet flushed */
+  bstring*         bodies;      /*< Formatted notes waiting to be flushed, from first */
+  size_t           capacity;    /*< Number of bodies allocated */
+  pk_fn_format_fn* format;      /*< Formats one note */
+  pk_fn_flush_fn*  flush;       /*< Wraps the flushed notes */
+  void*            ctx;         /*< Context for the callbacks */
+  };
+
+/* Initialise the engine, with notes numbered from one */
+void pk_footnotes_init (struct pk_footnotes* notes, int placement, pk_fn_format_fn* format, pk_fn_flush_fn* flush,
+                        void* ctx);
+
+/* Release any notes still waiting */
+void pk_footnotes_clear (struct pk_footnotes* notes);
+
+/* Number the next note, as its reference is reached in the stream */
+int pk_footnote_number (struct pk_footnotes* notes);
+
+/* Set aside the rendered body of the note with the given number. Notes
+ * may be completed out of order (a note within a note completes first)
+ */
+int pk_footnote_add (struct pk_footnotes* notes, int number, const_bstring body);
+
+/* Mark the end of a section: the waiting notes are written to out if the
+ * notes are placed by section
+ */
+int pk_footnotes_section_end (struct pk_footnotes* notes, bstring out);
+
+/* Mark the end of the document: any waiting notes are written to out */
+int pk_footnotes_document_end (struct pk_footnotes* notes, bstring out);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
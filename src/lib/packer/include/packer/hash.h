@@ -0,0 +1,55 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file hash.h
+*** \brief Non-cryptographic hashes used for tables and caches
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_HASH_H
+#define PACKER_HASH_H
+
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Hash a block of bytes with 64-bit FNV-1a. Fast for the short keys
+ * (paths, tag names, literals) that make up most of our lookups
+ */
+uint64_t pk_hash_bytes (const void* data, size_t len);
+
+/* Continue a pk_hash_bytes hash over more data, so large inputs can be
+ * hashed in pieces. Start from pk_hash_seed (): hashing in pieces gives the
+ * same result as hashing the whole block at once
+ */
+uint64_t pk_hash_continue (uint64_t hash, const void* data, size_t len);
+
+/* The starting value for pk_hash_continue */
+uint64_t pk_hash_seed (void);
+
+/* Hash a NUL terminated C string with pk_hash_bytes */
+uint64_t pk_hash_cstr (const char* str);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,121 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file highlight.h
+*** \brief Syntax highlighting of code listings
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_HIGHLIGHT_H
+#define PACKER_HIGHLIGHT_H
+
+#include <stdint.h>
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Highlighter. Splits the body of a +[code lang|line]+ block into runs
+*** of text, each with a highlight class. Each language is a list of
+*** rules compiled, on first use, into one table-driven DFA (see dfa.h).
+***
+*** Highlighted fragments are cached by the hash of their language and
+*** text, so a listing repeated across pages is only scanned once per
+*** highlighter. Languages we do not know are returned as a single plain
+*** run.
+**/
+
+enum pk_hl_class {
+  PK_HL_PLAIN = 0,    /*< Names, white space and anything unrecognised */
+  PK_HL_COMMENT,      /*< Comments */
+  PK_HL_KEYWORD,      /*< Keywords and record types */
+  PK_HL_TYPE,         /*< Type names */
+  PK_HL_STRING,       /*< Quoted strings */
+  PK_HL_NUMBER,       /*< Numbers, addresses and durations */
+  PK_HL_VARIABLE,     /*< Variable references */
+  PK_HL_PREPROC,      /*< Directives (+#include+, +$TTL+) */
+  PK_HL_OPERATOR,     /*< Operators and punctuation */
+  PK_HL_COUNT
+  };
+
+struct pk_hl_run {
+  size_t offset;  /*< Start of the run in the fragment text */
+  size_t len;     /*< Length of the run */
+  int    cls;     /*< One of enum pk_hl_class */
+  };
+
+struct pk_hl_fragment {
+  char*                  text;      /*< Copy of the highlighted text */
+  size_t                 len;       /*< Length of the text */
+  int                    lang;      /*< Language index (-1 if unknown) */
+  struct pk_hl_run*      runs;      /*< The runs, covering the whole text */
+  size_t                 count;     /*< Number of runs */
+  uint64_t               hash;      /*< Hash of the language and text */
+  struct pk_hl_fragment* next;      /*< Next fragment in the same cache bucket */
+  };
+
+struct pk_highlighter;
+
+/* Create a highlighter, with an empty cache */
+struct pk_highlighter* pk_highlighter_new (void);
+
+/* Release the highlighter, its compiled languages and its cache */
+void pk_highlighter_free (struct pk_highlighter* hl);
+
+/* Empty the cache of fragments, keeping the compiled languages. Every
+ * fragment handed out so far is released
+ */
+void pk_highlight_flush (struct pk_highlighter* hl);
+
+/* The number of bytes held by the cache */
+size_t pk_highlight_cached (const struct pk_highlighter* hl);
+
+/* Highlight the len bytes of text as the named language. The fragment is
+ * owned by the highlighter. Returns NULL if memory could not be allocated,
+ * or the language is known but its rules could not be compiled
+ */
+const struct pk_hl_fragment* pk_highlight (struct pk_highlighter* hl, struct pk_span lang, const char* text,
+    size_t len);
+
+/* Split the arguments of a code block (e.g. "bind|18") into the language
+ * and the number of the first line (zero if not given)
+ */
+void pk_highlight_args (struct pk_span args, struct pk_span* lang, int* first_line);
+
+/* Append the fragment to out as HTML, with a span for each highlighted
+ * run. If first_line is positive, each line is prefixed with its number
+ */
+int pk_highlight_html (const struct pk_hl_fragment* fragment, int first_line, bstring out);
+
+/* The name of a highlight class (e.g. "comment") */
+const char* pk_hl_class_name (int cls);
+
+/* The number of fragments found in, and added to, the cache */
+void pk_highlight_stats (const struct pk_highlighter* hl, size_t* hits, size_t* misses);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,98 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file intern.h
+*** \brief Site-wide table of interned strings
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_INTERN_H
+#define PACKER_INTERN_H
+
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** String Interning. The same short strings turn up again and again
+*** across a site: tag names and arguments, and literals such as
+*** +[tt 192.168.7.1/24]+ or the names of commands. The table keeps one
+*** copy of each, and names it by a 32-bit identifier, so compiled
+*** documents hold identifiers rather than strings of their own.
+***
+*** Strings of up to PK_INTERN_SHORT bytes are shared. Longer strings
+*** (most of the running text) rarely repeat, so they are stored without
+*** being looked up. Identifier zero is always the empty string.
+**/
+
+/* Longest string shared between its uses */
+#define PK_INTERN_SHORT 64
+
+/* Returned when a string cannot be added */
+#define PK_INTERN_NONE ( (uint32_t) 0xFFFFFFFFUL)
+
+struct pk_intern {
+  char*     pool;       /*< The strings, end to end, each NUL terminated */
+  size_t    used;       /*< Bytes of the pool in use */
+  size_t    size;       /*< Bytes of the pool allocated */
+  uint32_t* offsets;    /*< Start of each string in the pool, by identifier */
+  uint32_t* hashes;     /*< Hash of each string, by identifier */
+  uint32_t  count;      /*< Number of strings */
+  uint32_t  capacity;   /*< Number of identifiers allocated */
+  uint32_t* slots;      /*< Hash table of shared identifiers (zero if empty) */
+  uint32_t  nslots;     /*< Number of slots (a power of two) */
+  size_t    requests;   /*< Number of strings asked for */
+  size_t    saved;      /*< Bytes not stored because the string was shared */
+  };
+
+/* Set up an empty table */
+int pk_intern_init (struct pk_intern* strings);
+
+/* Empty the table, keeping its memory for the strings to come. Every
+ * identifier handed out so far becomes invalid
+ */
+void pk_intern_reset (struct pk_intern* strings);
+
+/* Release the memory used by the table */
+void pk_intern_clear (struct pk_intern* strings);
+
+/* Intern the len bytes at text, returning the identifier of the string,
+ * or PK_INTERN_NONE if memory runs out
+ */
+uint32_t pk_intern_span (struct pk_intern* strings, const char* text, size_t len);
+
+/* Intern a NUL terminated string */
+uint32_t pk_intern_cstr (struct pk_intern* strings, const char* text);
+
+/* The string with the given identifier. Identifiers not in the table
+ * give the empty string
+ */
+struct pk_span pk_intern_get (const struct pk_intern* strings, uint32_t id);
+
+/* The string with the given identifier, NUL terminated */
+const char* pk_intern_str (const struct pk_intern* strings, uint32_t id);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file io.h
+*** \brief File helpers shared by the Packer library
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_IO_H
+#define PACKER_IO_H
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Read the whole of the named file into a new malloc'ed buffer, which
+ * is NUL terminated for convenience. Returns NULL (with *len set to
+ * zero) if the file cannot be read, or is not a regular file
+ */
+char* pk_read_file (const char* path, size_t* len);
+
+/* A read-only view of a whole file */
+struct pk_mapping {
+  const char* data;     /*< Contents of the file */
+  size_t      len;      /*< Length of the file */
+  int         mapped;   /*< Non-zero if data is mapped, rather than read */
+  };
+
+/* Map the named file into memory, or read it where mapping is not
+ * possible. Returns PK_ERR if the file cannot be opened
+ */
+int pk_map_file (const char* path, struct pk_mapping* map);
+
+/* Release a mapping made by pk_map_file */
+void pk_unmap_file (struct pk_mapping* map);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
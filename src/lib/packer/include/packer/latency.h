@@ -0,0 +1,83 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file latency.h
+*** \brief Times taken by the pages of a build: percentiles and a histogram
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_LATENCY_H
+#define PACKER_LATENCY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Latency. The time each page of a build took, kept whole so that the
+*** slow pages are seen as well as the typical ones: an average hides the
+*** one page that doubles the time of a build. Percentiles are taken by
+*** nearest rank over every time recorded, and a histogram counts the
+*** times in buckets that double in width.
+**/
+
+/* Buckets of the histogram. Bucket 0 holds times under a microsecond,
+ * bucket i those from 2^(i-1) up to 2^i microseconds, and the last bucket
+ * everything slower
+ */
+#define PK_LATENCY_BUCKETS 24
+
+struct pk_latency {
+  uint64_t* times;                        /*< Every time recorded, in nanoseconds */
+  size_t    count;                        /*< Number of times recorded */
+  size_t    capacity;                     /*< Number of times allocated */
+  int       sorted;                       /*< Non-zero while the times are in order */
+  size_t    buckets[PK_LATENCY_BUCKETS];  /*< Histogram of the times */
+  };
+
+/* The time on a monotonic clock, in nanoseconds */
+uint64_t pk_clock_ns (void);
+
+/* Start with no times recorded */
+void pk_latency_init (struct pk_latency* latency);
+
+/* Release the times */
+void pk_latency_clear (struct pk_latency* latency);
+
+/* Record a time, in nanoseconds */
+int pk_latency_add (struct pk_latency* latency, uint64_t ns);
+
+/* The time that a fraction q (0 to 1) of the times recorded do not exceed:
+ * q of 0.5 gives the median, and 1 the slowest. Returns 0 if no time has
+ * been recorded
+ */
+uint64_t pk_latency_quantile (struct pk_latency* latency, double q);
+
+/* The bucket of the histogram holding a time */
+int pk_latency_bucket (uint64_t ns);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
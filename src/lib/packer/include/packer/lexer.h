@@ -0,0 +1,147 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file lexer.h
+*** \brief Streaming tokeniser for Bayeux markup
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_LEXER_H
+#define PACKER_LEXER_H
+
+#include "packer/pkdefs.h"
+#include "packer/tags.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Bayeux Lexer. Splits a Bayeux source buffer into a stream of tokens.
+*** Inline tags (+[tt www]+) produce an OPEN token, the tokens of the body
+*** and a CLOSE token at the matching ']'. Block tags (+[ol] ... [end]+)
+*** produce an OPEN token carrying the header arguments, the tokens of the
+*** body, and an END token at the matching +[end]+. The bodies of verbatim
+*** blocks (+[code bind|18]+) are returned as a single TEXT token.
+***
+*** The stream is always balanced: if the source leaves tags open (a
+*** missing ']' or +[end]+), the lexer supplies the missing CLOSE and END
+*** tokens, flagged with PK_TOKEN_IMPLICIT. Tokens hold spans into the
+*** source buffer, which must outlive them.
+***
+*** The lexer does a bounded amount of work for each byte of the source,
+*** whatever the markup. Tags nested past the depth limit are returned
+*** as TEXT, and the ']' or +[end]+ that would close them is text too, so
+*** the rest of the page keeps its shape. Once the token limit is reached
+*** the rest of the source is dropped, and the open tags closed.
+**/
+
+/**
+*** Resource Limits. Caps on what one page may cost to lex, compile and
+*** render. A limit of zero means no limit. Another thread may also call
+*** off the work on a page by setting the flag cancel points to: the
+*** lexer checks it before every token, and drops the rest of the source.
+**/
+struct pk_limits {
+  size_t              depth;    /*< Deepest nesting of tags */
+  size_t              tokens;   /*< Most tokens (nodes of a compiled document) read from one source */
+  size_t              output;   /*< Most bytes of output rendered from one page */
+  const volatile int* cancel;   /*< Non-zero once the page is to be given up (NULL for never) */
+  };
+
+/* Limits applied unless the caller asks for others */
+#define PK_LIMIT_DEPTH_DEFAULT    256
+#define PK_LIMIT_TOKENS_DEFAULT   (16UL * 1024 * 1024)
+#define PK_LIMIT_OUTPUT_DEFAULT   (256UL * 1024 * 1024)
+
+extern const struct pk_limits pk_limits_default;
+
+/* Which limits were reached (the limited member of a lexer, document or
+ * renderer)
+ */
+#define PK_LIMIT_DEPTH    1
+#define PK_LIMIT_TOKENS   2
+#define PK_LIMIT_OUTPUT   4
+#define PK_LIMIT_HELD     8   /*< Too many tags holding their body (PK_RENDER_MAX_HELD) */
+#define PK_LIMIT_CANCEL   16  /*< The page was given up (see cancel) */
+
+enum pk_token_type {
+  PK_TOKEN_EOF = 0,   /*< End of the source */
+  PK_TOKEN_TEXT,      /*< A run of text */
+  PK_TOKEN_OPEN,      /*< The start of a tag */
+  PK_TOKEN_CLOSE,     /*< The end of an inline (or void) tag */
+  PK_TOKEN_END        /*< The end of a block tag */
+  };
+
+/* Token flags, in addition to the PK_TAG_* flags of the tag */
+#define PK_TOKEN_IMPLICIT 0x100   /*< Close supplied by the lexer, not the source */
+
+struct pk_token {
+  enum pk_token_type type;    /*< Type of the token */
+  int                tag;     /*< Tag identifier (for OPEN, CLOSE and END) */
+  unsigned           flags;   /*< PK_TAG_* and PK_TOKEN_* flags */
+  struct pk_span     name;    /*< OPEN: name of the tag (e.g. "man") */
+  struct pk_span     label;   /*< OPEN: label after the colon (e.g. "8" in "[man:8") */
+  struct pk_span     args;    /*< OPEN of a block: the header arguments (e.g. "bind|18") */
+  struct pk_span     text;    /*< TEXT: the text. Otherwise the raw source of the token */
+  int                line;    /*< Line the token starts on (from 1) */
+  };
+
+struct pk_lexer_frame {
+  int      tag;     /*< Tag identifier of the open tag */
+  unsigned flags;   /*< PK_TAG_* flags of the open tag */
+  };
+
+struct pk_lexer {
+  const char*            start;         /*< Start of the source */
+  const char*            cur;           /*< Current read position */
+  const char*            end;           /*< One past the end of the source */
+  int                    line;          /*< Current line number */
+  struct pk_lexer_frame* stack;         /*< Tags currently open */
+  size_t                 depth;         /*< Number of open tags */
+  size_t                 capacity;      /*< Number of frames allocated */
+  int                    closing;       /*< Implicit closes owed before the next token */
+  int                    pending;       /*< Token type owed after the implicit closes */
+  struct pk_token        saved;         /*< The owed token */
+  size_t                 max_depth;     /*< Deepest nesting allowed (0 for no limit) */
+  size_t                 max_tokens;    /*< Most tokens read from the source (0 for no limit) */
+  const volatile int*    cancel;        /*< Flag that gives up the source, or NULL */
+  size_t                 tokens;        /*< Tokens read from the source so far */
+  size_t                 excess;        /*< Inline tags past the depth limit, kept as text */
+  size_t                 excess_blocks; /*< Block tags past the depth limit, kept as text */
+  unsigned               limited;       /*< PK_LIMIT_* flags of the limits reached */
+  };
+
+/* Set up a lexer over the len bytes of buf, with the default limits */
+void pk_lexer_init (struct pk_lexer* lexer, const char* buf, size_t len);
+
+/* Apply the depth and token limits (NULL for the defaults) */
+void pk_lexer_limit (struct pk_lexer* lexer, const struct pk_limits* limits);
+
+/* Release the memory used by the lexer */
+void pk_lexer_clear (struct pk_lexer* lexer);
+
+/* Read the next token into token. Returns the token type (PK_TOKEN_EOF
+ * at the end of the source), or PK_ERR if memory could not be allocated
+ */
+int pk_lexer_next (struct pk_lexer* lexer, struct pk_token* token);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
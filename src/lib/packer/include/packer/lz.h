@@ -0,0 +1,68 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file lz.h
+*** \brief A small LZ77 block codec
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_LZ_H
+#define PACKER_LZ_H
+
+#include <stddef.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Block Compression. A byte-oriented LZ77 codec in the style of LZ4,
+*** used to pack the sections of compiled documents. It favours speed
+*** over ratio: markup is repetitive enough that a greedy match finder
+*** over a 64K window does most of the work.
+***
+*** A block is a series of sequences. Each starts with a token byte whose
+*** high nibble is the number of literals and low nibble the match length
+*** less four; a nibble of 15 is extended by following bytes, each added
+*** in turn, until one is less than 255. The literals follow, then a two
+*** byte little endian distance back to the match. The last sequence has
+*** literals only, and ends the block. Blocks carry no header: the caller
+*** records both sizes.
+**/
+
+/* The largest block pk_lz_compress can make from len bytes */
+size_t pk_lz_bound (size_t len);
+
+/* Compress the len bytes of src into dst, which holds capacity bytes.
+ * Returns the size of the block, or zero if it does not fit
+ */
+size_t pk_lz_compress (const void* src, size_t len, void* dst, size_t capacity);
+
+/* Expand the len byte block at src into exactly size bytes at dst.
+ * Damaged blocks are rejected with PK_ERR, never read or written past
+ * either buffer
+ */
+int pk_lz_decompress (const void* src, size_t len, void* dst, size_t size);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
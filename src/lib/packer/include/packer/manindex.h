@@ -0,0 +1,109 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file manindex.h
+*** \brief Prebuilt index of the available manual pages
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_MANINDEX_H
+#define PACKER_MANINDEX_H
+
+#include <stdio.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Manual Page Index. References such as +[man:8 ping]+ are resolved
+*** against an index of the available pages, built once (from a manual
+*** path, or from a list) and written to disk as a hash table. Readers
+*** map the file and look each reference up directly, without parsing
+*** or loading the index.
+***
+*** The file is a fixed header, an open-addressed table of slots and a
+*** pool of NUL terminated strings. All integers are 32-bit, little
+*** endian:
+***
+***   header:  "PKMANIX1", slot count, entry count, slot offset,
+***            pool offset, pool size, reserved
+***   slot:    hash of the key, key offset, URL offset (0: empty slot)
+***
+*** Keys have the form +name(section)+. Pages in a qualified section
+*** (+openssl(1ssl)+) can also be found under the bare section number.
+**/
+
+/* Default URL for the pages found on a manual path */
+#define PK_MAN_DEFAULT_URL "https://man.openbsd.org/{name}.{section}"
+
+struct pk_man_builder;
+struct pk_man_index;
+
+/* Start a new index. The URL of each page found on a manual path is made
+ * from url_template, replacing "{name}" and "{section}"
+ */
+struct pk_man_builder* pk_man_builder_new (const char* url_template);
+
+/* Release the builder */
+void pk_man_builder_free (struct pk_man_builder* builder);
+
+/* Add one page. If url is NULL, it is made from the template. Earlier
+ * pages take precedence over later pages with the same key
+ */
+int pk_man_builder_add (struct pk_man_builder* builder, const char* name, const char* section, const char* url);
+
+/* Add every page found in the man* directories of a colon separated
+ * manual path. Directories which cannot be read are skipped
+ */
+int pk_man_builder_scan (struct pk_man_builder* builder, const char* manpath);
+
+/* Add the pages in a list, one per line as "name section [url]". Blank
+ * lines, and lines starting with '#', are ignored
+ */
+int pk_man_builder_read_list (struct pk_man_builder* builder, FILE* file);
+
+/* The number of pages added so far */
+size_t pk_man_builder_count (const struct pk_man_builder* builder);
+
+/* Write the index to path (replacing any existing file) */
+int pk_man_builder_write (struct pk_man_builder* builder, const char* path);
+
+/* Map an index written by pk_man_builder_write. Returns NULL if the
+ * file is missing or malformed
+ */
+struct pk_man_index* pk_man_index_open (const char* path);
+
+/* Release the index */
+void pk_man_index_close (struct pk_man_index* index);
+
+/* Look up a page, returning its URL (owned by the index), or NULL if
+ * the page is unknown
+ */
+const char* pk_man_index_lookup (const struct pk_man_index* index, struct pk_span name, struct pk_span section);
+
+/* The number of pages in the index */
+size_t pk_man_index_count (const struct pk_man_index* index);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
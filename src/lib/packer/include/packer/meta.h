@@ -0,0 +1,142 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file meta.h
+*** \brief Document metadata read from the YAML sidecar files
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_META_H
+#define PACKER_META_H
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** YAML Reader. Each Bayeux source file (e.g. +L3_DNS.byx+) has a sidecar
+*** YAML file (+L3_DNS.yaml+) holding its front-matter. We only use a
+*** small subset of YAML: a flat mapping of scalar keys to scalar values,
+*** with comments, optional document markers and quoted values. The reader
+*** walks a caller supplied buffer and returns spans into that buffer, so
+*** it never allocates or copies.
+***
+*** Values in double quotes are returned without the quotes, but escape
+*** sequences are _not_ interpreted. Indented lines (nested mappings and
+*** sequences) are outside the subset, and are skipped.
+**/
+
+struct pk_yaml_reader {
+  const char* cur;    /*< Current read position */
+  const char* end;    /*< One past the last byte of the buffer */
+  int         line;   /*< Line number of the last pair, or of the error */
+  };
+
+/* Set up a reader over the len bytes of buf */
+void pk_yaml_init (struct pk_yaml_reader* reader, const char* buf, size_t len);
+
+/* Read the next key/value pair. Returns 1 if a pair was found, 0 at
+ * the end of the buffer, or PK_ERR if the current line is not a valid
+ * mapping entry (reader->line gives the offending line, and the next
+ * call continues on the following line)
+ */
+int pk_yaml_next (struct pk_yaml_reader* reader, struct pk_span* key, struct pk_span* value);
+
+/**
+*** Metadata. A metadata set holds the pairs for one file, plus any pairs
+*** inherited from the enclosing directories. Keys and values are spans
+*** into the source text: for inherited pairs, this is the text owned by
+*** the directory cache.
+**/
+
+struct pk_meta_entry {
+  struct pk_span key;       /*< Key of the pair */
+  struct pk_span value;     /*< Value of the pair */
+  int            inherited; /*< Non-zero if the pair came from an enclosing directory */
+  };
+
+struct pk_meta {
+  struct pk_meta_entry* entries;    /*< The pairs, in file order */
+  size_t                count;      /*< Number of pairs in use */
+  size_t                capacity;   /*< Number of pairs allocated */
+  char*                 buffer;     /*< Source text owned by this set (may be NULL) */
+  };
+
+/* Initialise an empty metadata set */
+void pk_meta_init (struct pk_meta* meta);
+
+/* Release the pairs and any source text owned by the set */
+void pk_meta_clear (struct pk_meta* meta);
+
+/* Parse len bytes of YAML from buffer into meta. The set takes ownership
+ * of buffer (which must come from malloc), and releases it in
+ * pk_meta_clear. Later keys override earlier ones
+ */
+int pk_meta_parse (struct pk_meta* meta, char* buffer, size_t len);
+
+/* Add the pairs of parent that are not already set in meta, marking
+ * them as inherited. The spans are borrowed from parent
+ */
+int pk_meta_inherit (struct pk_meta* meta, const struct pk_meta* parent);
+
+/* Find the value of key, or return NULL if the key is not set */
+const struct pk_span* pk_meta_get (const struct pk_meta* meta, const char* key);
+
+/* Find the value of key, ignoring any inherited pairs */
+const struct pk_span* pk_meta_get_own (const struct pk_meta* meta, const char* key);
+
+/**
+*** Directory Cache. Metadata is inherited down the directory tree: the
+*** pairs in +Labs/Labs.yaml+ apply to every document under +Labs/+, unless
+*** overridden by a deeper directory file or the document's own sidecar.
+*** The directory file of a directory +D+ is +D/basename(D).yaml+.
+***
+*** The cache reads and merges each directory file once, and keeps the
+*** merged set for the lifetime of the cache. Document sets built from the
+*** cache borrow inherited spans from it, so the cache must outlive them.
+**/
+
+struct pk_meta_cache;
+
+/* Create a cache. Inheritance stops at root (if given): directories
+ * above it are never consulted
+ */
+struct pk_meta_cache* pk_meta_cache_new (const char* root);
+
+/* Release the cache and all the directory sets it holds */
+void pk_meta_cache_free (struct pk_meta_cache* cache);
+
+/* Return the merged metadata for the directory holding path, reading
+ * the directory files for it and its ancestors if not already cached.
+ * Returns NULL if memory could not be allocated
+ */
+const struct pk_meta* pk_meta_cache_directory (struct pk_meta_cache* cache, const char* path);
+
+/* Build the metadata for the document at path: the pairs from the
+ * sidecar YAML file, merged with the metadata of its directory. A
+ * missing sidecar is not an error. meta must be initialised, and is
+ * released by the caller with pk_meta_clear
+ */
+int pk_meta_cache_document (struct pk_meta_cache* cache, const char* path, struct pk_meta* meta);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
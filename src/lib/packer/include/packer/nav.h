@@ -0,0 +1,165 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file nav.h
+*** \brief Incrementally maintained site navigation
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_NAV_H
+#define PACKER_NAV_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Page Outlines. The outline of a page is its title (the first [h1]) and
+*** the list of its headings, which becomes the page table of contents.
+*** Outlines are read straight from the token stream, so finding them
+*** costs one pass of the lexer and never builds a document tree.
+**/
+
+struct pk_nav_heading {
+  int     level;    /*< Heading level: 1 for [h1], 2 for [h2], ... */
+  bstring text;     /*< Heading text, with tags stripped and spaces collapsed */
+  bstring anchor;   /*< Anchor name, unique within the page */
+  int     repeats;  /*< Number of later headings numbered from this anchor */
+  };
+
+struct pk_nav_outline {
+  bstring                title;     /*< Text of the first [h1], or NULL */
+  struct pk_nav_heading* headings;  /*< Headings in document order */
+  size_t                 count;     /*< Number of headings */
+  size_t                 capacity;  /*< Number of headings allocated */
+  size_t*                anchors;   /*< Set of the anchors taken: heading index + 1, or 0 */
+  size_t                 nanchors;  /*< Number of slots in the set (a power of two) */
+  };
+
+/* Initialise an empty outline */
+void pk_nav_outline_init (struct pk_nav_outline* outline);
+
+/* Release the memory held by an outline */
+void pk_nav_outline_clear (struct pk_nav_outline* outline);
+
+/* Add a heading, given the len bytes of its source text (with any tags
+ * already removed). The new heading is the last in the outline
+ */
+int pk_nav_outline_add (struct pk_nav_outline* outline, int level, const char* src, size_t len);
+
+/* Scan len bytes of Bayeux source for the page title and headings */
+int pk_nav_scan (const char* buf, size_t len, struct pk_nav_outline* outline);
+
+/**
+*** Navigation Graph. The graph holds one node per page, arranged by the
+*** directory hierarchy of the site: the index page of a directory
+*** (+Labs/Labs.byx+ for +Labs/+) stands for the directory itself, and
+*** directories without an index page get a placeholder node. Siblings are
+*** ordered by weight, then by name; prev/next links follow the pre-order
+*** (reading order) of the tree.
+***
+*** The graph is long-lived: updating one page patches the links around
+*** it and marks only the pages whose navigation actually changed as
+*** dirty. Callers then regenerate just the dirty pages, found with
+*** pk_nav_take_dirty. The graph can be saved and loaded between runs.
+**/
+
+/* Reasons a page is dirty */
+enum {
+  PK_NAV_DIRTY_TOC     = 0x1,   /*< The page title or table of contents changed */
+  PK_NAV_DIRTY_LINKS   = 0x2,   /*< A parent, child or prev/next link changed */
+  PK_NAV_DIRTY_CRUMBS  = 0x4    /*< The title of an ancestor changed */
+  };
+
+struct pk_nav_page {
+  bstring                key;         /*< Node key: the page path, or "dir/" for a directory */
+  bstring                path;        /*< Source path of the page, or NULL for a placeholder */
+  bstring                title;       /*< Title shown in the navigation */
+  int                    weight;      /*< Sort weight amongst siblings */
+  struct pk_nav_heading* headings;    /*< Table of contents */
+  size_t                 nheadings;   /*< Number of headings */
+  struct pk_nav_page*    parent;      /*< Enclosing directory (NULL for top-level pages) */
+  struct pk_nav_page*    first_child; /*< First child page */
+  struct pk_nav_page*    last_child;  /*< Last child page */
+  struct pk_nav_page*    prev_sibling;/*< Previous page in the same directory */
+  struct pk_nav_page*    next_sibling;/*< Next page in the same directory */
+  struct pk_nav_page*    prev_node;   /*< Previous node in reading order */
+  struct pk_nav_page*    next_node;   /*< Next node in reading order */
+  unsigned               dirty;       /*< PK_NAV_DIRTY_* flags */
+  struct pk_nav_page*    dirty_next;  /*< Next page on the dirty list */
+  uint64_t               hash;        /*< Hash of the key */
+  struct pk_nav_page*    chain;       /*< Next page in the same hash bucket */
+  };
+
+struct pk_nav;
+
+/* Create an empty navigation graph */
+struct pk_nav* pk_nav_new (void);
+
+/* Release the graph and all its pages */
+void pk_nav_free (struct pk_nav* nav);
+
+/* Add or update the page at path (relative to the site root). title is
+ * the page title (NULL to use the outline title, or the file name), and
+ * weight orders the page amongst its siblings. The outline is moved into
+ * the graph, and left empty
+ */
+int pk_nav_update (struct pk_nav* nav, const char* path, const char* title, int weight,
+                   struct pk_nav_outline* outline);
+
+/* Remove the page at path from the graph */
+int pk_nav_remove (struct pk_nav* nav, const char* path);
+
+/* Find the node for the page at path, or NULL */
+struct pk_nav_page* pk_nav_find (struct pk_nav* nav, const char* path);
+
+/* Return the first real page in reading order, or NULL if there is none */
+struct pk_nav_page* pk_nav_first (struct pk_nav* nav);
+
+/* Return the previous or next real page in reading order, or NULL */
+struct pk_nav_page* pk_nav_prev (struct pk_nav_page* page);
+struct pk_nav_page* pk_nav_next (struct pk_nav_page* page);
+
+/* Remove and return the next dirty page (with its dirty flags still
+ * set, for the caller to inspect). Returns NULL once no pages are dirty
+ */
+struct pk_nav_page* pk_nav_take_dirty (struct pk_nav* nav);
+
+/* Append the navigation of page (breadcrumbs, prev/next, children and
+ * table of contents) to out as a JSON object
+ */
+int pk_nav_format (struct pk_nav_page* page, bstring out);
+
+/* Save the graph to, or load the graph from, a state file. Loading does
+ * not mark any page as dirty
+ */
+int pk_nav_save (struct pk_nav* nav, FILE* file);
+int pk_nav_load (struct pk_nav* nav, FILE* file);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
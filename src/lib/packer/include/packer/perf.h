@@ -0,0 +1,110 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file perf.h
+*** \brief Hardware performance counters read around each phase of a build
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_PERF_H
+#define PACKER_PERF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Performance Counters. The counters of the processor, read around each
+*** phase of a build through the Linux perf_event_open interface: cycles,
+*** instructions, branch misses, level 1 data and last level cache misses,
+*** and the processor time taken. Only the time spent in the program is
+*** counted, including threads it starts while the counters are open.
+***
+*** Counters the host does not offer (a virtual machine often has none of
+*** the hardware ones) are left out, and the rest still counted. Where
+*** the processor has more events than counters the kernel shares them
+*** out, and the counts are scaled up to the whole of each phase.
+***
+*** Every call but pk_perf_open does nothing given a NULL perf, so code
+*** that is only sometimes counted can pass its counters straight on.
+**/
+
+enum pk_perf_event {
+  PK_PERF_CYCLES = 0,     /*< Processor cycles */
+  PK_PERF_INSTRUCTIONS,   /*< Instructions retired */
+  PK_PERF_BRANCH_MISSES,  /*< Mispredicted branches */
+  PK_PERF_L1_MISSES,      /*< Level 1 data cache read misses */
+  PK_PERF_LLC_MISSES,     /*< Last level cache misses */
+  PK_PERF_TIME,           /*< Processor time, in nanoseconds */
+  PK_PERF_EVENTS
+  };
+
+enum pk_phase {
+  PK_PHASE_LEX = 0,       /*< Splitting the source into tokens */
+  PK_PHASE_PARSE,         /*< Building the document tree */
+  PK_PHASE_RESOLVE,       /*< Navigation, images and manual page references */
+  PK_PHASE_EMIT,          /*< Rendering and writing the output */
+  PK_PHASES
+  };
+
+struct pk_perf {
+  int      fd[PK_PERF_EVENTS];                /*< Counter of each event (-1 if the host has none) */
+  uint64_t start[PK_PERF_EVENTS];             /*< Counts when the running phase began */
+  uint64_t count[PK_PHASES][PK_PERF_EVENTS];  /*< Counts of each phase */
+  size_t   runs[PK_PHASES];                   /*< Times each phase has been counted */
+  int      phase;                             /*< Phase being counted (-1 for none) */
+  size_t   input;                             /*< Bytes of source read, for rates per KB */
+  };
+
+/* Names of the events and the phases, for reports */
+extern const char* const pk_perf_event_names[PK_PERF_EVENTS];
+extern const char* const pk_phase_names[PK_PHASES];
+
+/* Open every counter the host offers. Returns PK_ERR (with nothing open)
+ * if there are none, or the system is not Linux
+ */
+int pk_perf_open (struct pk_perf* perf);
+
+/* Close the counters. The counts are kept */
+void pk_perf_close (struct pk_perf* perf);
+
+/* Non-zero if the event is counted */
+int pk_perf_has (const struct pk_perf* perf, int event);
+
+/* Start counting phase, ending the phase already running */
+void pk_perf_begin (struct pk_perf* perf, int phase);
+
+/* End the running phase, adding its counts to those of the phase */
+void pk_perf_end (struct pk_perf* perf);
+
+/* Take the counts of part out of those of phase, for a phase that was
+ * counted with part inside it (parsing reads its tokens as it goes).
+ * Counts never drop below zero
+ */
+void pk_perf_exclude (struct pk_perf* perf, int phase, int part);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file pkdefs.h
+*** \brief Common return codes and types shared by the Packer library
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_PKDEFS_H
+#define PACKER_PKDEFS_H
+
+/* Link to the project configure file */
+#include "config.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Return codes used by the library routines. These follow the
+ * convention of the bstring library: zero for success, and a
+ * negative value for failure
+ */
+#define PK_OK   (0)
+#define PK_ERR  (-1)
+
+/**
+*** A borrowed (non-owning) run of bytes. Spans point into a buffer
+*** owned by someone else, and are only valid for as long as that buffer
+*** is. They are _not_ NUL terminated.
+**/
+struct pk_span {
+  const char* data;   /*< Start of the run */
+  size_t      len;    /*< Number of bytes in the run */
+  };
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
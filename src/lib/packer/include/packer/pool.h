@@ -0,0 +1,52 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file pool.h
+*** \brief A simple pool of worker threads
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_POOL_H
+#define PACKER_POOL_H
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The work done for one job: index is the job number, ctx is the
+ * context given to pk_pool_run
+ */
+typedef void (pk_pool_fn) (size_t index, void* ctx);
+
+/* Run fn for each of the njobs jobs on up to workers threads, returning
+ * once every job is done. Jobs are handed out in order, one at a time, so
+ * uneven jobs balance across the threads. If workers is zero, use one
+ * thread per online processor. Returns PK_ERR if no thread could be
+ * started (in which case the jobs are run on the calling thread)
+ */
+int pk_pool_run (int workers, size_t njobs, pk_pool_fn* fn, void* ctx);
+
+/* The number of online processors (at least one) */
+int pk_pool_processors (void);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,91 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file query.h
+*** \brief Tag queries over compiled documents
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_QUERY_H
+#define PACKER_QUERY_H
+
+#include <stddef.h>
+
+#include "packer/pkdefs.h"
+#include "packer/doc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Tag Queries. A query picks out tags by their place in the document,
+*** in a small path language:
+***
+***   command[~nsd]          every [command] whose text mentions "nsd"
+***   figure:*[!caption]     every labelled [figure] with no [caption]
+***   ol/item//man           every [man] anywhere in an item of a list
+***   /h2                    every [h2] at the top level
+***
+*** A query is a series of steps separated by '/' (the next tag is a
+*** child) or '//' (the next tag is anywhere inside). The first step may
+*** match at any depth, unless the query starts with '/'. Each step is a
+*** tag name or '*', optionally a label pattern after ':' in which '*'
+*** matches any run of characters, then any number of predicates:
+***
+***   [tag:label]   some tag inside matches (tag name and label as above)
+***   [~text]       some text inside contains the given text, which may
+***                 also be quoted: [~"a b"]
+***   [!...]        the predicate does not hold
+***
+*** Matches are found from the tag postings: only the tags named by the
+*** last step are tried against it, and a document without any is passed
+*** over without being read. The steps before are matched in one pass
+*** from the top of the document, so a query costs at most the number of
+*** nodes times the number of steps, however deeply the tags are nested.
+**/
+
+/* Longest path a query may have */
+#define PK_QUERY_STEPS 16
+
+struct pk_query;
+
+/* Report one match: node of doc is a tag picked out by the query */
+typedef int (pk_query_fn) (const struct pk_doc* doc, size_t node, void* ctx);
+
+/* Compile a query. On a syntax error, returns NULL and sets *error (if
+ * not NULL) to the offset of the error in text
+ */
+struct pk_query* pk_query_new (const char* text, size_t* error);
+
+/* Release a query */
+void pk_query_free (struct pk_query* query);
+
+/* Call fn for every match in a document, in document order */
+int pk_query_doc (const struct pk_query* query, const struct pk_doc* doc, pk_query_fn* fn, void* ctx);
+
+/* Call fn for every match in an open .pdoc file. Only sections holding
+ * tags named by the last step are read
+ */
+int pk_query_file (const struct pk_query* query, const struct pk_doc_file* file, pk_query_fn* fn, void* ctx);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
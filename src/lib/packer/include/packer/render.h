@@ -0,0 +1,211 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file render.h
+*** \brief Streaming renderer for Bayeux token streams
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_RENDER_H
+#define PACKER_RENDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+#include "packer/footnote.h"
+#include "packer/highlight.h"
+#include "packer/lexer.h"
+#include "packer/manindex.h"
+#include "packer/nav.h"
+#include "packer/rope.h"
+#include "packer/table.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Renderer. Turns the token stream of one document into output for a
+*** backend (HTML, plain text, ...) in a single pass. The renderer keeps a
+*** stack of the open tags, finds the paragraphs, numbers the footnotes
+*** and sets their bodies aside, and hands everything else to the
+*** handlers of the backend, one per tag.
+***
+*** Output is written to the file as it is produced, so only the open
+*** tags (and any waiting footnotes) are ever held in memory. A handler
+*** writes to pk_render_out, which is the main output, or the body of the
+*** innermost tag whose output is being diverted.
+***
+*** The main output is kept as a rope. While the renderer is borrowing
+*** (through pk_render_run, or whenever the caller sets borrow), text that
+*** needs no escaping is referenced in the source rather than copied.
+***
+*** pk_render_run lexes the page within the limits of the renderer. A
+*** stream of tokens nested deeper than the depth limit (which the lexer
+*** never returns), or whose output grows past the output limit, fails to
+*** render; the limit reached is left in limited. Tags that divert or
+*** collect their body hand it on to the enclosing tag when they end, so
+*** whatever the depth limit (even none), a stream with more than
+*** PK_RENDER_MAX_HELD of them open at once fails to render (PK_LIMIT_HELD).
+**/
+
+struct pk_render;
+struct pk_render_frame;
+
+/* Handle the start or end of a tag. Open handlers run before the body
+ * of the frame is diverted; close handlers run once the frame is off the
+ * stack. Either way, output goes to the enclosing tag
+ */
+typedef int (pk_tag_fn) (struct pk_render* render, struct pk_render_frame* frame);
+
+/* Handle a run of text within a tag, in place of the backend text handler */
+typedef int (pk_text_fn) (struct pk_render* render, struct pk_render_frame* frame, const char* text, size_t len);
+
+/* Handler flags */
+#define PK_RENDER_BLOCK     1   /*< Laid out as a block, outside any paragraph */
+#define PK_RENDER_DIVERT    2   /*< Render the body into the frame, for the close handler */
+#define PK_RENDER_COLLECT   4   /*< Collect the plain text of the body in the frame */
+#define PK_RENDER_HIDE      8   /*< Do not render the body at all */
+
+/* Most tags diverting, or collecting, their body that may be open at once */
+#define PK_RENDER_MAX_HELD  PK_LIMIT_DEPTH_DEFAULT
+
+struct pk_tag_handler {
+  pk_tag_fn*  open;     /*< Called at the start of the tag (may be NULL) */
+  pk_tag_fn*  close;    /*< Called at the end of the tag (may be NULL) */
+  pk_text_fn* text;     /*< Called for the text directly within the tag (may be NULL) */
+  unsigned    flags;    /*< PK_RENDER_* flags */
+  };
+
+struct pk_backend {
+  const char*                  name;        /*< Name of the backend (e.g. "html") */
+  int                          footnotes;   /*< Placement of the footnotes (enum pk_fn_placement) */
+  const struct pk_tag_handler* tags;        /*< Handlers, indexed by tag (PK_TAG_COUNT entries) */
+
+  /* Write plain text, escaped as the output format needs */
+  int (*text) (struct pk_render* render, const char* text, size_t len);
+
+  /* Start (open is non-zero) or end a paragraph */
+  int (*paragraph) (struct pk_render* render, int open);
+
+  pk_fn_format_fn* note;    /*< Formats one footnote */
+  pk_fn_flush_fn*  notes;   /*< Wraps the footnotes of a section or document */
+  };
+
+struct pk_render_frame {
+  struct pk_token  open;     /*< The token that opened the tag */
+  unsigned         flags;    /*< PK_RENDER_* flags of the handler */
+  bstring          body;     /*< Diverted output (DIVERT), or NULL */
+  bstring          text;     /*< Collected plain text (COLLECT), or NULL */
+  int              number;   /*< Footnote number, for [fn] */
+  struct pk_table* table;    /*< Layout of a [table], made by the open handler, or NULL */
+  size_t           divert;   /*< 1 + index of the innermost frame up to this one with a body, or 0 */
+  size_t           collect;  /*< 1 + index of the innermost frame up to this one with text, or 0 */
+  };
+
+struct pk_render {
+  const struct pk_backend* backend;       /*< The output format */
+  FILE*                    file;          /*< Where the output goes (may be NULL) */
+  struct pk_rope           rope;          /*< Main output not yet written to the file */
+  bstring                  out;           /*< Main output written by handlers, not yet added to the rope */
+  int                      borrow;        /*< Non-zero if token text outlives the output, and so can be referenced */
+  struct pk_render_frame*  frames;        /*< The open tags, innermost last */
+  size_t                   depth;         /*< Number of open tags */
+  size_t                   capacity;      /*< Number of frames allocated */
+  int                      hidden;        /*< Number of open tags hiding their body */
+  size_t                   diverted;      /*< Number of open tags with a diverted body */
+  size_t                   collecting;    /*< Number of open tags collecting their text */
+  int                      paragraph;     /*< Non-zero while a paragraph is open */
+  struct pk_footnotes      notes;         /*< Footnotes of the document */
+  struct pk_nav_outline    outline;       /*< Headings met so far (for the anchors) */
+  struct pk_highlighter*   highlighter;   /*< Highlighter for [code] (may be NULL) */
+  struct pk_man_index*     man_index;     /*< Index for [man] (may be NULL) */
+  const struct pk_limits*  limits;        /*< Limits on the page (NULL for the defaults) */
+  size_t                   produced;      /*< Bytes of main output written to the file so far */
+  unsigned                 limited;       /*< PK_LIMIT_* flags of the limits reached */
+  struct pk_tag_costs*     costs;         /*< Where the cost of rendering each tag is counted (may be NULL) */
+  };
+
+/* Create a renderer for one document, writing to file. If file is NULL
+ * the output is kept, and can be taken with pk_render_take
+ */
+struct pk_render* pk_render_new (const struct pk_backend* backend, FILE* file);
+
+/* Release the renderer. The highlighter and man index are not released */
+void pk_render_free (struct pk_render* render);
+
+/* Render the next token of the stream */
+int pk_render_token (struct pk_render* render, const struct pk_token* token);
+
+/* End the document: close any paragraph and flush the footnotes */
+int pk_render_finish (struct pk_render* render);
+
+/* Lex and render the whole of the len bytes of buf, then finish */
+int pk_render_run (struct pk_render* render, const char* buf, size_t len);
+
+/* Take the output kept by a renderer with no file (the caller owns it) */
+bstring pk_render_take (struct pk_render* render);
+
+/* Where handlers should write */
+bstring pk_render_out (struct pk_render* render);
+
+/* Where the output of the tags enclosing frame goes */
+bstring pk_render_outer (struct pk_render* render, const struct pk_render_frame* frame);
+
+/* Write raw output, or plain text escaped by the backend. The text must
+ * come from a token
+ */
+int pk_render_write (struct pk_render* render, const char* data, size_t len);
+int pk_render_puts (struct pk_render* render, const char* str);
+int pk_render_text (struct pk_render* render, const char* text, size_t len);
+
+/* Write raw output taken from the text of a token. It is referenced rather
+ * than copied where it can be
+ */
+int pk_render_ref (struct pk_render* render, const char* data, size_t len);
+
+/* Write source text as plain text, removing the escapes ("\x" is x) */
+int pk_render_source (struct pk_render* render, const char* text, size_t len);
+
+/* Text handler for [table]: splits the body into rows and cells, which
+ * are laid out by the table of the frame. The table body must be diverted
+ */
+int pk_render_table_text (struct pk_render* render, struct pk_render_frame* frame, const char* text, size_t len);
+
+/* The innermost open tag with the given tag identifier, or NULL */
+struct pk_render_frame* pk_render_find (struct pk_render* render, int tag);
+
+/* Backends provided by the library */
+extern const struct pk_backend pk_backend_html;
+extern const struct pk_backend pk_backend_text;
+
+/* Look up a backend by name, or NULL */
+const struct pk_backend* pk_backend_find (const char* name);
+
+/* Append text to out, escaping the HTML special characters */
+int pk_html_escape (bstring out, const char* text, size_t len);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
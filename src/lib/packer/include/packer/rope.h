@@ -0,0 +1,93 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file rope.h
+*** \brief Chunked output buffers, written with scatter/gather I/O
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_ROPE_H
+#define PACKER_ROPE_H
+
+#include <stdio.h>
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Ropes. Output is built as a list of pieces rather than one growing
+*** buffer. Copied bytes are packed into fixed-size chunks, which never
+*** move once allocated; bytes that will stay unchanged until the rope is
+*** written (such as runs of the source document) can be referenced in
+*** place, without being copied at all. Writing the rope hands the pieces
+*** to writev, so the output never has to be gathered into one buffer.
+**/
+
+/* Bytes held by each chunk */
+#define PK_ROPE_CHUNK (16 * 1024)
+
+struct pk_rope_chunk {
+  struct pk_rope_chunk* next;                 /*< The next chunk */
+  size_t                used;                 /*< Bytes of data in use */
+  char                  data[PK_ROPE_CHUNK];  /*< The copied bytes */
+  };
+
+struct pk_rope {
+  struct pk_span*       pieces;     /*< The pieces of the output, in order */
+  size_t                count;      /*< Number of pieces */
+  size_t                capacity;   /*< Number of pieces allocated */
+  size_t                length;     /*< Total length of the pieces */
+  struct pk_rope_chunk* chunks;     /*< Chunks in use, oldest first */
+  struct pk_rope_chunk* last;       /*< The chunk being filled */
+  struct pk_rope_chunk* spare;      /*< Chunks free for reuse */
+  };
+
+/* Set up an empty rope */
+void pk_rope_init (struct pk_rope* rope);
+
+/* Release the memory used by the rope */
+void pk_rope_clear (struct pk_rope* rope);
+
+/* Append a copy of len bytes at data */
+int pk_rope_write (struct pk_rope* rope, const char* data, size_t len);
+
+/* Append len bytes at data without copying them. The bytes must not
+ * change until the rope is written, taken or reset
+ */
+int pk_rope_ref (struct pk_rope* rope, const char* data, size_t len);
+
+/* Write the rope to file, then empty it. The chunks are kept for reuse */
+int pk_rope_flush (struct pk_rope* rope, FILE* file);
+
+/* Append the contents of the rope to out, then empty it */
+int pk_rope_take (struct pk_rope* rope, bstring out);
+
+/* Empty the rope, keeping the chunks for reuse */
+void pk_rope_reset (struct pk_rope* rope);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,93 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file span.h
+*** \brief Borrowed string views, and their conversion to bstrings
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_SPAN_H
+#define PACKER_SPAN_H
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** String Views. A bstring owns (and so copies) its data, which is the
+*** right thing for a value that must outlive its source, but is wasted
+*** work when a piece of the input is only looked at and thrown away.
+*** These routines work on struct pk_span instead: substrings, searches
+*** and splits all return views into the same buffer, and allocate
+*** nothing. A view becomes a bstring only when pk_span_dup is asked for
+*** one.
+***
+*** A view of a bstring (from pk_span_bstr) is valid only until the
+*** bstring is next changed.
+**/
+
+/* Returned by the searches when nothing is found */
+#define PK_SPAN_NPOS ( (size_t) -1)
+
+/* A view of len bytes at data */
+struct pk_span pk_span_make (const char* data, size_t len);
+
+/* A view of a NUL terminated string, or of the contents of a bstring */
+struct pk_span pk_span_cstr (const char* str);
+struct pk_span pk_span_bstr (const_bstring str);
+
+/* The len bytes of span from pos, clipped to the span (as bmidstr) */
+struct pk_span pk_span_mid (struct pk_span span, size_t pos, size_t len);
+
+/* The span without any leading and trailing white space */
+struct pk_span pk_span_trim (struct pk_span span);
+
+/* Position of the first (or last) c in span, or PK_SPAN_NPOS */
+size_t pk_span_chr (struct pk_span span, int c);
+size_t pk_span_rchr (struct pk_span span, int c);
+
+/* Position of the first needle in span at or after pos, or PK_SPAN_NPOS */
+size_t pk_span_find (struct pk_span span, size_t pos, struct pk_span needle);
+
+/* Take the next field, up to sep, off the front of rest. Returns zero once
+ * every field has been taken: "a|b" gives "a" then "b", and "" gives one
+ * empty field
+ */
+int pk_span_split (struct pk_span* rest, int sep, struct pk_span* field);
+
+/* Compare two views, or a view and a NUL terminated string */
+int pk_span_eq (struct pk_span a, struct pk_span b);
+int pk_span_eqcstr (struct pk_span a, const char* str);
+
+/* A new bstring holding a copy of the view (NULL if out of memory) */
+bstring pk_span_dup (struct pk_span span);
+
+/* Append (or assign) the view to a bstring, as bcatblk (or bassignblk) */
+int pk_span_cat (bstring str, struct pk_span span);
+int pk_span_assign (bstring str, struct pk_span span);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,158 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file table.h
+*** \brief Streaming layout of pipe-delimited tables
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+#ifndef PACKER_TABLE_H
+#define PACKER_TABLE_H
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Table Layout. The body of a [table] is a run of lines, with the cells
+*** of each line separated by '|', and an optional rule of dashes under
+*** the header:
+***
+***   Port Number | Gateway Address
+***   ------------------------------
+***   [tt 1]      | [tt 192.168.7.1/24]
+***
+*** Cells are not kept as strings of their own. The renderer writes each
+*** cell into a single buffer, and the table records where each cell
+*** ends. The widths of the columns, and whether they hold numbers, are
+*** updated as each row finishes, so no second pass over the cells is
+*** needed.
+***
+*** Rows are handed to the backend as soon as they can be. A table that
+*** streams its rows keeps only the rows that may still turn out to be
+*** the header; a table that keeps its rows (for a backend that has to
+*** know the width of the columns before writing anything) hands them
+*** all over when the table ends.
+**/
+
+/* Alignment of a column. A rule cell of ":--" aligns left, "--:" right,
+ * and ":-:" centres
+ */
+enum pk_table_align {
+  PK_ALIGN_DEFAULT = 0,
+  PK_ALIGN_LEFT,
+  PK_ALIGN_CENTRE,
+  PK_ALIGN_RIGHT
+  };
+
+/* The rule must come within this many rows for them to be the header */
+#define PK_TABLE_HEADER_MAX 4
+
+struct pk_table_column {
+  size_t width;     /*< Widest cell so far, in characters */
+  int    align;     /*< Alignment given by the rule (enum pk_table_align) */
+  size_t numbers;   /*< Number of body cells holding a number */
+  size_t words;     /*< Number of body cells holding anything else */
+  };
+
+/* One row, as handed to the backend */
+struct pk_table_row {
+  const char*   data;     /*< The buffer holding the cells */
+  const size_t* ends;     /*< End of each cell of the row within data */
+  size_t        start;    /*< Start of the first cell within data */
+  size_t        count;    /*< Number of cells in the row */
+  size_t        index;    /*< Number of rows handed over before this one */
+  int           header;   /*< Non-zero for a row above the rule */
+  };
+
+struct pk_table;
+
+/* Write one row to out */
+typedef int (pk_table_row_fn) (bstring out, const struct pk_table* table, const struct pk_table_row* row, void* ctx);
+
+struct pk_table {
+  pk_table_row_fn*        row;          /*< Writes each row */
+  void*                   ctx;          /*< Passed to row */
+  int                     keep;         /*< Keep every row until the table ends */
+  size_t*                 ends;         /*< End of each waiting cell in the buffer */
+  size_t                  cells;        /*< Number of waiting cells */
+  size_t                  cell_capacity;
+  size_t*                 rows;         /*< First cell of each waiting row */
+  size_t                  waiting;      /*< Number of waiting rows */
+  size_t                  row_capacity;
+  struct pk_table_column* columns;      /*< Columns seen so far */
+  size_t                  ncolumns;
+  size_t                  column_capacity;
+  size_t                  row_start;    /*< First cell of the row being read */
+  size_t                  cell_start;   /*< Start in the buffer of the cell being read */
+  size_t                  total;        /*< Rows read so far, not counting rules */
+  size_t                  written;      /*< Rows handed to row so far */
+  size_t                  header;       /*< Number of header rows */
+  int                     ruled;        /*< Non-zero once the header rule is seen */
+  bstring                 caption;      /*< Rendered [caption] of the table, or NULL */
+  };
+
+/* Create a table writing its rows through row. If keep is zero, rows are
+ * written as soon as it is known whether they are in the header
+ */
+struct pk_table* pk_table_new (pk_table_row_fn* row, int keep, void* ctx);
+
+/* Release the table (but not the buffer holding its cells) */
+void pk_table_free (struct pk_table* table);
+
+/* Find the next '|' or newline in the text, skipping escaped characters.
+ * Returns end if there is none
+ */
+const char* pk_table_split (const char* text, const char* end);
+
+/* Non-zero if nothing has been written to the cell being read */
+int pk_table_cell_empty (const struct pk_table* table, const_bstring cells);
+
+/* End the cell being read, which runs to the end of cells */
+int pk_table_end_cell (struct pk_table* table, bstring cells);
+
+/* End the row being read. Rows that are ready are written to out */
+int pk_table_end_row (struct pk_table* table, bstring cells, bstring out);
+
+/* End the table, writing any rows still waiting to out */
+int pk_table_finish (struct pk_table* table, bstring cells, bstring out);
+
+/* The text of cell i of a row */
+struct pk_span pk_table_cell (const struct pk_table_row* row, size_t i);
+
+/* Alignment to use for a column once the table is complete: as given by
+ * the rule, or right for a column of numbers, or else left
+ */
+int pk_table_align (const struct pk_table* table, size_t column);
+
+/* Width of text in characters (UTF-8 continuation bytes are not counted) */
+size_t pk_table_width (const char* text, size_t len);
+
+/* Non-zero if the text is a number, such as "12", "-0.5" or "80%" */
+int pk_table_numeric (const char* text, size_t len);
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
@@ -0,0 +1,134 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file tags.h
+*** \brief The table of Bayeux tags known to the compiler
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#ifndef PACKER_TAGS_H
+#define PACKER_TAGS_H
+
+#include <stdint.h>
+
+#include "packer/pkdefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+*** Tag Identifiers. Every tag name the compiler understands has an
+*** identifier, so later stages can switch on an integer rather than
+*** comparing names. Names not in the table map to PK_TAG_UNKNOWN.
+***
+*** NOTE: Keep these in alphabetical order of the tag name: the lookup
+*** table in tags.c relies on it.
+**/
+
+enum pk_tag {
+  PK_TAG_UNKNOWN = 0,
+  PK_TAG_A,
+  PK_TAG_AC,
+  PK_TAG_ACL,
+  PK_TAG_BIB,
+  PK_TAG_CAPTION,
+  PK_TAG_CITE,
+  PK_TAG_CODE,
+  PK_TAG_COM,
+  PK_TAG_COMMAND,
+  PK_TAG_DL,
+  PK_TAG_E,
+  PK_TAG_END,
+  PK_TAG_FIGURE,
+  PK_TAG_FN,
+  PK_TAG_H1,
+  PK_TAG_H2,
+  PK_TAG_H3,
+  PK_TAG_IMAGE,
+  PK_TAG_ITEM,
+  PK_TAG_LINK,
+  PK_TAG_MAN,
+  PK_TAG_MEDSKIP,
+  PK_TAG_NOTE,
+  PK_TAG_OL,
+  PK_TAG_OUTPUT,
+  PK_TAG_QUESTION,
+  PK_TAG_QUESTIONS,
+  PK_TAG_QUOTE,
+  PK_TAG_REF,
+  PK_TAG_S,
+  PK_TAG_SC,
+  PK_TAG_TABLE,
+  PK_TAG_TT,
+  PK_TAG_UL,
+  PK_TAG_COUNT
+  };
+
+/* Tag flags, describing how the tag is delimited in the source */
+enum {
+  PK_TAG_INLINE   = 0x0,  /*< Body runs to the matching ']' */
+  PK_TAG_BLOCK    = 0x1,  /*< Header runs to ']', body runs to the matching [end] */
+  PK_TAG_VERBATIM = 0x2,  /*< Block body is raw text, with no nested tags */
+  PK_TAG_VOID     = 0x4,  /*< Tag has no body at all */
+  PK_TAG_HEADING  = 0x8   /*< Tag is a section heading */
+  };
+
+/* Look up the tag named by the len bytes at name. Returns PK_TAG_UNKNOWN
+ * if the name is not a known tag
+ */
+int pk_tag_lookup (const char* name, size_t len);
+
+/* Return the PK_TAG_* flags of a tag */
+unsigned pk_tag_flags (int tag);
+
+/* Return the name of a tag, or "?" for PK_TAG_UNKNOWN */
+const char* pk_tag_name (int tag);
+
+/**
+*** Tag Costs. What each kind of tag costs to compile or to render: how
+*** many were opened, the tokens handled, the time taken and the bytes
+*** of source read (compiling) or of main output produced (rendering)
+*** meanwhile. Each token is charged to the tag it opens, or else to the
+*** innermost open tag, so the text of a [tt] within a [fn] counts
+*** towards [tt], and the costs of every kind add up to the whole pass.
+*** Text outside any tag, and the end of the page (where waiting
+*** footnotes are written), count towards the document itself.
+***
+*** Costs are only counted by a document or renderer given somewhere to
+*** count them, at two clock reads a token. Pages are only compiled and
+*** rendered one at a time, so a set of costs is never shared between
+*** threads.
+**/
+
+struct pk_tag_cost {
+  size_t   count;   /*< Tags of the kind opened */
+  size_t   calls;   /*< Tokens handled: opens, closes and runs of text */
+  uint64_t ns;      /*< Nanoseconds handling them */
+  size_t   bytes;   /*< Bytes of source read, or of main output produced, meanwhile */
+  };
+
+/* Costs indexed by tag, with the document itself at PK_TAG_COUNT */
+struct pk_tag_costs {
+  struct pk_tag_cost tags[PK_TAG_COUNT + 1];
+  };
+
+#ifdef __cplusplus
+  }
+#endif
+
+#endif
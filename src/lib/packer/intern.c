@@ -0,0 +1,229 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file intern.c
+*** \brief Site-wide table of interned strings
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/hash.h"
+#include "packer/intern.h"
+
+/* Largest pool the 32-bit offsets can address */
+#define INTERN_POOL_MAX ( (size_t) 0xFFFFFFFFUL)
+
+int pk_intern_init (struct pk_intern* strings) {
+  memset (strings, 0, sizeof (*strings));
+
+  /* Identifier zero is the empty string */
+  if (pk_intern_span (strings, "", 0) != 0) {
+    return PK_ERR;
+    }
+
+  strings->requests = 0;
+  return PK_OK;
+  }
+
+void pk_intern_reset (struct pk_intern* strings) {
+  strings->used = 0;
+  strings->count = 0;
+  strings->requests = 0;
+  strings->saved = 0;
+
+  if (strings->slots != NULL) {
+    memset (strings->slots, 0, strings->nslots * sizeof (*strings->slots));
+    }
+
+  /* Room for the empty string is always there by now */
+  pk_intern_span (strings, "", 0);
+  strings->requests = 0;
+  }
+
+void pk_intern_clear (struct pk_intern* strings) {
+  free (strings->pool);
+  free (strings->offsets);
+  free (strings->hashes);
+  free (strings->slots);
+  memset (strings, 0, sizeof (*strings));
+  }
+
+/* Length of a string in the table */
+static size_t length (const struct pk_intern* strings, uint32_t id) {
+  size_t end = id + 1 < strings->count ? strings->offsets[id + 1] : strings->used;
+
+  return end - strings->offsets[id] - 1;
+  }
+
+/* Place a shared identifier in the slot table */
+static void place (uint32_t* slots, uint32_t nslots, uint32_t hash, uint32_t id) {
+  uint32_t i = hash & (nslots - 1);
+
+  while (slots[i] != 0) {
+    i = (i + 1) & (nslots - 1);
+    }
+
+  slots[i] = id;
+  }
+
+/* Keep the slot table at most half full */
+static int grow_slots (struct pk_intern* strings) {
+  uint32_t nslots = strings->nslots ? strings->nslots * 2 : 1024;
+  uint32_t* slots = (uint32_t*) calloc (nslots, sizeof (*slots));
+  uint32_t i;
+
+  if (slots == NULL) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < strings->nslots; i++) {
+    if (strings->slots[i] != 0) {
+      place (slots, nslots, strings->hashes[strings->slots[i]], strings->slots[i]);
+      }
+    }
+
+  free (strings->slots);
+  strings->slots = slots;
+  strings->nslots = nslots;
+  return PK_OK;
+  }
+
+/* Store a new string, returning its identifier */
+static uint32_t store (struct pk_intern* strings, const char* text, size_t len, uint32_t hash) {
+  if (strings->count == strings->capacity) {
+    uint32_t capacity = strings->capacity ? strings->capacity * 2 : 1024;
+    uint32_t* offsets = (uint32_t*) realloc (strings->offsets, capacity * sizeof (*offsets));
+    uint32_t* hashes;
+
+    if (offsets == NULL) {
+      return PK_INTERN_NONE;
+      }
+
+    strings->offsets = offsets;
+    hashes = (uint32_t*) realloc (strings->hashes, capacity * sizeof (*hashes));
+
+    if (hashes == NULL) {
+      return PK_INTERN_NONE;
+      }
+
+    strings->hashes = hashes;
+    strings->capacity = capacity;
+    }
+
+  if (len + 1 > INTERN_POOL_MAX - strings->used) {
+    return PK_INTERN_NONE;
+    }
+
+  if (strings->used + len + 1 > strings->size) {
+    size_t size = strings->size ? strings->size : 16 * 1024;
+    char* pool;
+
+    while (size < strings->used + len + 1) {
+      size *= 2;
+      }
+
+    pool = (char*) realloc (strings->pool, size);
+
+    if (pool == NULL) {
+      return PK_INTERN_NONE;
+      }
+
+    strings->pool = pool;
+    strings->size = size;
+    }
+
+  memcpy (strings->pool + strings->used, text, len);
+  strings->pool[strings->used + len] = '\0';
+  strings->offsets[strings->count] = (uint32_t) strings->used;
+  strings->hashes[strings->count] = hash;
+  strings->used += len + 1;
+  return strings->count++;
+  }
+
+uint32_t pk_intern_span (struct pk_intern* strings, const char* text, size_t len) {
+  uint32_t hash;
+  uint32_t id;
+  uint32_t i;
+
+  strings->requests++;
+
+  if (len > PK_INTERN_SHORT) {
+    return store (strings, text, len, 0);
+    }
+
+  if (len == 0 && strings->count > 0) {
+    strings->saved++;
+    return 0;
+    }
+
+  hash = (uint32_t) (pk_hash_bytes (text, len) & 0xFFFFFFFFUL);
+
+  if (strings->nslots > 0) {
+    for (i = hash & (strings->nslots - 1); (id = strings->slots[i]) != 0; i = (i + 1) & (strings->nslots - 1)) {
+      if (strings->hashes[id] == hash && length (strings, id) == len &&
+          memcmp (strings->pool + strings->offsets[id], text, len) == 0) {
+        strings->saved += len + 1;
+        return id;
+        }
+      }
+    }
+
+  id = store (strings, text, len, hash);
+
+  /* The empty string is found without the table */
+  if (id == PK_INTERN_NONE || id == 0) {
+    return id;
+    }
+
+  if ( (id + 1) * 2 > strings->nslots && grow_slots (strings) != PK_OK) {
+    return PK_INTERN_NONE;
+    }
+
+  place (strings->slots, strings->nslots, hash, id);
+  return id;
+  }
+
+uint32_t pk_intern_cstr (struct pk_intern* strings, const char* text) {
+  return pk_intern_span (strings, text, strlen (text));
+  }
+
+struct pk_span pk_intern_get (const struct pk_intern* strings, uint32_t id) {
+  struct pk_span span;
+
+  span.data = pk_intern_str (strings, id);
+  span.len = id < strings->count ? length (strings, id) : 0;
+  return span;
+  }
+
+const char* pk_intern_str (const struct pk_intern* strings, uint32_t id) {
+  return id < strings->count ? strings->pool + strings->offsets[id] : "";
+  }
@@ -0,0 +1,146 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file io.c
+*** \brief File helpers shared by the Packer library
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* We need the POSIX file and memory mapping interfaces */
+#define _POSIX_C_SOURCE 200809L
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STDIO_H
+#include <stdio.h>
+#else
+#error "can't find the C standard I/O library"
+#endif
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "packer/io.h"
+
+char* pk_read_file (const char* path, size_t* len) {
+  struct stat info;
+  FILE* file;
+  char* buffer = NULL;
+  long size;
+
+  *len = 0;
+  file = fopen (path, "rb");
+
+  if (file == NULL) {
+    return NULL;
+    }
+
+  /* Only regular files have a size to read (a directory claims to be
+   * as large as a file can be)
+   */
+  if (fstat (fileno (file), &info) != 0 || !S_ISREG (info.st_mode)) {
+    fclose (file);
+    return NULL;
+    }
+
+  if (fseek (file, 0, SEEK_END) == 0 && (size = ftell (file)) >= 0 && fseek (file, 0, SEEK_SET) == 0) {
+    buffer = (char*) malloc ( (size_t) size + 1);
+
+    if (buffer != NULL) {
+      *len = fread (buffer, 1, (size_t) size, file);
+      buffer[*len] = '\0';
+      }
+    }
+
+  fclose (file);
+  return buffer;
+  }
+
+int pk_map_file (const char* path, struct pk_mapping* map) {
+#ifdef HAVE_SYS_MMAN_H
+  struct stat info;
+  void* data;
+  int fd;
+#endif
+
+  map->data = NULL;
+  map->len = 0;
+  map->mapped = 0;
+
+#ifdef HAVE_SYS_MMAN_H
+  fd = open (path, O_RDONLY);
+
+  if (fd < 0) {
+    return PK_ERR;
+    }
+
+  /* Empty files cannot be mapped, so are read (as nothing) instead */
+  if (fstat (fd, &info) == 0 && info.st_size > 0) {
+    data = mmap (NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (data != MAP_FAILED) {
+      close (fd);
+      map->data = (const char*) data;
+      map->len = (size_t) info.st_size;
+      map->mapped = 1;
+      return PK_OK;
+      }
+    }
+
+  close (fd);
+#endif
+
+  map->data = pk_read_file (path, &map->len);
+  return map->data ? PK_OK : PK_ERR;
+  }
+
+void pk_unmap_file (struct pk_mapping* map) {
+  if (map->data != NULL) {
+#ifdef HAVE_SYS_MMAN_H
+
+    if (map->mapped) {
+      munmap ( (void*) map->data, map->len);
+      }
+
+    else {
+      free ( (void*) map->data);
+      }
+
+#else
+    free ( (void*) map->data);
+#endif
+    }
+
+  map->data = NULL;
+  map->len = 0;
+  map->mapped = 0;
+  }
@@ -0,0 +1,133 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file latency.c
+*** \brief Times taken by the pages of a build: percentiles and a histogram
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* clock_gettime is POSIX */
+#define _POSIX_C_SOURCE 200809L
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include <time.h>
+
+#include "packer/latency.h"
+
+uint64_t pk_clock_ns (void) {
+#ifdef CLOCK_MONOTONIC
+  struct timespec now;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &now) == 0) {
+    return (uint64_t) now.tv_sec * 1000000000UL + (uint64_t) now.tv_nsec;
+    }
+
+#endif
+
+  /* Processor time will do where there is no monotonic clock */
+  return (uint64_t) ( (double) clock () * (1e9 / CLOCKS_PER_SEC));
+  }
+
+void pk_latency_init (struct pk_latency* latency) {
+  memset (latency, 0, sizeof (*latency));
+  latency->sorted = 1;
+  }
+
+void pk_latency_clear (struct pk_latency* latency) {
+  free (latency->times);
+  pk_latency_init (latency);
+  }
+
+int pk_latency_bucket (uint64_t ns) {
+  uint64_t us = ns / 1000;
+  int bucket = 0;
+
+  while (us > 0 && bucket < PK_LATENCY_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+    }
+
+  return bucket;
+  }
+
+int pk_latency_add (struct pk_latency* latency, uint64_t ns) {
+  if (latency->count == latency->capacity) {
+    size_t capacity = latency->capacity ? latency->capacity * 2 : 256;
+    uint64_t* times = (uint64_t*) realloc (latency->times, capacity * sizeof (*times));
+
+    if (times == NULL) {
+      return PK_ERR;
+      }
+
+    latency->times = times;
+    latency->capacity = capacity;
+    }
+
+  if (latency->count > 0 && ns < latency->times[latency->count - 1]) {
+    latency->sorted = 0;
+    }
+
+  latency->times[latency->count++] = ns;
+  latency->buckets[pk_latency_bucket (ns)]++;
+  return PK_OK;
+  }
+
+static int compare_times (const void* a, const void* b) {
+  uint64_t x = * (const uint64_t*) a;
+  uint64_t y = * (const uint64_t*) b;
+
+  return x < y ? -1 : x > y;
+  }
+
+uint64_t pk_latency_quantile (struct pk_latency* latency, double q) {
+  double target = q * (double) latency->count;
+  size_t rank = target > 0 ? (size_t) target : 0;
+
+  if (latency->count == 0) {
+    return 0;
+    }
+
+  if (!latency->sorted) {
+    qsort (latency->times, latency->count, sizeof (*latency->times), compare_times);
+    latency->sorted = 1;
+    }
+
+  /* The nearest rank: the first time, in order, with at least q of the
+   * times at or below it
+   */
+  if ( (double) rank < target) {
+    rank++;
+    }
+
+  rank = rank < 1 ? 1 : rank > latency->count ? latency->count : rank;
+  return latency->times[rank - 1];
+  }
@@ -0,0 +1,423 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file lexer.c
+*** \brief Streaming tokeniser for Bayeux markup
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/lexer.h"
+#include "packer/span.h"
+
+/* Initial number of frames on the tag stack */
+#define LEXER_STACK_SIZE 32
+
+/* The closing tag of a block */
+static const char end_tag[] = "[end]";
+
+/* Test for the characters that terminate a tag name */
+#define IS_NAME_STOP(c) ((c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n' || \
+                         (c) == '[' || (c) == ']' || (c) == '|')
+
+const struct pk_limits pk_limits_default = {
+  PK_LIMIT_DEPTH_DEFAULT, PK_LIMIT_TOKENS_DEFAULT, PK_LIMIT_OUTPUT_DEFAULT, NULL
+  };
+
+void pk_lexer_init (struct pk_lexer* lexer, const char* buf, size_t len) {
+  memset (lexer, 0, sizeof (*lexer));
+  lexer->start = buf;
+  lexer->cur = buf;
+  lexer->end = buf + len;
+  lexer->line = 1;
+  pk_lexer_limit (lexer, NULL);
+  }
+
+void pk_lexer_limit (struct pk_lexer* lexer, const struct pk_limits* limits) {
+  if (limits == NULL) {
+    limits = &pk_limits_default;
+    }
+
+  lexer->max_depth = limits->depth;
+  lexer->max_tokens = limits->tokens;
+  lexer->cancel = limits->cancel;
+  }
+
+void pk_lexer_clear (struct pk_lexer* lexer) {
+  free (lexer->stack);
+  lexer->stack = NULL;
+  lexer->depth = 0;
+  lexer->capacity = 0;
+  }
+
+/* Reset a token to an empty token of the given type */
+static void token_reset (struct pk_token* token, enum pk_token_type type, int line) {
+  memset (token, 0, sizeof (*token));
+  token->type = type;
+  token->line = line;
+  }
+
+/* Count the newlines in [from, to) */
+static int count_lines (const char* from, const char* to) {
+  int lines = 0;
+
+  while (from < to && (from = (const char*) memchr (from, '\n', (size_t) (to - from))) != NULL) {
+    lines++;
+    from++;
+    }
+
+  return lines;
+  }
+
+/* Push an open tag onto the tag stack. The stack never grows past the
+ * depth limit (with room for one void tag, which is popped at once)
+ */
+static int push_frame (struct pk_lexer* lexer, int tag, unsigned flags) {
+  if (lexer->depth == lexer->capacity) {
+    size_t capacity = lexer->capacity ? lexer->capacity * 2 : LEXER_STACK_SIZE;
+    struct pk_lexer_frame* stack;
+
+    if (lexer->max_depth > 0 && capacity > lexer->max_depth + 1) {
+      capacity = lexer->max_depth + 1;
+      }
+
+    stack = (struct pk_lexer_frame*) realloc (lexer->stack, capacity * sizeof (*stack));
+
+    if (stack == NULL) {
+      return PK_ERR;
+      }
+
+    lexer->stack = stack;
+    lexer->capacity = capacity;
+    }
+
+  lexer->stack[lexer->depth].tag = tag;
+  lexer->stack[lexer->depth].flags = flags;
+  lexer->depth++;
+  return PK_OK;
+  }
+
+/* Pop the innermost open tag, and form the token closing it */
+static int pop_frame (struct pk_lexer* lexer, struct pk_token* token, unsigned extra) {
+  struct pk_lexer_frame* frame = &lexer->stack[--lexer->depth];
+
+  token_reset (token, (frame->flags & PK_TAG_BLOCK) ? PK_TOKEN_END : PK_TOKEN_CLOSE, lexer->line);
+  token->tag = frame->tag;
+  token->flags = frame->flags | extra;
+  return token->type;
+  }
+
+/* Test whether the innermost open tag is an inline tag (so that a ']'
+ * closes it)
+ */
+static int inline_open (const struct pk_lexer* lexer) {
+  return lexer->depth > 0 && (lexer->stack[lexer->depth - 1].flags & (PK_TAG_BLOCK | PK_TAG_VOID)) == 0;
+  }
+
+/* Return the source up to stop as a TEXT token */
+static int lex_source (struct pk_lexer* lexer, struct pk_token* token, const char* stop) {
+  token_reset (token, PK_TOKEN_TEXT, lexer->line);
+  token->text.data = lexer->cur;
+  token->text.len = (size_t) (stop - lexer->cur);
+  lexer->line += count_lines (lexer->cur, stop);
+  lexer->cur = stop;
+  return PK_TOKEN_TEXT;
+  }
+
+/* Return the text token starting at the current position. The first
+ * character is always taken, so stray brackets become text
+ */
+static int lex_text (struct pk_lexer* lexer, struct pk_token* token) {
+  const char* p = lexer->cur + 1;
+  int close = inline_open (lexer) || lexer->excess > 0;
+
+  while (p < lexer->end) {
+    if (*p == '[' || (*p == ']' && close)) {
+      break;
+      }
+
+    /* A backslash escapes the following character */
+    if (*p == '\\' && p + 1 < lexer->end) {
+      p++;
+      }
+
+    p++;
+    }
+
+  return lex_source (lexer, token, p);
+  }
+
+/* Return the next part of a verbatim block body: the text up to the
+ * [end], or the END token itself
+ */
+static int lex_verbatim (struct pk_lexer* lexer, struct pk_token* token) {
+  const char* p = lexer->cur;
+  const char* stop = NULL;
+
+  while (p < lexer->end && (p = (const char*) memchr (p, '[', (size_t) (lexer->end - p))) != NULL) {
+    if ( (size_t) (lexer->end - p) >= sizeof (end_tag) - 1 && memcmp (p, end_tag, sizeof (end_tag) - 1) == 0) {
+      stop = p;
+      break;
+      }
+
+    p++;
+    }
+
+  if (stop == lexer->cur) {
+    lexer->cur += sizeof (end_tag) - 1;
+    pop_frame (lexer, token, 0);
+    token->text.data = stop;
+    token->text.len = sizeof (end_tag) - 1;
+    return token->type;
+    }
+
+  if (stop == NULL) {
+    stop = lexer->end;
+    }
+
+  return lex_source (lexer, token, stop);
+  }
+
+/* Handle an [end]: close any inline tags left open inside the innermost
+ * block, then the block itself. An [end] outside any block is text
+ */
+static int lex_end (struct pk_lexer* lexer, struct pk_token* token, const char* stop) {
+  size_t block = lexer->depth;
+
+  while (block > 0 && (lexer->stack[block - 1].flags & PK_TAG_BLOCK) == 0) {
+    block--;
+    }
+
+  if (block == 0) {
+    return lex_text (lexer, token);
+    }
+
+  lexer->closing = (int) (lexer->depth - block);
+  lexer->pending = PK_TOKEN_END;
+
+  token_reset (&lexer->saved, PK_TOKEN_END, lexer->line);
+  lexer->saved.tag = lexer->stack[block - 1].tag;
+  lexer->saved.flags = lexer->stack[block - 1].flags;
+  lexer->saved.text.data = lexer->cur;
+  lexer->saved.text.len = (size_t) (stop - lexer->cur);
+  lexer->cur = stop;
+
+  return pk_lexer_next (lexer, token);
+  }
+
+/* Parse the tag starting at the current '[' */
+static int lex_tag (struct pk_lexer* lexer, struct pk_token* token) {
+  const char* name = lexer->cur + 1;
+  const char* p = name;
+  const char* colon = NULL;
+  const char* stop;
+  int tag;
+  unsigned flags;
+
+  while (p < lexer->end && !IS_NAME_STOP (*p)) {
+    if (*p == ':' && colon == NULL) {
+      colon = p;
+      }
+
+    p++;
+    }
+
+  /* Not a tag ("[ ", "[]", a trailing '[') */
+  if (p == name || colon == name) {
+    return lex_text (lexer, token);
+    }
+
+  tag = pk_tag_lookup (name, (size_t) ( (colon ? colon : p) - name));
+  flags = pk_tag_flags (tag);
+
+  if (tag == PK_TAG_END && colon == NULL) {
+    stop = (p < lexer->end && *p == ']') ? p + 1 : p;
+
+    /* The [end] of a block kept as text is text, and closes any inline
+     * tags kept as text within it
+     */
+    lexer->excess = 0;
+
+    if (lexer->excess_blocks > 0) {
+      lexer->excess_blocks--;
+      return lex_source (lexer, token, stop);
+      }
+
+    return lex_end (lexer, token, stop);
+    }
+
+  token_reset (token, PK_TOKEN_OPEN, lexer->line);
+  token->tag = tag;
+  token->flags = flags;
+  token->name.data = name;
+  token->name.len = (size_t) ( (colon ? colon : p) - name);
+
+  if (colon != NULL) {
+    token->label.data = colon + 1;
+    token->label.len = (size_t) (p - colon - 1);
+    }
+
+  if (flags & (PK_TAG_BLOCK | PK_TAG_VOID)) {
+    /* The header arguments run to the ']' (or the end of the line, if
+     * the author forgot it)
+     */
+    stop = p;
+
+    while (stop < lexer->end && *stop != ']' && *stop != '\n') {
+      stop++;
+      }
+
+    token->args = pk_span_trim (pk_span_make (p, (size_t) (stop - p)));
+
+    if (stop < lexer->end && *stop == ']') {
+      stop++;
+      }
+
+    /* Verbatim bodies start on the line after the header */
+    if ( (flags & PK_TAG_VERBATIM) && stop < lexer->end && *stop == '\r') {
+      stop++;
+      }
+
+    if ( (flags & PK_TAG_VERBATIM) && stop < lexer->end && *stop == '\n') {
+      stop++;
+      }
+    }
+
+  else {
+    /* Inline: the body starts after the separating white space */
+    stop = p;
+
+    while (stop < lexer->end && (*stop == ' ' || *stop == '\t' || *stop == '\r' || *stop == '\n')) {
+      stop++;
+      }
+    }
+
+  /* Past the depth limit the tag is text, and so is its closing ']' or
+   * [end] (counted here, as there is no frame to hold it)
+   */
+  if (lexer->max_depth > 0 && lexer->depth >= lexer->max_depth && (flags & PK_TAG_VOID) == 0) {
+    lexer->limited |= PK_LIMIT_DEPTH;
+
+    if (flags & PK_TAG_BLOCK) {
+      lexer->excess_blocks++;
+      }
+
+    else {
+      lexer->excess++;
+      }
+
+    return lex_source (lexer, token, stop);
+    }
+
+  token->text.data = lexer->cur;
+  token->text.len = (size_t) (stop - lexer->cur);
+  lexer->line += count_lines (lexer->cur, stop);
+  lexer->cur = stop;
+
+  if (push_frame (lexer, tag, flags) != PK_OK) {
+    return PK_ERR;
+    }
+
+  /* Void tags close immediately */
+  if (flags & PK_TAG_VOID) {
+    lexer->pending = PK_TOKEN_CLOSE;
+    token_reset (&lexer->saved, PK_TOKEN_CLOSE, lexer->line);
+    lexer->saved.tag = tag;
+    lexer->saved.flags = flags;
+    lexer->depth--;
+    }
+
+  return PK_TOKEN_OPEN;
+  }
+
+int pk_lexer_next (struct pk_lexer* lexer, struct pk_token* token) {
+  /* First pay back any closes and tokens we owe */
+  if (lexer->closing > 0) {
+    lexer->closing--;
+    return pop_frame (lexer, token, PK_TOKEN_IMPLICIT);
+    }
+
+  if (lexer->pending != PK_TOKEN_EOF) {
+    *token = lexer->saved;
+    lexer->pending = PK_TOKEN_EOF;
+
+    if (token->type == PK_TOKEN_END) {
+      lexer->depth--;
+      }
+
+    return token->type;
+    }
+
+  /* Past the token limit the rest of the source is dropped */
+  if (lexer->max_tokens > 0 && lexer->tokens >= lexer->max_tokens && lexer->cur < lexer->end) {
+    lexer->limited |= PK_LIMIT_TOKENS;
+    lexer->cur = lexer->end;
+    }
+
+  /* So is the rest of a page that has been given up */
+  if (lexer->cancel != NULL && *lexer->cancel && lexer->cur < lexer->end) {
+    lexer->limited |= PK_LIMIT_CANCEL;
+    lexer->cur = lexer->end;
+    }
+
+  if (lexer->cur >= lexer->end) {
+    if (lexer->depth > 0) {
+      return pop_frame (lexer, token, PK_TOKEN_IMPLICIT);
+      }
+
+    token_reset (token, PK_TOKEN_EOF, lexer->line);
+    return PK_TOKEN_EOF;
+    }
+
+  lexer->tokens++;
+
+  if (lexer->depth > 0 && (lexer->stack[lexer->depth - 1].flags & PK_TAG_VERBATIM)) {
+    return lex_verbatim (lexer, token);
+    }
+
+  if (*lexer->cur == '[') {
+    return lex_tag (lexer, token);
+    }
+
+  if (*lexer->cur == ']' && lexer->excess > 0) {
+    lexer->excess--;
+    return lex_source (lexer, token, lexer->cur + 1);
+    }
+
+  if (*lexer->cur == ']' && inline_open (lexer)) {
+    pop_frame (lexer, token, 0);
+    token->text.data = lexer->cur++;
+    token->text.len = 1;
+    return PK_TOKEN_CLOSE;
+    }
+
+  return lex_text (lexer, token);
+  }
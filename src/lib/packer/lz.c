@@ -0,0 +1,227 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file lz.c
+*** \brief A small LZ77 block codec
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include <stdint.h>
+
+#include "packer/lz.h"
+
+/* Shortest match worth coding, and the furthest a match may reach back */
+#define LZ_MIN_MATCH 4
+#define LZ_WINDOW 65535
+
+/* Size of the table of recent positions, as a power of two */
+#define LZ_HASH_BITS 13
+
+/* Read four bytes as a little endian word */
+static uint32_t read32 (const unsigned char* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+  }
+
+/* Hash the four bytes at a position into the table */
+static size_t lz_hash (uint32_t value) {
+  return (size_t) ( ( (value * 2654435761UL) & 0xFFFFFFFFUL) >> (32 - LZ_HASH_BITS));
+  }
+
+/* Write the extension bytes of a length, once its nibble is full */
+static unsigned char* put_length (unsigned char* out, size_t len) {
+  while (len >= 255) {
+    *out++ = 255;
+    len -= 255;
+    }
+
+  *out++ = (unsigned char) len;
+  return out;
+  }
+
+/* Append a sequence of literals and a match. A match of length zero ends
+ * the block. Returns the new end of the output, or NULL if it is full
+ */
+static unsigned char* put_sequence (unsigned char* out, const unsigned char* end, const unsigned char* literals,
+                                    size_t count, size_t distance, size_t match) {
+  size_t extra = match ? match - LZ_MIN_MATCH : 0;
+  unsigned char* token = out;
+
+  if ( (size_t) (end - out) < 1 + count / 255 + 1 + count + 2 + extra / 255 + 1) {
+    return NULL;
+    }
+
+  *token = (unsigned char) ( (count < 15 ? count : 15) << 4);
+  out++;
+
+  if (count >= 15) {
+    out = put_length (out, count - 15);
+    }
+
+  memcpy (out, literals, count);
+  out += count;
+
+  if (match) {
+    *token |= (unsigned char) (extra < 15 ? extra : 15);
+    *out++ = (unsigned char) (distance & 0xFF);
+    *out++ = (unsigned char) (distance >> 8);
+
+    if (extra >= 15) {
+      out = put_length (out, extra - 15);
+      }
+    }
+
+  return out;
+  }
+
+size_t pk_lz_bound (size_t len) {
+  return len + len / 255 + 16;
+  }
+
+size_t pk_lz_compress (const void* src, size_t len, void* dst, size_t capacity) {
+  const unsigned char* in = (const unsigned char*) src;
+  unsigned char* out = (unsigned char*) dst;
+  const unsigned char* end = out + capacity;
+  size_t* table = (size_t*) calloc ( (size_t) 1 << LZ_HASH_BITS, sizeof (*table));
+  size_t anchor = 0;
+  size_t i = 0;
+
+  if (table == NULL) {
+    return 0;
+    }
+
+  /* Positions are kept one up, so zero marks an empty slot */
+  while (out != NULL && i + LZ_MIN_MATCH <= len) {
+    uint32_t value = read32 (in + i);
+    size_t slot = lz_hash (value);
+    size_t candidate = table[slot];
+
+    table[slot] = i + 1;
+
+    if (candidate != 0 && i - (candidate - 1) <= LZ_WINDOW && read32 (in + candidate - 1) == value) {
+      size_t from = candidate - 1;
+      size_t match = LZ_MIN_MATCH;
+
+      while (i + match < len && in[from + match] == in[i + match]) {
+        match++;
+        }
+
+      out = put_sequence (out, end, in + anchor, i - anchor, i - from, match);
+      i += match;
+      anchor = i;
+      }
+
+    else {
+      /* Step faster through data that will not compress */
+      i += 1 + ( (i - anchor) >> 6);
+      }
+    }
+
+  free (table);
+
+  if (out != NULL) {
+    out = put_sequence (out, end, in + anchor, len - anchor, 0, 0);
+    }
+
+  return out ? (size_t) (out - (unsigned char*) dst) : 0;
+  }
+
+/* Read the extension bytes of a length onto its nibble. Returns PK_ERR
+ * if the block ends first, or the length could not fit in limit
+ */
+static int get_length (const unsigned char** in, const unsigned char* end, size_t* len, size_t limit) {
+  unsigned char byte;
+
+  do {
+    if (*in == end || *len > limit) {
+      return PK_ERR;
+      }
+
+    byte = *(*in)++;
+    *len += byte;
+    }
+  while (byte == 255);
+
+  return PK_OK;
+  }
+
+int pk_lz_decompress (const void* src, size_t len, void* dst, size_t size) {
+  const unsigned char* in = (const unsigned char*) src;
+  const unsigned char* end = in + len;
+  unsigned char* base = (unsigned char*) dst;
+  unsigned char* out = base;
+  unsigned char* limit = base + size;
+
+  while (in < end) {
+    unsigned char token = *in++;
+    size_t count = token >> 4;
+    size_t match = token & 0x0F;
+    size_t distance;
+    const unsigned char* from;
+
+    if ( (count == 15 && get_length (&in, end, &count, size) != PK_OK) || count > (size_t) (end - in) ||
+         count > (size_t) (limit - out)) {
+      return PK_ERR;
+      }
+
+    memcpy (out, in, count);
+    in += count;
+    out += count;
+
+    if (in == end) {
+      break;
+      }
+
+    if (end - in < 2) {
+      return PK_ERR;
+      }
+
+    distance = (size_t) in[0] | (size_t) in[1] << 8;
+    in += 2;
+
+    if (distance == 0 || distance > (size_t) (out - base) ||
+        (match == 15 && get_length (&in, end, &match, size) != PK_OK) ||
+        match + LZ_MIN_MATCH > (size_t) (limit - out)) {
+      return PK_ERR;
+      }
+
+    /* Matches may overlap the bytes they produce, so copy forwards */
+    match += LZ_MIN_MATCH;
+    from = out - distance;
+
+    while (match-- > 0) {
+      *out++ = *from++;
+      }
+    }
+
+  return out == limit ? PK_OK : PK_ERR;
+  }
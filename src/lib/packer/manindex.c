@@ -0,0 +1,592 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file manindex.c
+*** \brief Prebuilt index of the available manual pages
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* We need the POSIX directory interface */
+#define _POSIX_C_SOURCE 200809L
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_CTYPE_H
+#include <ctype.h>
+#else
+#error "can't find the C character class library"
+#endif
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#else
+#error "can't find the C99 standard types"
+#endif
+
+#ifdef HAVE_DIRENT_H
+#include <dirent.h>
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/hash.h"
+#include "packer/io.h"
+#include "packer/manindex.h"
+
+/* Identifies an index file */
+#define MAN_MAGIC "PKMANIX1"
+
+/* Size of the header and of each slot, in bytes */
+#define MAN_HEADER_SIZE 36
+#define MAN_SLOT_SIZE 12
+
+/* Longest key looked up, including the section and brackets */
+#define MAN_KEY_MAX 512
+
+/* Compression suffixes stripped from the names of page files */
+static const char* const man_suffixes[] = { ".gz", ".bz2", ".xz", ".lzma", ".zst", ".Z", NULL };
+
+/* Read and write little endian 32-bit integers */
+static uint32_t get32 (const unsigned char* p) {
+  return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+  }
+
+static void put32 (unsigned char* p, uint32_t value) {
+  p[0] = (unsigned char) (value & 0xFF);
+  p[1] = (unsigned char) ( (value >> 8) & 0xFF);
+  p[2] = (unsigned char) ( (value >> 16) & 0xFF);
+  p[3] = (unsigned char) ( (value >> 24) & 0xFF);
+  }
+
+/* The hash stored in each slot */
+static uint32_t key_hash (const char* key, size_t len) {
+  return (uint32_t) (pk_hash_bytes (key, len) & 0xFFFFFFFFUL);
+  }
+
+/**
+*** Building
+**/
+
+struct man_entry {
+  uint32_t key;       /*< Offset of the key in the pool */
+  uint32_t url;       /*< Offset of the URL in the pool */
+  uint32_t hash;      /*< Hash of the key */
+  int      fallback;  /*< Non-zero for the bare section alias of a qualified section */
+  };
+
+struct pk_man_builder {
+  bstring           pool;       /*< Keys and URLs, NUL terminated */
+  bstring           url;        /*< URL template */
+  struct man_entry* entries;    /*< Keys added, in order */
+  size_t            count;      /*< Number of keys */
+  size_t            capacity;   /*< Number of keys allocated */
+  size_t            pages;      /*< Number of pages added */
+  };
+
+struct pk_man_builder* pk_man_builder_new (const char* url_template) {
+  struct pk_man_builder* builder = (struct pk_man_builder*) calloc (1, sizeof (*builder));
+
+  if (builder == NULL) {
+    return NULL;
+    }
+
+  /* Offset zero marks an empty slot, so the pool starts with a NUL */
+  builder->pool = blk2bstr ("", 1);
+  builder->url = bfromcstr (url_template ? url_template : PK_MAN_DEFAULT_URL);
+
+  if (builder->pool == NULL || builder->url == NULL) {
+    pk_man_builder_free (builder);
+    return NULL;
+    }
+
+  return builder;
+  }
+
+void pk_man_builder_free (struct pk_man_builder* builder) {
+  if (builder != NULL) {
+    bdestroy (builder->pool);
+    bdestroy (builder->url);
+    free (builder->entries);
+    free (builder);
+    }
+  }
+
+size_t pk_man_builder_count (const struct pk_man_builder* builder) {
+  return builder->pages;
+  }
+
+/* Add a NUL terminated string to the pool, returning its offset (or 0) */
+static uint32_t pool_add (struct pk_man_builder* builder, const char* str, size_t len) {
+  uint32_t offset = (uint32_t) blength (builder->pool);
+
+  if (bcatblk (builder->pool, str, (int) len) != BSTR_OK || bconchar (builder->pool, '\0') != BSTR_OK) {
+    return 0;
+    }
+
+  return offset;
+  }
+
+/* Record the key "name(section)" for the URL at url */
+static int add_key (struct pk_man_builder* builder, const char* name, const char* section, size_t slen,
+                    uint32_t url, int fallback) {
+  struct man_entry* entry;
+  bstring key = bformat ("%s(%.*s)", name, (int) slen, section);
+
+  if (key == NULL) {
+    return PK_ERR;
+    }
+
+  if (builder->count == builder->capacity) {
+    size_t capacity = builder->capacity ? builder->capacity * 2 : 256;
+    struct man_entry* entries = (struct man_entry*) realloc (builder->entries, capacity * sizeof (*entries));
+
+    if (entries == NULL) {
+      bdestroy (key);
+      return PK_ERR;
+      }
+
+    builder->entries = entries;
+    builder->capacity = capacity;
+    }
+
+  entry = &builder->entries[builder->count];
+  entry->hash = key_hash ( (const char*) key->data, (size_t) key->slen);
+  entry->key = pool_add (builder, (const char*) key->data, (size_t) key->slen);
+  entry->url = url;
+  entry->fallback = fallback;
+  bdestroy (key);
+
+  if (entry->key == 0) {
+    return PK_ERR;
+    }
+
+  builder->count++;
+  return PK_OK;
+  }
+
+/* Make the URL of a page from the template */
+static bstring expand_url (const_bstring template, const char* name, const char* section) {
+  bstring url = bfromcstr ("");
+  int i;
+
+  for (i = 0; url != NULL && i < blength (template); i++) {
+    const char* rest = (const char*) template->data + i;
+    int status;
+
+    if (strncmp (rest, "{name}", 6) == 0) {
+      status = bcatcstr (url, name);
+      i += 5;
+      }
+
+    else if (strncmp (rest, "{section}", 9) == 0) {
+      status = bcatcstr (url, section);
+      i += 8;
+      }
+
+    else {
+      status = bconchar (url, *rest);
+      }
+
+    if (status != BSTR_OK) {
+      bdestroy (url);
+      url = NULL;
+      }
+    }
+
+  return url;
+  }
+
+int pk_man_builder_add (struct pk_man_builder* builder, const char* name, const char* section, const char* url) {
+  bstring made = NULL;
+  uint32_t offset;
+  size_t digits = 0;
+  int status;
+
+  if (*name == '\0' || *section == '\0') {
+    return PK_ERR;
+    }
+
+  if (url == NULL) {
+    made = expand_url (builder->url, name, section);
+
+    if (made == NULL) {
+      return PK_ERR;
+      }
+
+    url = (const char*) made->data;
+    }
+
+  offset = pool_add (builder, url, strlen (url));
+  bdestroy (made);
+  status = offset ? add_key (builder, name, section, strlen (section), offset, 0) : PK_ERR;
+
+  /* Pages in qualified sections (e.g. "3p") are also found under the
+   * bare section number, unless a page really is in that section
+   */
+  while (isdigit ( (unsigned char) section[digits])) {
+    digits++;
+    }
+
+  if (status == PK_OK && digits > 0 && section[digits] != '\0') {
+    status = add_key (builder, name, section, digits, offset, 1);
+    }
+
+  if (status == PK_OK) {
+    builder->pages++;
+    }
+
+  return status;
+  }
+
+/* Add the page held in a file (e.g. "ping.8.gz") of a man* directory */
+static int add_page_file (struct pk_man_builder* builder, const char* file, const char* dir_section) {
+  char name[MAN_KEY_MAX];
+  size_t len = strlen (file);
+  char* dot;
+  int i;
+
+  if (len == 0 || len >= sizeof (name) || file[0] == '.') {
+    return PK_OK;
+    }
+
+  memcpy (name, file, len + 1);
+
+  for (i = 0; man_suffixes[i] != NULL; i++) {
+    size_t slen = strlen (man_suffixes[i]);
+
+    if (len > slen && strcmp (name + len - slen, man_suffixes[i]) == 0) {
+      name[len - slen] = '\0';
+      break;
+      }
+    }
+
+  /* The section follows the last dot, and must match the directory */
+  dot = strrchr (name, '.');
+
+  if (dot == NULL || dot == name || dot[1] != dir_section[0]) {
+    return PK_OK;
+    }
+
+  *dot = '\0';
+  return pk_man_builder_add (builder, name, dot + 1, NULL);
+  }
+
+int pk_man_builder_scan (struct pk_man_builder* builder, const char* manpath) {
+#ifdef HAVE_DIRENT_H
+  const char* p = manpath;
+  int status = PK_OK;
+
+  while (status == PK_OK && *p != '\0') {
+    size_t len = strcspn (p, ":");
+    bstring dir = blk2bstr (p, (int) len);
+    DIR* top = dir ? opendir ( (const char*) dir->data) : NULL;
+    struct dirent* sub;
+
+    while (status == PK_OK && top != NULL && (sub = readdir (top)) != NULL) {
+      bstring path;
+      DIR* pages;
+      struct dirent* page;
+
+      /* Only the section directories (man1, man3p, ...) hold pages */
+      if (strncmp (sub->d_name, "man", 3) != 0 || sub->d_name[3] == '\0') {
+        continue;
+        }
+
+      path = bformat ("%s/%s", (const char*) dir->data, sub->d_name);
+      pages = path ? opendir ( (const char*) path->data) : NULL;
+
+      while (status == PK_OK && pages != NULL && (page = readdir (pages)) != NULL) {
+        status = add_page_file (builder, page->d_name, sub->d_name + 3);
+        }
+
+      if (pages != NULL) {
+        closedir (pages);
+        }
+
+      bdestroy (path);
+      }
+
+    if (top != NULL) {
+      closedir (top);
+      }
+
+    bdestroy (dir);
+    p += len;
+    p += *p == ':';
+    }
+
+  return status;
+#else
+  (void) builder;
+  (void) manpath;
+  return PK_ERR;
+#endif
+  }
+
+int pk_man_builder_read_list (struct pk_man_builder* builder, FILE* file) {
+  char line[4096];
+  int status = PK_OK;
+
+  while (status == PK_OK && fgets (line, sizeof (line), file) != NULL) {
+    char* fields[3];
+    char* p = line;
+    int n;
+
+    /* Split the line into the name, the section and the rest (the URL) */
+    for (n = 0; n < 3; n++) {
+      char* end;
+
+      while (*p == ' ' || *p == '\t') {
+        p++;
+        }
+
+      fields[n] = p;
+      end = p + strcspn (p, n < 2 ? " \t\r\n" : "\r\n");
+
+      /* Only a blank ends the name and section: a line end ends them all */
+      p = (*end == ' ' || *end == '\t') ? end + 1 : end;
+
+      while (n == 2 && end > fields[n] && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+        }
+
+      *end = '\0';
+      }
+
+    if (*fields[0] == '\0' || *fields[0] == '#') {
+      continue;
+      }
+
+    if (*fields[1] == '\0') {
+      status = PK_ERR;
+      break;
+      }
+
+    status = pk_man_builder_add (builder, fields[0], fields[1], *fields[2] ? fields[2] : NULL);
+    }
+
+  return ferror (file) ? PK_ERR : status;
+  }
+
+/* Place one entry in the slot table, unless its key is already present */
+static uint32_t place (const struct pk_man_builder* builder, unsigned char* slots, uint32_t nslots,
+                       const struct man_entry* entry) {
+  const char* pool = (const char*) builder->pool->data;
+  uint32_t i = entry->hash & (nslots - 1);
+
+  for (;;) {
+    unsigned char* slot = slots + (size_t) i * MAN_SLOT_SIZE;
+    uint32_t key = get32 (slot + 4);
+
+    if (key == 0) {
+      put32 (slot, entry->hash);
+      put32 (slot + 4, entry->key);
+      put32 (slot + 8, entry->url);
+      return 1;
+      }
+
+    if (get32 (slot) == entry->hash && strcmp (pool + key, pool + entry->key) == 0) {
+      return 0;
+      }
+
+    i = (i + 1) & (nslots - 1);
+    }
+  }
+
+int pk_man_builder_write (struct pk_man_builder* builder, const char* path) {
+  unsigned char header[MAN_HEADER_SIZE];
+  unsigned char* slots;
+  uint32_t nslots = 16;
+  uint32_t count = 0;
+  size_t size;
+  size_t i;
+  int pass;
+  int status = PK_OK;
+  bstring temp;
+  FILE* file;
+
+  /* Keep the table at most half full, so probes stay short */
+  while (nslots < builder->count * 2) {
+    nslots *= 2;
+    }
+
+  size = (size_t) nslots * MAN_SLOT_SIZE;
+  slots = (unsigned char*) calloc (1, size);
+
+  if (slots == NULL) {
+    return PK_ERR;
+    }
+
+  /* Real keys are placed before the bare section aliases */
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < builder->count; i++) {
+      if (builder->entries[i].fallback == pass) {
+        count += place (builder, slots, nslots, &builder->entries[i]);
+        }
+      }
+    }
+
+  memset (header, 0, sizeof (header));
+  memcpy (header, MAN_MAGIC, 8);
+  put32 (header + 8, nslots);
+  put32 (header + 12, count);
+  put32 (header + 16, MAN_HEADER_SIZE);
+  put32 (header + 20, (uint32_t) (MAN_HEADER_SIZE + size));
+  put32 (header + 24, (uint32_t) blength (builder->pool));
+
+  /* Write to a temporary name, so readers never map a partial index */
+  temp = bformat ("%s.tmp", path);
+  file = temp ? fopen ( (const char*) temp->data, "wb") : NULL;
+
+  if (file == NULL || fwrite (header, 1, sizeof (header), file) != sizeof (header) ||
+      fwrite (slots, 1, size, file) != size ||
+      fwrite (builder->pool->data, 1, (size_t) blength (builder->pool), file) != (size_t) blength (builder->pool)) {
+    status = PK_ERR;
+    }
+
+  if (file != NULL && fclose (file) != 0) {
+    status = PK_ERR;
+    }
+
+  if (status == PK_OK && rename ( (const char*) temp->data, path) != 0) {
+    status = PK_ERR;
+    }
+
+  if (status != PK_OK && file != NULL) {
+    remove ( (const char*) temp->data);
+    }
+
+  bdestroy (temp);
+  free (slots);
+  return status;
+  }
+
+/**
+*** Reading
+**/
+
+struct pk_man_index {
+  struct pk_mapping    map;        /*< The index file */
+  const unsigned char* slots;      /*< The slot table */
+  uint32_t             nslots;     /*< Number of slots (a power of two) */
+  uint32_t             count;      /*< Number of keys */
+  const char*          pool;       /*< The string pool */
+  uint32_t             pool_size;  /*< Size of the pool */
+  };
+
+struct pk_man_index* pk_man_index_open (const char* path) {
+  struct pk_man_index* index = (struct pk_man_index*) calloc (1, sizeof (*index));
+  const unsigned char* data;
+  uint32_t slot_offset;
+  uint32_t pool_offset;
+
+  if (index == NULL) {
+    return NULL;
+    }
+
+  if (pk_map_file (path, &index->map) != PK_OK || index->map.len < MAN_HEADER_SIZE ||
+      memcmp (index->map.data, MAN_MAGIC, 8) != 0) {
+    pk_man_index_close (index);
+    return NULL;
+    }
+
+  data = (const unsigned char*) index->map.data;
+  index->nslots = get32 (data + 8);
+  index->count = get32 (data + 12);
+  slot_offset = get32 (data + 16);
+  pool_offset = get32 (data + 20);
+  index->pool_size = get32 (data + 24);
+
+  /* Check the tables lie within the file, one after another as they were
+   * written, before trusting them
+   */
+  if (index->nslots == 0 || (index->nslots & (index->nslots - 1)) != 0 || slot_offset > index->map.len ||
+      (index->map.len - slot_offset) / MAN_SLOT_SIZE < index->nslots || pool_offset > index->map.len ||
+      index->map.len - pool_offset < index->pool_size || index->pool_size == 0 ||
+      data[pool_offset + index->pool_size - 1] != '\0' || slot_offset != MAN_HEADER_SIZE ||
+      pool_offset - slot_offset != (size_t) index->nslots * MAN_SLOT_SIZE ||
+      index->map.len - pool_offset != index->pool_size || index->count > index->nslots) {
+    pk_man_index_close (index);
+    return NULL;
+    }
+
+  index->slots = data + slot_offset;
+  index->pool = index->map.data + pool_offset;
+  return index;
+  }
+
+void pk_man_index_close (struct pk_man_index* index) {
+  if (index != NULL) {
+    pk_unmap_file (&index->map);
+    free (index);
+    }
+  }
+
+size_t pk_man_index_count (const struct pk_man_index* index) {
+  return index->count;
+  }
+
+const char* pk_man_index_lookup (const struct pk_man_index* index, struct pk_span name, struct pk_span section) {
+  char key[MAN_KEY_MAX];
+  size_t len = name.len + section.len + 2;
+  uint32_t hash;
+  uint32_t i;
+  uint32_t probes;
+
+  if (name.len == 0 || len >= sizeof (key)) {
+    return NULL;
+    }
+
+  memcpy (key, name.data, name.len);
+  key[name.len] = '(';
+  memcpy (key + name.len + 1, section.data, section.len);
+  key[len - 1] = ')';
+  key[len] = '\0';
+  hash = key_hash (key, len);
+
+  for (i = hash & (index->nslots - 1), probes = 0; probes < index->nslots; i = (i + 1) & (index->nslots - 1), probes++) {
+    const unsigned char* slot = index->slots + (size_t) i * MAN_SLOT_SIZE;
+    uint32_t offset = get32 (slot + 4);
+    uint32_t url = get32 (slot + 8);
+
+    if (offset == 0) {
+      break;
+      }
+
+    if (get32 (slot) == hash && offset < index->pool_size && url < index->pool_size &&
+        strcmp (index->pool + offset, key) == 0) {
+      return index->pool + url;
+      }
+    }
+
+  return NULL;
+  }
@@ -0,0 +1,576 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file meta.c
+*** \brief Document metadata read from the YAML sidecar files
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/hash.h"
+#include "packer/io.h"
+#include "packer/meta.h"
+
+/* Initial number of buckets in the directory cache */
+#define META_CACHE_BUCKETS 64
+
+/**
+*** YAML Reader
+**/
+
+/* Trim spaces and tabs from both ends of the span [*start, *stop) */
+static void trim_span (const char** start, const char** stop) {
+  while (*start < *stop && (**start == ' ' || **start == '\t')) {
+    (*start)++;
+    }
+
+  while (*stop > *start && ((*stop)[-1] == ' ' || (*stop)[-1] == '\t')) {
+    (*stop)--;
+    }
+  }
+
+void pk_yaml_init (struct pk_yaml_reader* reader, const char* buf, size_t len) {
+  reader->cur = buf;
+  reader->end = buf + len;
+  reader->line = 0;
+
+  /* Skip any UTF-8 byte order mark */
+  if (len >= 3 && (unsigned char) buf[0] == 0xEF && (unsigned char) buf[1] == 0xBB &&
+      (unsigned char) buf[2] == 0xBF) {
+    reader->cur += 3;
+    }
+  }
+
+int pk_yaml_next (struct pk_yaml_reader* reader, struct pk_span* key, struct pk_span* value) {
+  const char* line;
+  const char* eol;
+  const char* colon;
+  const char* vstart;
+  const char* vstop;
+
+  while (reader->cur < reader->end) {
+    line = reader->cur;
+    eol = (const char*) memchr (line, '\n', (size_t) (reader->end - line));
+
+    if (eol == NULL) {
+      eol = reader->end;
+      reader->cur = reader->end;
+      }
+
+    else {
+      reader->cur = eol + 1;
+      }
+
+    reader->line++;
+
+    /* Drop the carriage return of DOS line endings */
+    if (eol > line && eol[-1] == '\r') {
+      eol--;
+      }
+
+    /* Skip blank lines, comments and document markers */
+    if (line == eol || *line == '#') {
+      continue;
+      }
+
+    if (eol - line >= 3 && (memcmp (line, "---", 3) == 0 || memcmp (line, "...", 3) == 0)) {
+      continue;
+      }
+
+    /* Indented lines belong to nested structures outside our subset */
+    if (*line == ' ' || *line == '\t') {
+      continue;
+      }
+
+    /* Find the separator: a colon followed by a space or the end of line */
+    colon = line;
+
+    while (colon < eol) {
+      colon = (const char*) memchr (colon, ':', (size_t) (eol - colon));
+
+      if (colon == NULL || colon + 1 == eol || colon[1] == ' ' || colon[1] == '\t') {
+        break;
+        }
+
+      colon++;
+      }
+
+    if (colon == NULL || colon >= eol || colon == line) {
+      return PK_ERR;
+      }
+
+    vstart = line;
+    vstop = colon;
+    trim_span (&vstart, &vstop);
+    key->data = vstart;
+    key->len = (size_t) (vstop - vstart);
+
+    vstart = colon + 1;
+    vstop = eol;
+    trim_span (&vstart, &vstop);
+
+    if (vstart < vstop && (*vstart == '"' || *vstart == '\'')) {
+      /* Quoted value: everything up to the closing quote */
+      const char* close = (const char*) memchr (vstart + 1, *vstart, (size_t) (vstop - vstart - 1));
+
+      if (close == NULL) {
+        return PK_ERR;
+        }
+
+      vstart++;
+      vstop = close;
+      }
+
+    else {
+      /* Plain value: a comment starts at a '#' preceeded by a space */
+      const char* p;
+
+      for (p = vstart; p < vstop; p++) {
+        if (*p == '#' && p > vstart && (p[-1] == ' ' || p[-1] == '\t')) {
+          vstop = p;
+          trim_span (&vstart, &vstop);
+          break;
+          }
+        }
+      }
+
+    value->data = vstart;
+    value->len = (size_t) (vstop - vstart);
+    return 1;
+    }
+
+  return 0;
+  }
+
+/**
+*** Metadata Sets
+**/
+
+void pk_meta_init (struct pk_meta* meta) {
+  meta->entries = NULL;
+  meta->count = 0;
+  meta->capacity = 0;
+  meta->buffer = NULL;
+  }
+
+void pk_meta_clear (struct pk_meta* meta) {
+  free (meta->entries);
+  free (meta->buffer);
+  pk_meta_init (meta);
+  }
+
+/* Find the pair with the given key, or NULL */
+static struct pk_meta_entry* find_entry (const struct pk_meta* meta, const char* key, size_t len) {
+  size_t i;
+
+  for (i = 0; i < meta->count; i++) {
+    if (meta->entries[i].key.len == len && memcmp (meta->entries[i].key.data, key, len) == 0) {
+      return &meta->entries[i];
+      }
+    }
+
+  return NULL;
+  }
+
+/* Append a pair to the set, growing the pair array if needed */
+static int append_entry (struct pk_meta* meta, const struct pk_span* key, const struct pk_span* value,
+                         int inherited) {
+  struct pk_meta_entry* entry;
+
+  if (meta->count == meta->capacity) {
+    size_t capacity = meta->capacity ? meta->capacity * 2 : 8;
+    entry = (struct pk_meta_entry*) realloc (meta->entries, capacity * sizeof (*entry));
+
+    if (entry == NULL) {
+      return PK_ERR;
+      }
+
+    meta->entries = entry;
+    meta->capacity = capacity;
+    }
+
+  entry = &meta->entries[meta->count++];
+  entry->key = *key;
+  entry->value = *value;
+  entry->inherited = inherited;
+  return PK_OK;
+  }
+
+int pk_meta_parse (struct pk_meta* meta, char* buffer, size_t len) {
+  struct pk_yaml_reader reader;
+  struct pk_span key;
+  struct pk_span value;
+  struct pk_meta_entry* entry;
+  int status;
+
+  /* Take ownership of the text first, so it is released on any error */
+  free (meta->buffer);
+  meta->buffer = buffer;
+
+  pk_yaml_init (&reader, buffer, len);
+
+  while ( (status = pk_yaml_next (&reader, &key, &value)) != 0) {
+    if (status == PK_ERR) {
+      /* Skip lines we don't understand: front-matter is advisory */
+      continue;
+      }
+
+    entry = find_entry (meta, key.data, key.len);
+
+    if (entry != NULL) {
+      entry->value = value;
+      entry->inherited = 0;
+      }
+
+    else if (append_entry (meta, &key, &value, 0) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+int pk_meta_inherit (struct pk_meta* meta, const struct pk_meta* parent) {
+  size_t i;
+  size_t own = meta->count;
+
+  for (i = 0; i < parent->count; i++) {
+    const struct pk_meta_entry* pentry = &parent->entries[i];
+    size_t j;
+    int found = 0;
+
+    /* Only the pairs already in meta can override the parent */
+    for (j = 0; j < own; j++) {
+      if (meta->entries[j].key.len == pentry->key.len &&
+          memcmp (meta->entries[j].key.data, pentry->key.data, pentry->key.len) == 0) {
+        found = 1;
+        break;
+        }
+      }
+
+    if (!found && append_entry (meta, &pentry->key, &pentry->value, 1) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+const struct pk_span* pk_meta_get (const struct pk_meta* meta, const char* key) {
+  struct pk_meta_entry* entry = find_entry (meta, key, strlen (key));
+  return entry ? &entry->value : NULL;
+  }
+
+const struct pk_span* pk_meta_get_own (const struct pk_meta* meta, const char* key) {
+  struct pk_meta_entry* entry = find_entry (meta, key, strlen (key));
+  return (entry && !entry->inherited) ? &entry->value : NULL;
+  }
+
+/**
+*** Directory Cache
+**/
+
+struct pk_meta_dir {
+  uint64_t            hash;     /*< Hash of the directory path */
+  bstring             path;     /*< Directory path, without a trailing separator */
+  struct pk_meta      meta;     /*< Merged metadata for the directory */
+  bstring             file;     /*< Path of the directory file (which may not exist) */
+  struct pk_meta_dir* next;     /*< Next directory in the same bucket */
+  };
+
+struct pk_meta_cache {
+  bstring              root;    /*< Directory at which inheritance stops (may be NULL) */
+  struct pk_meta_dir** buckets; /*< Hash buckets of cached directories */
+  size_t               nbuckets;/*< Number of buckets */
+  size_t               count;   /*< Number of cached directories */
+  };
+
+/* Length of the directory part of path (without the separator), or
+ * zero if the path has no directory part
+ */
+static size_t dir_length (const char* path, size_t len) {
+  while (len > 0 && path[len - 1] != '/') {
+    len--;
+    }
+
+  /* Strip the separator(s), but keep a lone root separator */
+  while (len > 1 && path[len - 1] == '/') {
+    len--;
+    }
+
+  return len;
+  }
+
+/* Test whether the directory is at (or above) the cache root */
+static int is_top (const struct pk_meta_cache* cache, const char* dir, size_t len) {
+  if (len == 0 || (len == 1 && (dir[0] == '/' || dir[0] == '.'))) {
+    return 1;
+    }
+
+  return cache->root != NULL && len <= (size_t) blength (cache->root);
+  }
+
+struct pk_meta_cache* pk_meta_cache_new (const char* root) {
+  struct pk_meta_cache* cache = (struct pk_meta_cache*) calloc (1, sizeof (*cache));
+
+  if (cache == NULL) {
+    return NULL;
+    }
+
+  cache->nbuckets = META_CACHE_BUCKETS;
+  cache->buckets = (struct pk_meta_dir**) calloc (cache->nbuckets, sizeof (*cache->buckets));
+
+  if (cache->buckets == NULL) {
+    free (cache);
+    return NULL;
+    }
+
+  if (root != NULL) {
+    size_t len = strlen (root);
+
+    while (len > 1 && root[len - 1] == '/') {
+      len--;
+      }
+
+    cache->root = blk2bstr (root, (int) len);
+
+    if (cache->root == NULL) {
+      pk_meta_cache_free (cache);
+      return NULL;
+      }
+    }
+
+  return cache;
+  }
+
+void pk_meta_cache_free (struct pk_meta_cache* cache) {
+  size_t i;
+
+  if (cache == NULL) {
+    return;
+    }
+
+  for (i = 0; i < cache->nbuckets; i++) {
+    struct pk_meta_dir* dir = cache->buckets[i];
+
+    while (dir != NULL) {
+      struct pk_meta_dir* next = dir->next;
+      pk_meta_clear (&dir->meta);
+      bdestroy (dir->path);
+      bdestroy (dir->file);
+      free (dir);
+      dir = next;
+      }
+    }
+
+  free (cache->buckets);
+  bdestroy (cache->root);
+  free (cache);
+  }
+
+/* Double the number of buckets once the chains get long */
+static void grow_cache (struct pk_meta_cache* cache) {
+  size_t nbuckets = cache->nbuckets * 2;
+  struct pk_meta_dir** buckets = (struct pk_meta_dir**) calloc (nbuckets, sizeof (*buckets));
+  size_t i;
+
+  /* Failing to grow only makes the chains longer */
+  if (buckets == NULL) {
+    return;
+    }
+
+  for (i = 0; i < cache->nbuckets; i++) {
+    struct pk_meta_dir* dir = cache->buckets[i];
+
+    while (dir != NULL) {
+      struct pk_meta_dir* next = dir->next;
+      size_t slot = (size_t) (dir->hash & (nbuckets - 1));
+      dir->next = buckets[slot];
+      buckets[slot] = dir;
+      dir = next;
+      }
+    }
+
+  free (cache->buckets);
+  cache->buckets = buckets;
+  cache->nbuckets = nbuckets;
+  }
+
+/* Find or load the merged metadata for the directory [dir, dir + len) */
+static struct pk_meta_dir* lookup_dir (struct pk_meta_cache* cache, const char* dir, size_t len) {
+  uint64_t hash = pk_hash_bytes (dir, len);
+  struct pk_meta_dir* entry;
+  struct pk_meta_dir* parent = NULL;
+  const char* name;
+  char* text;
+  size_t text_len;
+
+  for (entry = cache->buckets[hash & (cache->nbuckets - 1)]; entry != NULL; entry = entry->next) {
+    if (entry->hash == hash && (size_t) blength (entry->path) == len &&
+        memcmp (entry->path->data, dir, len) == 0) {
+      return entry;
+      }
+    }
+
+  /* Not cached: resolve the parent first, so we can inherit from it */
+  if (!is_top (cache, dir, len)) {
+    parent = lookup_dir (cache, dir, dir_length (dir, len));
+
+    if (parent == NULL) {
+      return NULL;
+      }
+    }
+
+  entry = (struct pk_meta_dir*) calloc (1, sizeof (*entry));
+
+  if (entry == NULL) {
+    return NULL;
+    }
+
+  pk_meta_init (&entry->meta);
+  entry->hash = hash;
+  entry->path = blk2bstr (dir, (int) len);
+
+  /* The directory file is named after the directory itself */
+  name = dir + dir_length (dir, len);
+
+  while (name < dir + len && *name == '/') {
+    name++;
+    }
+
+  if (len > 0 && name < dir + len) {
+    entry->file = bformat ("%s/%.*s.yaml", bdata (entry->path), (int) (dir + len - name), name);
+    }
+
+  else {
+    entry->file = bfromcstr ("");
+    }
+
+  if (entry->path == NULL || entry->file == NULL) {
+    goto fail;
+    }
+
+  if (blength (entry->file) > 0 && (text = pk_read_file (bdata (entry->file), &text_len)) != NULL) {
+    if (pk_meta_parse (&entry->meta, text, text_len) != PK_OK) {
+      goto fail;
+      }
+    }
+
+  if (parent != NULL && pk_meta_inherit (&entry->meta, &parent->meta) != PK_OK) {
+    goto fail;
+    }
+
+  entry->next = cache->buckets[hash & (cache->nbuckets - 1)];
+  cache->buckets[hash & (cache->nbuckets - 1)] = entry;
+
+  if (++cache->count > cache->nbuckets) {
+    grow_cache (cache);
+    }
+
+  return entry;
+
+fail:
+  pk_meta_clear (&entry->meta);
+  bdestroy (entry->path);
+  bdestroy (entry->file);
+  free (entry);
+  return NULL;
+  }
+
+const struct pk_meta* pk_meta_cache_directory (struct pk_meta_cache* cache, const char* path) {
+  struct pk_meta_dir* dir = lookup_dir (cache, path, dir_length (path, strlen (path)));
+  return dir ? &dir->meta : NULL;
+  }
+
+int pk_meta_cache_document (struct pk_meta_cache* cache, const char* path, struct pk_meta* meta) {
+  size_t len = strlen (path);
+  size_t dlen = dir_length (path, len);
+  struct pk_meta_dir* dir;
+  bstring sidecar;
+  char* text;
+  size_t text_len;
+  int index;
+  int status = PK_OK;
+
+  dir = lookup_dir (cache, path, dlen);
+
+  if (dir == NULL) {
+    return PK_ERR;
+    }
+
+  /* Form the name of the sidecar by swapping the file extension */
+  sidecar = bfromcstr (path);
+
+  if (sidecar == NULL) {
+    return PK_ERR;
+    }
+
+  index = bstrrchr (sidecar, '.');
+
+  if (index != BSTR_ERR && (size_t) index > dlen) {
+    btrunc (sidecar, index);
+    }
+
+  if (bcatcstr (sidecar, ".yaml") != BSTR_OK) {
+    bdestroy (sidecar);
+    return PK_ERR;
+    }
+
+  if (biseq (sidecar, dir->file)) {
+    /* The document is the directory index (e.g. Labs/Labs.byx), whose
+     * sidecar is the directory file: reuse the merged set
+     */
+    size_t i;
+
+    for (i = 0; i < dir->meta.count && status == PK_OK; i++) {
+      status = append_entry (meta, &dir->meta.entries[i].key, &dir->meta.entries[i].value,
+                             dir->meta.entries[i].inherited);
+      }
+    }
+
+  else {
+    text = pk_read_file (bdata (sidecar), &text_len);
+
+    if (text != NULL) {
+      status = pk_meta_parse (meta, text, text_len);
+      }
+
+    if (status == PK_OK) {
+      status = pk_meta_inherit (meta, &dir->meta);
+      }
+    }
+
+  bdestroy (sidecar);
+  return status;
+  }
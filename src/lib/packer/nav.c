@@ -0,0 +1,1257 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file nav.c
+*** \brief Incrementally maintained site navigation
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_CTYPE_H
+#include <ctype.h>
+#else
+#error "can't find the C character class library"
+#endif
+
+#include "packer/hash.h"
+#include "packer/lexer.h"
+#include "packer/nav.h"
+
+/* Initial number of buckets in the page table */
+#define NAV_BUCKETS 256
+
+/* First line of a saved navigation state. Version 1 kept each field as
+ * it was; version 2 escapes the tabs, line ends and backslashes within
+ */
+#define NAV_STATE_MAGIC "PACKER-NAV 2"
+#define NAV_STATE_MAGIC_V1 "PACKER-NAV 1"
+
+struct pk_nav {
+  struct pk_nav_page*  root;      /*< Site root: parent of the top-level pages, head of the reading order */
+  struct pk_nav_page** buckets;   /*< Hash buckets of the pages, by key */
+  size_t               nbuckets;  /*< Number of buckets */
+  size_t               count;     /*< Number of nodes in the table */
+  struct pk_nav_page*  dirty;     /*< Head of the dirty list */
+  };
+
+/**
+*** Outlines
+**/
+
+void pk_nav_outline_init (struct pk_nav_outline* outline) {
+  memset (outline, 0, sizeof (*outline));
+  }
+
+/* Release an array of headings */
+static void free_headings (struct pk_nav_heading* headings, size_t count) {
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    bdestroy (headings[i].text);
+    bdestroy (headings[i].anchor);
+    }
+
+  free (headings);
+  }
+
+void pk_nav_outline_clear (struct pk_nav_outline* outline) {
+  bdestroy (outline->title);
+  free_headings (outline->headings, outline->count);
+  free (outline->anchors);
+  pk_nav_outline_init (outline);
+  }
+
+/* Append source text to a heading, stripping escapes and collapsing
+ * runs of white space into single spaces
+ */
+static int append_heading_text (bstring text, const char* src, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    char c = src[i];
+
+    if (c == '\\' && i + 1 < len) {
+      /* "\/" is an italic correction, and vanishes */
+      if (src[++i] == '/') {
+        continue;
+        }
+
+      c = src[i];
+      }
+
+    if (isspace ( (unsigned char) c)) {
+      if (blength (text) == 0 || text->data[text->slen - 1] == ' ') {
+        continue;
+        }
+
+      c = ' ';
+      }
+
+    if (bconchar (text, c) != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+/* Find anchor in the set of anchors taken by the outline: the slot found
+ * holds the heading with that anchor, or is empty
+ */
+static size_t find_anchor (const struct pk_nav_outline* outline, const_bstring anchor) {
+  size_t mask = outline->nanchors - 1;
+  size_t slot = (size_t) pk_hash_bytes (anchor->data, (size_t) blength (anchor)) & mask;
+
+  while (outline->anchors[slot] != 0 && !biseq (outline->headings[outline->anchors[slot] - 1].anchor, anchor)) {
+    slot = (slot + 1) & mask;
+    }
+
+  return slot;
+  }
+
+/* Make room in the anchor set for one more heading, keeping it at most
+ * half full
+ */
+static int grow_anchors (struct pk_nav_outline* outline) {
+  size_t* old = outline->anchors;
+  size_t nold = outline->nanchors;
+  size_t i;
+
+  if ( (outline->count + 1) * 2 <= outline->nanchors) {
+    return PK_OK;
+    }
+
+  outline->nanchors = nold ? nold * 2 : 32;
+  outline->anchors = (size_t*) calloc (outline->nanchors, sizeof (*outline->anchors));
+
+  if (outline->anchors == NULL) {
+    outline->anchors = old;
+    outline->nanchors = nold;
+    return PK_ERR;
+    }
+
+  for (i = 0; i < nold; i++) {
+    if (old[i] != 0) {
+      outline->anchors[find_anchor (outline, outline->headings[old[i] - 1].anchor)] = old[i];
+      }
+    }
+
+  free (old);
+  return PK_OK;
+  }
+
+/* Form an anchor name from the heading text, unique within the outline */
+static bstring make_anchor (struct pk_nav_outline* outline, const_bstring text) {
+  bstring anchor = bfromcstr ("");
+  bstring numbered = NULL;
+  struct pk_nav_heading* owner;
+  size_t slot;
+  int i;
+
+  if (anchor == NULL) {
+    return NULL;
+    }
+
+  for (i = 0; i < blength (text); i++) {
+    unsigned char c = text->data[i];
+
+    if (isalnum (c)) {
+      bconchar (anchor, (char) tolower (c));
+      }
+
+    else if (blength (anchor) > 0 && anchor->data[anchor->slen - 1] != '-') {
+      bconchar (anchor, '-');
+      }
+    }
+
+  if (blength (anchor) > 0 && anchor->data[anchor->slen - 1] == '-') {
+    btrunc (anchor, anchor->slen - 1);
+    }
+
+  if (blength (anchor) == 0) {
+    bassigncstr (anchor, "section");
+    }
+
+  slot = find_anchor (outline, anchor);
+
+  if (outline->anchors[slot] == 0) {
+    return anchor;
+    }
+
+  /* Number any repeats from the first: "questions", "questions-2", ...
+   * skipping numbers already taken by other headings
+   */
+  owner = &outline->headings[outline->anchors[slot] - 1];
+
+  do {
+    bdestroy (numbered);
+    numbered = bformat ("%s-%d", bdata (anchor), ++owner->repeats + 1);
+
+    if (numbered == NULL) {
+      break;
+      }
+    }
+  while (outline->anchors[find_anchor (outline, numbered)] != 0);
+
+  bdestroy (anchor);
+  return numbered;
+  }
+
+/* Add a completed heading to the outline */
+static int add_heading (struct pk_nav_outline* outline, int level, bstring text) {
+  struct pk_nav_heading* heading;
+
+  while (blength (text) > 0 && text->data[text->slen - 1] == ' ') {
+    btrunc (text, text->slen - 1);
+    }
+
+  if (level == 1 && outline->title == NULL) {
+    outline->title = bstrcpy (text);
+
+    if (outline->title == NULL) {
+      return PK_ERR;
+      }
+    }
+
+  if (outline->count == outline->capacity) {
+    size_t capacity = outline->capacity ? outline->capacity * 2 : 16;
+    heading = (struct pk_nav_heading*) realloc (outline->headings, capacity * sizeof (*heading));
+
+    if (heading == NULL) {
+      return PK_ERR;
+      }
+
+    outline->headings = heading;
+    outline->capacity = capacity;
+    }
+
+  if (grow_anchors (outline) != PK_OK) {
+    return PK_ERR;
+    }
+
+  heading = &outline->headings[outline->count];
+  heading->level = level;
+  heading->text = text;
+  heading->repeats = 0;
+  heading->anchor = make_anchor (outline, text);
+
+  if (heading->anchor == NULL) {
+    return PK_ERR;
+    }
+
+  outline->anchors[find_anchor (outline, heading->anchor)] = ++outline->count;
+  return PK_OK;
+  }
+
+int pk_nav_outline_add (struct pk_nav_outline* outline, int level, const char* src, size_t len) {
+  bstring text = bfromcstr ("");
+
+  if (text == NULL || append_heading_text (text, src, len) != PK_OK || add_heading (outline, level, text) != PK_OK) {
+    bdestroy (text);
+    return PK_ERR;
+    }
+
+  return PK_OK;
+  }
+
+int pk_nav_scan (const char* buf, size_t len, struct pk_nav_outline* outline) {
+  struct pk_lexer lexer;
+  struct pk_token token;
+  bstring text = NULL;
+  int level = 0;
+  int depth = 0;
+  int type;
+  int status = PK_OK;
+
+  pk_lexer_init (&lexer, buf, len);
+
+  while (status == PK_OK && (type = pk_lexer_next (&lexer, &token)) != PK_TOKEN_EOF) {
+    if (type == PK_ERR) {
+      status = PK_ERR;
+      break;
+      }
+
+    if (text == NULL) {
+      /* Outside a heading: look for the next one */
+      if (type == PK_TOKEN_OPEN && (token.flags & PK_TAG_HEADING)) {
+        level = token.tag - PK_TAG_H1 + 1;
+        depth = 1;
+        text = bfromcstr ("");
+
+        if (text == NULL) {
+          status = PK_ERR;
+          }
+        }
+
+      continue;
+      }
+
+    if (type == PK_TOKEN_TEXT) {
+      status = append_heading_text (text, token.text.data, token.text.len);
+      }
+
+    else if (type == PK_TOKEN_OPEN) {
+      depth++;
+      }
+
+    else if (--depth == 0) {
+      /* The outline owns the text from here on */
+      status = add_heading (outline, level, text);
+      text = NULL;
+      }
+    }
+
+  bdestroy (text);
+  pk_lexer_clear (&lexer);
+  return status;
+  }
+
+/**
+*** Page Table
+**/
+
+/* Allocate a node for the given key */
+static struct pk_nav_page* new_page (const char* key, size_t len) {
+  struct pk_nav_page* page = (struct pk_nav_page*) calloc (1, sizeof (*page));
+
+  if (page == NULL) {
+    return NULL;
+    }
+
+  page->key = blk2bstr (key, (int) len);
+
+  if (page->key == NULL) {
+    free (page);
+    return NULL;
+    }
+
+  page->hash = pk_hash_bytes (key, len);
+  return page;
+  }
+
+/* Release a node */
+static void free_page (struct pk_nav_page* page) {
+  bdestroy (page->key);
+  bdestroy (page->path);
+  bdestroy (page->title);
+  free_headings (page->headings, page->nheadings);
+  free (page);
+  }
+
+struct pk_nav* pk_nav_new (void) {
+  struct pk_nav* nav = (struct pk_nav*) calloc (1, sizeof (*nav));
+
+  if (nav == NULL) {
+    return NULL;
+    }
+
+  nav->nbuckets = NAV_BUCKETS;
+  nav->buckets = (struct pk_nav_page**) calloc (nav->nbuckets, sizeof (*nav->buckets));
+  nav->root = new_page ("", 0);
+
+  if (nav->buckets == NULL || nav->root == NULL) {
+    pk_nav_free (nav);
+    return NULL;
+    }
+
+  return nav;
+  }
+
+void pk_nav_free (struct pk_nav* nav) {
+  struct pk_nav_page* page;
+
+  if (nav == NULL) {
+    return;
+    }
+
+  /* Every node is on the reading order list, starting from the root */
+  page = nav->root;
+
+  while (page != NULL) {
+    struct pk_nav_page* next = page->next_node;
+    free_page (page);
+    page = next;
+    }
+
+  free (nav->buckets);
+  free (nav);
+  }
+
+/* Find the node with the given key */
+static struct pk_nav_page* find_key (struct pk_nav* nav, const char* key, size_t len) {
+  uint64_t hash = pk_hash_bytes (key, len);
+  struct pk_nav_page* page;
+
+  for (page = nav->buckets[hash & (nav->nbuckets - 1)]; page != NULL; page = page->chain) {
+    if (page->hash == hash && (size_t) page->key->slen == len && memcmp (page->key->data, key, len) == 0) {
+      return page;
+      }
+    }
+
+  return NULL;
+  }
+
+/* Add a node to the page table, growing the table as needed */
+static void insert_key (struct pk_nav* nav, struct pk_nav_page* page) {
+  size_t slot;
+
+  if (nav->count >= nav->nbuckets) {
+    size_t nbuckets = nav->nbuckets * 2;
+    struct pk_nav_page** buckets = (struct pk_nav_page**) calloc (nbuckets, sizeof (*buckets));
+
+    if (buckets != NULL) {
+      size_t i;
+
+      for (i = 0; i < nav->nbuckets; i++) {
+        struct pk_nav_page* entry = nav->buckets[i];
+
+        while (entry != NULL) {
+          struct pk_nav_page* chain = entry->chain;
+          entry->chain = buckets[entry->hash & (nbuckets - 1)];
+          buckets[entry->hash & (nbuckets - 1)] = entry;
+          entry = chain;
+          }
+        }
+
+      free (nav->buckets);
+      nav->buckets = buckets;
+      nav->nbuckets = nbuckets;
+      }
+    }
+
+  slot = (size_t) (page->hash & (nav->nbuckets - 1));
+  page->chain = nav->buckets[slot];
+  nav->buckets[slot] = page;
+  nav->count++;
+  }
+
+/* Remove a node from the page table */
+static void remove_key (struct pk_nav* nav, struct pk_nav_page* page) {
+  struct pk_nav_page** link = &nav->buckets[page->hash & (nav->nbuckets - 1)];
+
+  while (*link != NULL) {
+    if (*link == page) {
+      *link = page->chain;
+      nav->count--;
+      return;
+      }
+
+    link = & (*link)->chain;
+    }
+  }
+
+/**
+*** Paths
+**/
+
+/* Length of the directory part of path, without the separator */
+static size_t dir_length (const char* path, size_t len) {
+  while (len > 0 && path[len - 1] != '/') {
+    len--;
+    }
+
+  return len > 0 ? len - 1 : 0;
+  }
+
+/* Form the node key of the page at path. Index pages (Labs/Labs.byx) are
+ * keyed by their directory ("Labs/"), other pages by their path
+ */
+static size_t page_key (const char* path, size_t len, int* is_index) {
+  size_t dlen = dir_length (path, len);
+  const char* base = path + (dlen ? dlen + 1 : 0);
+  const char* dot = strrchr (base, '.');
+  const char* dir = path + dlen;
+  size_t stem = dot ? (size_t) (dot - base) : (size_t) (path + len - base);
+
+  *is_index = 0;
+
+  if (dlen == 0) {
+    return len;
+    }
+
+  /* Find the last component of the directory */
+  while (dir > path && dir[-1] != '/') {
+    dir--;
+    }
+
+  if ( (size_t) (path + dlen - dir) == stem && memcmp (dir, base, stem) == 0) {
+    *is_index = 1;
+    return dlen + 1;
+    }
+
+  return len;
+  }
+
+/* The name used to order a node amongst its siblings: the last
+ * component of its key
+ */
+static void sort_name (const struct pk_nav_page* page, const char** name, size_t* len) {
+  size_t klen = (size_t) page->key->slen;
+  const char* key = (const char*) page->key->data;
+
+  if (klen > 0 && key[klen - 1] == '/') {
+    klen--;
+    }
+
+  *len = klen - (klen > 0 ? dir_length (key, klen) + (dir_length (key, klen) > 0) : 0);
+  *name = key + klen - *len;
+  }
+
+/* Compare the sibling order of two nodes */
+static int compare_pages (const struct pk_nav_page* a, const struct pk_nav_page* b) {
+  const char* aname;
+  const char* bname;
+  size_t alen;
+  size_t blen;
+  int cmp;
+
+  if (a->weight != b->weight) {
+    return a->weight < b->weight ? -1 : 1;
+    }
+
+  sort_name (a, &aname, &alen);
+  sort_name (b, &bname, &blen);
+  cmp = memcmp (aname, bname, alen < blen ? alen : blen);
+  return cmp ? cmp : (alen > blen) - (alen < blen);
+  }
+
+/**
+*** Tree and Reading Order
+**/
+
+/* The last node of the subtree rooted at page, in reading order */
+static struct pk_nav_page* last_descendant (struct pk_nav_page* page) {
+  while (page->last_child != NULL) {
+    page = page->last_child;
+    }
+
+  return page;
+  }
+
+/* Unlink the subtree rooted at page from its parent and the reading order */
+static void detach (struct pk_nav_page* page) {
+  struct pk_nav_page* last = last_descendant (page);
+
+  if (page->prev_sibling) {
+    page->prev_sibling->next_sibling = page->next_sibling;
+    }
+
+  else {
+    page->parent->first_child = page->next_sibling;
+    }
+
+  if (page->next_sibling) {
+    page->next_sibling->prev_sibling = page->prev_sibling;
+    }
+
+  else {
+    page->parent->last_child = page->prev_sibling;
+    }
+
+  page->prev_sibling = page->next_sibling = NULL;
+
+  /* The subtree is a contiguous run of the reading order */
+  page->prev_node->next_node = last->next_node;
+
+  if (last->next_node) {
+    last->next_node->prev_node = page->prev_node;
+    }
+
+  page->prev_node = NULL;
+  last->next_node = NULL;
+  }
+
+/* Link the subtree rooted at page under parent, in sibling order */
+static void attach (struct pk_nav_page* page, struct pk_nav_page* parent) {
+  struct pk_nav_page* before = parent->last_child;
+  struct pk_nav_page* pred;
+  struct pk_nav_page* last = last_descendant (page);
+
+  /* Search from the end, so pages arriving in order are appended at once */
+  while (before != NULL && compare_pages (page, before) < 0) {
+    before = before->prev_sibling;
+    }
+
+  page->parent = parent;
+  page->prev_sibling = before;
+  page->next_sibling = before ? before->next_sibling : parent->first_child;
+
+  if (page->next_sibling) {
+    page->next_sibling->prev_sibling = page;
+    }
+
+  else {
+    parent->last_child = page;
+    }
+
+  if (before) {
+    before->next_sibling = page;
+    }
+
+  else {
+    parent->first_child = page;
+    }
+
+  /* In reading order, the subtree follows the previous sibling's subtree */
+  pred = before ? last_descendant (before) : parent;
+  last->next_node = pred->next_node;
+
+  if (pred->next_node) {
+    pred->next_node->prev_node = last;
+    }
+
+  pred->next_node = page;
+  page->prev_node = pred;
+  }
+
+struct pk_nav_page* pk_nav_prev (struct pk_nav_page* page) {
+  for (page = page->prev_node; page != NULL && page->path == NULL; page = page->prev_node)
+    ;
+
+  return page;
+  }
+
+struct pk_nav_page* pk_nav_first (struct pk_nav* nav) {
+  return pk_nav_next (nav->root);
+  }
+
+struct pk_nav_page* pk_nav_next (struct pk_nav_page* page) {
+  for (page = page->next_node; page != NULL && page->path == NULL; page = page->next_node)
+    ;
+
+  return page;
+  }
+
+/**
+*** Dirty Tracking
+**/
+
+/* Flag a page for regeneration */
+static void mark (struct pk_nav* nav, struct pk_nav_page* page, unsigned flags) {
+  if (flags == 0 || page == NULL || page == nav->root || page->path == NULL) {
+    return;
+    }
+
+  if (page->dirty == 0) {
+    page->dirty_next = nav->dirty;
+    nav->dirty = page;
+    }
+
+  page->dirty |= flags;
+  }
+
+/* Flag the pages that link to page: its parent (which lists it) and its
+ * neighbours in reading order
+ */
+static void mark_neighbours (struct pk_nav* nav, struct pk_nav_page* page) {
+  mark (nav, page->parent, PK_NAV_DIRTY_LINKS);
+  mark (nav, pk_nav_prev (page), PK_NAV_DIRTY_LINKS);
+  mark (nav, pk_nav_next (page), PK_NAV_DIRTY_LINKS);
+  }
+
+/* Flag every page below page, whose breadcrumbs include its title */
+static void mark_descendants (struct pk_nav* nav, struct pk_nav_page* page) {
+  struct pk_nav_page* last = last_descendant (page);
+
+  while (page != last) {
+    page = page->next_node;
+    mark (nav, page, PK_NAV_DIRTY_CRUMBS);
+    }
+  }
+
+struct pk_nav_page* pk_nav_take_dirty (struct pk_nav* nav) {
+  struct pk_nav_page* page = nav->dirty;
+
+  if (page != NULL) {
+    nav->dirty = page->dirty_next;
+    page->dirty_next = NULL;
+    }
+
+  return page;
+  }
+
+/* Drop all pending dirty flags */
+static void clear_dirty (struct pk_nav* nav) {
+  struct pk_nav_page* page;
+
+  while ( (page = pk_nav_take_dirty (nav)) != NULL) {
+    page->dirty = 0;
+    }
+  }
+
+/**
+*** Updates
+**/
+
+/* Find or create the node for the directory [dir, dir + len) */
+static struct pk_nav_page* directory (struct pk_nav* nav, const char* dir, size_t len) {
+  struct pk_nav_page* page;
+  struct pk_nav_page* parent;
+  bstring key;
+  size_t plen;
+
+  if (len == 0) {
+    return nav->root;
+    }
+
+  key = blk2bstr (dir, (int) len);
+
+  if (key == NULL || bconchar (key, '/') != BSTR_OK) {
+    bdestroy (key);
+    return NULL;
+    }
+
+  page = find_key (nav, bdata (key), (size_t) key->slen);
+
+  if (page == NULL) {
+    parent = directory (nav, dir, dir_length (dir, len));
+
+    if (parent != NULL && (page = new_page (bdata (key), (size_t) key->slen)) != NULL) {
+      plen = dir_length (dir, len);
+      page->title = blk2bstr (dir + (plen ? plen + 1 : 0), (int) (len - (plen ? plen + 1 : 0)));
+      insert_key (nav, page);
+      attach (page, parent);
+      mark (nav, parent, PK_NAV_DIRTY_LINKS);
+      }
+    }
+
+  bdestroy (key);
+  return page;
+  }
+
+/* Test whether two tables of contents differ */
+static int headings_differ (const struct pk_nav_page* page, const struct pk_nav_outline* outline) {
+  size_t i;
+
+  if (page->nheadings != outline->count) {
+    return 1;
+    }
+
+  for (i = 0; i < outline->count; i++) {
+    if (page->headings[i].level != outline->headings[i].level ||
+        !biseq (page->headings[i].text, outline->headings[i].text)) {
+      return 1;
+      }
+    }
+
+  return 0;
+  }
+
+int pk_nav_update (struct pk_nav* nav, const char* path, const char* title, int weight,
+                   struct pk_nav_outline* outline) {
+  size_t len = strlen (path);
+  int is_index;
+  size_t klen = page_key (path, len, &is_index);
+  struct pk_nav_page* page;
+  struct pk_nav_page* parent;
+  bstring new_title;
+  unsigned changes = 0;
+
+  /* Choose the title: the one given, the first [h1], or the file name */
+  if (title != NULL) {
+    new_title = bfromcstr (title);
+    }
+
+  else if (outline->title != NULL) {
+    new_title = bstrcpy (outline->title);
+    }
+
+  else {
+    size_t dlen = dir_length (path, len);
+    new_title = bfromcstr (path + (dlen ? dlen + 1 : 0));
+    }
+
+  if (new_title == NULL) {
+    return PK_ERR;
+    }
+
+  page = find_key (nav, path, klen);
+
+  if (page == NULL) {
+    /* A new page: link it into the tree */
+    parent = directory (nav, path, dir_length (path, is_index ? klen - 1 : len));
+    page = parent ? new_page (path, klen) : NULL;
+
+    if (page == NULL) {
+      bdestroy (new_title);
+      return PK_ERR;
+      }
+
+    page->weight = weight;
+    insert_key (nav, page);
+    attach (page, parent);
+    changes |= PK_NAV_DIRTY_LINKS;
+    }
+
+  else if (page->weight != weight) {
+    /* Moving amongst the siblings: the old neighbours lose their link */
+    mark_neighbours (nav, page);
+    parent = page->parent;
+    detach (page);
+    page->weight = weight;
+    attach (page, parent);
+    changes |= PK_NAV_DIRTY_LINKS;
+    }
+
+  if (page->path == NULL) {
+    /* A new page, or a directory placeholder gaining its index page */
+    page->path = blk2bstr (path, (int) len);
+
+    if (page->path == NULL) {
+      bdestroy (new_title);
+      return PK_ERR;
+      }
+
+    changes |= PK_NAV_DIRTY_LINKS;
+    }
+
+  if (page->title == NULL || !biseq (page->title, new_title)) {
+    bdestroy (page->title);
+    page->title = new_title;
+    changes |= PK_NAV_DIRTY_TOC | PK_NAV_DIRTY_LINKS;
+    mark_descendants (nav, page);
+    }
+
+  else {
+    bdestroy (new_title);
+    }
+
+  if (headings_differ (page, outline)) {
+    free_headings (page->headings, page->nheadings);
+    page->headings = outline->headings;
+    page->nheadings = outline->count;
+    outline->headings = NULL;
+    outline->count = outline->capacity = 0;
+    free (outline->anchors);
+    outline->anchors = NULL;
+    outline->nanchors = 0;
+    changes |= PK_NAV_DIRTY_TOC;
+    }
+
+  /* Anything but a change of headings shows up in the neighbours too */
+  if (changes & PK_NAV_DIRTY_LINKS) {
+    mark_neighbours (nav, page);
+    }
+
+  mark (nav, page, changes);
+  return PK_OK;
+  }
+
+struct pk_nav_page* pk_nav_find (struct pk_nav* nav, const char* path) {
+  int is_index;
+  size_t klen = page_key (path, strlen (path), &is_index);
+  struct pk_nav_page* page = find_key (nav, path, klen);
+
+  return (page != NULL && page->path != NULL) ? page : NULL;
+  }
+
+/* Unlink a node from the dirty list */
+static void undirty (struct pk_nav* nav, struct pk_nav_page* page) {
+  struct pk_nav_page** link = &nav->dirty;
+
+  while (*link != NULL) {
+    if (*link == page) {
+      *link = page->dirty_next;
+      break;
+      }
+
+    link = & (*link)->dirty_next;
+    }
+
+  page->dirty = 0;
+  page->dirty_next = NULL;
+  }
+
+int pk_nav_remove (struct pk_nav* nav, const char* path) {
+  struct pk_nav_page* page = pk_nav_find (nav, path);
+  struct pk_nav_page* parent;
+
+  if (page == NULL) {
+    return PK_ERR;
+    }
+
+  mark_neighbours (nav, page);
+  undirty (nav, page);
+
+  if (page->first_child != NULL) {
+    /* An index page: the directory stays, as a placeholder */
+    size_t klen = (size_t) page->key->slen - 1;
+    size_t dlen = dir_length ( (const char*) page->key->data, klen);
+
+    bdestroy (page->path);
+    bdestroy (page->title);
+    page->path = NULL;
+    page->title = blk2bstr (page->key->data + (dlen ? dlen + 1 : 0), (int) (klen - (dlen ? dlen + 1 : 0)));
+    mark_descendants (nav, page);
+    return page->title ? PK_OK : PK_ERR;
+    }
+
+  /* Remove the page, and any placeholders left empty by its removal */
+  do {
+    parent = page->parent;
+    mark (nav, parent, PK_NAV_DIRTY_LINKS);
+    detach (page);
+    remove_key (nav, page);
+    free_page (page);
+    page = parent;
+    }
+
+  while (page != nav->root && page->path == NULL && page->first_child == NULL);
+
+  return PK_OK;
+  }
+
+/**
+*** Output
+**/
+
+/* Append a JSON string literal (or null) to out */
+static void json_string (bstring out, const_bstring str) {
+  int i;
+
+  if (str == NULL) {
+    bcatcstr (out, "null");
+    return;
+    }
+
+  bconchar (out, '"');
+
+  for (i = 0; i < str->slen; i++) {
+    unsigned char c = str->data[i];
+
+    if (c == '"' || c == '\\') {
+      bconchar (out, '\\');
+      bconchar (out, (char) c);
+      }
+
+    else if (c < 0x20) {
+      bformata (out, "\\u%04x", c);
+      }
+
+    else {
+      bconchar (out, (char) c);
+      }
+    }
+
+  bconchar (out, '"');
+  }
+
+/* Append a link to page (path and title) to out */
+static void json_link (bstring out, const struct pk_nav_page* page) {
+  if (page == NULL) {
+    bcatcstr (out, "null");
+    return;
+    }
+
+  bcatcstr (out, "{\"path\":");
+  json_string (out, page->path);
+  bcatcstr (out, ",\"title\":");
+  json_string (out, page->title);
+  bconchar (out, '}');
+  }
+
+/* Append the breadcrumbs of page, outermost first */
+static void json_crumbs (bstring out, const struct pk_nav_page* page) {
+  if (page->parent == NULL) {
+    return;
+    }
+
+  json_crumbs (out, page->parent);
+
+  if (page->parent->parent != NULL) {
+    bconchar (out, ',');
+    }
+
+  json_link (out, page);
+  }
+
+int pk_nav_format (struct pk_nav_page* page, bstring out) {
+  struct pk_nav_page* child;
+  size_t i;
+  int start = blength (out);
+
+  bcatcstr (out, "{\"path\":");
+  json_string (out, page->path);
+  bcatcstr (out, ",\"title\":");
+  json_string (out, page->title);
+
+  bcatcstr (out, ",\"parent\":");
+  json_link (out, (page->parent && page->parent->parent) ? page->parent : NULL);
+  bcatcstr (out, ",\"prev\":");
+  json_link (out, pk_nav_prev (page));
+  bcatcstr (out, ",\"next\":");
+  json_link (out, pk_nav_next (page));
+
+  bcatcstr (out, ",\"breadcrumbs\":[");
+
+  if (page->parent != NULL) {
+    json_crumbs (out, page->parent);
+    }
+
+  bcatcstr (out, "],\"children\":[");
+
+  for (child = page->first_child; child != NULL; child = child->next_sibling) {
+    json_link (out, child);
+
+    if (child->next_sibling != NULL) {
+      bconchar (out, ',');
+      }
+    }
+
+  bcatcstr (out, "],\"toc\":[");
+
+  for (i = 0; i < page->nheadings; i++) {
+    bformata (out, "%s{\"level\":%d,\"anchor\":", i ? "," : "", page->headings[i].level);
+    json_string (out, page->headings[i].anchor);
+    bcatcstr (out, ",\"title\":");
+    json_string (out, page->headings[i].text);
+    bconchar (out, '}');
+    }
+
+  /* bstring operations leave the string alone on failure, so one check
+   * of the final result catches a failure anywhere above
+   */
+  if (bcatcstr (out, "]}\n") != BSTR_OK) {
+    btrunc (out, start);
+    return PK_ERR;
+    }
+
+  return PK_OK;
+  }
+
+/**
+*** Persistence
+**/
+
+/* Write a field of a state line, escaping what would end the field or
+ * the line. A missing field is left empty
+ */
+static void save_field (FILE* file, const_bstring text) {
+  int i;
+
+  for (i = 0; text != NULL && i < blength (text); i++) {
+    switch (text->data[i]) {
+      case '\t':
+        fputs ("\\t", file);
+        break;
+
+      case '\n':
+        fputs ("\\n", file);
+        break;
+
+      case '\r':
+        fputs ("\\r", file);
+        break;
+
+      case '\\':
+        fputs ("\\\\", file);
+        break;
+
+      default:
+        putc (text->data[i], file);
+        break;
+      }
+    }
+  }
+
+int pk_nav_save (struct pk_nav* nav, FILE* file) {
+  struct pk_nav_page* page;
+  size_t i;
+
+  fprintf (file, "%s\n", NAV_STATE_MAGIC);
+
+  /* Reading order, so the pages are appended to the tree on loading */
+  for (page = pk_nav_next (nav->root); page != NULL; page = pk_nav_next (page)) {
+    fprintf (file, "P\t%d\t", page->weight);
+    save_field (file, page->path);
+    putc ('\t', file);
+    save_field (file, page->title);
+    putc ('\n', file);
+
+    for (i = 0; i < page->nheadings; i++) {
+      fprintf (file, "H\t%d\t", page->headings[i].level);
+      save_field (file, page->headings[i].text);
+      putc ('\n', file);
+      }
+    }
+
+  return ferror (file) ? PK_ERR : PK_OK;
+  }
+
+/* Read the next line of a state file into line, without its line end.
+ * Returns one for a line, zero at the end of the file and -1 on error
+ */
+static int read_line (FILE* file, bstring line) {
+  int c;
+
+  btrunc (line, 0);
+
+  while ( (c = getc (file)) != EOF && c != '\n') {
+    if (bconchar (line, (char) c) != BSTR_OK) {
+      return -1;
+      }
+    }
+
+  if (ferror (file)) {
+    return -1;
+    }
+
+  if (blength (line) > 0 && bchar (line, blength (line) - 1) == '\r') {
+    btrunc (line, blength (line) - 1);
+    }
+
+  return c != EOF || blength (line) > 0;
+  }
+
+/* Split a state line at the next tab, returning the start of the field
+ * and advancing *line past it
+ */
+static char* next_field (char** line) {
+  char* field = *line;
+  char* tab = strchr (field, '\t');
+
+  if (tab != NULL) {
+    *tab = '\0';
+    *line = tab + 1;
+    }
+
+  else {
+    *line = field + strlen (field);
+    }
+
+  return field;
+  }
+
+/* Copy a field of a state line, undoing the escapes of save_field (if
+ * escaped is set)
+ */
+static bstring load_field (const char* field, int escaped) {
+  bstring text = bfromcstr ("");
+  const char* p;
+
+  for (p = field; text != NULL && *p != '\0'; p++) {
+    char c = *p;
+
+    if (escaped && c == '\\' && p[1] != '\0') {
+      p++;
+      c = *p == 't' ? '\t' : *p == 'n' ? '\n' : *p == 'r' ? '\r' : *p;
+      }
+
+    if (bconchar (text, c) != BSTR_OK) {
+      bdestroy (text);
+      text = NULL;
+      }
+    }
+
+  return text;
+  }
+
+/* Add the page read from the state file to the graph */
+static int load_page (struct pk_nav* nav, bstring path, bstring title, int weight,
+                      struct pk_nav_outline* outline) {
+  int status = PK_OK;
+
+  /* An empty title is made again from the outline, as when first added */
+  if (path != NULL) {
+    status = pk_nav_update (nav, bdata (path), blength (title) > 0 ? bdata (title) : NULL, weight, outline);
+    }
+
+  pk_nav_outline_clear (outline);
+  return status;
+  }
+
+int pk_nav_load (struct pk_nav* nav, FILE* file) {
+  bstring buffer = bfromcstr ("");
+  struct pk_nav_outline outline;
+  bstring path = NULL;
+  bstring title = NULL;
+  int weight = 0;
+  int escaped;
+  int more;
+  int status = PK_OK;
+
+  if (buffer == NULL || read_line (file, buffer) <= 0 || (biseqcstr (buffer, NAV_STATE_MAGIC) != 1 &&
+      biseqcstr (buffer, NAV_STATE_MAGIC_V1) != 1)) {
+    bdestroy (buffer);
+    return PK_ERR;
+    }
+
+  escaped = biseqcstr (buffer, NAV_STATE_MAGIC) == 1;
+  pk_nav_outline_init (&outline);
+
+  while (status == PK_OK && (more = read_line (file, buffer)) != 0) {
+    char* line = (char*) buffer->data;
+    char* type;
+
+    if (more < 0) {
+      status = PK_ERR;
+      break;
+      }
+
+    type = next_field (&line);
+
+    if (strcmp (type, "P") == 0) {
+      status = load_page (nav, path, title, weight, &outline);
+      bdestroy (path);
+      bdestroy (title);
+      weight = atoi (next_field (&line));
+      path = load_field (next_field (&line), escaped);
+      title = load_field (next_field (&line), escaped);
+
+      if (path == NULL || title == NULL) {
+        status = PK_ERR;
+        }
+      }
+
+    else if (strcmp (type, "H") == 0 && path != NULL) {
+      int level = atoi (next_field (&line));
+      bstring text = load_field (line, escaped);
+
+      if (text == NULL || add_heading (&outline, level, text) != PK_OK) {
+        bdestroy (text);
+        status = PK_ERR;
+        }
+      }
+    }
+
+  if (status == PK_OK) {
+    status = load_page (nav, path, title, weight, &outline);
+    }
+
+  pk_nav_outline_clear (&outline);
+  bdestroy (buffer);
+  bdestroy (path);
+  bdestroy (title);
+
+  /* The loaded graph is the baseline: nothing needs regenerating yet */
+  clear_dirty (nav);
+  return status;
+  }
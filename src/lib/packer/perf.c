@@ -0,0 +1,217 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file perf.c
+*** \brief Hardware performance counters read around each phase of a build
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* syscall is a GNU extension */
+#define _GNU_SOURCE
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+/* The counters need the Linux event interface, reached through syscall */
+#if defined(HAVE_LINUX_PERF_EVENT_H) && defined(HAVE_UNISTD_H)
+#define PERF_LINUX 1
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "packer/perf.h"
+
+const char* const pk_perf_event_names[PK_PERF_EVENTS] = {
+  "cycles", "instructions", "branch-misses", "L1-dcache-load-misses", "LLC-misses", "task-clock"
+  };
+
+const char* const pk_phase_names[PK_PHASES] = {
+  "lex", "parse", "resolve", "emit"
+  };
+
+#ifdef PERF_LINUX
+
+/* The kind of each event, in the order of enum pk_perf_event */
+static const struct {
+  uint32_t type;
+  uint64_t config;
+  } perf_events[PK_PERF_EVENTS] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK }
+  };
+
+/* Open a counter of the event for this thread and the threads it starts,
+ * on any processor, counting only time spent in the program
+ */
+static int open_event (int event) {
+  struct perf_event_attr attr;
+  unsigned long flags = 0;
+
+  memset (&attr, 0, sizeof (attr));
+  attr.size = sizeof (attr);
+  attr.type = perf_events[event].type;
+  attr.config = perf_events[event].config;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+#ifdef PERF_FLAG_FD_CLOEXEC
+  flags = PERF_FLAG_FD_CLOEXEC;
+#endif
+
+  return (int) syscall (SYS_perf_event_open, &attr, 0, -1, -1, flags);
+  }
+
+/* Read a counter, scaled up to the whole time it was enabled if it had to
+ * share the processor's counters with other events
+ */
+static uint64_t read_event (int fd) {
+  uint64_t value[3];
+
+  if (read (fd, value, sizeof (value)) != (ssize_t) sizeof (value)) {
+    return 0;
+    }
+
+  if (value[2] > 0 && value[2] < value[1]) {
+    return (uint64_t) ( (double) value[0] * ( (double) value[1] / (double) value[2]));
+    }
+
+  return value[0];
+  }
+
+#endif
+
+/* Read every open counter into values */
+static void sample (const struct pk_perf* perf, uint64_t* values) {
+  int i;
+
+  for (i = 0; i < PK_PERF_EVENTS; i++) {
+    values[i] = 0;
+
+#ifdef PERF_LINUX
+
+    if (perf->fd[i] >= 0) {
+      values[i] = read_event (perf->fd[i]);
+      }
+
+#endif
+    }
+  }
+
+int pk_perf_open (struct pk_perf* perf) {
+  int opened = 0;
+  int i;
+
+  memset (perf, 0, sizeof (*perf));
+  perf->phase = -1;
+
+  for (i = 0; i < PK_PERF_EVENTS; i++) {
+    perf->fd[i] = -1;
+
+#ifdef PERF_LINUX
+    perf->fd[i] = open_event (i);
+    opened += perf->fd[i] >= 0;
+#endif
+    }
+
+  return opened > 0 ? PK_OK : PK_ERR;
+  }
+
+void pk_perf_close (struct pk_perf* perf) {
+  int i;
+
+  if (perf == NULL) {
+    return;
+    }
+
+  pk_perf_end (perf);
+
+  for (i = 0; i < PK_PERF_EVENTS; i++) {
+#ifdef PERF_LINUX
+
+    if (perf->fd[i] >= 0) {
+      close (perf->fd[i]);
+      }
+
+#endif
+    perf->fd[i] = -1;
+    }
+  }
+
+int pk_perf_has (const struct pk_perf* perf, int event) {
+  return perf != NULL && perf->fd[event] >= 0;
+  }
+
+void pk_perf_begin (struct pk_perf* perf, int phase) {
+  if (perf == NULL) {
+    return;
+    }
+
+  pk_perf_end (perf);
+  perf->phase = phase;
+  sample (perf, perf->start);
+  }
+
+void pk_perf_end (struct pk_perf* perf) {
+  uint64_t now[PK_PERF_EVENTS];
+  int i;
+
+  if (perf == NULL || perf->phase < 0) {
+    return;
+    }
+
+  sample (perf, now);
+
+  for (i = 0; i < PK_PERF_EVENTS; i++) {
+    perf->count[perf->phase][i] += now[i] > perf->start[i] ? now[i] - perf->start[i] : 0;
+    }
+
+  perf->runs[perf->phase]++;
+  perf->phase = -1;
+  }
+
+void pk_perf_exclude (struct pk_perf* perf, int phase, int part) {
+  int i;
+
+  for (i = 0; perf != NULL && i < PK_PERF_EVENTS; i++) {
+    uint64_t* count = &perf->count[phase][i];
+
+    *count = *count > perf->count[part][i] ? *count - perf->count[part][i] : 0;
+    }
+  }
@@ -0,0 +1,154 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file pool.c
+*** \brief A simple pool of worker threads
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* We need the POSIX thread and sysconf interfaces */
+#define _POSIX_C_SOURCE 200809L
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#include "packer/pool.h"
+
+/* Upper bound on the number of threads in one pool */
+#define POOL_MAX_WORKERS 256
+
+int pk_pool_processors (void) {
+#if defined(HAVE_UNISTD_H) && defined(_SC_NPROCESSORS_ONLN)
+  long count = sysconf (_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (int) count : 1;
+#else
+  return 1;
+#endif
+  }
+
+#ifdef HAVE_PTHREAD_H
+
+struct pool {
+  pthread_mutex_t lock;   /*< Guards next */
+  size_t          next;   /*< Next job to hand out */
+  size_t          njobs;  /*< Total number of jobs */
+  pk_pool_fn*     fn;     /*< The work to do */
+  void*           ctx;    /*< Context for fn */
+  };
+
+/* Worker thread: take jobs until there are none left */
+static void* worker (void* arg) {
+  struct pool* pool = (struct pool*) arg;
+  size_t index;
+
+  for (;;) {
+    pthread_mutex_lock (&pool->lock);
+    index = pool->next++;
+    pthread_mutex_unlock (&pool->lock);
+
+    if (index >= pool->njobs) {
+      break;
+      }
+
+    pool->fn (index, pool->ctx);
+    }
+
+  return NULL;
+  }
+
+int pk_pool_run (int workers, size_t njobs, pk_pool_fn* fn, void* ctx) {
+  struct pool pool;
+  pthread_t threads[POOL_MAX_WORKERS];
+  int started = 0;
+  int i;
+
+  if (workers <= 0) {
+    workers = pk_pool_processors ();
+    }
+
+  if (workers > POOL_MAX_WORKERS) {
+    workers = POOL_MAX_WORKERS;
+    }
+
+  if ( (size_t) workers > njobs) {
+    workers = (int) njobs;
+    }
+
+  pool.next = 0;
+  pool.njobs = njobs;
+  pool.fn = fn;
+  pool.ctx = ctx;
+
+  /* A single worker gains nothing from a thread */
+  if (workers <= 1 || pthread_mutex_init (&pool.lock, NULL) != 0) {
+    size_t index;
+
+    for (index = 0; index < njobs; index++) {
+      fn (index, ctx);
+      }
+
+    return PK_OK;
+    }
+
+  for (i = 0; i < workers; i++) {
+    if (pthread_create (&threads[started], NULL, worker, &pool) == 0) {
+      started++;
+      }
+    }
+
+  /* If no thread started, do the work here */
+  if (started == 0) {
+    worker (&pool);
+    }
+
+  for (i = 0; i < started; i++) {
+    pthread_join (threads[i], NULL);
+    }
+
+  pthread_mutex_destroy (&pool.lock);
+  return started > 0 ? PK_OK : PK_ERR;
+  }
+
+#else
+
+int pk_pool_run (int workers, size_t njobs, pk_pool_fn* fn, void* ctx) {
+  size_t index;
+
+  (void) workers;
+
+  for (index = 0; index < njobs; index++) {
+    fn (index, ctx);
+    }
+
+  return PK_OK;
+  }
+
+#endif
@@ -0,0 +1,680 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file query.c
+*** \brief Tag queries over compiled documents
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#ifdef HAVE_CTYPE_H
+#include <ctype.h>
+#else
+#error "can't find the C character class library"
+#endif
+
+/* Include the bstring library */
+#include "bstring/bstrlib.h"
+
+#include "packer/lexer.h"
+#include "packer/query.h"
+#include "packer/span.h"
+#include "packer/tags.h"
+
+/* Marks a node at the top level of its document */
+#define QUERY_TOP 0xFFFFFFFFUL
+
+/* The kinds of predicate */
+enum query_kind {
+  QUERY_HAS,    /*< Some tag inside matches a test */
+  QUERY_TEXT    /*< Some text inside contains a string */
+  };
+
+/* A test of one tag: its name and label */
+struct query_test {
+  int     any;      /*< Non-zero to match any tag */
+  int     tag;      /*< Tag identifier, or PK_TAG_UNKNOWN for other names */
+  bstring name;     /*< Name, for tags not in the tag table */
+  bstring label;    /*< Label pattern, or NULL for any label */
+  };
+
+struct query_pred {
+  enum query_kind   kind;     /*< What is tested */
+  int               negate;   /*< Non-zero if the test must fail */
+  struct query_test test;     /*< QUERY_HAS: the tag looked for */
+  bstring           text;     /*< QUERY_TEXT: the text looked for */
+  };
+
+struct query_step {
+  int                descendant;  /*< Non-zero if anywhere inside the step before */
+  struct query_test  test;        /*< The tag of the step */
+  struct query_pred* preds;       /*< Predicates the tag must meet */
+  size_t             npreds;      /*< Number of predicates */
+  };
+
+struct pk_query {
+  int               anchored;               /*< The first step is at the top level */
+  struct query_step steps[PK_QUERY_STEPS];  /*< The steps, outermost first */
+  size_t            nsteps;                 /*< Number of steps */
+  };
+
+/* The structure of a document, built once per query: the parent of every
+ * node, and the OPEN nodes of each tag in document order. Bit k of ends
+ * is set on a node that matches step k with the steps before it matched
+ * by its ancestors, and bit k of within on that node and all inside it
+ */
+struct query_index {
+  const struct pk_doc* doc;
+  uint32_t*            parent;
+  uint32_t             starts[PK_TAG_COUNT + 1];
+  uint32_t*            postings;
+  uint32_t*            ends;
+  uint32_t*            within;
+  };
+
+/**
+*** Parsing
+**/
+
+static void skip_space (const char** p) {
+  while (isspace ( (unsigned char) **p)) {
+    (*p)++;
+    }
+  }
+
+static int name_char (char c) {
+  return isalnum ( (unsigned char) c) || c == '_' || c == '-';
+  }
+
+static void clear_test (struct query_test* test) {
+  bdestroy (test->name);
+  bdestroy (test->label);
+  }
+
+/* Parse a tag name or '*', and an optional label pattern */
+static int parse_test (const char** p, struct query_test* test) {
+  const char* start;
+
+  memset (test, 0, sizeof (*test));
+  skip_space (p);
+  start = *p;
+
+  if (**p == '*') {
+    test->any = 1;
+    (*p)++;
+    }
+
+  else {
+    while (name_char (**p)) {
+      (*p)++;
+      }
+
+    if (*p == start) {
+      return PK_ERR;
+      }
+
+    test->tag = pk_tag_lookup (start, (size_t) (*p - start));
+
+    if (test->tag == PK_TAG_UNKNOWN && (test->name = blk2bstr (start, (int) (*p - start))) == NULL) {
+      return PK_ERR;
+      }
+    }
+
+  if (**p == ':') {
+    start = ++*p;
+
+    while (**p != '\0' && **p != '/' && **p != '[' && **p != ']' && !isspace ( (unsigned char) **p)) {
+      (*p)++;
+      }
+
+    if (*p == start || (test->label = blk2bstr (start, (int) (*p - start))) == NULL) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+/* Parse a predicate, from just after its '[' to just after its ']' */
+static int parse_pred (const char** p, struct query_pred* pred) {
+  const char* start;
+  const char* end;
+
+  memset (pred, 0, sizeof (*pred));
+  skip_space (p);
+
+  if (**p == '!') {
+    pred->negate = 1;
+    (*p)++;
+    skip_space (p);
+    }
+
+  if (**p != '~') {
+    pred->kind = QUERY_HAS;
+
+    if (parse_test (p, &pred->test) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  else {
+    pred->kind = QUERY_TEXT;
+    (*p)++;
+    skip_space (p);
+
+    if (**p == '"') {
+      start = ++*p;
+      end = strchr (start, '"');
+
+      if (end == NULL) {
+        return PK_ERR;
+        }
+
+      *p = end + 1;
+      }
+
+    else {
+      start = *p;
+      *p += strcspn (start, "]");
+      end = *p;
+
+      while (end > start && isspace ( (unsigned char) end[-1])) {
+        end--;
+        }
+      }
+
+    if (end == start || (pred->text = blk2bstr (start, (int) (end - start))) == NULL) {
+      return PK_ERR;
+      }
+    }
+
+  skip_space (p);
+
+  if (**p != ']') {
+    return PK_ERR;
+    }
+
+  (*p)++;
+  return PK_OK;
+  }
+
+/* Parse a step: a tag test, then its predicates */
+static int parse_step (const char** p, struct query_step* step) {
+  if (parse_test (p, &step->test) != PK_OK) {
+    return PK_ERR;
+    }
+
+  for (skip_space (p); **p == '['; skip_space (p)) {
+    struct query_pred* preds = (struct query_pred*) realloc (step->preds, (step->npreds + 1) * sizeof (*preds));
+
+    if (preds == NULL) {
+      return PK_ERR;
+      }
+
+    step->preds = preds;
+    (*p)++;
+
+    if (parse_pred (p, &step->preds[step->npreds++]) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+struct pk_query* pk_query_new (const char* text, size_t* error) {
+  struct pk_query* query = (struct pk_query*) calloc (1, sizeof (*query));
+  const char* p = text;
+  int descendant = 0;
+  int status = PK_OK;
+
+  if (query == NULL) {
+    return NULL;
+    }
+
+  skip_space (&p);
+
+  /* A lone leading '/' anchors the query at the top level */
+  if (p[0] == '/' && p[1] != '/') {
+    query->anchored = 1;
+    p++;
+    }
+
+  else if (p[0] == '/') {
+    p += 2;
+    }
+
+  while (status == PK_OK) {
+    struct query_step* step = &query->steps[query->nsteps];
+
+    if (query->nsteps == PK_QUERY_STEPS) {
+      status = PK_ERR;
+      break;
+      }
+
+    query->nsteps++;
+    step->descendant = descendant;
+    status = parse_step (&p, step);
+    skip_space (&p);
+
+    if (status != PK_OK || *p == '\0') {
+      break;
+      }
+
+    if (*p != '/') {
+      status = PK_ERR;
+      break;
+      }
+
+    descendant = p[1] == '/';
+    p += descendant ? 2 : 1;
+    }
+
+  if (status != PK_OK) {
+    if (error != NULL) {
+      *error = (size_t) (p - text);
+      }
+
+    pk_query_free (query);
+    return NULL;
+    }
+
+  return query;
+  }
+
+void pk_query_free (struct pk_query* query) {
+  size_t i;
+  size_t j;
+
+  if (query != NULL) {
+    for (i = 0; i < query->nsteps; i++) {
+      for (j = 0; j < query->steps[i].npreds; j++) {
+        clear_test (&query->steps[i].preds[j].test);
+        bdestroy (query->steps[i].preds[j].text);
+        }
+
+      clear_test (&query->steps[i].test);
+      free (query->steps[i].preds);
+      }
+
+    free (query);
+    }
+  }
+
+/**
+*** Matching
+**/
+
+/* Match text against a pattern in which '*' matches any run of characters */
+static int glob_match (const char* pattern, size_t plen, const char* text, size_t tlen) {
+  size_t p = 0;
+  size_t t = 0;
+  size_t star = PK_SPAN_NPOS;
+  size_t mark = 0;
+
+  while (t < tlen) {
+    if (p < plen && pattern[p] == '*') {
+      star = p++;
+      mark = t;
+      }
+
+    else if (p < plen && pattern[p] == text[t]) {
+      p++;
+      t++;
+      }
+
+    else if (star != PK_SPAN_NPOS) {
+      p = star + 1;
+      t = ++mark;
+      }
+
+    else {
+      return 0;
+      }
+    }
+
+  while (p < plen && pattern[p] == '*') {
+    p++;
+    }
+
+  return p == plen;
+  }
+
+/* Does node i pass a tag test? */
+static int test_node (const struct query_index* index, const struct query_test* test, size_t i) {
+  const struct pk_doc_node* node = &index->doc->nodes[i];
+  struct pk_span span;
+
+  if (node->type != PK_TOKEN_OPEN) {
+    return 0;
+    }
+
+  if (!test->any) {
+    if (node->tag != test->tag) {
+      return 0;
+      }
+
+    if (test->name != NULL && !pk_span_eq (pk_intern_get (index->doc->strings, node->text), pk_span_bstr (test->name))) {
+      return 0;
+      }
+    }
+
+  if (test->label != NULL) {
+    span = pk_intern_get (index->doc->strings, node->label);
+    return span.len > 0 && glob_match ( (const char*) test->label->data, (size_t) blength (test->label), span.data,
+                                        span.len);
+    }
+
+  return 1;
+  }
+
+/* The node after the last child of node i */
+static size_t children_end (const struct pk_doc* doc, size_t i) {
+  return doc->nodes[i].type == PK_TOKEN_OPEN && doc->nodes[i].close > i ? doc->nodes[i].close : i + 1;
+  }
+
+/* Does some tag inside node i pass a test? Tags in the tag table are
+ * found from their postings, by a binary search for the first inside
+ */
+static int has_tag (const struct query_index* index, const struct query_test* test, size_t i) {
+  size_t end = children_end (index->doc, i);
+  size_t low;
+  size_t high;
+  size_t j;
+
+  if (test->any || test->tag == PK_TAG_UNKNOWN) {
+    for (j = i + 1; j < end; j++) {
+      if (test_node (index, test, j)) {
+        return 1;
+        }
+      }
+
+    return 0;
+    }
+
+  low = index->starts[test->tag];
+  high = index->starts[test->tag + 1];
+
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+
+    if (index->postings[middle] <= i) {
+      low = middle + 1;
+      }
+
+    else {
+      high = middle;
+      }
+    }
+
+  for (j = low; j < index->starts[test->tag + 1] && index->postings[j] < end; j++) {
+    if (test_node (index, test, index->postings[j])) {
+      return 1;
+      }
+    }
+
+  return 0;
+  }
+
+/* Does some text inside node i contain the given text? */
+static int has_text (const struct query_index* index, const_bstring text, size_t i) {
+  size_t end = children_end (index->doc, i);
+  size_t j;
+
+  for (j = i + 1; j < end; j++) {
+    const struct pk_doc_node* node = &index->doc->nodes[j];
+
+    if (node->type == PK_TOKEN_TEXT &&
+        pk_span_find (pk_intern_get (index->doc->strings, node->text), 0, pk_span_bstr (text)) != PK_SPAN_NPOS) {
+      return 1;
+      }
+    }
+
+  return 0;
+  }
+
+/* Does node i pass the test and every predicate of a step? */
+static int step_node (const struct query_index* index, const struct query_step* step, size_t i) {
+  size_t k;
+
+  if (!test_node (index, &step->test, i)) {
+    return 0;
+    }
+
+  for (k = 0; k < step->npreds; k++) {
+    const struct query_pred* pred = &step->preds[k];
+    int found = pred->kind == QUERY_HAS ? has_tag (index, &pred->test, i) : has_text (index, pred->text, i);
+
+    if (found == pred->negate) {
+      return 0;
+      }
+    }
+
+  return 1;
+  }
+
+/* Could node i match step k, given what its ancestors matched? */
+static int step_reached (const struct pk_query* query, const struct query_index* index, size_t k, size_t i) {
+  uint32_t parent = index->parent[i];
+
+  if (k == 0) {
+    return !query->anchored || parent == QUERY_TOP;
+    }
+
+  if (parent == QUERY_TOP) {
+    return 0;
+    }
+
+  return ( (query->steps[k].descendant ? index->within[parent] : index->ends[parent]) >> (k - 1)) & 1;
+  }
+
+/* Find the steps before the last that each node ends a match of. Parents
+ * come before their children, so one pass from the top sees every node
+ * after its ancestors, and each step is tried once on each node
+ */
+static void match_steps (const struct pk_query* query, struct query_index* index) {
+  size_t i;
+  size_t k;
+
+  for (i = 0; i < index->doc->count; i++) {
+    uint32_t parent = index->parent[i];
+    uint32_t ends = 0;
+
+    for (k = 0; k + 1 < query->nsteps; k++) {
+      if (step_reached (query, index, k, i) && step_node (index, &query->steps[k], i)) {
+        ends |= 1UL << k;
+        }
+      }
+
+    index->ends[i] = ends;
+    index->within[i] = ends | (parent != QUERY_TOP ? index->within[parent] : 0);
+    }
+  }
+
+/* Build the parents and postings of a document */
+static int build_index (struct query_index* index, const struct pk_doc* doc) {
+  uint32_t* open = NULL;
+  size_t depth = 0;
+  size_t capacity = 0;
+  uint32_t fill[PK_TAG_COUNT];
+  size_t i;
+
+  memset (index, 0, sizeof (*index));
+  index->doc = doc;
+  index->parent = (uint32_t*) malloc (doc->count * sizeof (*index->parent) + 1);
+  index->postings = (uint32_t*) malloc (doc->count * sizeof (*index->postings) + 1);
+  index->ends = (uint32_t*) malloc (doc->count * sizeof (*index->ends) + 1);
+  index->within = (uint32_t*) malloc (doc->count * sizeof (*index->within) + 1);
+
+  if (index->parent == NULL || index->postings == NULL || index->ends == NULL || index->within == NULL) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < doc->count; i++) {
+    const struct pk_doc_node* node = &doc->nodes[i];
+
+    index->parent[i] = depth > 0 ? open[depth - 1] : QUERY_TOP;
+
+    if (node->type == PK_TOKEN_OPEN) {
+      index->starts[node->tag + 1]++;
+      }
+
+    if (node->type == PK_TOKEN_OPEN && node->close > i) {
+      if (depth == capacity) {
+        size_t size = capacity ? capacity * 2 : 64;
+        uint32_t* stack = (uint32_t*) realloc (open, size * sizeof (*stack));
+
+        if (stack == NULL) {
+          free (open);
+          return PK_ERR;
+          }
+
+        open = stack;
+        capacity = size;
+        }
+
+      open[depth++] = (uint32_t) i;
+      }
+
+    else if (depth > 0 && doc->nodes[open[depth - 1]].close == i) {
+      depth--;
+      }
+    }
+
+  free (open);
+
+  for (i = 0; i < PK_TAG_COUNT; i++) {
+    index->starts[i + 1] += index->starts[i];
+    fill[i] = index->starts[i];
+    }
+
+  for (i = 0; i < doc->count; i++) {
+    if (doc->nodes[i].type == PK_TOKEN_OPEN) {
+      index->postings[fill[doc->nodes[i].tag]++] = (uint32_t) i;
+      }
+    }
+
+  return PK_OK;
+  }
+
+static void clear_index (struct query_index* index) {
+  free (index->parent);
+  free (index->postings);
+  free (index->ends);
+  free (index->within);
+  }
+
+int pk_query_doc (const struct pk_query* query, const struct pk_doc* doc, pk_query_fn* fn, void* ctx) {
+  const struct query_step* last = &query->steps[query->nsteps - 1];
+  struct query_index index;
+  int postings = !last->test.any && last->test.tag != PK_TAG_UNKNOWN;
+  size_t first = 0;
+  size_t end = doc->count;
+  size_t j;
+  int status = build_index (&index, doc);
+
+  if (status == PK_OK) {
+    match_steps (query, &index);
+    }
+
+  /* Only the tags of the last step need be visited */
+  if (status == PK_OK && postings) {
+    first = index.starts[last->test.tag];
+    end = index.starts[last->test.tag + 1];
+    }
+
+  for (j = first; status == PK_OK && j < end; j++) {
+    size_t i = postings ? index.postings[j] : j;
+
+    if (step_reached (query, &index, query->nsteps - 1, i) && step_node (&index, last, i)) {
+      status = fn (doc, i, ctx);
+      }
+    }
+
+  clear_index (&index);
+  return status;
+  }
+
+/* Query one section of a file */
+static int query_section (const struct pk_query* query, const struct pk_doc_file* file, size_t section,
+                          pk_query_fn* fn, void* ctx) {
+  struct pk_doc doc;
+  int status = pk_doc_init (&doc, NULL);
+
+  if (status == PK_OK) {
+    status = pk_doc_load (&doc, file, section);
+    }
+
+  if (status == PK_OK) {
+    status = pk_query_doc (query, &doc, fn, ctx);
+    }
+
+  pk_doc_clear (&doc);
+  return status;
+  }
+
+int pk_query_file (const struct pk_query* query, const struct pk_doc_file* file, pk_query_fn* fn, void* ctx) {
+  const struct query_step* last = &query->steps[query->nsteps - 1];
+  size_t previous = file->sections;
+  uint32_t count;
+  uint32_t n;
+  size_t i;
+  int status = PK_OK;
+
+  if (last->test.any || last->test.tag == PK_TAG_UNKNOWN || pk_doc_tag_count (file, last->test.tag, &count) != PK_OK) {
+    for (i = 0; status == PK_OK && i < file->sections; i++) {
+      status = query_section (query, file, i, fn, ctx);
+      }
+
+    return status;
+    }
+
+  /* Sections are cut at the top level, so each holds the whole of every
+   * tag within it, and the ancestors of its tags
+   */
+  for (n = 0; status == PK_OK && n < count; n++) {
+    uint32_t node = pk_doc_tag_node (file, last->test.tag, n);
+
+    if (node >= file->nodes) {
+      return PK_ERR;
+      }
+
+    i = pk_doc_section_of (file, node);
+
+    if (i != previous) {
+      status = query_section (query, file, i, fn, ctx);
+      previous = i;
+      }
+    }
+
+  return status;
+  }
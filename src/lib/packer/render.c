@@ -0,0 +1,659 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file render.c
+*** \brief Streaming renderer for Bayeux token streams
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/latency.h"
+#include "packer/render.h"
+
+/* Main output is written to the file once this much is waiting */
+#define RENDER_FLUSH_SIZE (64 * 1024)
+
+/* Shorter runs of text are copied, as that is cheaper than a piece */
+#define RENDER_REF_MIN 32
+
+struct pk_render* pk_render_new (const struct pk_backend* backend, FILE* file) {
+  struct pk_render* render = (struct pk_render*) calloc (1, sizeof (*render));
+
+  if (render == NULL) {
+    return NULL;
+    }
+
+  render->backend = backend;
+  render->file = file;
+  render->out = bfromcstr ("");
+
+  if (render->out == NULL) {
+    free (render);
+    return NULL;
+    }
+
+  pk_rope_init (&render->rope);
+  pk_footnotes_init (&render->notes, backend->footnotes, backend->note, backend->notes, render);
+  pk_nav_outline_init (&render->outline);
+  return render;
+  }
+
+void pk_render_free (struct pk_render* render) {
+  size_t i;
+
+  if (render == NULL) {
+    return;
+    }
+
+  for (i = 0; i < render->depth; i++) {
+    bdestroy (render->frames[i].body);
+    bdestroy (render->frames[i].text);
+    pk_table_free (render->frames[i].table);
+    }
+
+  pk_footnotes_clear (&render->notes);
+  pk_nav_outline_clear (&render->outline);
+  pk_rope_clear (&render->rope);
+  bdestroy (render->out);
+  free (render->frames);
+  free (render);
+  }
+
+/* The limits on the page */
+static const struct pk_limits* limits (const struct pk_render* render) {
+  return render->limits ? render->limits : &pk_limits_default;
+  }
+
+/* Bytes of main output produced so far, whether written out or not */
+static size_t output_size (const struct pk_render* render) {
+  return render->produced + render->rope.length + (size_t) blength (render->out);
+  }
+
+/* Fail once the main output grows past the output limit */
+static int check_output (struct pk_render* render) {
+  size_t output = limits (render)->output;
+
+  if (output > 0 && output_size (render) > output) {
+    render->limited |= PK_LIMIT_OUTPUT;
+    return PK_ERR;
+    }
+
+  return PK_OK;
+  }
+
+/* Move the output written by handlers onto the end of the rope */
+static int settle_output (struct pk_render* render) {
+  int status = PK_OK;
+
+  if (blength (render->out) > 0) {
+    status = pk_rope_write (&render->rope, (const char*) render->out->data, (size_t) blength (render->out));
+    btrunc (render->out, 0);
+    }
+
+  return status;
+  }
+
+/* Write all of the main output to the file or, with no file, gather it
+ * into out, so nothing is left referring to the source
+ */
+static int release_output (struct pk_render* render) {
+  if (settle_output (render) != PK_OK) {
+    return PK_ERR;
+    }
+
+  if (render->file != NULL) {
+    render->produced += render->rope.length;
+    return pk_rope_flush (&render->rope, render->file);
+    }
+
+  return pk_rope_take (&render->rope, render->out);
+  }
+
+bstring pk_render_take (struct pk_render* render) {
+  bstring out;
+
+  if (render->file == NULL && release_output (render) != PK_OK) {
+    return NULL;
+    }
+
+  out = render->out;
+  render->out = bfromcstr ("");
+  return out;
+  }
+
+bstring pk_render_out (struct pk_render* render) {
+  return pk_render_outer (render, render->frames + render->depth);
+  }
+
+bstring pk_render_outer (struct pk_render* render, const struct pk_render_frame* frame) {
+  size_t i = (size_t) (frame - render->frames);
+
+  if (render->diverted == 0 || i == 0 || render->frames[i - 1].divert == 0) {
+    return render->out;
+    }
+
+  return render->frames[render->frames[i - 1].divert - 1].body;
+  }
+
+int pk_render_write (struct pk_render* render, const char* data, size_t len) {
+  bstring out = pk_render_out (render);
+
+  if (out != render->out) {
+    return bcatblk (out, data, (int) len) == BSTR_OK ? PK_OK : PK_ERR;
+    }
+
+  return settle_output (render) == PK_OK ? pk_rope_write (&render->rope, data, len) : PK_ERR;
+  }
+
+int pk_render_ref (struct pk_render* render, const char* data, size_t len) {
+  if (!render->borrow || len < RENDER_REF_MIN || pk_render_out (render) != render->out) {
+    return pk_render_write (render, data, len);
+    }
+
+  return settle_output (render) == PK_OK ? pk_rope_ref (&render->rope, data, len) : PK_ERR;
+  }
+
+int pk_render_puts (struct pk_render* render, const char* str) {
+  return pk_render_write (render, str, strlen (str));
+  }
+
+int pk_render_text (struct pk_render* render, const char* text, size_t len) {
+  return len > 0 ? render->backend->text (render, text, len) : PK_OK;
+  }
+
+struct pk_render_frame* pk_render_find (struct pk_render* render, int tag) {
+  size_t i;
+
+  for (i = render->depth; i > 0; i--) {
+    if (render->frames[i - 1].open.tag == tag) {
+      return &render->frames[i - 1];
+      }
+    }
+
+  return NULL;
+  }
+
+
+/* Non-zero if text here is laid out in paragraphs */
+static int block_level (const struct pk_render* render) {
+  const struct pk_render_frame* top;
+
+  if (render->depth == 0) {
+    return 1;
+    }
+
+  top = &render->frames[render->depth - 1];
+  return (top->open.flags & PK_TAG_BLOCK) && ! (top->open.flags & PK_TAG_VERBATIM) &&
+         render->backend->tags[top->open.tag].text == NULL;
+  }
+
+static int set_paragraph (struct pk_render* render, int open) {
+  if (render->paragraph == open) {
+    return PK_OK;
+    }
+
+  render->paragraph = open;
+  return render->backend->paragraph (render, open);
+  }
+
+/* The escapes are removed as the text is written: "\x" is x, and "\/" vanishes */
+int pk_render_source (struct pk_render* render, const char* text, size_t len) {
+  const char* end = text + len;
+  int status = PK_OK;
+
+  while (text < end && status == PK_OK) {
+    const char* slash = (const char*) memchr (text, '\\', (size_t) (end - text));
+
+    if (slash == NULL || slash + 1 == end) {
+      return pk_render_text (render, text, (size_t) (end - text));
+      }
+
+    status = pk_render_text (render, text, (size_t) (slash - text));
+
+    if (status == PK_OK && slash[1] != '/') {
+      status = pk_render_text (render, slash + 1, 1);
+      }
+
+    text = slash + 2;
+    }
+
+  return status;
+  }
+
+/* Append text to the collected plain text, removing any escapes */
+static int collect_text (bstring text, const char* src, size_t len, int verbatim) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    if (src[i] == '\\' && !verbatim && i + 1 < len) {
+      if (src[++i] == '/') {
+        continue;
+        }
+      }
+
+    if (bconchar (text, src[i]) != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return PK_OK;
+  }
+
+/* Find the end of the paragraph starting at text: a blank line, or the
+ * end of the text. The start of the next paragraph is left in next
+ */
+static const char* paragraph_end (const char* text, const char* end, const char** next) {
+  const char* p;
+
+  for (p = text; p < end; p++) {
+    const char* q;
+
+    if (*p != '\n') {
+      continue;
+      }
+
+    for (q = p + 1; q < end && (*q == ' ' || *q == '\t' || *q == '\r'); q++) {
+      }
+
+    if (q < end && *q == '\n') {
+      /* Skip any further blank lines */
+      *next = q;
+
+      while (*next < end && (**next == ' ' || **next == '\t' || **next == '\r' || **next == '\n')) {
+        (*next)++;
+        }
+
+      return p;
+      }
+    }
+
+  *next = end;
+  return end;
+  }
+
+/* Write text at block level, starting and ending paragraphs at blank lines */
+static int emit_paragraphs (struct pk_render* render, const char* text, size_t len) {
+  const char* end = text + len;
+  int status = PK_OK;
+
+  while (text < end && status == PK_OK) {
+    const char* next;
+    const char* stop = paragraph_end (text, end, &next);
+
+    /* Paragraphs start at the first visible character */
+    if (!render->paragraph) {
+      while (text < stop && (*text == ' ' || *text == '\t' || *text == '\r' || *text == '\n')) {
+        text++;
+        }
+      }
+
+    if (text < stop) {
+      status = set_paragraph (render, 1);
+
+      if (status == PK_OK) {
+        status = pk_render_source (render, text, (size_t) (stop - text));
+        }
+      }
+
+    if (status == PK_OK && stop < end) {
+      status = set_paragraph (render, 0);
+      }
+
+    text = next;
+    }
+
+  return status;
+  }
+
+int pk_render_table_text (struct pk_render* render, struct pk_render_frame* frame, const char* text, size_t len) {
+  const char* end = text + len;
+  int status = PK_OK;
+
+  if (frame->table == NULL || frame->body == NULL) {
+    return pk_render_source (render, text, len);
+    }
+
+  while (text < end && status == PK_OK) {
+    const char* split = pk_table_split (text, end);
+
+    /* Cells start at their first visible character */
+    if (pk_table_cell_empty (frame->table, frame->body)) {
+      while (text < split && (*text == ' ' || *text == '\t' || *text == '\r')) {
+        text++;
+        }
+      }
+
+    status = pk_render_source (render, text, (size_t) (split - text));
+
+    if (status == PK_OK && split < end) {
+      status = *split == '|' ? pk_table_end_cell (frame->table, frame->body) :
+               pk_table_end_row (frame->table, frame->body, pk_render_outer (render, frame));
+      }
+
+    text = split + (split < end);
+    }
+
+  return status;
+  }
+
+static int render_text (struct pk_render* render, const struct pk_token* token) {
+  struct pk_render_frame* top = render->depth ? &render->frames[render->depth - 1] : NULL;
+  int verbatim = top != NULL && (top->open.flags & PK_TAG_VERBATIM);
+  pk_text_fn* hook = top != NULL ? render->backend->tags[top->open.tag].text : NULL;
+  size_t i;
+
+  /* Each collecting frame links to the next one out */
+  for (i = top != NULL ? top->collect : 0; i > 0; i = i > 1 ? render->frames[i - 2].collect : 0) {
+    if (collect_text (render->frames[i - 1].text, token->text.data, token->text.len, verbatim) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  if (render->hidden > 0) {
+    return PK_OK;
+    }
+
+  if (hook != NULL) {
+    return hook (render, top, token->text.data, token->text.len);
+    }
+
+  if (verbatim) {
+    return pk_render_text (render, token->text.data, token->text.len);
+    }
+
+  if (block_level (render)) {
+    return emit_paragraphs (render, token->text.data, token->text.len);
+    }
+
+  return pk_render_source (render, token->text.data, token->text.len);
+  }
+
+static int render_open (struct pk_render* render, const struct pk_token* token) {
+  const struct pk_tag_handler* handler = &render->backend->tags[token->tag];
+  struct pk_render_frame* frame;
+  int block = (token->flags & PK_TAG_BLOCK) || (handler->flags & PK_RENDER_BLOCK);
+  int status = PK_OK;
+
+  /* A top-level heading starts a new section */
+  if ( (token->flags & PK_TAG_HEADING) && render->depth == 0) {
+    status = set_paragraph (render, 0);
+
+    if (status == PK_OK) {
+      status = pk_footnotes_section_end (&render->notes, render->out);
+      }
+    }
+
+  if (status == PK_OK && block_level (render) && render->hidden == 0) {
+    status = set_paragraph (render, !block);
+    }
+
+  if (status != PK_OK) {
+    return status;
+    }
+
+  if (limits (render)->depth > 0 && render->depth >= limits (render)->depth) {
+    render->limited |= PK_LIMIT_DEPTH;
+    return PK_ERR;
+    }
+
+  /* Every diverted or collected body is copied again by each that holds it */
+  if ( (render->diverted >= PK_RENDER_MAX_HELD && ( (handler->flags & PK_RENDER_DIVERT) || token->tag == PK_TAG_FN)) ||
+       (render->collecting >= PK_RENDER_MAX_HELD && (handler->flags & PK_RENDER_COLLECT))) {
+    render->limited |= PK_LIMIT_HELD;
+    return PK_ERR;
+    }
+
+  if (render->depth == render->capacity) {
+    size_t capacity = render->capacity ? render->capacity * 2 : 16;
+    struct pk_render_frame* frames = (struct pk_render_frame*) realloc (render->frames, capacity * sizeof (*frames));
+
+    if (frames == NULL) {
+      return PK_ERR;
+      }
+
+    render->frames = frames;
+    render->capacity = capacity;
+    }
+
+  frame = &render->frames[render->depth++];
+  frame->open = *token;
+  frame->flags = handler->flags;
+  frame->body = NULL;
+  frame->text = NULL;
+  frame->number = 0;
+  frame->table = NULL;
+  frame->divert = render->depth > 1 ? frame[-1].divert : 0;
+  frame->collect = render->depth > 1 ? frame[-1].collect : 0;
+
+  /* Footnotes are numbered here, but their bodies are set aside */
+  if (token->tag == PK_TAG_FN) {
+    frame->flags |= PK_RENDER_DIVERT;
+    frame->number = pk_footnote_number (&render->notes);
+    }
+
+  if ( (frame->flags & PK_RENDER_COLLECT) && (frame->text = bfromcstr ("")) == NULL) {
+    return PK_ERR;
+    }
+
+  if (frame->text != NULL) {
+    render->collecting++;
+    frame->collect = render->depth;
+    }
+
+  if (handler->open != NULL && render->hidden == 0) {
+    status = handler->open (render, frame);
+    }
+
+  if ( (frame->flags & PK_RENDER_DIVERT) && (frame->body = bfromcstr ("")) == NULL) {
+    return PK_ERR;
+    }
+
+  if (frame->body != NULL) {
+    render->diverted++;
+    frame->divert = render->depth;
+    }
+
+  if (frame->flags & PK_RENDER_HIDE) {
+    render->hidden++;
+    }
+
+  return status;
+  }
+
+static int render_close (struct pk_render* render, const struct pk_token* token) {
+  const struct pk_tag_handler* handler;
+  struct pk_render_frame* frame;
+  int status = PK_OK;
+
+  if (render->depth == 0) {
+    return PK_OK;
+    }
+
+  frame = &render->frames[render->depth - 1];
+  handler = &render->backend->tags[frame->open.tag];
+
+  /* A paragraph within a block ends with it */
+  if (token->type == PK_TOKEN_END) {
+    status = set_paragraph (render, 0);
+    }
+
+  render->depth--;
+  render->collecting -= frame->text != NULL;
+  render->diverted -= frame->body != NULL;
+
+  if (frame->flags & PK_RENDER_HIDE) {
+    render->hidden--;
+    }
+
+  if (status == PK_OK && handler->close != NULL && render->hidden == 0) {
+    status = handler->close (render, frame);
+    }
+
+  if (status == PK_OK && frame->open.tag == PK_TAG_FN) {
+    status = pk_footnote_add (&render->notes, frame->number, frame->body);
+    }
+
+  bdestroy (frame->body);
+  bdestroy (frame->text);
+  pk_table_free (frame->table);
+  return status;
+  }
+
+/* The cost a token is charged to: the tag it opens, or else the innermost
+ * open tag (which a closing token ends), or else the document itself
+ */
+static struct pk_tag_cost* token_cost (struct pk_render* render, const struct pk_token* token) {
+  int tag = token->type == PK_TOKEN_OPEN ? token->tag :
+            render->depth > 0 ? render->frames[render->depth - 1].open.tag : PK_TAG_COUNT;
+
+  return &render->costs->tags[tag >= 0 && tag < PK_TAG_COUNT ? tag : PK_TAG_COUNT];
+  }
+
+/* Charge the time since start, and the output since before, to cost */
+static void charge (const struct pk_render* render, struct pk_tag_cost* cost, uint64_t start, size_t before) {
+  size_t after = output_size (render);
+
+  cost->calls++;
+  cost->ns += pk_clock_ns () - start;
+  cost->bytes += after > before ? after - before : 0;
+  }
+
+int pk_render_token (struct pk_render* render, const struct pk_token* token) {
+  struct pk_tag_cost* cost = NULL;
+  uint64_t start = 0;
+  size_t before = 0;
+  int status;
+
+  if (render->costs != NULL) {
+    cost = token_cost (render, token);
+    cost->count += token->type == PK_TOKEN_OPEN;
+    start = pk_clock_ns ();
+    before = output_size (render);
+    }
+
+  switch (token->type) {
+    case PK_TOKEN_TEXT:
+      status = render_text (render, token);
+      break;
+
+    case PK_TOKEN_OPEN:
+      status = render_open (render, token);
+      break;
+
+    case PK_TOKEN_CLOSE:
+    case PK_TOKEN_END:
+      status = render_close (render, token);
+      break;
+
+    default:
+      status = PK_OK;
+      break;
+    }
+
+  if (status == PK_OK) {
+    status = check_output (render);
+    }
+
+  if (status == PK_OK && render->file != NULL &&
+      render->rope.length + (size_t) blength (render->out) >= RENDER_FLUSH_SIZE) {
+    status = release_output (render);
+    }
+
+  if (cost != NULL) {
+    charge (render, cost, start, before);
+    }
+
+  return status;
+  }
+
+int pk_render_finish (struct pk_render* render) {
+  uint64_t start = render->costs ? pk_clock_ns () : 0;
+  size_t before = output_size (render);
+  int status = PK_ERR;
+
+  if (set_paragraph (render, 0) == PK_OK && pk_footnotes_section_end (&render->notes, render->out) == PK_OK &&
+      pk_footnotes_document_end (&render->notes, render->out) == PK_OK && check_output (render) == PK_OK) {
+    status = release_output (render);
+    }
+
+  if (render->costs != NULL) {
+    charge (render, &render->costs->tags[PK_TAG_COUNT], start, before);
+    }
+
+  return status;
+  }
+
+int pk_render_run (struct pk_render* render, const char* buf, size_t len) {
+  struct pk_lexer lexer;
+  struct pk_token token;
+  int type;
+  int status = PK_OK;
+
+  pk_lexer_init (&lexer, buf, len);
+  pk_lexer_limit (&lexer, render->limits);
+
+  /* The buffer outlives the run, and nothing refers to it afterwards */
+  render->borrow = 1;
+
+  while (status == PK_OK && (type = pk_lexer_next (&lexer, &token)) != PK_TOKEN_EOF) {
+    status = type == PK_ERR ? PK_ERR : pk_render_token (render, &token);
+    }
+
+  /* A page cut short by the token limit, or given up, is not rendered */
+  render->limited |= lexer.limited;
+
+  if (lexer.limited & (PK_LIMIT_TOKENS | PK_LIMIT_CANCEL)) {
+    status = PK_ERR;
+    }
+
+  pk_lexer_clear (&lexer);
+  status = status == PK_OK ? pk_render_finish (render) : status;
+
+  if (release_output (render) != PK_OK) {
+    status = PK_ERR;
+    }
+
+  render->borrow = 0;
+  return status;
+  }
+
+const struct pk_backend* pk_backend_find (const char* name) {
+  if (strcmp (name, pk_backend_html.name) == 0) {
+    return &pk_backend_html;
+    }
+
+  if (strcmp (name, pk_backend_text.name) == 0) {
+    return &pk_backend_text;
+    }
+
+  return NULL;
+  }
@@ -0,0 +1,252 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file rope.c
+*** \brief Chunked output buffers, written with scatter/gather I/O
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* We need the POSIX scatter/gather I/O interface */
+#define _POSIX_C_SOURCE 200809L
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include <errno.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_UIO_H
+#include <sys/uio.h>
+#endif
+
+#include "packer/rope.h"
+
+/* Most pieces handed to each writev call */
+#define ROPE_IOV_MAX 256
+
+void pk_rope_init (struct pk_rope* rope) {
+  memset (rope, 0, sizeof (*rope));
+  }
+
+static void free_chunks (struct pk_rope_chunk* chunk) {
+  while (chunk != NULL) {
+    struct pk_rope_chunk* next = chunk->next;
+
+    free (chunk);
+    chunk = next;
+    }
+  }
+
+void pk_rope_clear (struct pk_rope* rope) {
+  free_chunks (rope->chunks);
+  free_chunks (rope->spare);
+  free (rope->pieces);
+  memset (rope, 0, sizeof (*rope));
+  }
+
+void pk_rope_reset (struct pk_rope* rope) {
+  if (rope->last != NULL) {
+    rope->last->next = rope->spare;
+    rope->spare = rope->chunks;
+    }
+
+  rope->chunks = NULL;
+  rope->last = NULL;
+  rope->count = 0;
+  rope->length = 0;
+  }
+
+/* Append a piece, joining it to the last piece if they are adjacent */
+static int add_piece (struct pk_rope* rope, const char* data, size_t len) {
+  struct pk_span* last = rope->count > 0 ? &rope->pieces[rope->count - 1] : NULL;
+
+  if (last != NULL && last->data + last->len == data) {
+    last->len += len;
+    rope->length += len;
+    return PK_OK;
+    }
+
+  if (rope->count == rope->capacity) {
+    size_t capacity = rope->capacity ? rope->capacity * 2 : 64;
+    struct pk_span* pieces = (struct pk_span*) realloc (rope->pieces, capacity * sizeof (*pieces));
+
+    if (pieces == NULL) {
+      return PK_ERR;
+      }
+
+    rope->pieces = pieces;
+    rope->capacity = capacity;
+    }
+
+  rope->pieces[rope->count].data = data;
+  rope->pieces[rope->count].len = len;
+  rope->count++;
+  rope->length += len;
+  return PK_OK;
+  }
+
+/* Start a new chunk, reusing a spare one if there is one */
+static int add_chunk (struct pk_rope* rope) {
+  struct pk_rope_chunk* chunk = rope->spare;
+
+  if (chunk != NULL) {
+    rope->spare = chunk->next;
+    }
+
+  else if ( (chunk = (struct pk_rope_chunk*) malloc (sizeof (*chunk))) == NULL) {
+    return PK_ERR;
+    }
+
+  chunk->next = NULL;
+  chunk->used = 0;
+
+  if (rope->last != NULL) {
+    rope->last->next = chunk;
+    }
+
+  else {
+    rope->chunks = chunk;
+    }
+
+  rope->last = chunk;
+  return PK_OK;
+  }
+
+int pk_rope_write (struct pk_rope* rope, const char* data, size_t len) {
+  while (len > 0) {
+    struct pk_rope_chunk* chunk;
+    size_t room;
+
+    if ( (rope->last == NULL || rope->last->used == PK_ROPE_CHUNK) && add_chunk (rope) != PK_OK) {
+      return PK_ERR;
+      }
+
+    chunk = rope->last;
+    room = PK_ROPE_CHUNK - chunk->used < len ? PK_ROPE_CHUNK - chunk->used : len;
+    memcpy (chunk->data + chunk->used, data, room);
+
+    if (add_piece (rope, chunk->data + chunk->used, room) != PK_OK) {
+      return PK_ERR;
+      }
+
+    chunk->used += room;
+    data += room;
+    len -= room;
+    }
+
+  return PK_OK;
+  }
+
+int pk_rope_ref (struct pk_rope* rope, const char* data, size_t len) {
+  return len > 0 ? add_piece (rope, data, len) : PK_OK;
+  }
+
+int pk_rope_flush (struct pk_rope* rope, FILE* file) {
+#ifdef HAVE_SYS_UIO_H
+  struct iovec iov[ROPE_IOV_MAX];
+  size_t next = 0;
+  size_t skip = 0;
+  int fd;
+
+  /* Anything already buffered by stdio goes first */
+  if (fflush (file) != 0) {
+    return PK_ERR;
+    }
+
+  fd = fileno (file);
+
+  while (next < rope->count) {
+    ssize_t written;
+    size_t n;
+
+    for (n = 0; n < ROPE_IOV_MAX && next + n < rope->count; n++) {
+      iov[n].iov_base = (void*) (rope->pieces[next + n].data + (n == 0 ? skip : 0));
+      iov[n].iov_len = rope->pieces[next + n].len - (n == 0 ? skip : 0);
+      }
+
+    written = writev (fd, iov, (int) n);
+
+    if (written < 0 && errno == EINTR) {
+      continue;
+      }
+
+    if (written <= 0) {
+      return PK_ERR;
+      }
+
+    /* Step over the pieces written, which may end part way through one */
+    while (written > 0) {
+      size_t left = rope->pieces[next].len - skip;
+
+      if ( (size_t) written < left) {
+        skip += (size_t) written;
+        written = 0;
+        }
+
+      else {
+        written -= (ssize_t) left;
+        skip = 0;
+        next++;
+        }
+      }
+    }
+#else
+  size_t i;
+
+  for (i = 0; i < rope->count; i++) {
+    if (fwrite (rope->pieces[i].data, 1, rope->pieces[i].len, file) != rope->pieces[i].len) {
+      return PK_ERR;
+      }
+    }
+#endif
+
+  pk_rope_reset (rope);
+  return PK_OK;
+  }
+
+int pk_rope_take (struct pk_rope* rope, bstring out) {
+  size_t i;
+
+  if (balloc (out, blength (out) + (int) rope->length + 1) != BSTR_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < rope->count; i++) {
+    if (bcatblk (out, rope->pieces[i].data, (int) rope->pieces[i].len) != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  pk_rope_reset (rope);
+  return PK_OK;
+  }
@@ -0,0 +1,176 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file span.c
+*** \brief Borrowed string views, and their conversion to bstrings
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/span.h"
+
+/* Pieces of a split that has taken its last field have no data */
+static const char split_done[] = "";
+
+struct pk_span pk_span_make (const char* data, size_t len) {
+  struct pk_span span;
+
+  span.data = data;
+  span.len = len;
+  return span;
+  }
+
+struct pk_span pk_span_cstr (const char* str) {
+  return pk_span_make (str, strlen (str));
+  }
+
+struct pk_span pk_span_bstr (const_bstring str) {
+  if (str == NULL || str->data == NULL || str->slen <= 0) {
+    return pk_span_make ("", 0);
+    }
+
+  return pk_span_make ( (const char*) str->data, (size_t) str->slen);
+  }
+
+struct pk_span pk_span_mid (struct pk_span span, size_t pos, size_t len) {
+  if (pos > span.len) {
+    pos = span.len;
+    }
+
+  if (len > span.len - pos) {
+    len = span.len - pos;
+    }
+
+  return pk_span_make (span.data + pos, len);
+  }
+
+/* White space, as the lexer sees it */
+static int is_space (char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+struct pk_span pk_span_trim (struct pk_span span) {
+  while (span.len > 0 && is_space (span.data[0])) {
+    span.data++;
+    span.len--;
+    }
+
+  while (span.len > 0 && is_space (span.data[span.len - 1])) {
+    span.len--;
+    }
+
+  return span;
+  }
+
+size_t pk_span_chr (struct pk_span span, int c) {
+  const char* found = span.len > 0 ? (const char*) memchr (span.data, c, span.len) : NULL;
+
+  return found ? (size_t) (found - span.data) : PK_SPAN_NPOS;
+  }
+
+size_t pk_span_rchr (struct pk_span span, int c) {
+  size_t i;
+
+  for (i = span.len; i > 0; i--) {
+    if (span.data[i - 1] == (char) c) {
+      return i - 1;
+      }
+    }
+
+  return PK_SPAN_NPOS;
+  }
+
+size_t pk_span_find (struct pk_span span, size_t pos, struct pk_span needle) {
+  const char* p;
+  const char* last;
+
+  if (pos > span.len || needle.len > span.len - pos) {
+    return PK_SPAN_NPOS;
+    }
+
+  if (needle.len == 0) {
+    return pos;
+    }
+
+  /* Look for the first byte, then check the rest */
+  last = span.data + span.len - needle.len;
+
+  for (p = span.data + pos; p <= last; p++) {
+    p = (const char*) memchr (p, needle.data[0], (size_t) (last - p) + 1);
+
+    if (p == NULL) {
+      break;
+      }
+
+    if (memcmp (p, needle.data, needle.len) == 0) {
+      return (size_t) (p - span.data);
+      }
+    }
+
+  return PK_SPAN_NPOS;
+  }
+
+int pk_span_split (struct pk_span* rest, int sep, struct pk_span* field) {
+  size_t at;
+
+  if (rest->data == split_done) {
+    return 0;
+    }
+
+  at = pk_span_chr (*rest, sep);
+
+  if (at == PK_SPAN_NPOS) {
+    *field = *rest;
+    *rest = pk_span_make (split_done, 0);
+    }
+
+  else {
+    *field = pk_span_make (rest->data, at);
+    *rest = pk_span_make (rest->data + at + 1, rest->len - at - 1);
+    }
+
+  return 1;
+  }
+
+int pk_span_eq (struct pk_span a, struct pk_span b) {
+  return a.len == b.len && (a.len == 0 || memcmp (a.data, b.data, a.len) == 0);
+  }
+
+int pk_span_eqcstr (struct pk_span a, const char* str) {
+  return pk_span_eq (a, pk_span_cstr (str));
+  }
+
+bstring pk_span_dup (struct pk_span span) {
+  return blk2bstr (span.data, (int) span.len);
+  }
+
+int pk_span_cat (bstring str, struct pk_span span) {
+  return bcatblk (str, span.data, (int) span.len) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+int pk_span_assign (bstring str, struct pk_span span) {
+  return bassignblk (str, span.data, (int) span.len) == BSTR_OK ? PK_OK : PK_ERR;
+  }
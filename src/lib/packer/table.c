@@ -0,0 +1,399 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file table.c
+*** \brief Streaming layout of pipe-delimited tables
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#else
+#error "can't find the C standard library"
+#endif
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/cpu.h"
+#include "packer/table.h"
+
+/* Capacity to grow an array to, so that it holds at least need entries */
+static size_t grown (size_t capacity, size_t need) {
+  capacity = capacity ? capacity : 16;
+
+  while (capacity < need) {
+    capacity *= 2;
+    }
+
+  return capacity;
+  }
+
+static int reserve_cells (struct pk_table* table, size_t count) {
+  if (count > table->cell_capacity) {
+    size_t capacity = grown (table->cell_capacity, count);
+    size_t* ends = (size_t*) realloc (table->ends, capacity * sizeof (*ends));
+
+    if (ends == NULL) {
+      return PK_ERR;
+      }
+
+    table->ends = ends;
+    table->cell_capacity = capacity;
+    }
+
+  return PK_OK;
+  }
+
+static int reserve_rows (struct pk_table* table, size_t count) {
+  if (count > table->row_capacity) {
+    size_t capacity = grown (table->row_capacity, count);
+    size_t* rows = (size_t*) realloc (table->rows, capacity * sizeof (*rows));
+
+    if (rows == NULL) {
+      return PK_ERR;
+      }
+
+    table->rows = rows;
+    table->row_capacity = capacity;
+    }
+
+  return PK_OK;
+  }
+
+static int reserve_columns (struct pk_table* table, size_t count) {
+  if (count > table->column_capacity) {
+    size_t capacity = grown (table->column_capacity, count);
+    struct pk_table_column* columns =
+      (struct pk_table_column*) realloc (table->columns, capacity * sizeof (*columns));
+
+    if (columns == NULL) {
+      return PK_ERR;
+      }
+
+    table->columns = columns;
+    table->column_capacity = capacity;
+    }
+
+  if (count > table->ncolumns) {
+    memset (table->columns + table->ncolumns, 0, (count - table->ncolumns) * sizeof (*table->columns));
+    table->ncolumns = count;
+    }
+
+  return PK_OK;
+  }
+
+struct pk_table* pk_table_new (pk_table_row_fn* row, int keep, void* ctx) {
+  struct pk_table* table = (struct pk_table*) calloc (1, sizeof (*table));
+
+  if (table == NULL) {
+    return NULL;
+    }
+
+  table->row = row;
+  table->ctx = ctx;
+  table->keep = keep;
+  return table;
+  }
+
+void pk_table_free (struct pk_table* table) {
+  if (table == NULL) {
+    return;
+    }
+
+  free (table->ends);
+  free (table->rows);
+  free (table->columns);
+  bdestroy (table->caption);
+  free (table);
+  }
+
+const char* pk_table_split (const char* text, const char* end) {
+  const char* p = text;
+
+  /* Most of a table is cell text: skip it with the scanning kernel, up to
+   * the next separator or escape
+   */
+  while ( (p = pk_scan_set (p, end, "|\n\\\\")) < end) {
+    if (*p != '\\') {
+      return p;
+      }
+
+    p += end - p > 1 ? 2 : 1;
+    }
+
+  return end;
+  }
+
+int pk_table_cell_empty (const struct pk_table* table, const_bstring cells) {
+  return (size_t) blength (cells) == table->cell_start;
+  }
+
+int pk_table_end_cell (struct pk_table* table, bstring cells) {
+  size_t end = (size_t) blength (cells);
+
+  while (end > table->cell_start && (cells->data[end - 1] == ' ' || cells->data[end - 1] == '\t' ||
+                                     cells->data[end - 1] == '\r')) {
+    end--;
+    }
+
+  if (btrunc (cells, (int) end) != BSTR_OK ||
+      reserve_cells (table, table->cells + 1) != PK_OK) {
+    return PK_ERR;
+    }
+
+  table->ends[table->cells++] = end;
+  table->cell_start = end;
+  return PK_OK;
+  }
+
+/* Start of the cells of a row in the buffer */
+static size_t row_offset (const struct pk_table* table, size_t first) {
+  return first > 0 ? table->ends[first - 1] : 0;
+  }
+
+/* Non-zero if the cells are a rule of dashes, such as "------" or ":--|--:" */
+static int is_rule (const struct pk_table* table, const_bstring cells, size_t first, size_t count) {
+  size_t dashes = 0;
+  size_t i;
+
+  for (i = row_offset (table, first); i < table->ends[first + count - 1]; i++) {
+    switch (cells->data[i]) {
+      case '-':
+      case '=':
+        dashes++;
+        break;
+
+      case ':':
+      case '+':
+      case ' ':
+      case '\t':
+        break;
+
+      default:
+        return 0;
+      }
+    }
+
+  return dashes >= 3;
+  }
+
+/* The rows read so far are the header: take the alignment from the rule */
+static int set_header (struct pk_table* table, const_bstring cells, size_t first, size_t count) {
+  size_t i;
+
+  if (reserve_columns (table, count) != PK_OK) {
+    return PK_ERR;
+    }
+
+  table->header = table->total;
+  table->ruled = 1;
+
+  for (i = 0; i < table->ncolumns; i++) {
+    table->columns[i].numbers = 0;
+    table->columns[i].words = 0;
+    }
+
+  for (i = 0; i < count; i++) {
+    size_t start = row_offset (table, first + i);
+    size_t end = table->ends[first + i];
+    int left = end > start && cells->data[start] == ':';
+    int right = end > start && cells->data[end - 1] == ':';
+
+    table->columns[i].align = left && right ? PK_ALIGN_CENTRE : right ? PK_ALIGN_RIGHT : left ? PK_ALIGN_LEFT :
+                              PK_ALIGN_DEFAULT;
+    }
+
+  return PK_OK;
+  }
+
+/* Hand the waiting rows to the backend, and empty the buffer */
+static int write_rows (struct pk_table* table, bstring cells, bstring out) {
+  size_t i;
+
+  for (i = 0; i < table->waiting; i++) {
+    struct pk_table_row row;
+    size_t first = table->rows[i];
+    size_t last = i + 1 < table->waiting ? table->rows[i + 1] : table->cells;
+
+    row.data = (const char*) cells->data;
+    row.ends = table->ends + first;
+    row.start = row_offset (table, first);
+    row.count = last - first;
+    row.index = table->written;
+    row.header = table->written < table->header;
+
+    if (table->row (out, table, &row, table->ctx) != PK_OK) {
+      return PK_ERR;
+      }
+
+    table->written++;
+    }
+
+  table->waiting = 0;
+  table->cells = 0;
+  table->row_start = 0;
+  table->cell_start = 0;
+  return btrunc (cells, 0) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+int pk_table_end_row (struct pk_table* table, bstring cells, bstring out) {
+  size_t first = table->row_start;
+  size_t start = row_offset (table, first);
+  size_t count;
+  size_t i;
+
+  if (pk_table_end_cell (table, cells) != PK_OK) {
+    return PK_ERR;
+    }
+
+  count = table->cells - first;
+
+  /* Rules and blank lines are not rows */
+  if ( (count == 1 && table->ends[first] == start) || is_rule (table, cells, first, count)) {
+    int header = count > 1 || table->ends[first] > start;
+
+    header = header && !table->ruled && table->total <= PK_TABLE_HEADER_MAX;
+
+    if (header && set_header (table, cells, first, count) != PK_OK) {
+      return PK_ERR;
+      }
+
+    table->cells = first;
+    table->cell_start = start;
+
+    if (btrunc (cells, (int) start) != BSTR_OK) {
+      return PK_ERR;
+      }
+
+    return header && !table->keep ? write_rows (table, cells, out) : PK_OK;
+    }
+
+  if (reserve_columns (table, count) != PK_OK ||
+      reserve_rows (table, table->waiting + 1) != PK_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < count; i++) {
+    struct pk_table_column* column = &table->columns[i];
+    const char* cell = (const char*) cells->data + row_offset (table, first + i);
+    size_t len = table->ends[first + i] - row_offset (table, first + i);
+    size_t width = pk_table_width (cell, len);
+
+    if (width > column->width) {
+      column->width = width;
+      }
+
+    if (len > 0 && pk_table_numeric (cell, len)) {
+      column->numbers++;
+      }
+
+    else if (len > 0) {
+      column->words++;
+      }
+    }
+
+  table->rows[table->waiting++] = first;
+  table->row_start = table->cells;
+  table->total++;
+
+  /* Rows can go once they cannot be part of the header */
+  if (!table->keep && (table->ruled || table->total > PK_TABLE_HEADER_MAX)) {
+    return write_rows (table, cells, out);
+    }
+
+  return PK_OK;
+  }
+
+int pk_table_finish (struct pk_table* table, bstring cells, bstring out) {
+  if ( (table->cells > table->row_start || !pk_table_cell_empty (table, cells)) &&
+       pk_table_end_row (table, cells, out) != PK_OK) {
+    return PK_ERR;
+    }
+
+  return write_rows (table, cells, out);
+  }
+
+struct pk_span pk_table_cell (const struct pk_table_row* row, size_t i) {
+  struct pk_span cell;
+  size_t start = i > 0 ? row->ends[i - 1] : row->start;
+
+  cell.data = row->data + start;
+  cell.len = row->ends[i] - start;
+  return cell;
+  }
+
+int pk_table_align (const struct pk_table* table, size_t column) {
+  const struct pk_table_column* info;
+
+  if (column >= table->ncolumns) {
+    return PK_ALIGN_LEFT;
+    }
+
+  info = &table->columns[column];
+
+  if (info->align != PK_ALIGN_DEFAULT) {
+    return info->align;
+    }
+
+  return info->numbers > 0 && info->words == 0 ? PK_ALIGN_RIGHT : PK_ALIGN_LEFT;
+  }
+
+size_t pk_table_width (const char* text, size_t len) {
+  size_t width = 0;
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    if ( ( (unsigned char) text[i] & 0xC0) != 0x80) {
+      width++;
+      }
+    }
+
+  return width;
+  }
+
+int pk_table_numeric (const char* text, size_t len) {
+  size_t digits = 0;
+  size_t i = 0;
+
+  if (len > 0 && (text[0] == '-' || text[0] == '+')) {
+    i++;
+    }
+
+  for (; i < len; i++) {
+    if (text[i] >= '0' && text[i] <= '9') {
+      digits++;
+      }
+
+    else if ( (text[i] != '.' && text[i] != ',') || digits == 0) {
+      break;
+      }
+    }
+
+  if (i + 1 == len && text[i] == '%') {
+    i++;
+    }
+
+  return digits > 0 && i == len;
+  }
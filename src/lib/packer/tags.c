@@ -0,0 +1,123 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file tags.c
+*** \brief The table of Bayeux tags known to the compiler
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/tags.h"
+
+struct tag_info {
+  const char* name;   /*< Name of the tag, as written in the source */
+  unsigned    flags;  /*< PK_TAG_* flags */
+  };
+
+/* Indexed by enum pk_tag, and so sorted by name */
+static const struct tag_info tag_table[PK_TAG_COUNT] = {
+  { "?",         PK_TAG_INLINE },
+  { "a",         PK_TAG_INLINE },
+  { "ac",        PK_TAG_INLINE },
+  { "acl",       PK_TAG_INLINE },
+  { "bib",       PK_TAG_VOID },
+  { "caption",   PK_TAG_INLINE },
+  { "cite",      PK_TAG_INLINE },
+  { "code",      PK_TAG_BLOCK | PK_TAG_VERBATIM },
+  { "com",       PK_TAG_INLINE },
+  { "command",   PK_TAG_BLOCK | PK_TAG_VERBATIM },
+  { "dl",        PK_TAG_BLOCK },
+  { "e",         PK_TAG_INLINE },
+  { "end",       PK_TAG_VOID },
+  { "figure",    PK_TAG_BLOCK },
+  { "fn",        PK_TAG_INLINE },
+  { "h1",        PK_TAG_INLINE | PK_TAG_HEADING },
+  { "h2",        PK_TAG_INLINE | PK_TAG_HEADING },
+  { "h3",        PK_TAG_INLINE | PK_TAG_HEADING },
+  { "image",     PK_TAG_INLINE },
+  { "item",      PK_TAG_INLINE },
+  { "link",      PK_TAG_INLINE },
+  { "man",       PK_TAG_INLINE },
+  { "medskip",   PK_TAG_VOID },
+  { "note",      PK_TAG_BLOCK },
+  { "ol",        PK_TAG_BLOCK },
+  { "output",    PK_TAG_BLOCK | PK_TAG_VERBATIM },
+  { "question",  PK_TAG_BLOCK },
+  { "questions", PK_TAG_BLOCK },
+  { "quote",     PK_TAG_BLOCK },
+  { "ref",       PK_TAG_INLINE },
+  { "s",         PK_TAG_INLINE },
+  { "sc",        PK_TAG_INLINE },
+  { "table",     PK_TAG_BLOCK },
+  { "tt",        PK_TAG_INLINE },
+  { "ul",        PK_TAG_BLOCK }
+  };
+
+int pk_tag_lookup (const char* name, size_t len) {
+  int low = 1;
+  int high = PK_TAG_COUNT - 1;
+
+  /* Binary search over the sorted table, skipping the unknown entry */
+  while (low <= high) {
+    int mid = (low + high) / 2;
+    const char* entry = tag_table[mid].name;
+    size_t elen = strlen (entry);
+    int cmp = memcmp (name, entry, len < elen ? len : elen);
+
+    if (cmp == 0) {
+      cmp = (len > elen) - (len < elen);
+      }
+
+    if (cmp == 0) {
+      return mid;
+      }
+
+    else if (cmp < 0) {
+      high = mid - 1;
+      }
+
+    else {
+      low = mid + 1;
+      }
+    }
+
+  return PK_TAG_UNKNOWN;
+  }
+
+unsigned pk_tag_flags (int tag) {
+  if (tag < 0 || tag >= PK_TAG_COUNT) {
+    return PK_TAG_INLINE;
+    }
+
+  return tag_table[tag].flags;
+  }
+
+const char* pk_tag_name (int tag) {
+  if (tag < 0 || tag >= PK_TAG_COUNT) {
+    return tag_table[PK_TAG_UNKNOWN].name;
+    }
+
+  return tag_table[tag].name;
+  }
@@ -0,0 +1,296 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file text.c
+*** \brief Plain text backend for the renderer
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+
+/* config.h must be included before anything else */
+#include "config.h"
+
+#ifdef HAVE_STRING_H
+#include <string.h>
+#else
+#error "can't find the C string library"
+#endif
+
+#include "packer/render.h"
+#include "packer/span.h"
+
+static int text_text (struct pk_render* render, const char* text, size_t len) {
+  return pk_render_ref (render, text, len);
+  }
+
+static int text_paragraph (struct pk_render* render, int open) {
+  return open ? PK_OK : pk_render_puts (render, "\n\n");
+  }
+
+static int text_note (int number, const_bstring body, bstring notes, void* ctx) {
+  (void) ctx;
+
+  return bformata (notes, "  [%d] ", number) == BSTR_OK && bconcat (notes, body) == BSTR_OK &&
+         bconchar (notes, '\n') == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int text_notes (const_bstring notes, int first, int last, bstring out, void* ctx) {
+  (void) first;
+  (void) last;
+  (void) ctx;
+
+  return bcatcstr (out, "  ----\n") == BSTR_OK && bconcat (out, notes) == BSTR_OK && bconchar (out, '\n') == BSTR_OK ?
+         PK_OK : PK_ERR;
+  }
+
+/**
+*** Tag Handlers
+**/
+
+/* Headings are underlined to the length of their text */
+static int heading_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  char rule = frame->open.tag == PK_TAG_H1 ? '=' : frame->open.tag == PK_TAG_H2 ? '-' : '~';
+  int i;
+
+  btrimws (frame->body);
+
+  if (bconcat (out, frame->body) != BSTR_OK || bconchar (out, '\n') != BSTR_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < blength (frame->body); i++) {
+    if (bconchar (out, rule) != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return pk_render_puts (render, "\n\n");
+  }
+
+static int footnote_open (struct pk_render* render, struct pk_render_frame* frame) {
+  return bformata (pk_render_out (render), "[%d]", frame->number) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int item_open (struct pk_render* render, struct pk_render_frame* frame) {
+  (void) frame;
+  return pk_render_puts (render, "  * ");
+  }
+
+static int line_close (struct pk_render* render, struct pk_render_frame* frame) {
+  (void) frame;
+  return pk_render_puts (render, "\n");
+  }
+
+static int block_close (struct pk_render* render, struct pk_render_frame* frame) {
+  (void) frame;
+  return pk_render_puts (render, "\n");
+  }
+
+/* The caption of a table is kept by the table, and written after the rows */
+static int caption_close (struct pk_render* render, struct pk_render_frame* frame) {
+  struct pk_render_frame* parent = render->depth > 0 ? &render->frames[render->depth - 1] : NULL;
+
+  if (parent != NULL && parent->table != NULL) {
+    bdestroy (parent->table->caption);
+    parent->table->caption = frame->body;
+    frame->body = NULL;
+    return PK_OK;
+    }
+
+  btrimws (frame->body);
+  return bconcat (pk_render_out (render), frame->body) == BSTR_OK ? pk_render_puts (render, "\n") : PK_ERR;
+  }
+
+/* Append count copies of c */
+static int fill (bstring out, char c, size_t count) {
+  return binsertch (out, blength (out), (int) count, (unsigned char) c) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+/* Columns are padded to their widest cell, so the rows are only written
+ * once the table is complete. The header is ruled off from the body
+ */
+static int table_row (bstring out, const struct pk_table* table, const struct pk_table_row* row, void* ctx) {
+  size_t i;
+
+  (void) ctx;
+
+  if (table->header > 0 && row->index == table->header) {
+    for (i = 0; i < table->ncolumns; i++) {
+      if (bcatcstr (out, i > 0 ? "-+-" : "  ") != BSTR_OK || fill (out, '-', table->columns[i].width) != PK_OK) {
+        return PK_ERR;
+        }
+      }
+
+    if (bconchar (out, '\n') != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  if (bcatcstr (out, "  ") != BSTR_OK) {
+    return PK_ERR;
+    }
+
+  for (i = 0; i < table->ncolumns; i++) {
+    struct pk_span cell = { "", 0 };
+    int align = pk_table_align (table, i);
+    size_t pad;
+    size_t before;
+
+    if (i < row->count) {
+      cell = pk_table_cell (row, i);
+      }
+
+    pad = table->columns[i].width - pk_table_width (cell.data, cell.len);
+    before = align == PK_ALIGN_RIGHT ? pad : align == PK_ALIGN_CENTRE ? pad / 2 : 0;
+
+    if ( (i > 0 && bcatcstr (out, " | ") != BSTR_OK) || fill (out, ' ', before) != PK_OK ||
+         bcatblk (out, cell.data, (int) cell.len) != BSTR_OK) {
+      return PK_ERR;
+      }
+
+    if (fill (out, ' ', pad - before) != PK_OK) {
+      return PK_ERR;
+      }
+    }
+
+  /* No trailing blanks at the end of the line */
+  for (i = (size_t) blength (out); i > 0 && out->data[i - 1] == ' '; i--) {
+    }
+
+  return btrunc (out, (int) i) == BSTR_OK && bconchar (out, '\n') == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int table_open (struct pk_render* render, struct pk_render_frame* frame) {
+  (void) render;
+
+  frame->table = pk_table_new (table_row, 1, NULL);
+  return frame->table != NULL ? PK_OK : PK_ERR;
+  }
+
+static int table_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  bstring caption = frame->table->caption;
+
+  if (pk_table_finish (frame->table, frame->body, out) != PK_OK) {
+    return PK_ERR;
+    }
+
+  if (caption != NULL) {
+    btrimws (caption);
+
+    if (bcatcstr (out, "\n  ") != BSTR_OK || bconcat (out, caption) != BSTR_OK || bconchar (out, '\n') != BSTR_OK) {
+      return PK_ERR;
+      }
+    }
+
+  return pk_render_puts (render, "\n");
+  }
+
+static int quoted_close (struct pk_render* render, struct pk_render_frame* frame) {
+  btrimws (frame->text);
+  return bformata (pk_render_out (render), frame->open.tag == PK_TAG_IMAGE ? "[image: %s]" : "%s",
+                   bdata (frame->text)) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+static int man_close (struct pk_render* render, struct pk_render_frame* frame) {
+  btrimws (frame->text);
+  return bformata (pk_render_out (render), "%s(%.*s)", bdata (frame->text), (int) frame->open.label.len,
+                   frame->open.label.data) == BSTR_OK ? PK_OK : PK_ERR;
+  }
+
+/* [link text|url] becomes "text <url>" */
+static int link_close (struct pk_render* render, struct pk_render_frame* frame) {
+  bstring out = pk_render_out (render);
+  struct pk_span text = pk_span_bstr (frame->body);
+  size_t bar = pk_span_rchr (text, '|');
+
+  if (bar == PK_SPAN_NPOS) {
+    return pk_span_cat (out, text);
+    }
+
+  return pk_span_cat (out, pk_span_mid (text, 0, bar)) == PK_OK && pk_render_puts (render, " <") == PK_OK &&
+         pk_span_cat (out, pk_span_mid (text, bar + 1, text.len)) == PK_OK && pk_render_puts (render, ">") == PK_OK ?
+         PK_OK : PK_ERR;
+  }
+
+static int verbatim_text (struct pk_render* render, struct pk_render_frame* frame, const char* text, size_t len) {
+  (void) frame;
+
+  if (len > 0 && *text == '\n') {
+    text++;
+    len--;
+    }
+
+  return pk_render_ref (render, text, len);
+  }
+
+#define PLAIN { NULL, NULL, NULL, 0 }
+#define BLOCK { NULL, block_close, NULL, 0 }
+#define HEADING { NULL, heading_close, NULL, PK_RENDER_BLOCK | PK_RENDER_DIVERT }
+#define VERBATIM { NULL, block_close, verbatim_text, 0 }
+#define QUOTED { NULL, quoted_close, NULL, PK_RENDER_COLLECT | PK_RENDER_HIDE }
+
+/* Indexed by enum pk_tag */
+static const struct pk_tag_handler text_tags[PK_TAG_COUNT] = {
+  PLAIN,                                                    /* unknown */
+  PLAIN,                                                    /* a */
+  PLAIN,                                                    /* ac */
+  PLAIN,                                                    /* acl */
+  { NULL, NULL, NULL, PK_RENDER_BLOCK },                    /* bib */
+  { NULL, caption_close, NULL, PK_RENDER_BLOCK | PK_RENDER_DIVERT }, /* caption */
+  PLAIN,                                                    /* cite */
+  VERBATIM,                                                 /* code */
+  PLAIN,                                                    /* com */
+  VERBATIM,                                                 /* command */
+  BLOCK,                                                    /* dl */
+  PLAIN,                                                    /* e */
+  PLAIN,                                                    /* end */
+  BLOCK,                                                    /* figure */
+  { footnote_open, NULL, NULL, 0 },                         /* fn */
+  HEADING,                                                  /* h1 */
+  HEADING,                                                  /* h2 */
+  HEADING,                                                  /* h3 */
+  QUOTED,                                                   /* image */
+  { item_open, line_close, NULL, PK_RENDER_BLOCK },         /* item */
+  { NULL, link_close, NULL, PK_RENDER_DIVERT },             /* link */
+  { NULL, man_close, NULL, PK_RENDER_COLLECT | PK_RENDER_HIDE }, /* man */
+  { NULL, line_close, NULL, PK_RENDER_BLOCK },              /* medskip */
+  BLOCK,                                                    /* note */
+  BLOCK,                                                    /* ol */
+  VERBATIM,                                                 /* output */
+  BLOCK,                                                    /* question */
+  BLOCK,                                                    /* questions */
+  BLOCK,                                                    /* quote */
+  QUOTED,                                                   /* ref */
+  PLAIN,                                                    /* s */
+  PLAIN,                                                    /* sc */
+  { table_open, table_close, pk_render_table_text, PK_RENDER_DIVERT }, /* table */
+  PLAIN,                                                    /* tt */
+  BLOCK                                                     /* ul */
+  };
+
+/* Plain text has no pages to link to, so the notes follow each section */
+const struct pk_backend pk_backend_text = {
+  "text",
+  PK_FN_SECTION,
+  text_tags,
+  text_text,
+  text_paragraph,
+  text_note,
+  text_notes
+  };
@@ -0,0 +1,111 @@
+# Copyright (c) 2011 David Love
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+# OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+# WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+##
+## Render one adversarial page. Called by ctest as
+##
+##   cmake -DPPACK=<ppack> -DCASE=<name> -DDEPTH=<n> -DWORK=<dir> -P run.cmake
+##
+## The page is a head, a body repeated many times, and a tail. It must
+## render (or, past a limit, fail with the limit reported) within the
+## timeout of the test. A case may run some other ppack command over the
+## page instead, by setting query.
+##
+
+# Set var to count copies of text, doubling as it goes
+macro ( repeat var text count )
+  set ( piece "${text}" )
+  set ( ${var} "" )
+  set ( left ${count} )
+
+  while ( left GREATER 0 )
+    math ( EXPR bit "${left} % 2" )
+
+    if ( bit )
+      set ( ${var} "${${var}}${piece}" )
+    endif ( bit )
+
+    set ( piece "${piece}${piece}" )
+    math ( EXPR left "${left} / 2" )
+  endwhile ( left GREATER 0 )
+endmacro ( repeat )
+
+set ( head "" )
+set ( tail "" )
+set ( query "" )
+
+# Exit status of ppack: 0 when the page renders, 10 when a limit stops it
+set ( expect 0 )
+
+if ( CASE STREQUAL "unclosed_brackets" )
+  repeat ( body "[b " 100000 )
+elseif ( CASE STREQUAL "nested_lists" )
+  repeat ( body "[ol][item]" 50000 )
+elseif ( CASE STREQUAL "nested_inline" )
+  repeat ( body "[b]" 100000 )
+  set ( tail "x" )
+elseif ( CASE STREQUAL "nested_tables" )
+  repeat ( body "[table]" 20000 )
+  set ( tail "x" )
+
+  # Tables hold their body, so past PK_RENDER_MAX_HELD the page fails
+  if ( DEPTH EQUAL 0 )
+    set ( expect 10 )
+  endif ( DEPTH EQUAL 0 )
+elseif ( CASE STREQUAL "stray_ends" )
+  repeat ( body "[end]" 100000 )
+elseif ( CASE STREQUAL "code_without_end" )
+  set ( head "[code bind]\n" )
+  repeat ( body "zone \"example.com\" { type master; file \"db.example\"; };\n" 50000 )
+elseif ( CASE STREQUAL "unclosed_comment" )
+  set ( head "[code c]\n/*\n" )
+  repeat ( body "int x = 1; char* s = \"[b]\"; /* not closed here\n" 50000 )
+elseif ( CASE STREQUAL "deep_query" )
+  repeat ( head "[ol]" 250 )
+  set ( body "x" )
+  repeat ( tail "[end]" 250 )
+
+  # Every [ol] may stand for each '//' step, but none is in a [ul]: no match
+  set ( query query "//ul//ol//ol//ol//ol//ol" )
+  set ( expect 1 )
+else ( CASE STREQUAL "unclosed_brackets" )
+  message ( FATAL_ERROR "Unknown adversarial case '${CASE}'" )
+endif ( CASE STREQUAL "unclosed_brackets" )
+
+set ( page ${WORK}/${CASE}-${DEPTH}.byx )
+file ( WRITE ${page} "${head}${body}${tail}" )
+
+if ( query )
+  set ( command ${PPACK} ${query} ${page} )
+else ( query )
+  set ( command ${PPACK} --max-depth=${DEPTH} --render=${WORK}/${CASE}-${DEPTH}.html ${page} )
+endif ( query )
+
+execute_process (
+  COMMAND ${command}
+  RESULT_VARIABLE status
+  OUTPUT_QUIET
+  ERROR_QUIET
+)
+
+if ( NOT status EQUAL expect )
+  message ( FATAL_ERROR "ppack exited with '${status}' on ${CASE} (expected ${expect})" )
+endif ( NOT status EQUAL expect )
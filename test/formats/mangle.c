@@ -0,0 +1,88 @@
+/**
+*** Copyright (c) 2012 David Love <d.love@shu.ac.uk>
+***
+*** Permission to use, copy, modify, and/or distribute this software for any
+*** purpose with or without fee is hereby granted, provided that the above
+*** copyright notice and this permission notice appear in all copies.
+***
+*** THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+*** WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+*** MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+*** ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+*** WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+*** ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+*** OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+***
+*** \file mangle.c
+*** \brief Damage a file written by ppack, for the format tests
+***
+*** \author David Love
+*** \date October 2026
+**/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+*** Copy a file, damaged in one of two ways:
+***
+***   mangle <in> <out> cut <n>    keep only the first n bytes
+***   mangle <in> <out> flip <n>   flip the low bit of the byte at n
+***
+*** A negative n counts back from the end of the file. Exits with zero
+*** once the copy is written, and one on error.
+**/
+int main (int argc, char** argv) {
+  FILE* in;
+  FILE* out;
+  char* data;
+  long size;
+  long n;
+
+  if (argc != 5 || (strcmp (argv[3], "cut") != 0 && strcmp (argv[3], "flip") != 0)) {
+    fprintf (stderr, "Usage: mangle <in> <out> cut|flip <n>\n");
+    return 1;
+    }
+
+  in = fopen (argv[1], "rb");
+
+  if (in == NULL || fseek (in, 0, SEEK_END) != 0 || (size = ftell (in)) < 0 || fseek (in, 0, SEEK_SET) != 0) {
+    fprintf (stderr, "Cannot read '%s'\n", argv[1]);
+    return 1;
+    }
+
+  data = (char*) malloc ( (size_t) size + 1);
+
+  if (data == NULL || fread (data, 1, (size_t) size, in) != (size_t) size) {
+    fprintf (stderr, "Cannot read '%s'\n", argv[1]);
+    return 1;
+    }
+
+  fclose (in);
+  n = strtol (argv[4], NULL, 10);
+  n = n < 0 ? size + n : n;
+
+  if (n < 0 || n > size || (argv[3][0] == 'f' && n == size)) {
+    fprintf (stderr, "Offset %s lies outside '%s'\n", argv[4], argv[1]);
+    return 1;
+    }
+
+  if (argv[3][0] == 'c') {
+    size = n;
+    }
+
+  else {
+    data[n] ^= 1;
+    }
+
+  out = fopen (argv[2], "wb");
+
+  if (out == NULL || fwrite (data, 1, (size_t) size, out) != (size_t) size || fclose (out) != 0) {
+    fprintf (stderr, "Cannot write '%s'\n", argv[2]);
+    return 1;
+    }
+
+  free (data);
+  return 0;
+  }
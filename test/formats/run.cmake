@@ -0,0 +1,437 @@
+# Copyright (c) 2011 David Love
+#
+# Permission is hereby granted, free of charge, to any person obtaining
+# a copy of this software and associated documentation files (the
+# "Software"), to deal in the Software without restriction, including
+# without limitation the rights to use, copy, modify, merge, publish,
+# distribute, sublicense, and/or sell copies of the Software, and to
+# permit persons to whom the Software is furnished to do so, subject to
+# the following conditions:
+#
+# The above copyright notice and this permission notice shall be
+# included in all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+# EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+# MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+# NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+# LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+# OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+# WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+##
+## Round trip one file format. Called by ctest as
+##
+##   cmake -DPPACK=<ppack> -DMANGLE=<mangle> -DCASE=<name> -DDATA=<site>
+##         -DWORK=<dir> -P run.cmake
+##
+## Every run of ppack must exit as expected: a damaged file with ten, as
+## for any file ppack cannot read. Damage the format cannot detect (a bit
+## flipped within the text of a page, say) must still leave ppack to exit
+## normally, with zero, one or ten.
+##
+
+# Run ppack with the arguments after expect, which must be its exit status
+# (or "-" for any). Its output is left in ppack_output, and its exit
+# status in ppack_status
+function ( ppack expect )
+  execute_process (
+    COMMAND ${PPACK} ${ARGN}
+    WORKING_DIRECTORY ${WORK}
+    RESULT_VARIABLE status
+    OUTPUT_VARIABLE output
+    ERROR_QUIET
+  )
+
+  if ( NOT expect STREQUAL "-" AND NOT status EQUAL expect )
+    message ( FATAL_ERROR "ppack ${ARGN} exited with '${status}' (expected ${expect})" )
+  endif ( NOT expect STREQUAL "-" AND NOT status EQUAL expect )
+
+  set ( ppack_output "${output}" PARENT_SCOPE )
+  set ( ppack_status "${status}" PARENT_SCOPE )
+endfunction ( ppack )
+
+# Set var to a copy of file, damaged as mangle does (cut or flip at offset)
+function ( mangle var file how offset )
+  get_filename_component ( ext ${file} EXT )
+  set ( bad ${WORK}/bad-${how}${offset}${ext} )
+
+  execute_process (
+    COMMAND ${MANGLE} ${file} ${bad} ${how} ${offset}
+    RESULT_VARIABLE status
+  )
+
+  if ( NOT status EQUAL 0 )
+    message ( FATAL_ERROR "Cannot damage '${file}'" )
+  endif ( NOT status EQUAL 0 )
+
+  set ( ${var} ${bad} PARENT_SCOPE )
+endfunction ( mangle )
+
+# Damage a copy of file with mangle, then run ppack with the arguments
+# after offset, naming the copy as @BAD@. It must exit with ten; or, while
+# undetected is set, with zero, one or ten
+function ( damaged file how offset )
+  mangle ( bad ${file} ${how} ${offset} )
+  string ( REPLACE "@BAD@" "${bad}" args "${ARGN}" )
+
+  if ( undetected )
+    execute_process (
+      COMMAND ${PPACK} ${args}
+      WORKING_DIRECTORY ${WORK}
+      RESULT_VARIABLE status
+      OUTPUT_QUIET
+      ERROR_QUIET
+    )
+
+    if ( NOT (status EQUAL 0 OR status EQUAL 1 OR status EQUAL 10) )
+      message ( FATAL_ERROR "ppack ${args} exited with '${status}' on a ${how} at ${offset}" )
+    endif ( NOT (status EQUAL 0 OR status EQUAL 1 OR status EQUAL 10) )
+  else ( undetected )
+    ppack ( 10 ${args} )
+  endif ( undetected )
+endfunction ( damaged )
+
+# Set var to count copies of text, doubling as it goes
+macro ( repeat var text count )
+  set ( piece "${text}" )
+  set ( ${var} "" )
+  set ( left ${count} )
+
+  while ( left GREATER 0 )
+    math ( EXPR bit "${left} % 2" )
+
+    if ( bit )
+      set ( ${var} "${${var}}${piece}" )
+    endif ( bit )
+
+    set ( piece "${piece}${piece}" )
+    math ( EXPR left "${left} / 2" )
+  endwhile ( left GREATER 0 )
+endmacro ( repeat )
+
+# Set var to the size of file in bytes
+function ( file_size var file )
+  file ( READ ${file} hex HEX )
+  string ( LENGTH "${hex}" digits )
+  math ( EXPR size "${digits} / 2" )
+  set ( ${var} ${size} PARENT_SCOPE )
+endfunction ( file_size )
+
+# Compare the pages old and new (Bayeux sources), which must give exactly
+# the changes expected
+function ( compare name old new expected )
+  file ( WRITE ${WORK}/${name}-old.byx "${old}" )
+  file ( WRITE ${WORK}/${name}-new.byx "${new}" )
+  ppack ( 1 diff ${WORK}/${name}-old.byx ${WORK}/${name}-new.byx )
+  same ( "Comparing ${name}" "${ppack_output}" "${expected}" )
+endfunction ( compare )
+
+# Check two outputs of ppack are the same, once each file name is taken out
+function ( same what found expected )
+  if ( NOT found STREQUAL expected )
+    message ( FATAL_ERROR "${what} gives '${found}', not '${expected}'" )
+  endif ( NOT found STREQUAL expected )
+endfunction ( same )
+
+file ( REMOVE_RECURSE ${WORK} )
+file ( MAKE_DIRECTORY ${WORK} )
+file ( GLOB_RECURSE pages RELATIVE ${DATA} ${DATA}/*.byx )
+
+if ( CASE STREQUAL "archive" )
+  # Every page, read back from the archive, is the page it was made from,
+  # and finds the same tags
+  ppack ( 0 --archive=${WORK}/site.pak --root=${DATA} ${DATA} )
+
+  foreach ( page ${pages} )
+    ppack ( 0 diff ${WORK}/site.pak:${page} ${DATA}/${page} )
+    ppack ( 0 query -c * ${DATA}/${page} )
+    string ( REPLACE "${DATA}/" "" expected "${ppack_output}" )
+    ppack ( 0 query -c * ${WORK}/site.pak:${page} )
+    string ( REPLACE "${WORK}/site.pak:" "" found "${ppack_output}" )
+    same ( "Archived ${page}" "${found}" "${expected}" )
+  endforeach ( page )
+
+  # The archive is searched page by page; a page it lacks cannot be
+  ppack ( 0 query //h2 ${WORK}/site.pak )
+  ppack ( 10 query //h2 ${WORK}/site.pak:Missing.byx )
+
+  # Two pages cannot share a path
+  ppack ( 10 --archive=${WORK}/twice.pak ${DATA}/Welcome.byx ${DATA}/Welcome.byx )
+
+  # Listed pages make the same archive as the pages given
+  string ( REPLACE ";" "\n${DATA}/" listed "${DATA}/${pages}" )
+  file ( WRITE ${WORK}/pages.list "${listed}\n" )
+  ppack ( 0 --archive=${WORK}/listed.pak --root=${DATA} --files-from=${WORK}/pages.list )
+  file ( SHA256 ${WORK}/site.pak expected )
+  file ( SHA256 ${WORK}/listed.pak found )
+  same ( "Listed archive" "${found}" "${expected}" )
+  ppack ( 1 --archive=${WORK}/listed.pak --null ${DATA}/Welcome.byx )
+
+  # An archive of one page is not rendered as a page as well
+  ppack ( 0 --archive=${WORK}/one.pak --render=${WORK}/one.html ${DATA}/Welcome.byx )
+
+  if ( EXISTS ${WORK}/one.html )
+    message ( FATAL_ERROR "An archive of one page was rendered" )
+  endif ( EXISTS ${WORK}/one.html )
+
+  # The header, the slot table and the end of the string pool
+  foreach ( how cut flip )
+    foreach ( offset 0 4 12 30 -1 )
+      if ( NOT (how STREQUAL "cut" AND offset EQUAL 0) )
+        damaged ( ${WORK}/site.pak ${how} ${offset} query //h2 @BAD@ )
+      endif ( NOT (how STREQUAL "cut" AND offset EQUAL 0) )
+    endforeach ( offset )
+  endforeach ( how )
+
+  damaged ( ${WORK}/site.pak cut 0 query //h2 @BAD@ )
+elseif ( CASE STREQUAL "pdoc" )
+  # Each page compiled to a .pdoc reads back as the page, whole through its
+  # columns and by section through its postings
+  file ( COPY ${DATA}/ DESTINATION ${WORK} FILES_MATCHING PATTERN "*.byx" )
+
+  foreach ( page ${pages} )
+    string ( REGEX REPLACE "byx$" "pdoc" pdoc ${page} )
+    ppack ( 0 ${WORK}/${page} )
+    ppack ( 0 diff ${WORK}/${pdoc} ${WORK}/${page} )
+
+    foreach ( query * h2 ol/item item//tt "*[~the]" )
+      ppack ( - query ${query} ${WORK}/${page} )
+      string ( REPLACE "${WORK}/${page}" "" expected "${ppack_output}" )
+      ppack ( ${ppack_status} query ${query} ${WORK}/${pdoc} )
+      string ( REPLACE "${WORK}/${pdoc}" "" found "${ppack_output}" )
+      same ( "Query ${query} of ${pdoc}" "${found}" "${expected}" )
+    endforeach ( query )
+  endforeach ( page )
+
+  # Every field of the header, and the end of the file. The postings hold
+  # only node numbers, which a flip may change without notice
+  set ( pdoc ${WORK}/Labs/Lab3/L3_DNS.pdoc )
+
+  foreach ( offset 0 8 12 16 20 24 )
+    damaged ( ${pdoc} flip ${offset} diff @BAD@ ${WORK}/Labs/Lab3/L3_DNS.byx )
+    damaged ( ${pdoc} flip ${offset} query h2 @BAD@ )
+  endforeach ( offset )
+
+  foreach ( offset 0 31 40 1000 -1 )
+    damaged ( ${pdoc} cut ${offset} diff @BAD@ ${WORK}/Labs/Lab3/L3_DNS.byx )
+    damaged ( ${pdoc} cut ${offset} query h2 @BAD@ )
+  endforeach ( offset )
+
+  set ( undetected ON )
+
+  foreach ( offset 28 -1 -4 -8 )
+    damaged ( ${pdoc} flip ${offset} query h2 @BAD@ )
+  endforeach ( offset )
+elseif ( CASE STREQUAL "lz" )
+  # A long page of many sections, each alike enough to compress well. Each
+  # block is expanded on its own: the whole page, and each tag found by
+  # section, read back as compiled
+  repeat ( items "[item Set the [tt named.conf] zone for host.example.com]\n" 120 )
+  repeat ( body "[h2 Zones]\n[ol]\n${items}[end]\n[code bind]\nzone \"example.com\" { type master; };\n[end]\n" 40 )
+  file ( WRITE ${WORK}/long.byx "${body}" )
+  ppack ( 0 ${WORK}/long.byx )
+  ppack ( 0 diff ${WORK}/long.pdoc ${WORK}/long.byx )
+
+  foreach ( query h2 item/tt code )
+    ppack ( 0 query -c ${query} ${WORK}/long.byx )
+    string ( REPLACE "${WORK}/long.byx" "" expected "${ppack_output}" )
+    ppack ( 0 query -c ${query} ${WORK}/long.pdoc )
+    string ( REPLACE "${WORK}/long.pdoc" "" found "${ppack_output}" )
+    same ( "Query ${query} of long.pdoc" "${found}" "${expected}" )
+  endforeach ( query )
+
+  file_size ( source ${WORK}/long.byx )
+  file_size ( compiled ${WORK}/long.pdoc )
+
+  if ( NOT compiled LESS source )
+    message ( FATAL_ERROR "long.pdoc holds ${compiled} bytes, from ${source} of source" )
+  endif ( NOT compiled LESS source )
+
+  # The codec, sizes and offset of the first block, then blocks cut short
+  foreach ( offset 44 52 56 60 )
+    damaged ( ${WORK}/long.pdoc flip ${offset} diff @BAD@ ${WORK}/long.byx )
+    damaged ( ${WORK}/long.pdoc flip ${offset} query item @BAD@ )
+  endforeach ( offset )
+
+  foreach ( offset 2000 20000 40000 -100 )
+    damaged ( ${WORK}/long.pdoc cut ${offset} diff @BAD@ ${WORK}/long.byx )
+    damaged ( ${WORK}/long.pdoc cut ${offset} query item @BAD@ )
+  endforeach ( offset )
+
+  # Within a block a flip may only change the text expanded
+  set ( undetected ON )
+
+  foreach ( offset 2000 2001 5000 20000 40000 -5000 )
+    damaged ( ${WORK}/long.pdoc flip ${offset} diff @BAD@ ${WORK}/long.byx )
+    damaged ( ${WORK}/long.pdoc flip ${offset} query item @BAD@ )
+  endforeach ( offset )
+elseif ( CASE STREQUAL "byteorder" )
+  # test/data/pdoc holds a page compiled on a little endian host. It must
+  # read back as its source, and compiling the source here must give the
+  # same bytes, whichever way round this host keeps its integers
+  set ( golden ${DATA}/../pdoc/columns.pdoc )
+  configure_file ( ${DATA}/../pdoc/columns.byx ${WORK}/columns.byx COPYONLY )
+  ppack ( 0 ${WORK}/columns.byx )
+
+  execute_process (
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${golden} ${WORK}/columns.pdoc
+    RESULT_VARIABLE status
+  )
+
+  if ( NOT status EQUAL 0 )
+    message ( FATAL_ERROR "columns.pdoc differs from ${golden}" )
+  endif ( NOT status EQUAL 0 )
+
+  ppack ( 0 diff ${golden} ${WORK}/columns.byx )
+  ppack ( 0 query * ${WORK}/columns.byx )
+  string ( REPLACE "${WORK}/columns.byx" "" expected "${ppack_output}" )
+  ppack ( 0 query * ${golden} )
+  string ( REPLACE "${golden}" "" found "${ppack_output}" )
+  same ( "Query * of ${golden}" "${found}" "${expected}" )
+
+  # The counts and offsets of the header, and the columns cut short
+  foreach ( offset 8 9 12 16 19 20 23 )
+    damaged ( ${golden} flip ${offset} diff @BAD@ ${WORK}/columns.byx )
+  endforeach ( offset )
+
+  foreach ( offset 100 200 400 800 -1 )
+    damaged ( ${golden} cut ${offset} diff @BAD@ ${WORK}/columns.byx )
+  endforeach ( offset )
+elseif ( CASE STREQUAL "man" )
+  # A manual path of empty pages, and a list naming others
+  file ( WRITE ${WORK}/man/man8/named.8 "" )
+  file ( WRITE ${WORK}/man/man1/dig.1.gz "" )
+  file ( WRITE ${WORK}/man.list "# Pages of the lab\nnamed 8\nnsd 8 https://example.org/nsd.html\n\nopenssl 1ssl\n" )
+  file ( WRITE ${WORK}/page.byx "[h2 Tools]\n\nRun [man:8 named], [man:8 nsd], [man:1 openssl] and [man:1 dig].\n" )
+  set ( ENV{MANPATH} ${WORK}/man )
+
+  set ( listed "named(8) -> https://man.openbsd.org/named.8;nsd(8) -> https://example.org/nsd.html;" )
+  set ( listed "${listed}openssl(1) -> https://man.openbsd.org/openssl.1ssl" )
+  set ( scanned "named(8) -> https://man.openbsd.org/named.8;dig(1) -> https://man.openbsd.org/dig.1" )
+
+  # An index built from the list, then mapped again, finds the pages listed
+  foreach ( list --man-list=${WORK}/man.list "" )
+    ppack ( 0 -v --man-index=${WORK}/list.idx ${list} ${WORK}/page.byx )
+    string ( REGEX MATCHALL "[^\n]* -> [^\n]*" found "${ppack_output}" )
+    same ( "The listed index" "${found}" "${listed}" )
+  endforeach ( list )
+
+  # Rendered links come from the same index
+  ppack ( 0 --man-index=${WORK}/list.idx --render=${WORK}/page.html ${WORK}/page.byx )
+  file ( READ ${WORK}/page.html html )
+  string ( REGEX MATCHALL "href=\"[^\"]*\"" found "${html}" )
+  set ( expected "href=\"https://man.openbsd.org/named.8\";href=\"https://example.org/nsd.html\"" )
+  set ( expected "${expected};href=\"https://man.openbsd.org/openssl.1ssl\"" )
+  same ( "The rendered links" "${found}" "${expected}" )
+
+  # An index that cannot be trusted is built again, from MANPATH
+  foreach ( damage "flip;0" "flip;8" "flip;16" "flip;20" "flip;24" "cut;20" "cut;40" "cut;-1" )
+    mangle ( bad ${WORK}/list.idx ${damage} )
+    ppack ( 0 -v --man-index=${bad} ${WORK}/page.byx )
+    string ( REGEX MATCHALL "[^\n]* -> [^\n]*" found "${ppack_output}" )
+    same ( "The index damaged by ${damage}" "${found}" "${scanned}" )
+  endforeach ( damage )
+
+  # The count of pages, and the strings of the pool, are taken on trust
+  set ( undetected ON )
+  damaged ( ${WORK}/list.idx flip 12 -v --man-index=@BAD@ ${WORK}/page.byx )
+  damaged ( ${WORK}/list.idx flip -2 -v --man-index=@BAD@ ${WORK}/page.byx )
+elseif ( CASE STREQUAL "diff" )
+  # An item inserted before one that was edited is an insertion, not a
+  # change to the item it displaced
+  compare ( inserted
+    "[ol]\n[item alpha beta gamma]\n[item delta]\n[end]\n"
+    "[ol]\n[item inserted one]\n[item alpha beta gamma epsilon]\n[item delta]\n[end]\n"
+    "inserted  [item inserted one] in [ol], line 2\nchanged   text \"alpha beta gamma epsilon\" in [item alpha beta gamma epsilon], line 2 -> 3\n"
+  )
+
+  # Deletions are listed in the order of the page
+  compare ( deleted
+    "[ol]\n[item a]\n[item b]\n[item c]\n[item d]\n[end]\n"
+    "[ol]\n[item d]\n[end]\n"
+    "deleted   [item a] in [ol], line 2\ndeleted   [item b] in [ol], line 3\ndeleted   [item c] in [ol], line 4\n"
+  )
+
+  compare ( moved
+    "[ol]\n[item Install [tt nsd]]\n[item Edit the zone]\n[item Reload it]\n[end]\n"
+    "[ol]\n[item Edit the zone]\n[item Reload it]\n[item Install [tt nsd]]\n[end]\n"
+    "moved     [item Install] in [ol], line 2 -> 4\n"
+  )
+
+  # Each page of the site is the same as itself, compiled or not
+  file ( COPY ${DATA}/ DESTINATION ${WORK} FILES_MATCHING PATTERN "*.byx" )
+
+  foreach ( page ${pages} )
+    string ( REGEX REPLACE "byx$" "pdoc" pdoc ${page} )
+    ppack ( 0 ${WORK}/${page} )
+    ppack ( 0 diff ${WORK}/${page} ${WORK}/${page} )
+    same ( "Comparing ${page} with itself" "${ppack_output}" "" )
+    ppack ( 0 diff ${WORK}/${pdoc} ${WORK}/${page} )
+  endforeach ( page )
+
+  # Pages that differ, then the arguments or a version wrong
+  ppack ( 1 diff ${WORK}/Welcome.byx ${WORK}/Labs/Labs.byx )
+  ppack ( 2 diff ${WORK}/Welcome.byx )
+  ppack ( 2 diff --no-such-option ${WORK}/Welcome.byx ${WORK}/Welcome.byx )
+  ppack ( 10 diff ${WORK}/Welcome.byx ${WORK}/Missing.byx )
+  damaged ( ${WORK}/Welcome.pdoc cut 100 diff @BAD@ ${WORK}/Welcome.byx )
+  damaged ( ${WORK}/Welcome.pdoc flip 8 diff ${WORK}/Welcome.byx @BAD@ )
+elseif ( CASE STREQUAL "query" )
+  # The same tags are found in a page, its .pdoc and its copy in an
+  # archive, whichever way the query reaches them
+  file ( COPY ${DATA}/ DESTINATION ${WORK} FILES_MATCHING PATTERN "*.byx" )
+  ppack ( 0 --archive=${WORK}/site.pak --root=${WORK} ${WORK} )
+
+  foreach ( page ${pages} )
+    ppack ( 0 ${WORK}/${page} )
+  endforeach ( page )
+
+  ppack ( 0 query /h2 Welcome.byx )
+  same ( "Query /h2" "${ppack_output}"
+    "Welcome.byx:3: [h2 Overview]\nWelcome.byx:10: [h2 Learning Material]\nWelcome.byx:20: [h2 Labs and Seminars]\n" )
+
+  ppack ( 0 query man:8 Labs/Lab3/L3_DNS.byx )
+  same ( "Query man:8" "${ppack_output}" "Labs/Lab3/L3_DNS.byx:54: [man:8 ping]\n" )
+
+  # Counts of each query in Welcome.byx and L3_DNS.byx
+  set ( counts
+    "/h2" "3,7"
+    "h2[~Aim]" "0,1"
+    "ol/item//tt" "0,14"
+    "man:1[~dig]" "0,18"
+    "item[tt][!b]" "0,11"
+    "*[~nsd]" "0,58"
+  )
+
+  list ( LENGTH counts length )
+  math ( EXPR last "${length} - 1" )
+
+  foreach ( i RANGE 0 ${last} 2 )
+    math ( EXPR j "${i} + 1" )
+    list ( GET counts ${i} query )
+    list ( GET counts ${j} expected )
+
+    foreach ( form byx pdoc )
+      ppack ( 0 query -c -j 1 ${query} Welcome.${form} Labs/Lab3/L3_DNS.${form} )
+      string ( REGEX REPLACE "[^\n]*:([0-9]+)\n" "\\1," found "${ppack_output}" )
+      same ( "Query ${query} of the .${form} pages" "${found}" "${expected}," )
+    endforeach ( form )
+
+    # Each page of the archive, in order of path, then on many threads
+    ppack ( - query ${query} site.pak:Welcome.byx site.pak:Labs/Lab3/L3_DNS.byx )
+    string ( REPLACE "site.pak:" "" archived "${ppack_output}" )
+    ppack ( - query -j 4 ${query} Welcome.byx Labs/Lab3/L3_DNS.byx )
+    same ( "Query ${query} of the archive" "${archived}" "${ppack_output}" )
+  endforeach ( i )
+
+  # No match, a query that cannot be parsed, and pages that cannot be read
+  ppack ( 1 query h2[~nowhere] Welcome.byx Welcome.pdoc site.pak )
+  ppack ( 2 query ol[ Welcome.byx )
+  ppack ( 2 query )
+  ppack ( 10 query h2 Missing.byx )
+  damaged ( ${WORK}/Welcome.pdoc flip 16 query h2 @BAD@ )
+  damaged ( ${WORK}/Welcome.pdoc cut 200 query h2 @BAD@ )
+else ( CASE STREQUAL "archive" )
+  message ( FATAL_ERROR "Unknown format case '${CASE}'" )
+endif ( CASE STREQUAL "archive" )